@@ -14,5 +14,16 @@
 
 #define PANDO_PRODUCT_KEY "8e5be54e561811fa9b403b5387add08ba184855227df729b0998d6898de57a9b"
 
+// count heap usage per framework module, see pando_mem_stat.h.
+//#define PANDO_MEM_STAT
+
+// framework log level, PD_LOG_LEVEL_NONE(0) to PD_LOG_LEVEL_DEBUG(4), see pando_log.h.
+//#define PANDO_LOG_LEVEL 3
+// keep log records in a binary ring instead of printing them.
+//#define PANDO_LOG_BINARY
+
+// record latency trace points with the cycle counter, see pando_trace.h.
+//#define PANDO_TRACE
+
 #endif
 
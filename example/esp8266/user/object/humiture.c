@@ -4,7 +4,11 @@
 #include "user_interface.h"
 #include "humiture.h"
 // add your own includes below
+#include "../../pando/framework/subdevice/pando_subdevice.h"
 #define HUMITURE_OBJECT_NO 1
+// sample every 2 seconds, report the mean of each minute.
+#define HUMITURE_SAMPLE_INTERVAL 2000
+#define HUMITURE_SAMPLE_WINDOW 30
 
 struct humiture {
 	float32 percent;
@@ -84,4 +88,5 @@ humiture_object_init() {
 		humiture_object_unpack,
 	};
 	register_pando_object(humiture_object);
+	sample_object(HUMITURE_OBJECT_NO, HUMITURE_SAMPLE_INTERVAL, HUMITURE_SAMPLE_WINDOW, PANDO_AGGREGATE_MEAN);
 }
@@ -0,0 +1,726 @@
+/*******************************************************
+ * File name: at_engine.c
+ * Author:
+ * Versions: 1.0
+ * Description: the AT command engine shared by the modem drivers.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#include "at_engine.h"
+#include <stdio.h>
+#include <string.h>
+#include "malloc.h"
+
+struct at_trie_node
+{
+	char c;
+	uint8_t child;          // first child, 0 if none
+	uint8_t next;           // next sibling, 0 if none
+	uint8_t urc;            // urc index + 1 if a prefix ends here, else 0
+};
+
+struct at_command
+{
+	uint8_t opcode;
+	union at_arg args[AT_ARG_MAX];
+	struct at_payload *payload;
+};
+
+struct at_tx
+{
+	uint8_t *data;
+	uint16_t length;
+	at_tx_release release;
+	void *arg;
+};
+
+struct at_tx_queue
+{
+	struct at_tx tx[AT_TX_QUEUE_SIZE];
+	uint8_t head;
+	uint8_t count;
+};
+
+static const struct at_engine_config *s_config = NULL;
+
+// node 0 is the root.
+static struct at_trie_node s_trie[AT_URC_NODE_MAX];
+static uint8_t s_trie_count = 0;
+
+static struct at_command s_queue[AT_QUEUE_SIZE];
+static uint8_t s_queue_head = 0;
+static uint8_t s_queue_count = 0;
+static char s_command[AT_COMMAND_MAX];
+static const struct at_command_def *s_current = NULL;
+static union at_arg s_current_args[AT_ARG_MAX];
+static struct at_payload *s_payload = NULL;
+static uint32_t s_elapsed = 0;
+
+static char s_line[AT_LINE_MAX];
+static uint8_t s_line_length = 0;
+static uint16_t s_data_remaining = 0;
+static at_data_handler s_data_handler = NULL;
+
+static const struct at_command_def *s_tx_command = NULL;
+static uint8_t s_tx_arg_count = 0;
+static struct at_tx_queue s_tx[AT_LINK_MAX];
+static uint8_t s_tx_link = 0;       // link of the last send command
+static uint8_t s_tx_batch = 0;      // buffers in the send command, 0 if none
+
+static void free_payload(struct at_payload *payload)
+{
+	if(payload == NULL)
+	{
+		return;
+	}
+
+	if(payload->buf != NULL)
+	{
+		myfree(payload->buf);
+	}
+
+	myfree(payload);
+}
+
+static uint8_t common_length(const char *a, const char *b)
+{
+	uint8_t length = 0;
+
+	while(a[length] != '\0' && a[length] == b[length])
+	{
+		length++;
+	}
+
+	return length;
+}
+
+static int8_t trie_insert(uint8_t index)
+{
+	const char *prefix = s_config->urcs[index].prefix;
+	uint8_t length = strlen(prefix);
+	uint8_t depth = 0;
+	uint8_t common = 0;
+	uint8_t node = 0;
+	uint8_t child = 0;
+	uint8_t i = 0;
+
+	// deep enough to tell the prefix apart, the rest is compared at lookup.
+	for(i = 0; i < s_config->urc_count; i++)
+	{
+		if(i != index)
+		{
+			common = common_length(prefix, s_config->urcs[i].prefix);
+			if(common + 1 > depth)
+			{
+				depth = common + 1;
+			}
+		}
+	}
+
+	if(depth > length || depth == 0)
+	{
+		depth = length;
+	}
+
+	for(i = 0; i < depth; i++)
+	{
+		for(child = s_trie[node].child; child != 0; child = s_trie[child].next)
+		{
+			if(s_trie[child].c == prefix[i])
+			{
+				break;
+			}
+		}
+
+		if(child == 0)
+		{
+			if(s_trie_count >= AT_URC_NODE_MAX)
+			{
+				return -1;
+			}
+
+			child = s_trie_count++;
+			s_trie[child].c = prefix[i];
+			s_trie[child].child = 0;
+			s_trie[child].urc = 0;
+			s_trie[child].next = s_trie[node].child;
+			s_trie[node].child = child;
+		}
+
+		node = child;
+	}
+
+	// the first of duplicate prefixes wins.
+	if(s_trie[node].urc == 0)
+	{
+		s_trie[node].urc = index + 1;
+	}
+
+	return 0;
+}
+
+// the longest urc prefix the line starts with, -1 if none.
+static int16_t urc_lookup(const char *line, uint8_t length)
+{
+	const char *prefix = NULL;
+	int16_t found = -1;
+	uint8_t node = 0;
+	uint8_t i = 0;
+
+	for(i = 0; i < length; i++)
+	{
+		for(node = s_trie[node].child; node != 0; node = s_trie[node].next)
+		{
+			if(s_trie[node].c == line[i])
+			{
+				break;
+			}
+		}
+
+		if(node == 0)
+		{
+			break;
+		}
+
+		if(s_trie[node].urc != 0)
+		{
+			prefix = s_config->urcs[s_trie[node].urc - 1].prefix;
+			if(strncmp(line, prefix, strlen(prefix)) == 0)
+			{
+				found = s_trie[node].urc - 1;
+			}
+		}
+	}
+
+	return found;
+}
+
+// the arguments a format takes, -1 if a conversion is unknown.
+static int8_t count_args(const char *format)
+{
+	int8_t count = 0;
+
+	for(format = strchr(format, '%'); format != NULL; format = strchr(format + 2, '%'))
+	{
+		if(format[1] != 'd' && format[1] != 'i' && format[1] != 's')
+		{
+			return -1;
+		}
+
+		count++;
+	}
+
+	return count;
+}
+
+static uint8_t append(char *out, uint8_t length, const char *text)
+{
+	while(*text != '\0' && length < AT_COMMAND_MAX - 1)
+	{
+		out[length++] = *text++;
+	}
+
+	return length;
+}
+
+// the command text with its arguments, cut at AT_COMMAND_MAX.
+static void format_command(char *out, const char *format, const union at_arg *args)
+{
+	char number[12];
+	uint8_t length = 0;
+	uint8_t i = 0;
+
+	for(; *format != '\0' && length < AT_COMMAND_MAX - 1; format++)
+	{
+		if(*format != '%')
+		{
+			out[length++] = *format;
+			continue;
+		}
+
+		format++;
+		if(*format == 'd')
+		{
+			sprintf(number, "%ld", (long)args->num);
+			length = append(out, length, number);
+		}
+		else if(*format == 'i')
+		{
+			for(i = 0; i < 4; i++)
+			{
+				sprintf(number, i == 0? "%d": ".%d", ((uint8_t *)&args->ip)[i]);
+				length = append(out, length, number);
+			}
+		}
+		else
+		{
+			length = append(out, length, args->str);
+		}
+
+		args++;
+	}
+
+	out[length] = '\0';
+}
+
+// the AT_MATCH_* of a reply line of the command in flight, -1 if none.
+static int8_t match_reply(const char *line)
+{
+	const struct at_match *match = s_current->matches;
+	uint8_t i = 0;
+
+	for(i = 0; i < s_current->match_count; i++, match++)
+	{
+		if(strncmp(line, match->prefix, strlen(match->prefix)) == 0)
+		{
+			return match->result;
+		}
+	}
+
+	if(strcmp(line, "OK") == 0)
+	{
+		return AT_MATCH_OK;
+	}
+
+	if(strncmp(line, "ERROR", strlen("ERROR")) == 0
+		|| strncmp(line, "+CME ERROR", strlen("+CME ERROR")) == 0)
+	{
+		return AT_MATCH_ERROR;
+	}
+
+	return -1;
+}
+
+static void tx_send(void);
+
+// hand back the first count buffers of a link.
+static void tx_release(uint8_t link, uint8_t count, int8_t error)
+{
+	struct at_tx_queue *queue = &s_tx[link];
+	struct at_tx *tx = NULL;
+
+	while(count-- > 0)
+	{
+		tx = &queue->tx[queue->head];
+		queue->head = (queue->head + 1) % AT_TX_QUEUE_SIZE;
+		queue->count--;
+		if(tx->release != NULL)
+		{
+			tx->release(tx->arg, tx->data);
+		}
+
+		if(s_config->tx_done != NULL)
+		{
+			s_config->tx_done(link, error);
+		}
+	}
+}
+
+// the send command ended.
+static void tx_complete(int8_t error)
+{
+	tx_release(s_tx_link, s_tx_batch, error);
+	s_tx_batch = 0;
+	tx_send();
+}
+
+// the data went out at the prompt, straight from the buffers.
+static void tx_write(void)
+{
+	struct at_tx_queue *queue = &s_tx[s_tx_link];
+	struct at_tx *tx = NULL;
+	uint8_t i = 0;
+
+	for(i = 0; i < s_tx_batch; i++)
+	{
+		tx = &queue->tx[(queue->head + i) % AT_TX_QUEUE_SIZE];
+		s_config->send(tx->data, tx->length);
+	}
+}
+
+// queue one send command for as many waiting buffers of a link as it takes.
+// the links take turns, so a busy one does not hold the others back. with
+// the command queue full the buffers wait for send_next to free a slot.
+static void tx_send(void)
+{
+	struct at_tx_queue *queue = NULL;
+	struct at_tx *tx = NULL;
+	union at_arg args[2];
+	uint16_t length = 0;
+	uint8_t batch = 0;
+	uint8_t link = 0;
+	uint8_t i = 0;
+
+	if(s_tx_batch != 0 || s_queue_count >= AT_QUEUE_SIZE)
+	{
+		return;
+	}
+
+	for(i = 1; i <= AT_LINK_MAX; i++)
+	{
+		link = (s_tx_link + i) % AT_LINK_MAX;
+		if(s_tx[link].count > 0)
+		{
+			break;
+		}
+	}
+
+	if(i > AT_LINK_MAX)
+	{
+		return;
+	}
+
+	queue = &s_tx[link];
+	for(batch = 0; batch < queue->count; batch++)
+	{
+		tx = &queue->tx[(queue->head + batch) % AT_TX_QUEUE_SIZE];
+		if(length + tx->length > s_config->tx_chunk_max)
+		{
+			break;
+		}
+
+		length += tx->length;
+	}
+
+	s_tx_link = link;
+	s_tx_batch = batch;
+	args[0].num = link;
+	args[1].num = length;
+	if(at_engine_queue(s_config->tx_opcode, s_tx_arg_count == 2? args: args + 1, NULL) != 0)
+	{
+		tx_complete(-1);
+	}
+}
+
+// send the next queued command unless one is in flight.
+static void send_next(void)
+{
+	struct at_command *command = NULL;
+
+	if(s_current == NULL && s_queue_count > 0)
+	{
+		command = &s_queue[s_queue_head];
+		s_queue_head = (s_queue_head + 1) % AT_QUEUE_SIZE;
+		s_queue_count--;
+		s_current = &s_config->commands[command->opcode];
+		s_payload = command->payload;
+		memcpy(s_current_args, command->args, sizeof(s_current_args));
+		s_elapsed = 0;
+		format_command(s_command, s_current->format, command->args);
+		printf("send cmd: %s", s_command);
+		s_config->send((uint8_t *)s_command, strlen(s_command));
+
+		// a slot is free, buffers that found the queue full go in.
+		tx_send();
+	}
+}
+
+static void reply(uint8_t result)
+{
+	const struct at_command_def *command = s_current;
+
+	if(command->handler != NULL)
+	{
+		command->handler(s_line, result);
+	}
+
+	if(result == AT_MATCH_OK || result == AT_MATCH_ERROR || result == AT_MATCH_TIMEOUT)
+	{
+		free_payload(s_payload);
+		s_payload = NULL;
+		s_current = NULL;
+		if(command == s_tx_command)
+		{
+			tx_complete(result == AT_MATCH_OK? 0: -1);
+		}
+
+		send_next();
+	}
+}
+
+static void send_payload(void)
+{
+	struct at_payload *payload = s_payload;
+
+	if(payload != NULL)
+	{
+		s_payload = NULL;
+		s_config->send(payload->buf, payload->length);
+		free_payload(payload);
+	}
+	else
+	{
+		tx_write();
+	}
+
+	s_line[0] = '>';
+	s_line[1] = '\0';
+	reply(AT_MATCH_PROMPT);
+}
+
+static void process_line(void)
+{
+	int16_t urc = -1;
+	int8_t result = -1;
+
+	s_line[s_line_length] = '\0';
+	if(s_line_length == 0)
+	{
+		return;
+	}
+
+	if(s_current != NULL)
+	{
+		result = match_reply(s_line);
+		if(result >= 0)
+		{
+			reply(result);
+			return;
+		}
+	}
+
+	urc = urc_lookup(s_line, s_line_length);
+	if(urc >= 0)
+	{
+		if(s_config->urcs[urc].handler != NULL)
+		{
+			s_config->urcs[urc].handler(s_line, AT_MATCH_LINE);
+		}
+
+		return;
+	}
+
+	if(s_current != NULL)
+	{
+		reply(AT_MATCH_LINE);
+		return;
+	}
+
+	printf("unhandled modem line: %s\n", s_line);
+}
+
+int8_t at_engine_init(const struct at_engine_config *config)
+{
+	uint8_t i = 0;
+
+	free_payload(s_payload);
+	// buffers of the last session, the modem lost them.
+	s_tx_batch = 0;
+	if(s_config != NULL)
+	{
+		for(i = 0; i < AT_LINK_MAX; i++)
+		{
+			at_engine_tx_flush(i);
+		}
+	}
+
+	s_config = config;
+	s_current = NULL;
+	s_payload = NULL;
+	s_line_length = 0;
+	s_data_remaining = 0;
+	// commands of the last session.
+	while(s_queue_count > 0)
+	{
+		free_payload(s_queue[s_queue_head].payload);
+		s_queue_head = (s_queue_head + 1) % AT_QUEUE_SIZE;
+		s_queue_count--;
+	}
+
+	s_tx_link = 0;
+	s_tx_command = (config->tx_chunk_max > 0 && config->tx_opcode < config->command_count)?
+		&config->commands[config->tx_opcode]: NULL;
+	if(s_tx_command != NULL)
+	{
+		s_tx_arg_count = count_args(s_tx_command->format);
+		if(s_tx_arg_count != 1 && s_tx_arg_count != 2)
+		{
+			printf("the send command takes the link and the length!\n");
+			return -1;
+		}
+	}
+
+	memset(s_trie, 0, sizeof(s_trie));
+	s_trie_count = 1;
+	for(i = 0; i < config->urc_count; i++)
+	{
+		if(trie_insert(i) != 0)
+		{
+			printf("urc table does not fit the trie!\n");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int8_t at_engine_queue(uint8_t opcode, const union at_arg *args, struct at_payload *payload)
+{
+	struct at_command *command = NULL;
+	int8_t count = -1;
+
+	if(opcode < s_config->command_count)
+	{
+		count = count_args(s_config->commands[opcode].format);
+	}
+
+	if(count < 0 || count > AT_ARG_MAX || (count > 0 && args == NULL)
+		|| s_queue_count >= AT_QUEUE_SIZE)
+	{
+		printf("queue at command %d error!\n", opcode);
+		free_payload(payload);
+		return -1;
+	}
+
+	command = &s_queue[(s_queue_head + s_queue_count) % AT_QUEUE_SIZE];
+	command->opcode = opcode;
+	if(count > 0)
+	{
+		memcpy(command->args, args, count * sizeof(union at_arg));
+	}
+
+	command->payload = payload;
+	s_queue_count++;
+	send_next();
+	return 0;
+}
+
+int8_t at_engine_tx(uint8_t link, uint8_t *data, uint16_t length, at_tx_release release, void *arg)
+{
+	struct at_tx_queue *queue = &s_tx[link];
+	struct at_tx *tx = NULL;
+
+	if(s_tx_command == NULL || link >= AT_LINK_MAX || length == 0
+		|| length > s_config->tx_chunk_max || queue->count >= AT_TX_QUEUE_SIZE)
+	{
+		return -1;
+	}
+
+	tx = &queue->tx[(queue->head + queue->count) % AT_TX_QUEUE_SIZE];
+	tx->data = data;
+	tx->length = length;
+	tx->release = release;
+	tx->arg = arg;
+	queue->count++;
+	tx_send();
+	return 0;
+}
+
+void at_engine_tx_flush(uint8_t link)
+{
+	struct at_tx_queue *queue = &s_tx[link];
+	struct at_tx *tx = NULL;
+	// a send command in flight keeps its buffers until it ends.
+	uint8_t keep = (link == s_tx_link)? s_tx_batch: 0;
+
+	while(queue->count > keep)
+	{
+		queue->count--;
+		tx = &queue->tx[(queue->head + queue->count) % AT_TX_QUEUE_SIZE];
+		if(tx->release != NULL)
+		{
+			tx->release(tx->arg, tx->data);
+		}
+
+		if(s_config->tx_done != NULL)
+		{
+			s_config->tx_done(link, -1);
+		}
+	}
+}
+
+void at_engine_input(uint8_t *data, uint16_t length)
+{
+	uint16_t span = 0;
+	int16_t urc = -1;
+	char c;
+
+	while(length > 0)
+	{
+		if(s_data_remaining > 0)
+		{
+			span = (length < s_data_remaining)? length: s_data_remaining;
+			s_data_remaining -= span;
+			if(s_data_handler != NULL)
+			{
+				s_data_handler(data, span);
+			}
+
+			data += span;
+			length -= span;
+			continue;
+		}
+
+		c = *data++;
+		length--;
+		if(c == '\n')
+		{
+			process_line();
+			s_line_length = 0;
+			continue;
+		}
+
+		if(c == '\r' || (c == ' ' && s_line_length == 0))
+		{
+			continue;
+		}
+
+		if(s_line_length < AT_LINE_MAX - 1)
+		{
+			s_line[s_line_length++] = c;
+		}
+
+		// the prompt has no line end.
+		if(c == '>' && s_line_length == 1
+			&& (s_payload != NULL || (s_current != NULL && s_current == s_tx_command)))
+		{
+			s_line_length = 0;
+			send_payload();
+		}
+		else if(c == ':')
+		{
+			s_line[s_line_length] = '\0';
+			urc = urc_lookup(s_line, s_line_length);
+			if(urc >= 0 && (s_config->urcs[urc].flags & AT_URC_HEADER))
+			{
+				s_line_length = 0;
+				s_config->urcs[urc].handler(s_line, AT_MATCH_LINE);
+			}
+		}
+	}
+}
+
+void at_engine_read_data(uint16_t length, at_data_handler handler)
+{
+	s_data_remaining = length;
+	s_data_handler = handler;
+}
+
+void at_engine_tick(uint32_t ms)
+{
+	if(s_current == NULL)
+	{
+		return;
+	}
+
+	s_elapsed += ms;
+	if(s_elapsed >= (s_current->timeout == 0? AT_TIMEOUT_DEFAULT: s_current->timeout))
+	{
+		printf("the at command %s is timeout!\n", s_current->name);
+		s_line[0] = '\0';
+		reply(AT_MATCH_TIMEOUT);
+	}
+}
+
+const union at_arg *at_engine_args(void)
+{
+	return s_current_args;
+}
+
+uint8_t at_engine_busy(void)
+{
+	return s_current != NULL || s_queue_count > 0;
+}
@@ -0,0 +1,220 @@
+/*******************************************************
+ * File name: at_engine.h
+ * Author:
+ * Versions: 1.0
+ * Description: the AT command engine shared by the modem drivers. commands
+ *              are queued as an opcode, the index of their table entry, and
+ *              a few arguments. the entry has the command text, the reply
+ *              lines it waits for and a timeout. the text is formatted only
+ *              when the command goes out, as soon as the modem answered the
+ *              previous one. unsolicited results are dispatched through a
+ *              prefix trie.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#ifndef EXAMPLE_STM32_DRIVER_AT_ENGINE_H_
+#define EXAMPLE_STM32_DRIVER_AT_ENGINE_H_
+
+#include <stdint.h>
+
+// commands waiting for the modem, each takes sizeof(struct at_command).
+#ifndef AT_QUEUE_SIZE
+#define AT_QUEUE_SIZE 8
+#endif
+
+// arguments of one command.
+#define AT_ARG_MAX 3
+
+// longest formatted command, with its CRLF.
+#define AT_COMMAND_MAX 96
+
+// longer reply lines are cut.
+#define AT_LINE_MAX 128
+
+// trie nodes for the urc prefixes, a prefix only takes nodes up to the
+// character that tells it apart from the others.
+#define AT_URC_NODE_MAX 64
+
+#define AT_TIMEOUT_DEFAULT 5000
+
+// connections the modem keeps at once, each has its own send queue.
+#ifndef AT_LINK_MAX
+#define AT_LINK_MAX 2
+#endif
+
+// data buffers of a link waiting for the send command.
+#define AT_TX_QUEUE_SIZE 8
+
+// what a reply line means to the command waiting for it.
+#define AT_MATCH_LINE    0  // an intermediate line, the command goes on
+#define AT_MATCH_OK      1  // final, the command succeeded
+#define AT_MATCH_ERROR   2  // final, the command failed
+#define AT_MATCH_PROMPT  3  // the payload went out at the modem's '>'
+#define AT_MATCH_TIMEOUT 4  // no final reply in time, line is empty
+
+// urc flags.
+#define AT_URC_HEADER 1     // dispatched at the first ':', the data follows it
+
+union at_arg
+{
+	int32_t num;            // %d
+	uint32_t ip;            // %i, the address bytes in memory order
+	const char *str;        // %s, must stay valid until the command is sent
+};
+
+// sent at the command's AT_MATCH_PROMPT.
+struct at_payload
+{
+	uint16_t length;
+	uint8_t *buf;
+};
+
+struct at_match
+{
+	const char *prefix;
+	uint8_t result;
+};
+
+// a reply line of the command, or a urc. line is terminated and has no CRLF,
+// result is the AT_MATCH_* of the line.
+typedef void (* at_line_handler)(const char *line, uint8_t result);
+
+typedef void (* at_data_handler)(uint8_t *data, uint16_t length);
+
+typedef uint16_t (* at_send_func)(uint8_t *data, uint16_t length);
+
+// gives a buffer of at_engine_tx back to its owner.
+typedef void (* at_tx_release)(void *arg, uint8_t *data);
+
+struct at_command_def
+{
+	const char *name;       // for the log
+	const char *format;     // the command with its CRLF, see union at_arg
+	// checked in order before the default "OK" and "ERROR", so a command can
+	// make "OK" an intermediate line. lines matching nothing are passed to
+	// the handler as AT_MATCH_LINE.
+	const struct at_match *matches;
+	uint8_t match_count;
+	uint32_t timeout;       // ms, 0 for AT_TIMEOUT_DEFAULT
+	at_line_handler handler;    // may be NULL
+};
+
+struct at_urc
+{
+	const char *prefix;
+	at_line_handler handler;
+	uint8_t flags;
+};
+
+struct at_engine_config
+{
+	const struct at_command_def *commands;
+	uint8_t command_count;
+	const struct at_urc *urcs;
+	uint8_t urc_count;
+	at_send_func send;
+
+	// the data send command, queued buffers of a link are sent together in
+	// one. its format takes the link and the byte count, or only the byte
+	// count if the modem has a single link. the entry ends it with
+	// AT_MATCH_OK once the data is accepted.
+	uint8_t tx_opcode;
+	uint16_t tx_chunk_max;      // most bytes one command takes, 0 if no send
+	void (* tx_done)(uint8_t link, int8_t error);   // once per buffer, in order
+};
+
+/******************************************************************************
+ * FunctionName : at_engine_init
+ * Description  : reset the engine and build the urc trie.
+ * Parameters   : config: the tables and the uart send function, kept by the
+ *                engine.
+ * Returns      : 0 if ok, -1 if the urcs do not fit AT_URC_NODE_MAX.
+*******************************************************************************/
+int8_t at_engine_init(const struct at_engine_config *config);
+
+/******************************************************************************
+ * FunctionName : at_engine_queue
+ * Description  : queue a command, it is sent right away if the modem is idle.
+ * Parameters   : opcode: the command's index in the table.
+ *                args: one for each conversion of the format, NULL if none.
+ *                payload: sent at the AT_MATCH_PROMPT reply, NULL if none.
+ *                         the engine frees it with myfree once it is sent or
+ *                         the command ended.
+ * Returns      : 0 if queued, -1 if the queue is full. the payload is freed.
+*******************************************************************************/
+int8_t at_engine_queue(uint8_t opcode, const union at_arg *args, struct at_payload *payload);
+
+/******************************************************************************
+ * FunctionName : at_engine_tx
+ * Description  : queue data for the send command. buffers of a link that wait
+ *                while a send is in flight go out together in its next one,
+ *                written to the uart straight from the caller's memory. the
+ *                links with data take turns.
+ * Parameters   : link: the modem's connection, below AT_LINK_MAX.
+ *                data: the bytes, kept by the engine until release.
+ *                length: byte count, at most tx_chunk_max.
+ *                release: called when the engine is done with data, may be
+ *                         NULL.
+ *                arg: passed to release.
+ * Returns      : 0 if queued, -1 if not, data is not released then.
+*******************************************************************************/
+int8_t at_engine_tx(uint8_t link, uint8_t *data, uint16_t length, at_tx_release release, void *arg);
+
+/******************************************************************************
+ * FunctionName : at_engine_tx_flush
+ * Description  : drop the buffers of a link that wait for a send command,
+ *                each is released and reported to tx_done with -1. a send in
+ *                flight ends on its own.
+ * Parameters   : link: the modem's connection.
+ * Returns      : none.
+*******************************************************************************/
+void at_engine_tx_flush(uint8_t link);
+
+/******************************************************************************
+ * FunctionName : at_engine_input
+ * Description  : parse the bytes received from the modem.
+ * Parameters   : data: the bytes.
+ *                length: byte count.
+ * Returns      : none.
+*******************************************************************************/
+void at_engine_input(uint8_t *data, uint16_t length);
+
+/******************************************************************************
+ * FunctionName : at_engine_read_data
+ * Description  : called from a line handler, the next bytes are data and not
+ *                lines. they go to handler in spans as they arrive.
+ * Parameters   : length: data byte count.
+ *                handler: gets the data.
+ * Returns      : none.
+*******************************************************************************/
+void at_engine_read_data(uint16_t length, at_data_handler handler);
+
+/******************************************************************************
+ * FunctionName : at_engine_tick
+ * Description  : advance the timeout of the command in flight.
+ * Parameters   : ms: the time since the last tick.
+ * Returns      : none.
+*******************************************************************************/
+void at_engine_tick(uint32_t ms);
+
+/******************************************************************************
+ * FunctionName : at_engine_args
+ * Description  : the arguments the command in flight was queued with, for its
+ *                handler.
+ * Parameters   : none.
+ * Returns      : AT_ARG_MAX arguments, the ones its format takes are set.
+*******************************************************************************/
+const union at_arg *at_engine_args(void);
+
+/******************************************************************************
+ * FunctionName : at_engine_busy
+ * Description  : whether a command is in flight or queued.
+ * Parameters   : none.
+ * Returns      : 1 if busy, else 0.
+*******************************************************************************/
+uint8_t at_engine_busy(void);
+
+#endif /* EXAMPLE_STM32_DRIVER_AT_ENGINE_H_ */
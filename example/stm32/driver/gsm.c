@@ -15,579 +15,257 @@
 #include <string.h>
 #include "delay.h"
 #include "timer4.h"
-#include "fifo.h"
+#include "at_engine.h"
 #include "stdlib.h"
 #include "malloc.h"
 #include "pando_net_tcp.h"
 #include "common_functions.h"
+#include "platform/include/pando_log.h"
 
-#define ATC_RSP_FINISH 1
-#define ATC_RSP_WAIT 0
-#define AT_MAX_RESPONSE_TIME 300
+#define GSM_TICK_MS 1000
 
-extern uint8_t g_imei_buf[16];
+// most bytes one AT+CIPSEND carries, as AT+CIPSEND? reports.
+#define GSM_TX_CHUNK_MAX 1460
 
-struct gsm_buffer{
-	uint8_t *buffer;
-	uint16_t length;
-};
+// the modem runs in single connection mode, AT+CIPMUX=0.
+#define GSM_LINK 0
+
+extern uint8_t g_imei_buf[16];
 
-static struct gsm_buffer *gsm_send_data_buffer = NULL;
 static gsm_tcp_connected_callback tcp_connect_cb = NULL;
 static gsm_tcp_sent_callback tcp_sent_cb = NULL;
 static gsm_tcp_recv_callback tcp_recv_cb = NULL;
 static gsm_tcp_disconnected_callback tcp_disconnected_cb = NULL;
+static module_http_callback http_callback = NULL;
 
-typedef int8_t (*AT_cmdHandle)(bool *urc, char* buf);
-typedef struct
-{
-    char *name;
-    AT_cmdHandle at_cmd_handle;
-}AtcHandleType;
-
-static int8_t at_handle( bool *urc, char* buf);
-static int8_t sapbr_open_hanle( bool *urc, char* buf);
-static int8_t gsn_handle( bool *urc, char* buf);
-static int8_t http_data_para_handle(bool *urc, char* buf);
-static int8_t http_action_handle(bool *urc, char*buf);
-static int8_t http_read_hanle(bool *urc, char*buf);
-static int8_t cipstart_handle(bool *urc, char*buf);
-static int8_t ipsend_handle(bool *urc, char*buf);
-static int8_t urc_handle(bool *urc, char *buf);
-static int8_t tcp_closed_handle(bool *urc, char *buf);
-
-static void at_fifo_check(void *arg);
-
-//AT command table.
-AtcHandleType  atCmdTable[ ] =
-{
-        {"ATE",  at_handle},
-        {"AT+IFC",  at_handle},
-        {"AT+CPIN",   at_handle},
-        {"AT+CSQ",  at_handle},
-		{"AT+GSN", gsn_handle},
-		{"AT+HTTPINIT", at_handle},
-		{"AT+HTTPPARA_CID", at_handle},
-		{"AT+HTTPPARA_URL", at_handle},
-		{"AT+HTTPPARA_HEAD", at_handle},
-		{"AT+HTTPSSL", at_handle},
-		{"AT+HTTPDATA_PARA", http_data_para_handle},
-		{"AT+HTTPDATA", at_handle},
-		{"AT+HTTPACTION", http_action_handle},
-		{"AT+SAPBR_TYPE", at_handle},
-		{"AT+SAPBR_APN", at_handle},
-		{"AT+SAPBR_OPEN", sapbr_open_hanle},
-		{"AT+HTTPREAD", http_read_hanle},
-		{"AT+HTTPTERM", at_handle},
-		{"AT+CSTT", at_handle},
-		{"AT+CIPSTART", cipstart_handle},
-        {"AT+CIPSEND", ipsend_handle},
-        {"AT+CIPCLOSE", at_handle}
+// the body of +HTTPREAD.
+static char *s_http_response = NULL;
+static uint16_t s_http_length = 0;
+
+static void gsn_handle(const char *line, uint8_t result);
+static void sapbr_open_handle(const char *line, uint8_t result);
+static void http_read_handle(const char *line, uint8_t result);
+static void cipstart_handle(const char *line, uint8_t result);
+static void tx_done(uint8_t link, int8_t error);
+static void urc_handle(const char *line, uint8_t result);
+static void ipd_handle(const char *line, uint8_t result);
+static void tcp_closed_handle(const char *line, uint8_t result);
+
+static void gsm_tick(void *arg);
+
+static const struct at_match http_data_para_match[] =
+{
+	{"DOWNLOAD", AT_MATCH_OK}
 };
 
-// urc table,
-AtcHandleType urc_table[] =
+// "OK" comes first, the command ends with its own result.
+static const struct at_match http_action_match[] =
 {
-	{"Call Ready",  urc_handle},
-	{"SMS Ready", urc_handle},
-	{"CLOSED", tcp_closed_handle},
-	{"+CPIN: READY", urc_handle},
-	{"RDY", urc_handle}
+	{"OK", AT_MATCH_LINE},
+	{"+HTTPACTION:", AT_MATCH_OK}
 };
 
+static const struct at_match cipstart_match[] =
+{
+	{"OK", AT_MATCH_LINE},
+	{"CONNECT OK", AT_MATCH_OK},
+	{"ALREADY CONNECT", AT_MATCH_OK},
+	{"CONNECT FAIL", AT_MATCH_ERROR}
+};
 
-struct gsm_buf{
-	uint8_t* buf;
-	uint16_t length;
+static const struct at_match cipsend_match[] =
+{
+	{"SEND OK", AT_MATCH_OK},
+	{"SEND FAIL", AT_MATCH_ERROR},
+	{"CLOSED", AT_MATCH_ERROR}
 };
 
-struct at_cmd_entity{
-	uint8_t at_name[20];
-	uint8_t at_cmd[128];
+//AT command table, indexed by enum gsm_at_opcode.
+static const struct at_command_def at_command_table[] =
+{
+	{"ATE", "ATE0\r\n", NULL, 0, 0, NULL},
+	{"AT+IFC", "AT+IFC=0\r\n", NULL, 0, 0, NULL},
+	{"AT+CPIN", "AT+CPIN?\r\n", NULL, 0, 0, NULL},
+	{"AT+CSQ", "AT+CSQ\r\n", NULL, 0, 0, NULL},
+	{"AT+GSN", "AT+GSN\r\n", NULL, 0, 0, gsn_handle},
+	{"AT+HTTPINIT", "AT+HTTPINIT\r\n", NULL, 0, 0, NULL},
+	{"AT+HTTPPARA_CID", "AT+HTTPPARA=\"CID\",1\r\n", NULL, 0, 0, NULL},
+	{"AT+HTTPPARA_URL", "AT+HTTPPARA=\"URL\",\"%s\"\r\n", NULL, 0, 0, NULL},
+	{"AT+HTTPPARA_HEAD", "AT+HTTPPARA=\"CONTENT\",\"application/json\"\r\n", NULL, 0, 0, NULL},
+	{"AT+HTTPSSL", "AT+HTTPSSL=1\r\n", NULL, 0, 0, NULL},
+	{"AT+HTTPDATA_PARA", "AT+HTTPDATA=%d,10000\r\n", http_data_para_match, 1, 0, NULL},
+	{"AT+HTTPDATA", "%s", NULL, 0, 0, NULL},
+	{"AT+HTTPACTION", "AT+HTTPACTION=1\r\n", http_action_match, 2, 30000, NULL},
+	{"AT+SAPBR_TYPE", "AT+SAPBR=3,1,\"CONTYPE\",\"GPRS\"\r\n", NULL, 0, 0, NULL},
+	{"AT+SAPBR_APN", "AT+SAPBR=3,1,\"APN\",\"CMNET\"\r\n", NULL, 0, 0, NULL},
+	{"AT+SAPBR_OPEN", "AT+SAPBR=1,1\r\n", NULL, 0, 30000, sapbr_open_handle},
+	{"AT+HTTPREAD", "AT+HTTPREAD\r\n", NULL, 0, 0, http_read_handle},
+	{"AT+HTTPTERM", "AT+HTTPTERM\r\n", NULL, 0, 0, NULL},
+	{"AT+CSTT", "AT+CSTT=\"CMNET\"\r\n", NULL, 0, 0, NULL},
+	{"AT+CIPHEAD", "AT+CIPHEAD=1\r\n", NULL, 0, 0, NULL},
+	{"AT+CIPSTART", "AT+CIPSTART=\"TCP\",\"%i\",%d\r\n", cipstart_match, 4, 30000, cipstart_handle},
+	{"AT+CIPSEND", "AT+CIPSEND=%d\r\n", cipsend_match, 3, 10000, NULL},
+	{"AT+CIPCLOSE", "AT+CIPCLOSE\r\n", NULL, 0, 0, NULL}
 };
 
-static int8_t s_gsm_status = GSM_OFF_LINE;
-static struct FIFO  s_at_fifo;
-static uint8_t s_at_status = ATC_RSP_FINISH;
-static struct at_cmd_entity *s_current_at_command = NULL;
-static GSM_HTTP_CALLBACK http_callback = NULL;
-
-static void send_at_command(const char* cmd)
-{
-	uint32_t i;
-	//TODO: replace with delay api.
-	for(i = 0; i<500; i++);
-	printf("send cmd: %s, length:%d\r\n", cmd, strlen(cmd));
-	usart2_send((uint8_t*)cmd, strlen(cmd));
-	
-}
+// urc table,
+static const struct at_urc urc_table[] =
+{
+	{"Call Ready",  urc_handle, 0},
+	{"SMS Ready", urc_handle, 0},
+	{"CLOSED", tcp_closed_handle, 0},
+	{"+CPIN: READY", urc_handle, 0},
+	{"RDY", urc_handle, 0},
+	{"+IPD,", ipd_handle, AT_URC_HEADER}
+};
 
-static int8_t urc_handle(bool *urc, char *buf)
+static const struct at_engine_config at_config =
 {
-	printf("urc handle\n");
-}
+	at_command_table,
+	sizeof(at_command_table) / sizeof(at_command_table[0]),
+	urc_table,
+	sizeof(urc_table) / sizeof(urc_table[0]),
+	usart2_send,
+	GSM_AT_CIPSEND,
+	GSM_TX_CHUNK_MAX,
+	tx_done
+};
 
-static int8_t at_handle( bool *urc, char* buf)
-{
-	// TODO: deal with urc
-	char *rep_str[ ] = {"OK","ERROR"};
-	int8_t res = -1;
-	char *p;
-	uint8_t  i = 0;
-    p= (char *)buf;
-
-    while ( '\r' == *p || '\n' == *p)
-    {
-       p++;
-    }
-
-    for (i = 0; i < sizeof(rep_str) / sizeof(rep_str[0]); i++)
-    {
-    	if (strstr( p,rep_str[i]))
-       {
-           res = i;
-           break;
-       }
-    }
-
-	switch (res)
-	{
-    	case 0:  // OK
-    	{
-           s_at_status  = ATC_RSP_FINISH;
-    	}
-    	break;
-
-        case 1: // ERROR
-        {
-           s_at_status = ATC_RSP_FINISH;
-        }
-        break;
-
-        default:
-        break;
-    }
-   	return s_at_status;
+static int8_t s_gsm_status = GSM_OFF_LINE;
+
+static void urc_handle(const char *line, uint8_t result)
+{
+	printf("urc handle: %s\n", line);
 }
 
-static int8_t gsn_handle(bool *urc, char*buf)
+static void gsn_handle(const char *line, uint8_t result)
 {
-	// TODO: deal with urc
-	char *rep_str[ ] = {"OK","ERROR"};
-	int8_t res = -1;
-	char *p;
-	uint8_t  i = 0;
 	static uint8_t flag = 0;
-    p= (char *)buf;
-    while ( '\r' == *p || '\n' == *p)
-    {
-       p++;
-    }
-	
-	if(flag == 0)
+
+	if(flag == 0 && result == AT_MATCH_LINE && line[0] >= '0' && line[0] <= '9')
 	{
-		memcpy(g_imei_buf, p, 15);
+		memcpy(g_imei_buf, line, 15);
 		g_imei_buf[15] = 0;
 		printf("the imei is %s\n", g_imei_buf);
 		flag = 1;
 	}
-	
-    for (i = 0; i < sizeof(rep_str) / sizeof(rep_str[0]); i++)
-    {
-    	if (strstr( p,rep_str[i]))
-       {
-           res = i;
-           break;
-       }
-    }
-
-	switch (res)
-    {
-    	case 0:  // OK
-    	{
-           s_at_status  = ATC_RSP_FINISH;
-    	}
-    	break;
-
-        case 1: // ERROR
-        {
-           s_at_status = ATC_RSP_FINISH;
-        }
-        break;
-
-        default:
-        break;
-    }
-   	return s_at_status;
 }
 
-static int8_t sapbr_open_hanle( bool *urc, char* buf)
-{
-	/// TODO: deal with urc
-	char *rep_str[ ] = {"OK","ERROR"};
-	int8_t res = -1;
-	char *p;
-	uint8_t  i = 0;
-    p= (char *)buf;
-
-    while ( '\r' == *p || '\n' == *p)
-    {
-       p++;
-    }
-
-    for (i = 0; i < sizeof(rep_str) / sizeof(rep_str[0]); i++)
-    {
-    	if (strstr( p,rep_str[i]))
-       {
-           res = i;
-           break;
-       }
-    }
-
-    switch (res)
-    {
-    	case 0:  // OK
-    	{
-		   s_gsm_status = GSM_GET_IP;
-           s_at_status  = ATC_RSP_FINISH;
-    	}
-    	break;
-
-        case 1: // ERROR
-        {
-			//TODO: error process.
-		   s_gsm_status = GSM_GET_IP;
-           s_at_status = ATC_RSP_FINISH;
-        }
-        break;
-
-        default:
-        break;
-    }
-
-   	return s_at_status;
+static void sapbr_open_handle(const char *line, uint8_t result)
+{
+	if(result != AT_MATCH_LINE)
+	{
+		//TODO: error process.
+		s_gsm_status = GSM_GET_IP;
+	}
 }
 
-static int8_t http_data_para_handle(bool *urc, char* buf)
-{
-	// TODO: deal with urc
-	char *rep_str[ ] = {"DOWNLOAD","ERROR"};
-	int8_t res = -1;
-	char *p;
-	uint8_t  i = 0;
-    p= (char *)buf;
-
-    while ( '\r' == *p || '\n' == *p)
-    {
-       p++;
-    }
-
-    for (i = 0; i < sizeof(rep_str) / sizeof(rep_str[0]); i++)
-    {
-    	if (strstr( p,rep_str[i]))
-       {
-           res = i;
-           break;
-       }
-    }
-
-    switch (res)
-    {
-    	case 0:  // OK
-    	{
-           s_at_status  = ATC_RSP_FINISH;
-    	}
-    	break;
-
-        case 1: // ERROR
-        {
-           s_at_status = ATC_RSP_FINISH;
-        }
-        break;
-
-        default:
-        break;
-    }
-
-   	return s_at_status;
+static void http_read_data(uint8_t *data, uint16_t length)
+{
+	memcpy(s_http_response + s_http_length, data, length);
+	s_http_length += length;
+	s_http_response[s_http_length] = '\0';
 }
 
-static int8_t http_action_handle(bool *urc, char*buf)
-{
-	// TODO: deal with urc
-	char *rep_str[ ] = {"OK","ERROR","+HTTPACTION"};
-	int8_t res = -1;
-	char *p;
-	uint8_t  i = 0;
-    p= (char *)buf;
-
-    while ( '\r' == *p || '\n' == *p)
-    {
-       p++;
-    }
-
-    for (i = 0; i < sizeof(rep_str) / sizeof(rep_str[0]); i++)
-    {
-    	if (strstr( p,rep_str[i]))
-       {
-           res = i;
-           break;
-       }
-    }
-
-   switch (res)
-    {
-    	case 0:  // OK
-    	{
-           //s_at_status  = ATC_RSP_FINISH;
-    	}
-    	break;
-
-        case 1: /* ERROR */
-        {
-		    s_at_status = ATC_RSP_FINISH;
-        }
-        break;
-
-        case 2:
-        {
-			//TODO: consider status is not 200;
-			s_at_status = ATC_RSP_FINISH;
-
-        }
-        break;
-
-        default:
-        break;
-    }
-   	return s_at_status;
-}
+// +HTTPREAD: <length>, the body follows the line, then OK.
+static void http_read_handle(const char *line, uint8_t result)
+{
+	uint16_t length = 0;
 
-static int8_t http_read_hanle(bool *urc, char*buf)
-{
-	// TODO: deal with urc
-    char *rep_str[ ] = {"OK","ERROR","+HTTPREAD: "};
-	int8_t res = -1;
-	char *p;
-	uint8_t  i = 0;
-    p= (char *)buf;
-
-    while ( '\r' == *p || '\n' == *p)
-    {
-       p++;
-    }
-
-    for (i = 0; i < sizeof(rep_str) / sizeof(rep_str[0]); i++)
-    {
-    	if (strstr( p,rep_str[i]))
-       {
-           res = i;
-           break;
-       }
-    }
-   //*urc = FALSE;
-    switch (res)
-    {
-		case 0:  /* OK */
-    	{
-			char len_str[4];
-        	char* http_response_buffer = NULL;
-        	uint16_t rsp_len;
-			p = strstr(p,"+HTTPREAD: ");
-			p = p + strlen("+HTTPREAD: ");
-			memcpy(len_str, p, 3);
-        	len_str[3] = 0;
-        	rsp_len = atoi(len_str);
-        	http_response_buffer = (char*)mymalloc(rsp_len) + 1;
-        	p = strstr(p, "{");
-        	memcpy(http_response_buffer, p, rsp_len);
-        	http_response_buffer[rsp_len] = 0;
-        	printf("http_respon_buffer:%s\n", http_response_buffer);
-        	s_at_status = ATC_RSP_FINISH;
-        	if(http_callback != NULL)
-        	{
-        		http_callback(http_response_buffer);
-        		if(http_response_buffer != NULL)
-        		{
-        			myfree(http_response_buffer);
-        			http_response_buffer = NULL;
-        		}
-        	}
-    	}
-    	break;
-        case 1: /* ERROR */
-        {
-           s_at_status = ATC_RSP_FINISH;
-        }
-        break;
-
-        case 2:
-        {
-        	
-        }
-        break;
-        default:
-        break;
-    }
-   	return s_at_status;
-}
+	if(result == AT_MATCH_LINE)
+	{
+		if(strncmp(line, "+HTTPREAD: ", strlen("+HTTPREAD: ")) == 0 && s_http_response == NULL)
+		{
+			length = atoi(line + strlen("+HTTPREAD: "));
+			s_http_response = (char *)mymalloc(length + 1);
+			if(s_http_response != NULL)
+			{
+				s_http_length = 0;
+				s_http_response[0] = '\0';
+				at_engine_read_data(length, http_read_data);
+			}
+		}
+
+		return;
+	}
 
-static int8_t cipstart_handle(bool *urc, char*buf)
-{
-	// TODO: deal with urc
-	char *rep_str[ ] = {"CONNECT OK", "ERROR", "OK"};
-	int8_t res = -1;
-	char *p;
-	uint8_t  i = 0;
-    p= (char *)buf;
-    while ( '\r' == *p || '\n' == *p)
-    {
-       p++;
-    }
-    for (i = 0; i < sizeof(rep_str) / sizeof(rep_str[0]); i++)
-    {
-    	if (strstr( p,rep_str[i]))
-       {
-           res = i;
-           break;
-       }
-    }
-
-    switch (res)
-    {
-        case 0:  // CONNECT OK.
-    	{
-    		if(tcp_connect_cb != NULL)
-    		{
-    			tcp_connect_cb(0, 0);
-    		}
-    		s_at_status = ATC_RSP_FINISH;
-    	}
-    	break;
-        case 1: // ERROR
-        {
-        	//tcp_connect_cb(conn, 1);
-        	s_at_status = ATC_RSP_FINISH;
-        }
-        break;
-        case 2:
-        {
-
-        }
-        break;
-        default:
-        //*urc = TRUE;
-        break;
-    }
-
-   	return s_at_status;
+	if(result == AT_MATCH_OK && s_http_response != NULL)
+	{
+		printf("http_respon_buffer:%s\n", s_http_response);
+		if(http_callback != NULL)
+		{
+			http_callback(s_http_response);
+		}
+	}
+
+	if(s_http_response != NULL)
+	{
+		myfree(s_http_response);
+		s_http_response = NULL;
+	}
 }
 
-int8_t ipsend_handle(bool *urc, char*buf)
+static void cipstart_handle(const char *line, uint8_t result)
 {
-	// TODO: deal with urc
-	char *rep_str[ ] = {"SEND OK","ERROR", ">", "OK", "CLOSED"};
-	int8_t res = -1;
-	char *p;
-	uint8_t  i = 0;
-    p= (char *)buf;
+	if(result != AT_MATCH_LINE && tcp_connect_cb != NULL)
+	{
+		tcp_connect_cb(0, result == AT_MATCH_OK? 0: -1);
+	}
+}
 
-	while ( '\r' == *p || '\n' == *p)
+// once per buffer of a send command.
+static void tx_done(uint8_t link, int8_t error)
+{
+	if(tcp_sent_cb != NULL)
 	{
-		p++;
+		tcp_sent_cb(0, error);
 	}
+}
+
+static void release_copy(void *arg, uint8_t *data)
+{
+	myfree(data);
+}
 
-	for (i = 0; i < sizeof(rep_str) / sizeof(rep_str[0]); i++)
+static void ipd_data(uint8_t *data, uint16_t length)
+{
+	PD_LOGD("%s\n", __func__);
+	PD_LOG_HEX(data, length);
+	if(tcp_recv_cb != NULL)
 	{
-		if (strstr( p,rep_str[i]))
-	    {
-			res = i;
-			break;
-	    }
+		tcp_recv_cb(0, data, length);
 	}
+}
+
+// +IPD,<length>: and the data, with AT+CIPHEAD=1.
+static void ipd_handle(const char *line, uint8_t result)
+{
+	int length = atoi(line + strlen("+IPD,"));
 
-	switch (res)
+	if(length > 0)
 	{
-		case 0:  //SEND OK
-	    {
-			//TODO: add respose send ok!
-	    	if(gsm_send_data_buffer != NULL)
-	    	{
-	    		if(gsm_send_data_buffer->buffer != NULL)
-	    		{
-	    			myfree(gsm_send_data_buffer->buffer);
-	    			gsm_send_data_buffer->buffer = NULL;
-	    		}
-	    	}
-	    	myfree(gsm_send_data_buffer);
-	    	gsm_send_data_buffer = NULL;
-	    	s_at_status = ATC_RSP_FINISH;
-	    	tcp_sent_cb(0,0);
-	    }
-	    break;
-
-	    case 1: //ERROR
-	    {
-	    	if(gsm_send_data_buffer != NULL)
-	    	{
-	    		if(gsm_send_data_buffer->buffer != NULL)
-	    		{
-	    			myfree(gsm_send_data_buffer->buffer);
-	    			gsm_send_data_buffer->buffer = NULL;
-	    		}
-	    	}
-	    	myfree(gsm_send_data_buffer);
-	    	gsm_send_data_buffer = NULL;
-	    	s_at_status = ATC_RSP_FINISH;
-	    	tcp_sent_cb(0,-1);
-	    	s_at_status = ATC_RSP_FINISH;
-	    }
-	    break;
-
-	    case 2:
-	    {
-	    	if(gsm_send_data_buffer != NULL)
-	    	{
-	    		printf("sending.....\n");
-	    		usart2_send(gsm_send_data_buffer->buffer, gsm_send_data_buffer->length);
-	    		//TODO:need to send ctrl+z;
-	    	}
-	    }
-	    break;
-
-	    case 3:
-	    {
-	    	
-	    }
-	    break;
-
-	    case 4:
-	    {
-	    	// TODO: free send buf and set the sending state to finish?
-	    }
-	    break;
-
-	    default:
-	    break;
-	 }
-	   	return s_at_status;
+		at_engine_read_data(length, ipd_data);
+	}
 }
 
-static int8_t tcp_closed_handle(bool *urc, char *buf)
+static void tcp_closed_handle(const char *line, uint8_t result)
 {
-	tcp_disconnected_cb(0, -1);
-	return -1;
+	if(tcp_disconnected_cb != NULL)
+	{
+		tcp_disconnected_cb(0, -1);
+	}
 }
 
 uint8_t gsm_system_start()
 {
 	s_gsm_status = GSM_START;
-	timer4_init(1000, 1, at_fifo_check);
+	usart2_register_receive_cb(gsm_data_input);
+	timer4_init(GSM_TICK_MS, 1, gsm_tick);
 	timer4_start();
 	return s_gsm_status;
 }
 
-void register_gsm_http_callback(GSM_HTTP_CALLBACK http_cb)
+void register_gsm_http_callback(module_http_callback http_cb)
 {
 	http_callback = http_cb;
 }
@@ -614,129 +292,83 @@ void register_gsm_tcp_disconnected_callback(uint16_t fd, gsm_tcp_disconnected_ca
 
 uint8_t gsm_system_init()
 {
-	FIFO_Init (&s_at_fifo);
-	char at_cmd_Buff[30] = {0};
-	char at_name_Buff[20] = {0};
+	// replies are only parsed from GSM_INIT on, the first command goes out
+	// right away.
+	s_gsm_status = GSM_INIT;
+	at_engine_init(&at_config);
 
     //ATE0, set no echo.
-    strcpy(at_name_Buff, "ATE");
-    strcpy(at_cmd_Buff, "ATE0\r\n");
-    FIFO_Put(&s_at_fifo, at_name_Buff,  at_cmd_Buff);
+    add_send_at_command(GSM_AT_ATE);
 
     //AT+IFC=0, set no flow control.
-    memset(at_cmd_Buff, 0x0, sizeof(at_cmd_Buff));
-    memset(at_name_Buff, 0x0, sizeof(at_name_Buff));
-    strcpy(at_name_Buff,"AT+IFC");
-    strcpy(at_cmd_Buff, "AT+IFC=0\r\n");
-    FIFO_Put(&s_at_fifo, at_name_Buff,  at_cmd_Buff);
+    add_send_at_command(GSM_AT_IFC);
 
     //AT+CPIN, query .....
-    memset(at_cmd_Buff, 0x0, sizeof(at_cmd_Buff));
-    memset(at_name_Buff, 0x0, sizeof(at_name_Buff));
-    strcpy(at_name_Buff,"AT+CPIN");
-    strcpy(at_cmd_Buff, "AT+CPIN?\r\n");
-    FIFO_Put(&s_at_fifo, at_name_Buff,  at_cmd_Buff);
+    add_send_at_command(GSM_AT_CPIN);
 
     //AT+CSQ
-    memset(at_cmd_Buff, 0x0, sizeof(at_cmd_Buff));
-    memset(at_name_Buff, 0x0, sizeof(at_name_Buff));
-    strcpy(at_name_Buff,"AT+CSQ");
-    strcpy(at_cmd_Buff, "AT+CSQ\r\n");     
-    FIFO_Put(&s_at_fifo, at_name_Buff,  at_cmd_Buff);
-	
+    add_send_at_command(GSM_AT_CSQ);
+
 	//AT+GSN  request for the IMEI of the gsm.
-	memset(at_cmd_Buff, 0x0, sizeof(at_cmd_Buff));
-    memset(at_name_Buff, 0x0, sizeof(at_name_Buff));
-    strcpy(at_name_Buff,"AT+GSN");
-    strcpy(at_cmd_Buff, "AT+GSN\r\n");     
-    FIFO_Put(&s_at_fifo, at_name_Buff,  at_cmd_Buff);
-	
+    add_send_at_command(GSM_AT_GSN);
+
+	//AT+CIPHEAD, received data comes as +IPD,<length>:<data>.
+    add_send_at_command(GSM_AT_CIPHEAD);
+
 	//AT+SAPBR, config type of internet connection.
-	memset(at_cmd_Buff, 0x0, sizeof(at_cmd_Buff));
-    memset(at_name_Buff, 0x0, sizeof(at_name_Buff));
-    strcpy(at_name_Buff,"AT+SAPBR_TYPE");
-    strcpy(at_cmd_Buff, "AT+SAPBR=3,1,\"CONTYPE\",\"GPRS\"\r\n");     
-    FIFO_Put(&s_at_fifo, at_name_Buff,  at_cmd_Buff);
-	
+    add_send_at_command(GSM_AT_SAPBR_TYPE);
+
 	//AT+SAPBR, config access point.
-	memset(at_cmd_Buff, 0x0, sizeof(at_cmd_Buff));
-    memset(at_name_Buff, 0x0, sizeof(at_name_Buff));
-    strcpy(at_name_Buff,"AT+SAPBR_APN");
-    strcpy(at_cmd_Buff, "AT+SAPBR=3,1,\"APN\",\"CMNET\"\r\n");     
-    FIFO_Put(&s_at_fifo, at_name_Buff,  at_cmd_Buff);
-	
+    add_send_at_command(GSM_AT_SAPBR_APN);
+
 	//AT+SAPBR, open bearer.
-	memset(at_cmd_Buff, 0x0, sizeof(at_cmd_Buff));
-    memset(at_name_Buff, 0x0, sizeof(at_name_Buff));
-    strcpy(at_name_Buff,"AT+SAPBR_OPEN");
-    strcpy(at_cmd_Buff, "AT+SAPBR=1,1\r\n");     
-    FIFO_Put(&s_at_fifo, at_name_Buff,  at_cmd_Buff);
-    
-	s_gsm_status = GSM_INIT;
+    add_send_at_command(GSM_AT_SAPBR_OPEN);
+
 	return s_gsm_status;
 }
 
-
-static void at_fifo_check(void *arg)
+// the reply to the "AT" of the tick, the bytes are not terminated.
+static uint8_t find_ok(const uint8_t *data, uint16_t length)
 {
-	static uint8_t wait_response_tick = 0;
+	uint16_t i = 0;
+
+	for(i = 0; i + 1 < length; i++)
+	{
+		if(data[i] == 'O' && data[i + 1] == 'K')
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
 
+// the commands advance on the modem's replies, the tick only syncs the
+// module and times out commands.
+static void gsm_tick(void *arg)
+{
 	if(s_gsm_status == GSM_START)
 	{
-		send_at_command("AT\r\n");
+		printf("send cmd: AT\n");
+		usart2_send((uint8_t *)"AT\r\n", strlen("AT\r\n"));
 	}
 	else if(GSM_INIT ==s_gsm_status|| GSM_INIT_DONE == s_gsm_status)
 	{
-		if ((NULL == s_current_at_command))
-		{
-			if ((!FIFO_isEmpty(&s_at_fifo)) &&(s_at_status == ATC_RSP_FINISH))
-			{
-				s_current_at_command = (struct at_cmd_entity*)malloc(sizeof(struct at_cmd_entity));
-	            if (FIFO_Get(&s_at_fifo, s_current_at_command->at_name,  s_current_at_command->at_cmd))
-	            {
-	            	s_at_status = ATC_RSP_WAIT;
-	                send_at_command(s_current_at_command->at_cmd);
-	            }
-			}
-			else
-			{
-				printf("fifo is empty or the previous at command not complete!\n");
-			}
-		}
-		else
-		{
-			printf("the at command is in sending!\n");
-			if(wait_response_tick > AT_MAX_RESPONSE_TIME)
-			{
-				printf("the at command sending is timeout!\n");
-			}
-			wait_response_tick++;
-
-		}
+		at_engine_tick(GSM_TICK_MS);
 	}
 }
 
-
-
 /******************************************************************************
  * FunctionName : add_send_at_command
- * Description  : add the at command to the send buffer.
- * Parameters   : name_buffer: the at command name
- * 				  cmd_buffer: cmd_buffer: the command.
+ * Description  : add an at command without arguments to the send queue.
+ * Parameters   : opcode: the GSM_AT_* of the command.
  * Returns      : none.
 *******************************************************************************/
-void add_send_at_command(uint8_t* name_buffer, uint8_t* cmd_buffer)
+void add_send_at_command(uint8_t opcode)
 {
-	char at_cmd_Buff[256] = {0};
-	char at_name_Buff[20] = {0};
-
-	strcpy(at_name_Buff, name_buffer);
-	strcpy(at_cmd_Buff, cmd_buffer);
-
-	FIFO_Put(&s_at_fifo, at_name_Buff,  at_cmd_Buff);
+	at_engine_queue(opcode, NULL, NULL);
 }
 
-
 /******************************************************************************
  * FunctionName : get_gsm_status
  * Description  : get the status of the gsm.
@@ -769,103 +401,41 @@ void set_gsm_status(int8_t status)
 *******************************************************************************/
 void gsm_send_data(uint16_t fd, uint8_t *buf, uint16_t len)
 {
-	if(gsm_send_data_buffer == NULL)
-	{
-		gsm_send_data_buffer = (struct gsm_buffer *)mymalloc(sizeof(struct gsm_buffer));
-		gsm_send_data_buffer->length = len;
-		gsm_send_data_buffer->buffer = (uint8_t*)mymalloc(len);
-		memcpy(gsm_send_data_buffer->buffer, buf, len);
-	}
-	char command_buffer[48];
-	sprintf(command_buffer, "AT+CIPSEND=%d\r\n", len);
-	add_send_at_command("AT+CIPSEND", command_buffer);
-}
+	uint8_t *copy = (uint8_t *)mymalloc(len);
 
-static int8_t urc_process(uint8_t* data)
-{
-	// is urc.
-	uint8_t i= 0;
-	uint8_t urc = 0;
-	for (i = 0; i <sizeof(urc_table)/sizeof(urc_table[0]); i++)
+	if(copy != NULL)
 	{
-		if(strstr(data, urc_table[i].name))
+		memcpy(copy, buf, len);
+		if(at_engine_tx(GSM_LINK, copy, len, release_copy, NULL) == 0)
 		{
-			urc_table[i].at_cmd_handle(&urc, data);
-			return 0;
+			return;
 		}
+
+		myfree(copy);
 	}
 
-	return -1;
+	printf("%s, drop %d\n", __func__, len);
+	if(tcp_sent_cb != NULL)
+	{
+		tcp_sent_cb(fd, -1);
+	}
 }
 
-int8_t gsm_data_handler(void* data)
+void gsm_data_input(uint8_t *data, uint16_t length)
 {
-
-	uint8_t urc = 0;
-	struct gsm_buf* gsm_data = (struct gsm_buf*)data;
-	printf("gsm response:%s\n", gsm_data->buf);
-	show_package(gsm_data->buf, gsm_data->length);
-	if(gsm_data->length < 3)
-	{
-		printf("gsm response not enough length!");
-		if(gsm_data->buf != NULL)
-		{
-			free(gsm_data->buf);
-			gsm_data->buf = NULL;
-		}
-		return -1;
-	}
+	PD_LOGD("gsm response:%d\n", length);
+	PD_LOG_HEX(data, length);
 	if(GSM_START == s_gsm_status)
 	{
-		if((strstr(gsm_data->buf, "OK")))
+		if(find_ok(data, length))
 		{
 			printf("the \"at\" cmd response \"OK\"\n");
 			s_gsm_status = GSM_SYNC;
 		}
 	}
-	if (GSM_INIT ==s_gsm_status|| GSM_INIT_DONE == s_gsm_status)
-	{
-		int i = 0;
-		if (NULL != s_current_at_command)
-	    {
-			for (i = 0; i <sizeof(atCmdTable)/sizeof(atCmdTable[0]); i++)
-	        {
-				if(!strcmp(s_current_at_command->at_name, atCmdTable[i].name))
-	            {
-					s_at_status =atCmdTable[i].at_cmd_handle(&urc, gsm_data->buf);
-
-	                if (ATC_RSP_FINISH ==s_at_status)
-	                {
-	                	free(s_current_at_command);
-	                    s_current_at_command = NULL;
-	                }
-
-	                break;
-	            }
-	        }
-		}
-		else
-		{
-			if(urc_process(gsm_data->buf) == -1) // not urc.
-			{
-				printf("%s\n, __func__");
-				show_package(gsm_data->buf, gsm_data->length);
-				tcp_recv_cb(0, gsm_data->buf, (gsm_data->length)-1); // -1 for identifier of string end.
-			}
 
-		}
-	}
-
-	if(gsm_data != NULL)
+	if (GSM_INIT ==s_gsm_status|| GSM_INIT_DONE == s_gsm_status)
 	{
-		if(gsm_data->buf != NULL)
-		{
-			free(gsm_data->buf);
-			gsm_data->buf = NULL;
-		}
-		free(gsm_data);
-		gsm_data = NULL;
+		at_engine_input(data, length);
 	}
-
-	return 0;
 }
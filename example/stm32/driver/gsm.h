@@ -20,6 +20,34 @@
 #define GSM_GET_IP  3
 #define GSM_INIT_DONE 4
 
+// the at commands, in the order of the driver's command table.
+enum gsm_at_opcode
+{
+	GSM_AT_ATE = 0,
+	GSM_AT_IFC,
+	GSM_AT_CPIN,
+	GSM_AT_CSQ,
+	GSM_AT_GSN,
+	GSM_AT_HTTPINIT,
+	GSM_AT_HTTPPARA_CID,
+	GSM_AT_HTTPPARA_URL,
+	GSM_AT_HTTPPARA_HEAD,
+	GSM_AT_HTTPSSL,
+	GSM_AT_HTTPDATA_PARA,
+	GSM_AT_HTTPDATA,
+	GSM_AT_HTTPACTION,
+	GSM_AT_SAPBR_TYPE,
+	GSM_AT_SAPBR_APN,
+	GSM_AT_SAPBR_OPEN,
+	GSM_AT_HTTPREAD,
+	GSM_AT_HTTPTERM,
+	GSM_AT_CSTT,
+	GSM_AT_CIPHEAD,
+	GSM_AT_CIPSTART,
+	GSM_AT_CIPSEND,
+	GSM_AT_CIPCLOSE
+};
+
 
 typedef void (* module_http_callback)(char* response);
 typedef void(*gsm_tcp_connected_callback)(int16_t fd, int8_t error_no);
@@ -48,20 +76,21 @@ uint8_t gsm_system_start(void);
 
 /******************************************************************************
  * FunctionName : add_send_at_command
- * Description  : add the at command to the send buffer.
- * Parameters   : name_buffer: the at command name
- * 				  cmd_buffer: cmd_buffer: the command.
+ * Description  : add an at command without arguments to the send queue.
+ * Parameters   : opcode: the GSM_AT_* of the command.
  * Returns      : none.
 *******************************************************************************/
-void add_send_at_command(char *name_buffer, char *cmd_buffer);
+void add_send_at_command(uint8_t opcode);
 
 /******************************************************************************
- * FunctionName : gsm_handler
- * Description  : the gsm response data process handler.
- * Parameters   : data : the gsm response data, include data and length. 
+ * FunctionName : gsm_data_input
+ * Description  : the gsm response data process handler, usart2 calls it
+ *                from the main loop.
+ * Parameters   : data: the received bytes, not terminated.
+ *                length: byte count.
  * Returns      : none.
 *******************************************************************************/
-int8_t gsm_data_handler(void* data);
+void gsm_data_input(uint8_t *data, uint16_t length);
 
 /******************************************************************************
  * FunctionName : gsm_system_init
@@ -71,7 +100,7 @@ int8_t gsm_data_handler(void* data);
 *******************************************************************************/
 uint8_t gsm_system_init(void);
 
-//void register_gsm_http_callback(GSM_HTTP_CALLBACK http_cb);
+void register_gsm_http_callback(module_http_callback http_cb);
 
 
 void register_gsm_tcp_connect_callback(uint16_t fd, gsm_tcp_disconnected_callback connect_cb);
@@ -86,7 +115,7 @@ void module_http_post(char *url, const char* data, module_http_callback http_cb)
 
 /******************************************************************************
  * FunctionName : gsm_send_data
- * Description  : gsm send data api.
+ * Description  : gsm send data api, the data is copied.
  * Parameters   : fd: the send connect index.
  * 				  buf: the send data.
  * 				  length: the send length.
@@ -1,5 +1,6 @@
 #include "malloc.h"
 #include <stdio.h>
+#include "platform/include/pando_log.h"
 //////////////////////////////////////////////////////////////////////////////////	 
 //������ֻ��ѧϰʹ�ã�δ��������ɣ��������������κ���;
 //ALIENTEK MiniSTM32������
@@ -71,6 +72,23 @@ u8 mem_perused(void)
     } 
     return (used*100)/(memtblsize);  
 }  
+//get the largest run of free blocks, in bytes.
+u32 mem_max_free(void)
+{
+    u32 cmemb=0;
+    u32 max_cmemb=0;
+    u32 i;
+    for(i=0;i<memtblsize;i++)
+    {
+        if(!mallco_dev.memmap[i])
+        {
+            cmemb++;
+            if(cmemb>max_cmemb)max_cmemb=cmemb;
+        }
+        else cmemb=0;
+    }
+    return max_cmemb*memblksize;
+}
 //�ڴ����(�ڲ�����)
 
 //memx:�����ڴ��
@@ -78,8 +96,7 @@ u8 mem_perused(void)
 //����ֵ:0XFFFFFFFF,�������;����,�ڴ�ƫ�Ƶ�ַ
 u32 mem_malloc(u32 size)  
 {  
-	uint8_t mem_used = mem_perused();
-	printf("%s the used heap is %d %\n", __func__, mem_used);
+	PD_LOGD("%s the used heap is %d%%\n", __func__, mem_perused());
     signed long offset=0;  
     u16 nmemb;	//��Ҫ���ڴ����
 	u16 cmemb=0;//�������ڴ����
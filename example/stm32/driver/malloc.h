@@ -43,6 +43,7 @@ void mem_init(void);					 //
 u32 mem_malloc(u32 size);		 		//ڴ(ڲ)
 u8 mem_free(u32 offset);		 		//ڴͷ(ڲ)
 u8 mem_perused(void);					//ڴʹ(/ڲ) 
+u32 mem_max_free(void);					//largest free run in bytes
 ////////////////////////////////////////////////////////////////////////////////
 //ûú
 void myfree(void *ptr);  				//ڴͷ(ⲿ)
@@ -15,28 +15,34 @@
 #include <string.h>
 #include "delay.h"
 #include "timer4.h"
-#include "fifo.h"
+#include "at_engine.h"
 #include "stdlib.h"
 #include "malloc.h"
 #include "pando_net_tcp.h"
 #include "common_functions.h"
-
-#define ATC_RSP_FINISH 1
-#define ATC_RSP_WAIT 0
-#define AT_MAX_RESPONSE_TIME 300
+#include "platform/include/pando_log.h"
 
 // Suport different Content-Type header
 #define HTTP_HEADER_CONTENT_TYPE "application/json"
 #define MAX_HTTP_SIZE 1000
 
-uint8_t g_imei_buf[16];
+#define MODULE_TICK_MS 1000
 
-struct module_buffer{
-	uint8_t *buffer;
-	uint16_t length;
-};
+// the response of a post ends when the server closes the session.
+#define MODULE_HTTP_TIMEOUT_MS 30000
+
+// most bytes one AT+CCHSEND carries, queued packets are sent together.
+#define MODULE_TX_CHUNK_MAX 1024
+
+// a link is a CCH session of the modem, its owner is the fd + 1 of the tcp
+// connection on it, or one of these.
+#define LINK_FREE 0
+#define LINK_HTTP 0xffff
+
+#define MATCH_COUNT(matches) (sizeof(matches) / sizeof((matches)[0]))
+
+uint8_t g_imei_buf[16];
 
-static struct module_buffer *module_send_data_buffer = NULL;
 static module_tcp_connected_callback tcp_connect_cb = NULL;
 static module_tcp_sent_callback tcp_sent_cb = NULL;
 static module_tcp_recv_callback tcp_recv_cb = NULL;
@@ -45,744 +51,467 @@ static module_http_callback s_http_cb = NULL;
 
 static uint8_t s_csq_value = 0;
 static char s_http_buffer[MAX_HTTP_SIZE];
+// AT+CCHOPEN reads it when it goes out.
+static char s_http_host[64];
+static uint16_t s_http_data_len = 0;
+static uint8_t s_http_link = 0;
+static uint32_t s_http_wait_ms = 0;
 
-typedef int8_t (*AT_cmdHandle)(bool *urc, char* buf);
-typedef struct
-{
-    char *name;
-    AT_cmdHandle at_cmd_handle;
-}AtcHandleType;
+static uint16_t s_link_owner[AT_LINK_MAX];
+static uint8_t s_recv_link = 0;
 
 // general handle.
-static int8_t at_handle( bool *urc, char* buf);
-static int8_t ate_handle(bool *urc, char* buf);
-static int8_t csq_handle(bool *urc, char*buf);
+static void csq_handle(const char *line, uint8_t result);
+static void gsn_handle(const char *line, uint8_t result);
 
 // net open handle.
-static int8_t net_open_hanle( bool *urc, char* buf);
-static int8_t gsn_handle( bool *urc, char* buf);
+static void net_open_handle(const char *line, uint8_t result);
 
 // http handle.
-/*static int8_t http_send_handle(bool *urc, char*buf);
-static int8_t http_read_handle(bool *urc, char*buf);*/
-static int8_t cch_open_handle(bool *urc, char*buf);
-static int8_t cch_send_handle(bool *urc, char*buf);
+static void cch_open_handle(const char *line, uint8_t result);
+static void cch_send_handle(const char *line, uint8_t result);
 
 // tcp handle.
-static int8_t tcp_connect_handle(bool *urc, char*buf);
-static int8_t ipsend_handle(bool *urc, char*buf);
-static int8_t urc_handle(bool *urc, char *buf);
-static int8_t tcp_closed_handle(bool *urc, char *buf);
-static int8_t tcp_disconnect_handle(bool *urc, char *buf);
+static void cip_open_handle(const char *line, uint8_t result);
+static void tcp_connect_handle(const char *line, uint8_t result);
+static void tx_done(uint8_t link, int8_t error);
+static void urc_handle(const char *line, uint8_t result);
+static void cch_recv_handle(const char *line, uint8_t result);
+static void peer_closed_handle(const char *line, uint8_t result);
 
-static void at_fifo_check(void *arg);
+static void module_tick(void *arg);
 
-//AT command table.
-AtcHandleType  atCmdTable[ ] =
+// "OK" comes first, the command ends with its own result.
+static const struct at_match net_open_match[] =
 {
-        {"ATE",  ate_handle},
-        {"AT+IFC",  at_handle},
-        {"AT+CPIN",   at_handle},
-        {"AT+CSQ",  csq_handle},
-		{"AT+GSN", gsn_handle},
-		{"AT+CGSOCKCONT", at_handle},
-		{"AT+CIPMODE", at_handle},
-		{"AT+NETOPEN", net_open_hanle},
-
-		// creat connect.
-		{"AT+SAPBR_TYPE", at_handle},
-		{"AT+SAPBR_APN", at_handle},
-		{"AT+SAPBR_OPEN", net_open_hanle},
-
-		// https use CCH.
-		{"AT+CCHSET", at_handle},
-		{"AT+CCHSTART", at_handle},
-		{"AT+CCHOPEN", cch_open_handle},
-		{"AT+CCHSEND", cch_send_handle},
-		{"AT+CCHCLOSE", at_handle}, // TODO: consider response after OK.
-		{"AT+CCHSTOP", at_handle},
-
-		// tcp
-		{"AT+CIPHEAD", at_handle},
-		{"AT+CIPOPEN", tcp_connect_handle},
-        {"AT+CIPSEND", ipsend_handle},
-        {"AT+CIPCLOSE", at_handle},
-		{"AT+CIPSRIP", at_handle},
-
-        // tls
-        {"AT+CCHOPEN_TLS", tcp_connect_handle},
-		{"AT+CCHSEND_TLS", ipsend_handle}
+	{"OK", AT_MATCH_LINE},
+	{"+NETOPEN:", AT_MATCH_OK}
 };
 
-// urc table,
-AtcHandleType urc_table[] =
+static const struct at_match cch_open_match[] =
+{
+	{"OK", AT_MATCH_LINE},
+	{"+CCHOPEN:", AT_MATCH_OK}
+};
+
+// a closed session is left to its urc, it may be another link's.
+static const struct at_match cch_send_match[] =
 {
-	{"START", urc_handle},
-	{"CALL READY",  urc_handle},
-	{"SMS Ready", urc_handle},
-	//{"CLOSED", tcp_closed_handle},
-	{"+CPIN: READY", urc_handle},
-	{"+STIN:", urc_handle},
-	{"RDY", urc_handle},
-	{"OPL UPDATING", urc_handle},
-	{"PNN UPDATING", urc_handle},
-	{"SMS DONE", urc_handle},
-	{"PB DONE", urc_handle},
-	{"+CHTTPS:RECV EVENT", urc_handle},
-	{"+CHTTPSNOTIFY: PEER CLOSED", urc_handle},
-	{"+STIN:", urc_handle},
-	{"+CCH_PEER_CLOSED:", urc_handle},
-	{"+IPCLOSE:", tcp_disconnect_handle}
+	{"OK", AT_MATCH_LINE},
+	{"+CCHSEND:", AT_MATCH_OK}
 };
 
+static const struct at_match cip_open_match[] =
+{
+	{"OK", AT_MATCH_LINE},
+	{"+CIPOPEN:", AT_MATCH_OK}
+};
 
-struct module_buf{
-	uint8_t* buf;
-	uint16_t length;
+static const struct at_match cip_send_match[] =
+{
+	{"OK", AT_MATCH_LINE},
+	{"+CIPSEND:", AT_MATCH_OK}
 };
 
-struct at_cmd_entity{
-	char at_name[20];
-	char at_cmd[128];
+//AT command table, indexed by enum module_at_opcode.
+static const struct at_command_def at_command_table[] =
+{
+	{"ATE", "ATE0\r\n", NULL, 0, 0, NULL},
+	{"AT+IFC", "AT+IFC=0\r\n", NULL, 0, 0, NULL},
+	{"AT+CPIN", "AT+CPIN?\r\n", NULL, 0, 0, NULL},
+	{"AT+CSQ", "AT+CSQ\r\n", NULL, 0, 0, csq_handle},
+	{"AT+GSN", "AT+GSN\r\n", NULL, 0, 0, gsn_handle},
+	{"AT+CGSOCKCONT", "AT+CGSOCKCONT=1,\"IP\",\"CMNET\"\r\n", NULL, 0, 0, NULL},
+	{"AT+CIPMODE", "AT+CIPMODE=0\r\n", NULL, 0, 0, NULL},
+	{"AT+NETOPEN", "AT+NETOPEN\r\n", net_open_match, MATCH_COUNT(net_open_match), 30000, net_open_handle},
+
+	// https use CCH.
+	{"AT+CCHSET", "AT+CCHSET=1\r\n", NULL, 0, 0, NULL},
+	{"AT+CCHSTART", "AT+CCHSTART\r\n", NULL, 0, 0, NULL},
+	{"AT+CCHOPEN", "AT+CCHOPEN=%d,\"%s\",443\r\n", cch_open_match, MATCH_COUNT(cch_open_match), 30000, cch_open_handle},
+	{"AT+CCHSEND", "AT+CCHSEND=%d,%d\r\n", cch_send_match, MATCH_COUNT(cch_send_match), 30000, cch_send_handle},
+	{"AT+CCHCLOSE", "AT+CCHCLOSE=%d\r\n", NULL, 0, 0, NULL}, // TODO: consider response after OK.
+	{"AT+CCHSTOP", "AT+CCHSTOP\r\n", NULL, 0, 0, NULL},
+
+	// tcp
+	{"AT+CIPHEAD", "AT+CIPHEAD=1\r\n", NULL, 0, 0, NULL},
+	{"AT+CIPOPEN", "AT+CIPOPEN=0,\"TCP\",\"%i\",%d\r\n", cip_open_match, MATCH_COUNT(cip_open_match), 30000, cip_open_handle},
+	{"AT+CIPSEND", "AT+CIPSEND=0,%d\r\n", cip_send_match, MATCH_COUNT(cip_send_match), 10000, NULL},
+	{"AT+CIPCLOSE", "AT+CIPCLOSE=0\r\n", NULL, 0, 0, NULL},
+	{"AT+CIPSRIP", "AT+CIPSRIP=0\r\n", NULL, 0, 0, NULL},
+
+	// tls
+	{"AT+CCHOPEN_TLS", "AT+CCHOPEN=%d,\"%i\",%d,2\r\n", cch_open_match, MATCH_COUNT(cch_open_match), 30000, tcp_connect_handle},
+	{"AT+CCHSEND_TLS", "AT+CCHSEND=%d,%d\r\n", cch_send_match, MATCH_COUNT(cch_send_match), 10000, NULL}
+};
+
+// urc table,
+static const struct at_urc urc_table[] =
+{
+	{"START", urc_handle, 0},
+	{"CALL READY", urc_handle, 0},
+	{"SMS Ready", urc_handle, 0},
+	{"+CPIN: READY", urc_handle, 0},
+	{"+STIN:", urc_handle, 0},
+	{"RDY", urc_handle, 0},
+	{"OPL UPDATING", urc_handle, 0},
+	{"PNN UPDATING", urc_handle, 0},
+	{"SMS DONE", urc_handle, 0},
+	{"PB DONE", urc_handle, 0},
+	{"+CHTTPS:RECV EVENT", urc_handle, 0},
+	{"+CHTTPSNOTIFY: PEER CLOSED", urc_handle, 0},
+	{"+CCH_PEER_CLOSED:", peer_closed_handle, 0},
+	{"+CCHRECV:", cch_recv_handle, 0},
+	{"+IPCLOSE:", urc_handle, 0}
+};
+
+static const struct at_engine_config at_config =
+{
+	at_command_table,
+	sizeof(at_command_table) / sizeof(at_command_table[0]),
+	urc_table,
+	sizeof(urc_table) / sizeof(urc_table[0]),
+	usart2_send,
+	MODULE_AT_CCHSEND_TLS,
+	MODULE_TX_CHUNK_MAX,
+	tx_done
 };
 
 static int8_t s_module_status = MODULE_OFF_LINE;
-static struct FIFO  s_at_fifo;
-static uint8_t s_at_status = ATC_RSP_FINISH;
-static struct at_cmd_entity *s_current_at_command = NULL;
 
-static void send_at_command(const char* cmd)
+static void urc_handle(const char *line, uint8_t result)
 {
-	uint32_t i;
-	//TODO: replace with delay api.
-	for(i = 0; i<500; i++);
-	printf("send cmd: %s, length:%d\r\n", cmd, strlen(cmd));
-	usart2_send((uint8_t*)cmd, strlen(cmd));
+	printf("urc handle: %s\n", line);
+}
 
+static void csq_handle(const char *line, uint8_t result)
+{
+	if(result == AT_MATCH_LINE && strncmp(line, "+CSQ: ", strlen("+CSQ: ")) == 0)
+	{
+		s_csq_value = atol(line + strlen("+CSQ: "));
+		printf("csq:%d\n", s_csq_value);
+	}
 }
 
-static int8_t urc_handle(bool *urc, char *buf)
+static void gsn_handle(const char *line, uint8_t result)
 {
-	printf("urc handle\n");
-	return 0;
+	static uint8_t flag = 0;
+
+	if(flag == 0 && result == AT_MATCH_LINE && line[0] >= '0' && line[0] <= '9')
+	{
+		memcpy(g_imei_buf, line, 15);
+		g_imei_buf[15] = 0;
+		printf("the imei is %s\n", g_imei_buf);
+		flag = 1;
+	}
 }
 
-static int8_t at_handle( bool *urc, char* buf)
+static void net_open_handle(const char *line, uint8_t result)
 {
-	// TODO: deal with urc
-	char *rep_str[ ] = {"OK","ERROR"};
-	int8_t res = -1;
-	char *p;
-	uint8_t  i = 0;
-    p= (char *)buf;
-
-    while ( '\r' == *p || '\n' == *p)
-    {
-       p++;
-    }
-
-    for (i = 0; i < sizeof(rep_str) / sizeof(rep_str[0]); i++)
-    {
-    	if (strstr( p,rep_str[i]))
-       {
-           res = i;
-           break;
-       }
-    }
-
-	switch (res)
+	if(result != AT_MATCH_LINE)
 	{
-    	case 0:  // OK
-    	{
-           s_at_status  = ATC_RSP_FINISH;
-    	}
-    	break;
-
-        case 1: // ERROR
-        {
-           s_at_status = ATC_RSP_FINISH;
-        }
-        break;
-
-        default:
-        break;
-    }
-   	return s_at_status;
+		//TODO: error process.
+		s_module_status = MODULE_GET_IP;
+	}
 }
 
-static int8_t ate_handle(bool *urc, char* buf)
+// a free session for the owner, the CCH service starts with the first.
+static int8_t link_open(uint16_t owner)
 {
-	// TODO: deal with urc
-	char *rep_str[ ] = {"OK","ERROR", "ATE"};
-	int8_t res = -1;
-	char *p;
-	uint8_t  i = 0;
-	p= (char *)buf;
-	while ( '\r' == *p || '\n' == *p)
+	int8_t found = -1;
+	uint8_t used = 0;
+	uint8_t link = 0;
+
+	for(link = 0; link < AT_LINK_MAX; link++)
 	{
-		p++;
+		if(s_link_owner[link] != LINK_FREE)
+		{
+			used++;
+		}
+		else if(found < 0)
+		{
+			found = link;
+		}
 	}
 
-	for (i = 0; i < sizeof(rep_str) / sizeof(rep_str[0]); i++)
+	if(found < 0)
 	{
-		if (strstr( p,rep_str[i]))
-	    {
-			res = i;
-	        break;
-	    }
+		return -1;
 	}
 
-	switch (res)
+	if(used == 0)
 	{
-		case 0:  // OK
-	    {
-	    	s_at_status  = ATC_RSP_FINISH;
-	    }
-	    break;
-
-	    case 1: // ERROR
-	    {
-	    	s_at_status = ATC_RSP_FINISH;
-	    }
-	    break;
-
-	    case 2: // ATE
-	    {
-
-	    }
-	    break;
-
-	    default:
-	    break;
+		add_send_at_command(MODULE_AT_CCHSET);
+		add_send_at_command(MODULE_AT_CCHSTART);
 	}
-	return s_at_status;
+
+	s_link_owner[found] = owner;
+	return found;
 }
 
-static int8_t csq_handle(bool *urc, char*buf)
+// the CCH service stops with the last session. the commands run in queue
+// order, so the session can be opened again right away.
+static void link_close(uint8_t link)
 {
-	// TODO: deal with urc
-	char *rep_str[ ] = {"OK","ERROR", "+CSQ: "};
-	int8_t res = -1;
-	char *p;
-	uint8_t  i = 0;
-	p= (char *)buf;
-
-	while ( '\r' == *p || '\n' == *p)
+	union at_arg arg;
+
+	at_engine_tx_flush(link);
+	arg.num = link;
+	at_engine_queue(MODULE_AT_CCHCLOSE, &arg, NULL);
+	s_link_owner[link] = LINK_FREE;
+	for(link = 0; link < AT_LINK_MAX; link++)
 	{
-		p++;
+		if(s_link_owner[link] != LINK_FREE)
+		{
+			return;
+		}
 	}
 
-	for (i = 0; i < sizeof(rep_str) / sizeof(rep_str[0]); i++)
+	add_send_at_command(MODULE_AT_CCHSTOP);
+}
+
+static int8_t link_of(uint16_t fd)
+{
+	uint8_t link = 0;
+
+	for(link = 0; link < AT_LINK_MAX; link++)
 	{
-		if (strstr( p,rep_str[i]))
-	    {
-			res = i;
-	        break;
-	    }
+		if(s_link_owner[link] == fd + 1)
+		{
+			return link;
+		}
 	}
 
-	switch (res)
+	return -1;
+}
+
+// the tcp connection of a link, -1 if it has none.
+static int16_t link_fd(uint8_t link)
+{
+	if(link >= AT_LINK_MAX || s_link_owner[link] == LINK_FREE
+		|| s_link_owner[link] == LINK_HTTP)
 	{
-		case 0:  // OK
-	    {
-			printf("csq:%s\n", p);
-			p = strstr(p, "+CSQ: ");
-	    	s_csq_value = atol(p + strlen("+CSQ: "));
-			printf("%d\n", s_csq_value);
-	    	s_at_status = ATC_RSP_FINISH;
-	    }
-	    break;
-
-	    case 1: // ERROR
-	    {
-	    	//TODO: error process.
-	        s_at_status = ATC_RSP_FINISH;
-	    }
-	    break;
-
-	    case 2:
-	    {
-			printf("csq:%s", p);
-	    	s_csq_value = atol(p + sizeof("+CSQ: "));
-	    }
-	    break;
-
-	    default:
-			
-	    break;
+		return -1;
 	}
-	return s_at_status;
+
+	return s_link_owner[link] - 1;
 }
 
-static int8_t gsn_handle(bool *urc, char*buf)
+static void http_finish(char *response)
 {
-	// TODO: deal with urc
-	char *rep_str[ ] = {"OK","ERROR"};
-	int8_t res = -1;
-	char *p;
-	uint8_t  i = 0;
-	static uint8_t flag = 0;
-    p= (char *)buf;
-    while ( '\r' == *p || '\n' == *p)
-    {
-       p++;
-    }
+	module_http_callback http_cb = s_http_cb;
 
-	if(flag == 0)
+	if(http_cb == NULL)
 	{
-		memcpy(g_imei_buf, p, 15);
-		g_imei_buf[15] = 0;
-		printf("the imei is %s\n", g_imei_buf);
-		flag = 1;
+		return;
 	}
 
-    for (i = 0; i < sizeof(rep_str) / sizeof(rep_str[0]); i++)
-    {
-    	if (strstr( p,rep_str[i]))
-       {
-           res = i;
-           break;
-       }
-    }
-
-	switch (res)
-    {
-    	case 0:  // OK
-    	{
-           s_at_status  = ATC_RSP_FINISH;
-    	}
-    	break;
-
-        case 1: // ERROR
-        {
-           s_at_status = ATC_RSP_FINISH;
-        }
-        break;
-
-        default:
-        break;
-    }
-   	return s_at_status;
+	s_http_cb = NULL;
+	s_http_data_len = 0;
+	s_http_wait_ms = 0;
+	link_close(s_http_link);
+	if(http_cb != NULL)
+	{
+		http_cb(response);
+	}
 }
 
-static int8_t net_open_hanle( bool *urc, char* buf)
+static void cch_open_handle(const char *line, uint8_t result)
 {
-	// TODO: deal with urc
-	char *rep_str[ ] = {"OK","ERROR", /*"+NETOPEN: 0"*/ "+NETOPEN:"};
-	int8_t res = -1;
-	char *p;
-	uint8_t  i = 0;
-    p= (char *)buf;
-
-    while ( '\r' == *p || '\n' == *p)
-    {
-       p++;
-    }
-
-    for (i = 0; i < sizeof(rep_str) / sizeof(rep_str[0]); i++)
-    {
-    	if (strstr( p,rep_str[i]))
-       {
-           res = i;
-           break;
-       }
-    }
-
-    switch (res)
-    {
-    	case 0:  // OK
-    	{
-
-    	}
-    	break;
-
-        case 1: // ERROR
-        {
-			//TODO: error process.
-		   s_module_status = MODULE_GET_IP;
-           s_at_status = ATC_RSP_FINISH;
-        }
-        break;
-
-        case 2:
-        {
-            s_module_status = MODULE_GET_IP;
-            s_at_status  = ATC_RSP_FINISH;
-        }
-        break;
-
-        default:
-        break;
-    }
-
-   	return s_at_status;
+	if(result == AT_MATCH_ERROR || result == AT_MATCH_TIMEOUT
+		|| (result == AT_MATCH_OK && strstr(line, ",0") == NULL))
+	{
+		// the AT+CCHSEND behind it fails and ends the post, the session
+		// must not be reused before.
+		printf("http connect failed:%s\n", line);
+	}
 }
 
-static int8_t cch_open_handle(bool *urc, char*buf)
+// the request went out, the response comes in +CCHRECV until the server
+// closes the session.
+static void cch_send_handle(const char *line, uint8_t result)
 {
-	// TODO: deal with urc
-	char *rep_str[ ] = {"+CCHOPEN", "OK", "ERROR"};
-	int8_t res = -1;
-	char *p;
-	uint8_t  i = 0;
-	p= (char *)buf;
-
-	while ( '\r' == *p || '\n' == *p)
+	if(result == AT_MATCH_ERROR || result == AT_MATCH_TIMEOUT)
 	{
-		p++;
+		http_finish(NULL);
 	}
+}
+
+static void http_response(void)
+{
+	const char * version = "HTTP/1.1 ";
+	char *p = NULL;
 
-	for (i = 0; i < sizeof(rep_str) / sizeof(rep_str[0]); i++)
+	// check http protocol.
+	s_http_buffer[s_http_data_len] = '\0';
+	printf("receive:%s\n", s_http_buffer);
+	p = strstr(s_http_buffer, version);
+	if (p == NULL)
 	{
-		if (strstr( p,rep_str[i]))
-	    {
-			res = i;
-	        break;
-	    }
+		printf("Invalid version in %s\n", s_http_buffer);
+		http_finish(NULL);
+		return;
 	}
 
-	switch (res)
+	// check http status.
+	if(atoi(p + strlen(version)) != 200)
 	{
-		case 0:  // +CCHOPEN
-	    {
-	    	s_at_status = ATC_RSP_FINISH;
-	    }
-	    break;
-	    case 1: // OK
-	    {
-
-	    }
-	    break;
-
-	    case 2:
-	    {
-	    	s_at_status = ATC_RSP_FINISH;
-	    }
-	    break;
-
-	    default:
-	    break;
+		printf("Invalid status in %s\n", p);
+		http_finish(NULL);
+		return;
 	}
-	return s_at_status;
+
+	p = strstr(p, "\r\n\r\n");
+	http_finish(p == NULL? NULL: p + 4);
 }
 
-static int8_t cch_send_handle(bool *urc, char*buf)
+// +CIPOPEN: <link>,<error>, no connection is routed to the tcp links yet.
+static void cip_open_handle(const char *line, uint8_t result)
 {
-	char *rep_str[ ] = {"+CCHRECV", ">", "OK", "ERROR", "+CCHSEND:", "+CCH_PEER_CLOSED:"};
-	int8_t res = -1;
-	char *p;
-	uint8_t  i = 0;
-	static  uint16_t s_http_data_len = 0;
-	p= (char *)buf;
-	
-	while ( '\r' == *p || '\n' == *p)
+	if(result == AT_MATCH_ERROR || result == AT_MATCH_TIMEOUT
+		|| (result == AT_MATCH_OK && strstr(line, ",0") == NULL))
 	{
-		p++;
+		printf("tcp connect failed:%s\n", line);
 	}
+}
+
+// +CCHOPEN: <session>,<error>
+static void tcp_connect_handle(const char *line, uint8_t result)
+{
+	uint8_t link = at_engine_args()[0].num;
+	int16_t fd = link_fd(link);
+	int8_t error = (result == AT_MATCH_OK && strstr(line, ",0") != NULL)? 0: -1;
 
-	for (i = 0; i < sizeof(rep_str) / sizeof(rep_str[0]); i++)
+	if(result == AT_MATCH_LINE || fd < 0)
 	{
-		if (strstr( p,rep_str[i]))
-	    {
-			res = i;
-	        break;
-	    }
+		return;
 	}
-	
-	switch (res)
+
+	if(error != 0)
 	{
-		case 0:  // +HTTPSRECV:
-	    {
-	    	// check response length.
-	    	p = strstr(p, "+CCHRECV: DATA,1,");
-	    	p = p + strlen("+CCHRECV: DATA,1,");
-	    	int response_len = atoi(p);
-	    	if(response_len>1000)
-	    	{
-	    		printf("response size is illegal:%d!\n", response_len);
-	    		if(s_http_cb != NULL)
-	    		{
-	    			s_http_cb(NULL);
-	    		}
-	    		s_at_status = ATC_RSP_FINISH;
-	    		return -1;
-	    	}
-			p = strstr(p, "\r\n");
-			p = p + strlen("\r\n");
-			memcpy(s_http_buffer + s_http_data_len, p, response_len);
-			s_http_data_len += response_len;		
-	    }
-	    break;
-	    case 1: // >
-	    {
-			struct fifo_data* http_post_data;
-	        http_post_data = fifo_get_data(&s_at_fifo);
-	        if(http_post_data != NULL)
-	        {
-	        	printf("sending.....\n");
-	        	usart2_send(http_post_data->buf, http_post_data->length);
-	        	if(http_post_data->buf != NULL)
-	        	{
-	        		myfree(http_post_data->buf);
-	        		http_post_data->buf = NULL;
-	        	}
-	        	myfree(http_post_data);
-	        	http_post_data = NULL;
-	        }
-	    }
-	    break;
-
-	    case 2:
-	    {
-
-	    }
-	    break;
-
-	    case 3:
-	    {
-			//TODO: consider error situation.
-	        s_at_status = ATC_RSP_FINISH;
-	    }
-	    break;
-
-	    case 4:
-	    {
-
-	    }
-	    break;
-			
-		case 5:
-		{
-			// check http protocol.
-			char* http_response_buffer = NULL;
-			const char * version = "HTTP/1.1 ";
-			printf("receive:%s\n", s_http_buffer);
-			p = strstr(s_http_buffer, version);
-	        if (p == NULL)
-	        {
-	        	printf("Invalid version in %s\n", p);
-	        	if(s_http_cb != NULL)
-	        	{
-	        		s_http_cb(NULL);
-	        	}
-	        	s_at_status = ATC_RSP_FINISH;
-	        	return -1;
-	        }
-
-	        // check http status.
-	        int http_status = atoi(p + strlen(version));
-	        if(http_status != 200)
-	        {
-	        	printf("Invalid version in %s\n", p);
-	        	if(s_http_cb != NULL)
-	        	{
-	        		s_http_cb(NULL);
-	        	}
-	        	s_at_status = ATC_RSP_FINISH;
-	        	return -1;
-	        }
-
-	        http_response_buffer = (char *)strstr(p, "\r\n\r\n") + 4;
-			s_http_data_len = 0;
-	        s_at_status = ATC_RSP_FINISH;
-	        if(s_http_cb != NULL)
-	        {
-	        	s_http_cb(http_response_buffer);
-	        }
-		}
-    
-		default:
-	    break;
+		link_close(link);
+	}
+
+	if(tcp_connect_cb != NULL)
+	{
+		tcp_connect_cb(fd, error);
 	}
-	return s_at_status;
 }
 
-static int8_t tcp_connect_handle(bool *urc, char*buf)
+// once per buffer of a send command.
+static void tx_done(uint8_t link, int8_t error)
 {
-	// TODO: deal with urc
-	char *rep_str[ ] = {"+CCHOPEN", "ERROR", "OK"};
-	int8_t res = -1;
-	char *p;
-	uint8_t  i = 0;
-    p= (char *)buf;
-    while ( '\r' == *p || '\n' == *p)
-    {
-       p++;
-    }
-    for (i = 0; i < sizeof(rep_str) / sizeof(rep_str[0]); i++)
-    {
-    	if (strstr( p,rep_str[i]))
-       {
-           res = i;
-           break;
-       }
-    }
-
-    switch (res)
-    {
-        case 0:  // CONNECT OK.
-    	{
-    		if(tcp_connect_cb != NULL)
-    		{
-    			tcp_connect_cb(0, 0);
-    		}
-    		s_at_status = ATC_RSP_FINISH;
-    	}
-    	break;
-        case 1: // ERROR
-        {
-        	//tcp_connect_cb(conn, 1);
-        	s_at_status = ATC_RSP_FINISH;
-        }
-        break;
-        case 2:
-        {
-
-        }
-        break;
-
-        default:
-        break;
-    }
-
-   	return s_at_status;
+	int16_t fd = link_fd(link);
+
+	if(fd >= 0 && tcp_sent_cb != NULL)
+	{
+		tcp_sent_cb(fd, error);
+	}
 }
 
-int8_t ipsend_handle(bool *urc, char*buf)
+static void release_copy(void *arg, uint8_t *data)
 {
-	// TODO: deal with urc,
-	// TODO: free heap when send failed.
-	char *rep_str[ ] = {"+CCHSEND:", "ERROR", ">", "OK", "+CCH_PEER_CLOSED:"};
-	int8_t res = -1;
-	char *p;
-	uint8_t  i = 0;
-    p= (char *)buf;
-
-	while ( '\r' == *p || '\n' == *p)
+	myfree(data);
+}
+
+static void cch_recv_data(uint8_t *data, uint16_t length)
+{
+	uint16_t span = length;
+	int16_t fd = -1;
+
+	// a response to module_http_post, else data of a tls connection.
+	if(s_http_cb != NULL && s_recv_link == s_http_link)
 	{
-		p++;
+		if(s_http_data_len + span > MAX_HTTP_SIZE - 1)
+		{
+			printf("response size is illegal:%d!\n", s_http_data_len + length);
+			span = MAX_HTTP_SIZE - 1 - s_http_data_len;
+		}
+
+		memcpy(s_http_buffer + s_http_data_len, data, span);
+		s_http_data_len += span;
+		return;
 	}
 
-	for (i = 0; i < sizeof(rep_str) / sizeof(rep_str[0]); i++)
+	PD_LOGD("%s\n", __func__);
+	PD_LOG_HEX(data, length);
+	fd = link_fd(s_recv_link);
+	if(fd >= 0 && tcp_recv_cb != NULL)
 	{
-		if (strstr( p,rep_str[i]))
-	    {
-			res = i;
-			break;
-	    }
+		tcp_recv_cb(fd, data, length);
 	}
+}
 
-	switch (res)
+// +CCHRECV: DATA,<session>,<length>, the data follows the line.
+static void cch_recv_handle(const char *line, uint8_t result)
+{
+	const char *session = strchr(line, ',');
+	const char *p = strrchr(line, ',');
+
+	if(p != NULL && p != session && atoi(p + 1) > 0)
 	{
-		case 0:  //+CCHSEND:
-	    {
-	    	if(module_send_data_buffer != NULL)
-	    	{
-	    		if(module_send_data_buffer->buffer != NULL)
-	    		{
-	    			myfree(module_send_data_buffer->buffer);
-	    			module_send_data_buffer->buffer = NULL;
-	    		}
-	    	}
-	    	myfree(module_send_data_buffer);
-	    	module_send_data_buffer = NULL;
-	    	s_at_status = ATC_RSP_FINISH;
-	    	if(tcp_sent_cb != NULL)
-	    	{
-	    		tcp_sent_cb(0,0);
-	    	}
-	    }
-	    break;
-
-	    case 1: //ERROR
-	    {
-	    	if(tcp_sent_cb != NULL)
-	    	{
-	    		tcp_sent_cb(0,-1);
-	    	}
-	    	s_at_status = ATC_RSP_FINISH;
-	    }
-	    break;
-
-	    case 2: // >
-	    {
-	    	struct fifo_data* tcp_data_buffer = fifo_get_data(&s_at_fifo);
-	    	printf("sending.....,%p,\n", module_send_data_buffer);
-	    	if(tcp_data_buffer != NULL)
-	    	{
-	    		usart2_send(tcp_data_buffer->buf, tcp_data_buffer->length);
-	    		if(tcp_data_buffer->buf != NULL)
-	    		{
-	    			myfree(tcp_data_buffer->buf);
-	    			tcp_data_buffer->buf = NULL;
-	    		}
-	    		myfree(tcp_data_buffer);
-	    		tcp_data_buffer = NULL;
-	    	}
-
-	    }
-	    break;
-
-	    case 3: //OK
-	    {
-
-	    }
-	    break;
-
-        case 4: //+CCH_PEER_CLOSED
-        {
-            if(tcp_sent_cb != NULL)
-	    	{
-	    		tcp_sent_cb(0,-1);
-	    	}
-	    	s_at_status = ATC_RSP_FINISH;
-        }
-        break;
-
-	    default:
-	    break;
-	 }
-	   	return s_at_status;
+		s_recv_link = atoi(session + 1);
+		at_engine_read_data(atoi(p + 1), cch_recv_data);
+	}
 }
 
-
-void module_tcp_connect(uint16_t fd, uint32_t ip, uint16_t port)
+// +CCH_PEER_CLOSED: <session>
+static void peer_closed_handle(const char *line, uint8_t result)
 {
-	char connect_buf[80];
-	uint8_t ip1, ip2, ip3, ip4;
-	ip1 = ((uint8_t*)(&ip))[0];
-	ip2 = ((uint8_t*)(&ip))[1];
-	ip3 = ((uint8_t*)(&ip))[2];
-	ip4 = ((uint8_t*)(&ip))[3];
-	// AT+CCHSET.
-	add_send_at_command("AT+CCHSET", "AT+CCHSET=1\r\n");
-
-	// AT+CCHSTART.
-	add_send_at_command("AT+CCHSTART", "AT+CCHSTART\r\n");
+	uint8_t link = atoi(line + strlen("+CCH_PEER_CLOSED:"));
+	int16_t fd = link_fd(link);
 
-	// AT+CCHOPEN.
-	sprintf(connect_buf, "AT+CCHOPEN=%d,\"%d.%d.%d.%d\",%d, 2\r\n", 1, ip1, ip2, ip3, ip4, port);
-	printf("tcp connecting:%s\n", connect_buf);
-	add_send_at_command("AT+CCHOPEN_TLS", connect_buf);
+	printf("urc handle: %s\n", line);
+	if(s_http_cb != NULL && link == s_http_link)
+	{
+		// the post asks the server to close after the response.
+		http_response();
+		return;
+	}
+
+	if(fd < 0)
+	{
+		return;
+	}
+
+	link_close(link);
+	if(tcp_disconnected_cb != NULL)
+	{
+		tcp_disconnected_cb(fd, -1);
+	}
 }
 
-//TODO: close callback.
-static int8_t tcp_closed_handle(bool *urc, char *buf)
+void module_tcp_connect(uint16_t fd, uint32_t ip, uint16_t port)
 {
-	if(tcp_disconnected_cb != NULL)
+	union at_arg args[3];
+	int8_t link = link_open(fd + 1);
+
+	if(link < 0)
 	{
-		tcp_disconnected_cb(0, -1);
+		printf("no free link for fd %d\n", fd);
+		if(tcp_connect_cb != NULL)
+		{
+			tcp_connect_cb(fd, -1);
+		}
+
+		return;
 	}
-	return -1;
+
+	// AT+CCHOPEN.
+	args[0].num = link;
+	args[1].ip = ip;
+	args[2].num = port;
+	at_engine_queue(MODULE_AT_CCHOPEN_TLS, args, NULL);
 }
 
-static int8_t tcp_disconnect_handle(bool *urc, char *buf)
+void module_tcp_disconnect(uint16_t fd)
 {
-	if(tcp_disconnected_cb != NULL)
+	int8_t link = link_of(fd);
+
+	if(link >= 0)
 	{
-		tcp_disconnected_cb(0, -1);
+		link_close(link);
 	}
-	return -1;
 }
 
 void register_module_tcp_connect_callback(uint16_t fd, module_tcp_connected_callback connect_cb)
@@ -808,104 +537,98 @@ void register_module_tcp_disconnected_callback(uint16_t fd, module_tcp_disconnec
 uint8_t module_system_start()
 {
 	s_module_status = MODULE_START;
-	timer4_init(1000, 1, at_fifo_check);
+	usart2_register_receive_cb(module_data_input);
+	timer4_init(MODULE_TICK_MS, 1, module_tick);
 	timer4_start();
 	return s_module_status;
 }
 
 uint8_t module_system_init()
 {
-	FIFO_Init (&s_at_fifo);
+	// replies are only parsed from MODULE_INIT on, the first command goes
+	// out right away.
+	s_module_status = MODULE_INIT;
+	at_engine_init(&at_config);
+	memset(s_link_owner, 0, sizeof(s_link_owner));
 
     //ATE0, set no echo.
-    add_send_at_command("ATE", "ATE0\r\n");
+    add_send_at_command(MODULE_AT_ATE);
 
     //AT+IFC=0, set no flow control.
-    add_send_at_command("AT+IFC", "AT+IFC=0\r\n");
+    add_send_at_command(MODULE_AT_IFC);
 
     //AT+CPIN, query .....
-    add_send_at_command("AT+CPIN", "AT+CPIN?\r\n");
+    add_send_at_command(MODULE_AT_CPIN);
 
     //AT+CSQ
-    add_send_at_command("AT+CSQ", "AT+CSQ\r\n");
+    add_send_at_command(MODULE_AT_CSQ);
 
 	//AT+GSN  request for the IMEI of the module.;
-    add_send_at_command("AT+GSN", "AT+GSN\r\n");
+    add_send_at_command(MODULE_AT_GSN);
 
 	// AT+CGSOCKCONT
-    add_send_at_command("AT+CGSOCKCONT", "AT+CGSOCKCONT=1,\"IP\",\"CMNET\"\r\n");
+    add_send_at_command(MODULE_AT_CGSOCKCONT);
 
     //AT+CIPMODE
-    add_send_at_command("AT+CIPMODE", "AT+CIPMODE=0\r\n");
+    add_send_at_command(MODULE_AT_CIPMODE);
 
     //AT+NETOPEN
-    add_send_at_command("AT+NETOPEN", "AT+NETOPEN\r\n");
+    add_send_at_command(MODULE_AT_NETOPEN);
 
-	s_module_status = MODULE_INIT;
 	return s_module_status;
 }
 
 
-static void at_fifo_check(void *arg)
+// the reply to the "AT" of the tick, the bytes are not terminated.
+static uint8_t find_ok(const uint8_t *data, uint16_t length)
 {
-	static uint8_t wait_response_tick = 0;
+	uint16_t i = 0;
 
+	for(i = 0; i + 1 < length; i++)
+	{
+		if(data[i] == 'O' && data[i + 1] == 'K')
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// the commands advance on the modem's replies, the tick only syncs the
+// module and times out commands.
+static void module_tick(void *arg)
+{
 	if(s_module_status == MODULE_START)
 	{
-		send_at_command("AT\r\n");
+		printf("send cmd: AT\n");
+		usart2_send((uint8_t *)"AT\r\n", strlen("AT\r\n"));
 	}
 	else if(MODULE_INIT ==s_module_status|| MODULE_INIT_DONE == s_module_status)
 	{
-		if ((NULL == s_current_at_command))
-		{
-			if ((!FIFO_isEmpty(&s_at_fifo)) &&(s_at_status == ATC_RSP_FINISH))
-			{
-				s_current_at_command = (struct at_cmd_entity*)mymalloc(sizeof(struct at_cmd_entity));
-	            if (FIFO_Get(&s_at_fifo, s_current_at_command->at_name,  s_current_at_command->at_cmd))
-	            {
-	            	s_at_status = ATC_RSP_WAIT;
-	                send_at_command(s_current_at_command->at_cmd);
-	            }
-			}
-			else
-			{
-				printf("fifo is empty or the previous at command not complete!\n");
-			}
-		}
-		else
-		{
-			printf("the at command is in sending!\n");
-			if(wait_response_tick > AT_MAX_RESPONSE_TIME)
-			{
-				printf("the at command sending is timeout!\n");
-			}
-			wait_response_tick++;
+		at_engine_tick(MODULE_TICK_MS);
+	}
 
+	if(s_http_cb != NULL)
+	{
+		s_http_wait_ms += MODULE_TICK_MS;
+		if(s_http_wait_ms >= MODULE_HTTP_TIMEOUT_MS)
+		{
+			printf("http response timeout\n");
+			http_finish(NULL);
 		}
 	}
 }
 
-
-
 /******************************************************************************
  * FunctionName : add_send_at_command
- * Description  : add the at command to the send buffer.
- * Parameters   : name_buffer: the at command name
- * 				  cmd_buffer: cmd_buffer: the command.
+ * Description  : add an at command without arguments to the send queue.
+ * Parameters   : opcode: the MODULE_AT_* of the command.
  * Returns      : none.
 *******************************************************************************/
-void add_send_at_command(char *name_buffer, char *cmd_buffer)
+void add_send_at_command(uint8_t opcode)
 {
-	char at_cmd_Buff[256] = {0};
-	char at_name_Buff[20] = {0};
-
-	strcpy(at_name_Buff, name_buffer);
-	strcpy(at_cmd_Buff, cmd_buffer);
-
-	if(FIFO_Put(&s_at_fifo, at_name_Buff,  at_cmd_Buff) ==-1)
-	{
-		printf("write fifo error!\n");
-	}
+	at_engine_queue(opcode, NULL, NULL);
 }
 
 
@@ -941,18 +664,25 @@ void set_module_status(int8_t status)
 *******************************************************************************/
 void module_send_data(uint16_t fd, uint8_t *buf, uint16_t len)
 {
-	printf("%s, %d\n", __func__, len);
-	struct fifo_data* tcp_data_buffer = (struct fifo_data *)mymalloc(sizeof(struct fifo_data));
-	tcp_data_buffer->length = len;
-	tcp_data_buffer->buf = (uint8_t*)mymalloc(len);
-	memcpy(tcp_data_buffer->buf, buf, len);
-
-	char command_buffer[48];
-	sprintf(command_buffer, "AT+CCHSEND=%d,%d\r\n", 1, len);
-	printf("%s, 22, %d\n", __func__, len);
-	add_send_at_command("AT+CCHSEND_TLS", command_buffer);
-	fifo_put_data(&s_at_fifo, tcp_data_buffer);
-	printf("%s, 33, %d\n", __func__, len);
+	int8_t link = link_of(fd);
+	uint8_t *copy = (link < 0)? NULL: (uint8_t *)mymalloc(len);
+
+	if(copy != NULL)
+	{
+		memcpy(copy, buf, len);
+		if(at_engine_tx(link, copy, len, release_copy, NULL) == 0)
+		{
+			return;
+		}
+
+		myfree(copy);
+	}
+
+	printf("%s, drop %d\n", __func__, len);
+	if(tcp_sent_cb != NULL)
+	{
+		tcp_sent_cb(fd, -1);
+	}
 }
 
 /******************************************************************************
@@ -964,13 +694,22 @@ void module_send_data(uint16_t fd, uint8_t *buf, uint16_t len)
 *******************************************************************************/
 uint8_t inquire_signal_quality(void)
 {
-	add_send_at_command("AT+CSQ", "AT+CSQ\r\n");
+	add_send_at_command(MODULE_AT_CSQ);
 	return s_csq_value;
 }
 
 void module_http_post(const char *url, const char *data, module_http_callback http_cb)
 {
-	s_http_cb = http_cb;
+	int8_t link = -1;
+
+	if(s_http_cb != NULL)
+	{
+		printf("a http post is running\n");
+		http_cb(NULL);
+		return;
+	}
+
+	s_http_data_len = 0;
 
 	char host_name[64] = "";
 	char http_path[64] = "";
@@ -1003,28 +742,35 @@ void module_http_post(const char *url, const char *data, module_http_callback ht
 	printf("host_name:%s\n", host_name);
 	printf("http_path:%s\n", http_path);
 
-	// AT+CCHSET.
-	add_send_at_command("AT+CCHSET", "AT+CCHSET=1\r\n");
+	// a session of its own, the tcp connections stay up.
+	link = link_open(LINK_HTTP);
+	if(link < 0)
+	{
+		printf("no free link for http\n");
+		http_cb(NULL);
+		return;
+	}
 
-	// AT+CCHSTART.
-	add_send_at_command("AT+CCHSTART", "AT+CCHSTART\r\n");
+	s_http_cb = http_cb;
+	s_http_link = link;
+	s_http_wait_ms = 0;
 
-	char http_url[64];
-	memset(http_url, 0x0, sizeof(http_url));
-	sprintf(http_url, "AT+CCHOPEN=%d,\"%s\",%d\r\n", 1, host_name, 443);
-	printf("http_para:%s\n", http_url);
-	add_send_at_command("AT+CCHOPEN", http_url);
+	// AT+CCHOPEN.
+	union at_arg args[2];
+	strcpy(s_http_host, host_name);
+	args[0].num = link;
+	args[1].str = s_http_host;
+	at_engine_queue(MODULE_AT_CCHOPEN, args, NULL);
 
 	// AT+CCHSEND
 	char post_headers[128] = "";
-	char at_send_buffer[20] = "";
 	sprintf(post_headers,
 				"Content-Type:"
 				HTTP_HEADER_CONTENT_TYPE
 				"\r\n"
 				"Content-Length: %d\r\n", strlen(data));
 
-	struct fifo_data* http_post_data =(struct fifo_data*)mymalloc(sizeof(struct fifo_data));
+	struct at_payload* http_post_data =(struct at_payload*)mymalloc(sizeof(struct at_payload));
 	http_post_data->buf =(uint8_t*)mymalloc(512);
 	memset(http_post_data->buf, 0 , 512);
 	int len = sprintf(http_post_data->buf,
@@ -1037,140 +783,29 @@ void module_http_post(const char *url, const char *data, module_http_callback ht
 						http_path, host_name, 443, post_headers, data);
 	http_post_data->length = len;
 	printf("http post:%s", http_post_data->buf);
-	sprintf(at_send_buffer, "AT+CCHSEND=%d,%d\r\n", 1, len);
-	add_send_at_command("AT+CCHSEND", at_send_buffer);
-	fifo_put_data(&s_at_fifo, http_post_data);
+	args[1].num = len;
+	at_engine_queue(MODULE_AT_CCHSEND, args, http_post_data);
 
-	// AT+CCHCLOSE
-	add_send_at_command("AT+CCHCLOSE", "AT+CCHCLOSE=1\r\n");
-
-	// AT+CCHSTOP
-	add_send_at_command("AT+CCHSTOP", "AT+CCHSTOP\r\n");
+	// AT+CCHCLOSE and AT+CCHSTOP follow when the response is in.
 }
 
-static int8_t urc_process(uint8_t* data)
+void module_data_input(uint8_t *data, uint16_t length)
 {
-	// is urc.
-	uint8_t i= 0;
-	uint8_t urc = 0;
-	for (i = 0; i <sizeof(urc_table)/sizeof(urc_table[0]); i++)
-	{
-		if(strstr(data, urc_table[i].name))
-		{
-			urc_table[i].at_cmd_handle(&urc, data);
-			return 0;
-		}
-	}
-
-	return -1;
-}
-
-static int8_t data_process(struct module_buf *buf)
-{
-	struct module_buf *data_buf = buf;
-	uint8_t *p = data_buf->buf;
-	if(strncmp(data_buf->buf, "\r\n+CCHRECV:", strlen("\r\n+CCHRECV:")) == 0)
-	{
-		p = strstr(data_buf->buf, "+CCHRECV: DATA,1,");
-		p += strlen("+CCHRECV: DATA,1,");
-		data_buf->length = atol(p);
-		p = strstr(p, "\r\n");
-		p = p + strlen("\r\n");
-		memcpy(data_buf->buf, p , data_buf->length);
-		return 1;
-	}
-
-	else
-	{
-		return 0;
-	}
-}
-
-int8_t module_data_handler(void* data)
-{
-
-	uint8_t urc = 0;
-	struct module_buf* module_data = (struct module_buf*)data;
-	printf("module response:%s\n", module_data->buf);
-	show_package(module_data->buf, module_data->length);
-	if(module_data->length < 3)
-	{
-		printf("module response not enough length!");
-		if(module_data != NULL)
-		{
-			if(module_data->buf != NULL)
-			{
-				free(module_data->buf);
-				module_data->buf = NULL;
-			}
-			free(module_data);
-			module_data = NULL;
-		}
-		return -1;
-	}
-
+	PD_LOGD("module response:%d\n", length);
+	PD_LOG_HEX(data, length);
 	if(MODULE_START == s_module_status)
 	{
-		if((strstr(module_data->buf, "OK")))
+		if(find_ok(data, length))
 		{
 			printf("the \"at\" cmd response \"OK\"\n");
 			s_module_status = MODULE_SYNC;
 		}
 	}
-	if (MODULE_INIT ==s_module_status|| MODULE_INIT_DONE == s_module_status)
-	{
-		int i = 0;
-		if (NULL != s_current_at_command)
-	    {
-			for (i = 0; i <sizeof(atCmdTable)/sizeof(atCmdTable[0]); i++)
-	        {
-				if(!strcmp(s_current_at_command->at_name, atCmdTable[i].name))
-	            {
-
-					s_at_status =atCmdTable[i].at_cmd_handle(&urc, module_data->buf);
-
-	                if (ATC_RSP_FINISH ==s_at_status)
-	                {
-	                	myfree(s_current_at_command);
-	                    s_current_at_command = NULL;
-	                }
-
-	                break;
-	            }
-	        }
-		}
-		else
-		{
-			if(data_process(module_data) == 1)
-			{
-				printf("%s\n", __func__);
-				show_package(module_data->buf, module_data->length);
-				if(tcp_recv_cb != NULL)
-				{
-					tcp_recv_cb(0, module_data->buf, module_data->length);
-				}
-			}
-
-			else
-			{
-				printf("the data is urc\n");
-			}
-
-		}
-	}
 
-	if(module_data != NULL)
+	if (MODULE_INIT ==s_module_status|| MODULE_INIT_DONE == s_module_status)
 	{
-		if(module_data->buf != NULL)
-		{
-			free(module_data->buf);
-			module_data->buf = NULL;
-		}
-		free(module_data);
-		module_data = NULL;
+		at_engine_input(data, length);
 	}
-
-	return 0;
 }
 
 
@@ -28,14 +28,56 @@ extern "C"
 	
 #define MIN_SIGNAL_QUAILTY 12
 
+// the at commands, in the order of the driver's command table.
+enum module_at_opcode
+{
+	MODULE_AT_ATE = 0,
+	MODULE_AT_IFC,
+	MODULE_AT_CPIN,
+	MODULE_AT_CSQ,
+	MODULE_AT_GSN,
+	MODULE_AT_CGSOCKCONT,
+	MODULE_AT_CIPMODE,
+	MODULE_AT_NETOPEN,
+	MODULE_AT_CCHSET,
+	MODULE_AT_CCHSTART,
+	MODULE_AT_CCHOPEN,
+	MODULE_AT_CCHSEND,
+	MODULE_AT_CCHCLOSE,
+	MODULE_AT_CCHSTOP,
+	MODULE_AT_CIPHEAD,
+	MODULE_AT_CIPOPEN,
+	MODULE_AT_CIPSEND,
+	MODULE_AT_CIPCLOSE,
+	MODULE_AT_CIPSRIP,
+	MODULE_AT_CCHOPEN_TLS,
+	MODULE_AT_CCHSEND_TLS
+};
+
 typedef void(*module_tcp_connected_callback)(int16_t fd, int8_t error_no);
 typedef void(* module_tcp_sent_callback)(int16_t fd, int8_t errno);
 typedef void(* module_tcp_recv_callback)(int16_t fd, uint8_t *data, uint16_t length);
 typedef void(* module_tcp_disconnected_callback)(int16_t fd, int8_t errno);
 typedef void(* module_http_callback)(char *buf);
 
+/******************************************************************************
+ * FunctionName : module_tcp_connect
+ * Description  : open a tls connection on a free CCH session of the modem.
+ * Parameters   : fd: the connect index, the callbacks get it back.
+ * 				  ip: the server address.
+ * 				  port: the server port.
+ * Returns      : none, the connect callback tells the result.
+*******************************************************************************/
 void module_tcp_connect(uint16_t fd, uint32_t ip, uint16_t port);
 
+/******************************************************************************
+ * FunctionName : module_tcp_disconnect
+ * Description  : close the connection, its unsent data is dropped.
+ * Parameters   : fd: the connect index.
+ * Returns      : none.
+*******************************************************************************/
+void module_tcp_disconnect(uint16_t fd);
+
 void register_module_tcp_connect_callback(uint16_t fd, module_tcp_disconnected_callback connect_cb);
 
 void register_module_tcp_sent_callback(uint16_t fd, module_tcp_sent_callback sent_callback);
@@ -49,7 +91,7 @@ void module_http_post(const char *url, const char* data, module_http_callback ht
 
 /******************************************************************************
  * FunctionName : module_send_data
- * Description  : module send data api.
+ * Description  : module send data api, the data is copied.
  * Parameters   : fd: the send connect index.
  * 				  buf: the send data.
  * 				  length: the send length.
@@ -94,20 +136,21 @@ uint8_t module_system_start(void);
 
 /******************************************************************************
  * FunctionName : add_send_at_command
- * Description  : add the at command to the send buffer.
- * Parameters   : name_buffer: the at command name
- * 				  cmd_buffer: cmd_buffer: the command.
+ * Description  : add an at command without arguments to the send queue.
+ * Parameters   : opcode: the MODULE_AT_* of the command.
  * Returns      : none.
 *******************************************************************************/
-void add_send_at_command(char* name_buffer, char* cmd_buffer);
+void add_send_at_command(uint8_t opcode);
 
 /******************************************************************************
- * FunctionName : module_handler
- * Description  : the module response data process handler.
- * Parameters   : data : the module response data, include data and length.
+ * FunctionName : module_data_input
+ * Description  : the module response data process handler, usart2 calls it
+ *                from the main loop.
+ * Parameters   : data: the received bytes, not terminated.
+ *                length: byte count.
  * Returns      : none.
 *******************************************************************************/
-int8_t module_data_handler(void* data);
+void module_data_input(uint8_t *data, uint16_t length);
 
 #ifdef __cplusplus
 }
@@ -4,20 +4,83 @@
 #include <stdio.h>
 #include "task.h"
 #include "platform/include/pando_types.h"
-#include "sim5360.h"
-#include <stdlib.h>
 #include <string.h>
-#include "malloc.h"
 
+// the dma writes around this buffer, its half and full interrupts and the
+// line idle interrupt move the bytes on to the ring.
+#define USART2_DMA_SIZE 128
 
-#define USART_RECEIVED_MAX_LEN 1000
+// bytes waiting for the main loop, a power of two.
+#define USART2_RX_RING_SIZE 1024
 
-uint8_t g_usart2_received_buf[USART_RECEIVED_MAX_LEN];
+static uint8_t s_dma_buf[USART2_DMA_SIZE];
+static uint16_t s_dma_pos = 0;
 
-struct uart_buffer{
-	uint8_t * buf;
-	uint16_t length;
-};
+// the interrupts write at the head, the main loop reads at the tail.
+static uint8_t s_rx_ring[USART2_RX_RING_SIZE];
+static volatile uint16_t s_rx_head = 0;
+static volatile uint16_t s_rx_tail = 0;
+static uint32_t s_rx_overrun = 0;
+
+static task_event s_rx_event;
+static uart2_recv_callback s_recv_cb = NULL;
+
+// hand the ring to the receive callback, in the main loop.
+static int8_t rx_event_handler(void *pdata)
+{
+	uint16_t head = s_rx_head;
+	uint16_t tail = s_rx_tail;
+	uint16_t span = 0;
+
+	while(tail != head)
+	{
+		span = (head > tail)? head - tail: USART2_RX_RING_SIZE - tail;
+		if(s_recv_cb != NULL)
+		{
+			s_recv_cb(s_rx_ring + tail, span);
+		}
+
+		tail = (tail + span) & (USART2_RX_RING_SIZE - 1);
+		s_rx_tail = tail;
+	}
+
+	return 0;
+}
+
+// move what the dma wrote since the last call to the ring, in the interrupts.
+static void rx_drain(void)
+{
+	uint16_t dma = USART2_DMA_SIZE - DMA_GetCurrDataCounter(DMA1_Channel6);
+	uint16_t head = s_rx_head;
+	uint16_t next = 0;
+
+	if(dma == USART2_DMA_SIZE)
+	{
+		dma = 0;
+	}
+
+	while(s_dma_pos != dma)
+	{
+		next = (head + 1) & (USART2_RX_RING_SIZE - 1);
+		if(next == s_rx_tail)
+		{
+			s_rx_overrun++;
+		}
+		else
+		{
+			s_rx_ring[head] = s_dma_buf[s_dma_pos];
+			head = next;
+		}
+
+		s_dma_pos = (s_dma_pos + 1) % USART2_DMA_SIZE;
+	}
+
+	if(head != s_rx_head)
+	{
+		s_rx_head = head;
+		post_event(&s_rx_event);
+	}
+}
 
 void usart2_init(void)
 {
@@ -48,6 +111,14 @@ void usart2_init(void)
 	NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
 	NVIC_Init(&NVIC_InitStructure);
 
+	// the same preemption priority, the two never interrupt each other.
+	NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel6_IRQn;
+	NVIC_Init(&NVIC_InitStructure);
+
+	s_rx_event.handler = rx_event_handler;
+	s_rx_event.pdata = NULL;
+	add_event(&s_rx_event);
+
 	USART_InitStructure.USART_BaudRate = 115200;
 	USART_InitStructure.USART_WordLength = USART_WordLength_8b;
 	USART_InitStructure.USART_StopBits = USART_StopBits_1;
@@ -64,9 +135,9 @@ void usart2_init(void)
 	RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
 	DMA_DeInit(DMA1_Channel6);
 	dma_structure.DMA_PeripheralBaseAddr = (uint32_t)(&USART2->DR);
-	dma_structure.DMA_MemoryBaseAddr = (uint32_t)g_usart2_received_buf;
+	dma_structure.DMA_MemoryBaseAddr = (uint32_t)s_dma_buf;
 	dma_structure.DMA_DIR = DMA_DIR_PeripheralSRC;
-	dma_structure.DMA_BufferSize = USART_RECEIVED_MAX_LEN;
+	dma_structure.DMA_BufferSize = USART2_DMA_SIZE;
 	dma_structure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
 	dma_structure.DMA_MemoryInc = DMA_MemoryInc_Enable;
 	dma_structure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
@@ -75,6 +146,7 @@ void usart2_init(void)
 	dma_structure.DMA_Priority = DMA_Priority_VeryHigh;
 	dma_structure.DMA_M2M = DMA_M2M_Disable;
 	DMA_Init(DMA1_Channel6, &dma_structure);
+	DMA_ITConfig(DMA1_Channel6, DMA_IT_HT | DMA_IT_TC, ENABLE);
 	DMA_Cmd(DMA1_Channel6, ENABLE);
 	USART_DMACmd(USART2, USART_DMAReq_Rx, ENABLE);
 
@@ -112,31 +184,11 @@ uint16_t usart2_send(uint8_t *buffer, uint16_t length)
 
 void USART2_IRQHandler(void)      //����2 �жϷ������
 {
-	uint8_t tmp;
-	task * uart2_task;
-	struct uart_buffer *uart2_buf;
-	uint16_t length = 0;
 	if(USART_GetITStatus(USART2, USART_IT_IDLE) != RESET)
 	{
-		tmp = USART_ReceiveData(USART2);
-		DMA_Cmd(DMA1_Channel6, DISABLE); // close DMA
-		length = USART_RECEIVED_MAX_LEN - DMA_GetCurrDataCounter(DMA1_Channel6);
-		//printf("uart2 dma2 length:%d\n", length);
-		uart2_buf = (struct uart_buffer*)malloc(sizeof(struct uart_buffer));
-		uart2_buf->buf = (uint8_t*)malloc(length + 1);
-		uart2_buf->length = length + 1;
-		memcpy(uart2_buf->buf, g_usart2_received_buf, length);
-		uart2_buf->buf[length] = 0;
-
-		uart2_task = new_task();
-		uart2_task->handler = module_data_handler;
-		uart2_task->pdata = uart2_buf;
-		add_task(uart2_task);
-
-		// set data length of transmission
-		DMA_SetCurrDataCounter(DMA1_Channel6, USART_RECEIVED_MAX_LEN);
-		// open DMA
-		DMA_Cmd(DMA1_Channel6,ENABLE);
+		// reading the data register clears the idle flag.
+		USART_ReceiveData(USART2);
+		rx_drain();
 	}
 	if(USART_GetITStatus(USART2, USART_IT_TXE) != RESET)                   //�����Ϊ�˱���STM32 USART ��һ���ֽڷ�����ȥ��BUG
 	{
@@ -144,3 +196,46 @@ void USART2_IRQHandler(void)      //����2 �жϷ������
 	}
 
 }
+
+/**
+  * @brief  This function handles the half and full transfer interrupts of
+  *         the USART2 receive DMA.
+  * @param  None
+  * @retval : None
+  */
+void DMA1_Channel6_IRQHandler(void)
+{
+	if(DMA_GetITStatus(DMA1_IT_HT6) != RESET)
+	{
+		DMA_ClearITPendingBit(DMA1_IT_HT6);
+	}
+
+	if(DMA_GetITStatus(DMA1_IT_TC6) != RESET)
+	{
+		DMA_ClearITPendingBit(DMA1_IT_TC6);
+	}
+
+	rx_drain();
+}
+
+/******************************************************************************
+* FunctionName : usart2_register_receive_cb
+* Description  : register the callback function when uart2 receive data.
+* Parameters   : recv_cb: the callback function specify when receive data.
+* Returns      : none.
+*******************************************************************************/
+void usart2_register_receive_cb(uart2_recv_callback recv)
+{
+	s_recv_cb = recv;
+}
+
+/******************************************************************************
+* FunctionName : usart2_rx_overrun
+* Description  : the bytes dropped because the main loop fell behind.
+* Parameters   : none.
+* Returns      : the dropped byte count.
+*******************************************************************************/
+uint32_t usart2_rx_overrun(void)
+{
+	return s_rx_overrun;
+}
@@ -13,9 +13,19 @@ uint16_t usart2_send(uint8_t *buffer, uint16_t length);
 * FunctionName : usart2_register_receive_cb
 * Description  : register the callback function when uart2 receive data.
 * Parameters   : recv_cb: the callback function specify when receive data.
+*                          it runs in the main loop, the buffer is only valid
+*                          during the call.
 * Returns      : none.
 *******************************************************************************/
 void usart2_register_receive_cb(uart2_recv_callback  recv);
 
+/******************************************************************************
+* FunctionName : usart2_rx_overrun
+* Description  : the bytes dropped because the main loop fell behind.
+* Parameters   : none.
+* Returns      : the dropped byte count.
+*******************************************************************************/
+uint32_t usart2_rx_overrun(void);
+
 
 #endif
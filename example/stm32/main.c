@@ -41,6 +41,8 @@ int main(void)
 			printf("start gateway!\n");
 			pando_framework_init();
 		}
+		// the uart receive interrupts only post events.
+		run_events();
 		while((task = pop_task()) != NULL)
 		{
 			printf("begin to execute task! %p\r\n", task);
@@ -11,6 +11,8 @@ typedef struct task_node {
 //declare the task head in the task queue
 task_node *g_task_head = NULL;
 
+static task_event *s_event_head = NULL;
+
 /******************************************************************************
  * FunctionName : new_task
  * Description  : new a empty task
@@ -120,3 +122,47 @@ void delete_task(task *ptask)
 	
 	free(ptask);
 }
+
+/******************************************************************************
+ * FunctionName : add_event
+ * Description  : register an event with the system, once at init.
+ * Parameters   : pevent: the event, handler and pdata set.
+ * Returns      : none
+*******************************************************************************/
+void add_event(task_event *pevent)
+{
+	pevent->pending = 0;
+	pevent->next = s_event_head;
+	s_event_head = pevent;
+}
+
+/******************************************************************************
+ * FunctionName : post_event
+ * Description  : have the event run from the main loop, safe in interrupts.
+ * Parameters   : pevent: the registered event.
+ * Returns      : none
+*******************************************************************************/
+void post_event(task_event *pevent)
+{
+	pevent->pending = 1;
+}
+
+/******************************************************************************
+ * FunctionName : run_events
+ * Description  : run the posted events, called from the main loop.
+ * Parameters   : none
+ * Returns      : none
+*******************************************************************************/
+void run_events(void)
+{
+	task_event *pevent;
+	for(pevent = s_event_head; pevent != NULL; pevent = pevent->next)
+	{
+		if(pevent->pending)
+		{
+			// cleared first, a post while it runs runs it again.
+			pevent->pending = 0;
+			pevent->handler(pevent->pdata);
+		}
+	}
+}
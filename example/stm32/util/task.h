@@ -16,6 +16,15 @@ typedef struct task {
 	void *pdata;
 }task;
 
+// a task allocated once that an interrupt can post without allocating. posts
+// before it runs are merged into one run.
+typedef struct task_event {
+	int8_t (*handler)(void *pdata);
+	void *pdata;
+	volatile uint8_t pending;
+	struct task_event *next;
+}task_event;
+
 /******************************************************************************
  * FunctionName : new_task
  * Description  : new a empty task
@@ -48,4 +57,28 @@ task* pop_task(void);
 *******************************************************************************/
 void delete_task(task *ptask);
 
+/******************************************************************************
+ * FunctionName : add_event
+ * Description  : register an event with the system, once at init.
+ * Parameters   : pevent: the event, handler and pdata set.
+ * Returns      : none
+*******************************************************************************/
+void add_event(task_event *pevent);
+
+/******************************************************************************
+ * FunctionName : post_event
+ * Description  : have the event run from the main loop, safe in interrupts.
+ * Parameters   : pevent: the registered event.
+ * Returns      : none
+*******************************************************************************/
+void post_event(task_event *pevent);
+
+/******************************************************************************
+ * FunctionName : run_events
+ * Description  : run the posted events, called from the main loop.
+ * Parameters   : none
+ * Returns      : none
+*******************************************************************************/
+void run_events(void);
+
 #endif
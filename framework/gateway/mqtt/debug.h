@@ -9,8 +9,9 @@
 #define DEBUG_H_
 
 #include "../../platform/include/pando_sys.h"
+#include "../../platform/include/pando_log.h"
 #ifndef INFO
-#define INFO pd_printf
+#define INFO PD_LOGD
 #endif
 
 #endif /* DEBUG_H_ */
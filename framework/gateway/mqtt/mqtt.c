@@ -29,6 +29,9 @@
 * POSSIBILITY OF SUCH DAMAGE.
 */
 
+#define PANDO_MEM_MODULE PD_MEM_MQTT
+#define PANDO_LOG_MODULE_LEVEL PANDO_LOG_LEVEL_MQTT
+
 #include "mqtt_msg.h"
 #include "debug.h"
 #include "mqtt.h"
@@ -37,6 +40,7 @@
 #include "../../platform/include/pando_types.h"
 #include "../../platform/include/pando_timer.h"
 #include "../../platform/include/pando_net_tcp.h"
+#include "../../platform/include/pando_trace.h"
 #include "utils.h"
 #include "../../protocol/common_functions.h"
 
@@ -48,12 +52,52 @@
 #define MQTT_TASK_QUEUE_SIZE    	1
 #define MQTT_SEND_TIMOUT			5
 
-#ifndef QUEUE_BUFFER_SIZE
-#define QUEUE_BUFFER_SIZE		 	2048
+// the queue frames a packet with two bytes and may escape every byte of it,
+// each lane holds at least one packet of MQTT_BUF_SIZE framed that way.
+#define MQTT_LANE_MIN_SIZE		(2 * MQTT_BUF_SIZE + 2)
+
+#ifndef MQTT_LANE_BULK_SIZE
+#define MQTT_LANE_BULK_SIZE		MQTT_LANE_MIN_SIZE
+#endif
+
+#ifndef MQTT_LANE_NORMAL_SIZE
+#define MQTT_LANE_NORMAL_SIZE	MQTT_LANE_MIN_SIZE
+#endif
+
+#ifndef MQTT_LANE_HIGH_SIZE
+#define MQTT_LANE_HIGH_SIZE		MQTT_LANE_MIN_SIZE
+#endif
+
+#if MQTT_LANE_BULK_SIZE < MQTT_LANE_MIN_SIZE || MQTT_LANE_NORMAL_SIZE < MQTT_LANE_MIN_SIZE \
+	|| MQTT_LANE_HIGH_SIZE < MQTT_LANE_MIN_SIZE
+#error "an MQTT lane must hold one framed packet of MQTT_BUF_SIZE"
 #endif
 
+static const uint16_t lane_size[MQTT_LANES] = {
+	MQTT_LANE_BULK_SIZE, MQTT_LANE_NORMAL_SIZE, MQTT_LANE_HIGH_SIZE
+};
+
 void MQTT_Task(MQTT_Client * arg);
 
+// the bytes a packet takes in a queue, with its frame and escapes.
+static uint32_t FUNCTION_ATTRIBUTE
+framed_length(const uint8_t *data, uint16_t length)
+{
+	uint32_t framed = length + 2;
+
+	while(length--)
+	{
+		if(*data == 0x7D || *data == 0x7E || *data == 0x7F)
+		{
+			framed++;
+		}
+
+		data++;
+	}
+
+	return framed;
+}
+
 
 static void FUNCTION_ATTRIBUTE
 deliver_publish(MQTT_Client* client, uint8_t* message, int length)
@@ -64,6 +108,8 @@ deliver_publish(MQTT_Client* client, uint8_t* message, int length)
 	event_data.topic = mqtt_get_publish_topic(message, &event_data.topic_length);
 	event_data.data_length = length;
 	event_data.data = mqtt_get_publish_data(message, &event_data.data_length);
+	client->dataMsgId = mqtt_get_qos(message) > 0 ? mqtt_get_id(message, length) : 0;
+	client->dataDup = mqtt_get_dup(message);
 
 	if(client->dataCb)
 		client->dataCb((uint32_t*)client, event_data.topic, event_data.topic_length, event_data.data, event_data.data_length);
@@ -71,15 +117,8 @@ deliver_publish(MQTT_Client* client, uint8_t* message, int length)
 }
 
 
-/**
-  * @brief  Client received callback function.
-  * @param  arg: contain the ip link information
-  * @param  pdata: received data
-  * @param  len: the lenght of received data
-  * @retval None
-  */
-void FUNCTION_ATTRIBUTE
-mqtt_tcpclient_recv(void *arg, struct data_buf *buffer)
+static void FUNCTION_ATTRIBUTE
+mqtt_tcpclient_recv_data(void *arg, struct data_buf *buffer)
 {
 	INFO("TCP: data received %d bytes\r\n", buffer->length);
 
@@ -92,12 +131,13 @@ mqtt_tcpclient_recv(void *arg, struct data_buf *buffer)
 
 	if(buffer->length > MQTT_BUF_SIZE || buffer->length == 0)
 	{
-		INFO("receive length is invalid.\n");
+		PD_LOGW("receive length is invalid.\n");
 		return;
 	}
 
 	pd_memcpy(client->mqtt_state.in_buffer + client->mqtt_state.message_length_read, buffer->data, buffer->length);
 	client->mqtt_state.message_length_read += buffer->length;
+	PD_MEM_MARK(PD_BUF_MQTT_IN, client->mqtt_state.message_length_read);
 
 READPACKET:
 	if(client->mqtt_state.message_length_read == 1)
@@ -109,7 +149,7 @@ READPACKET:
 	client->mqtt_state.message_length = mqtt_get_total_length(client->mqtt_state.in_buffer, client->mqtt_state.message_length_read);
 	INFO("message length:%d\n", client->mqtt_state.message_length);
 
-	show_package(client->mqtt_state.in_buffer, client->mqtt_state.message_length_read);
+	PD_LOG_HEX(client->mqtt_state.in_buffer, client->mqtt_state.message_length_read);
 	
 	if(client->mqtt_state.message_length > client->mqtt_state.message_length_read)
 	{
@@ -130,14 +170,18 @@ READPACKET:
 		{
 			if(client->mqtt_state.pending_msg_type != MQTT_MSG_TYPE_CONNECT)
 			{
-				INFO("MQTT: Invalid packet\r\n");
+				PD_LOGW("MQTT: Invalid packet\r\n");
 				net_tcp_disconnect(client->pCon);
 			}
 
 			else
 			{
-				INFO("MQTT: Connected to %s:%d\r\n", client->host, client->port);
+				PD_LOGI("MQTT: Connected to %s:%d\r\n", client->host, client->port);
 				client->connState = MQTT_DATA;
+				if(client->recvHold)
+				{
+					net_tcp_recv_hold(client->pCon, 1);
+				}
 				if(client->connectedCb)
 					client->connectedCb((uint32_t*)client);
 			}
@@ -166,13 +210,13 @@ READPACKET:
 			if(msg_qos == 1 || msg_qos == 2)
 			{
 				INFO("MQTT: Queue response QoS: %d\r\n", msg_qos);
-				if(QUEUE_Puts(&client->msgQueue, client->mqtt_state.outbound_message->data,\
+				if(QUEUE_Puts(&client->msgQueue[MQTT_LANE_HIGH], client->mqtt_state.outbound_message->data,\
 						client->mqtt_state.outbound_message->length) == -1)
 				{
-					INFO("MQTT: Queue full\r\n");
+					PD_LOGW("MQTT: Queue full\r\n");
 				}
 			}
-			show_package(client->mqtt_state.in_buffer, client->mqtt_state.message_length);
+			PD_LOG_HEX(client->mqtt_state.in_buffer, client->mqtt_state.message_length);
 			deliver_publish(client, client->mqtt_state.in_buffer, client->mqtt_state.message_length);
 			break;
 
@@ -185,17 +229,17 @@ READPACKET:
 
 			case MQTT_MSG_TYPE_PUBREC:
 			client->mqtt_state.outbound_message = mqtt_msg_pubrel(&client->mqtt_state.mqtt_connection, msg_id);
-			if(QUEUE_Puts(&client->msgQueue, client->mqtt_state.outbound_message->data, client->mqtt_state.outbound_message->length) == -1)
+			if(QUEUE_Puts(&client->msgQueue[MQTT_LANE_HIGH], client->mqtt_state.outbound_message->data, client->mqtt_state.outbound_message->length) == -1)
 			{
-				INFO("MQTT: Queue full\r\n");
+				PD_LOGW("MQTT: Queue full\r\n");
 			}
 			break;
 
 			case MQTT_MSG_TYPE_PUBREL:
 			client->mqtt_state.outbound_message = mqtt_msg_pubcomp(&client->mqtt_state.mqtt_connection, msg_id);
-			if(QUEUE_Puts(&client->msgQueue, client->mqtt_state.outbound_message->data, client->mqtt_state.outbound_message->length) == -1)
+			if(QUEUE_Puts(&client->msgQueue[MQTT_LANE_HIGH], client->mqtt_state.outbound_message->data, client->mqtt_state.outbound_message->length) == -1)
 			{
-				INFO("MQTT: Queue full\r\n");
+				PD_LOGW("MQTT: Queue full\r\n");
 			}
 			break;
 
@@ -208,9 +252,9 @@ READPACKET:
 
 			case MQTT_MSG_TYPE_PINGREQ:
 			client->mqtt_state.outbound_message = mqtt_msg_pingresp(&client->mqtt_state.mqtt_connection);
-			if(QUEUE_Puts(&client->msgQueue, client->mqtt_state.outbound_message->data, client->mqtt_state.outbound_message->length) == -1)
+			if(QUEUE_Puts(&client->msgQueue[MQTT_LANE_HIGH], client->mqtt_state.outbound_message->data, client->mqtt_state.outbound_message->length) == -1)
 			{
-				INFO("MQTT: Queue full\r\n");
+				PD_LOGW("MQTT: Queue full\r\n");
 			}
 			break;
 
@@ -229,14 +273,14 @@ READPACKET:
 	INFO("client->mqtt_state.message_length_read = %d\n", client->mqtt_state.message_length_read);
 	INFO("client->mqtt_state.message_length = %d\n", client->mqtt_state.message_length);
 	INFO("the package is\n");
-	show_package(client->mqtt_state.in_buffer, client->mqtt_state.message_length);
+	PD_LOG_HEX(client->mqtt_state.in_buffer, client->mqtt_state.message_length);
 	if(remain_length > 0)
 	{
 		int i = 0;
 		for(i = 0; i< remain_length; i++)
 		{
 			client->mqtt_state.in_buffer[i] = \
-					client->mqtt_state.in_buffer[client->mqtt_state.message_length_read - remain_length + i];
+					client->mqtt_state.in_buffer[client->mqtt_state.message_length + i];
 		}
 
 		INFO("Get another published message\r\n");
@@ -246,6 +290,21 @@ READPACKET:
 	MQTT_Task(client);
 }
 
+/**
+  * @brief  Client received callback function.
+  * @param  arg: contain the ip link information
+  * @param  pdata: received data
+  * @param  len: the lenght of received data
+  * @retval None
+  */
+void FUNCTION_ATTRIBUTE
+mqtt_tcpclient_recv(void *arg, struct data_buf *buffer)
+{
+	PD_TRACE_BEGIN(PD_TRACE_MQTT_RECV, buffer->length);
+	mqtt_tcpclient_recv_data(arg, buffer);
+	PD_TRACE_END(PD_TRACE_MQTT_RECV, buffer->length);
+}
+
 /**
   * @brief  Client send over callback function.
   * @param  arg: contain the ip link information
@@ -267,7 +326,7 @@ mqtt_tcpclient_sent_cb(void *arg, int8_t error_no)
 	}
 	else if(error_no == -1)
 	{
-		INFO("TCP: sent failed!");
+		PD_LOGW("TCP: sent failed!");
 		client->sendTimeout = 0;
 		client->connState = TCP_RECONNECT_REQ;
 	}
@@ -404,26 +463,55 @@ mqtt_tcpclient_connect_cb(void *arg, int8_t errno)
   */
 BOOL FUNCTION_ATTRIBUTE
 MQTT_Publish(MQTT_Client *client, const char* topic, const char* data, int data_length, int qos, int retain)
+{
+	return MQTT_PublishLane(client, topic, data, data_length, qos, retain, MQTT_LANE_NORMAL);
+}
+
+/**
+  * @brief  MQTT publish function with a lane, a full lane drops its oldest
+  *         packets and leaves the other lanes alone.
+  * @param  client: 	MQTT_Client reference
+  * @param  topic: 		string topic will publish to
+  * @param  data: 		buffer data send point to
+  * @param  data_length: length of data
+  * @param  qos:		qos
+  * @param  retain:		retain
+  * @param  lane:		MQTT_LANE_*
+  * @retval TRUE if success queue
+  */
+BOOL FUNCTION_ATTRIBUTE
+MQTT_PublishLane(MQTT_Client *client, const char* topic, const char* data, int data_length, int qos, int retain, uint8_t lane)
 {
 	uint8_t dataBuffer[MQTT_BUF_SIZE];
 	uint16_t dataLen;
+	QUEUE *queue = &client->msgQueue[lane < MQTT_LANES? lane: MQTT_LANE_NORMAL];
+	PD_TRACE_BEGIN(PD_TRACE_MQTT_PUBLISH, data_length);
 	client->mqtt_state.outbound_message = mqtt_msg_publish(&client->mqtt_state.mqtt_connection,
 										 topic, data, data_length,
 										 qos, retain,
 										 &client->mqtt_state.pending_msg_id);
 	if(client->mqtt_state.outbound_message->length == 0){
-		INFO("MQTT: Queuing publish failed\r\n");
+		PD_LOGE("MQTT: Queuing publish failed\r\n");
+		PD_TRACE_END(PD_TRACE_MQTT_PUBLISH, 0);
 		return FALSE;
 	}
-	INFO("MQTT: queuing publish, length: %d, queue size(%d/%d)\r\n", client->mqtt_state.outbound_message->length, client->msgQueue.rb.fill_cnt, client->msgQueue.rb.size);
-	while(QUEUE_Puts(&client->msgQueue, client->mqtt_state.outbound_message->data, client->mqtt_state.outbound_message->length) == -1){
-		INFO("MQTT: Queue full\r\n");
-		if(QUEUE_Gets(&client->msgQueue, dataBuffer, &dataLen, MQTT_BUF_SIZE) == -1) {
-			INFO("MQTT: Serious buffer error\r\n");
+	INFO("MQTT: queuing publish, length: %d, lane %d size(%d/%d)\r\n", client->mqtt_state.outbound_message->length, lane, (int)queue->rb.fill_cnt, (int)queue->rb.size);
+	if(framed_length(client->mqtt_state.outbound_message->data, client->mqtt_state.outbound_message->length) > queue->rb.size){
+		// dropping the queued packets would not make room.
+		PD_LOGE("MQTT: publish too long for lane %d\r\n", lane);
+		PD_TRACE_END(PD_TRACE_MQTT_PUBLISH, 0);
+		return FALSE;
+	}
+	while(QUEUE_Puts(queue, client->mqtt_state.outbound_message->data, client->mqtt_state.outbound_message->length) == -1){
+		PD_LOGW("MQTT: Queue full\r\n");
+		if(QUEUE_Gets(queue, dataBuffer, &dataLen, MQTT_BUF_SIZE) == -1) {
+			PD_LOGE("MQTT: Serious buffer error\r\n");
+			PD_TRACE_END(PD_TRACE_MQTT_PUBLISH, 0);
 			return FALSE;
 		}
 	}
 	MQTT_Task(client);
+	PD_TRACE_END(PD_TRACE_MQTT_PUBLISH, data_length);
 	return TRUE;
 }
 
@@ -444,10 +532,10 @@ MQTT_Subscribe(MQTT_Client *client, char* topic, uint8_t qos)
 											topic, 0,
 											&client->mqtt_state.pending_msg_id);
 	INFO("MQTT: queue subscribe, topic\"%s\", id: %d\r\n",topic, client->mqtt_state.pending_msg_id);
-	while(QUEUE_Puts(&client->msgQueue, client->mqtt_state.outbound_message->data, client->mqtt_state.outbound_message->length) == -1){
-		INFO("MQTT: Queue full\r\n");
-		if(QUEUE_Gets(&client->msgQueue, dataBuffer, &dataLen, MQTT_BUF_SIZE) == -1) {
-			INFO("MQTT: Serious buffer error\r\n");
+	while(QUEUE_Puts(&client->msgQueue[MQTT_LANE_NORMAL], client->mqtt_state.outbound_message->data, client->mqtt_state.outbound_message->length) == -1){
+		PD_LOGW("MQTT: Queue full\r\n");
+		if(QUEUE_Gets(&client->msgQueue[MQTT_LANE_NORMAL], dataBuffer, &dataLen, MQTT_BUF_SIZE) == -1) {
+			PD_LOGE("MQTT: Serious buffer error\r\n");
 			return FALSE;
 		}
 	}
@@ -459,6 +547,7 @@ MQTT_Subscribe(MQTT_Client *client, char* topic, uint8_t qos)
 static void FUNCTION_ATTRIBUTE
 MQTT_exit(MQTT_Client *client)
 {
+	uint8_t lane;
 	if(client == NULL)
 	{
 		return;
@@ -493,10 +582,13 @@ MQTT_exit(MQTT_Client *client)
 		pd_free(client->mqtt_state.out_buffer);
 		client->mqtt_state.out_buffer = NULL;
 	}
-	if(client->msgQueue.buf != NULL)
+	for(lane = 0; lane < MQTT_LANES; lane++)
 	{
-		pd_free(client->msgQueue.buf);
-		client->msgQueue.buf = NULL;
+		if(client->msgQueue[lane].buf != NULL)
+		{
+			pd_free(client->msgQueue[lane].buf);
+			client->msgQueue[lane].buf = NULL;
+		}
 	}
 	INFO("mqtt exit:\n");
 	if(client->errorCb != NULL)
@@ -513,6 +605,7 @@ MQTT_Task(MQTT_Client *client)
 
 	uint16_t dataLen;
     struct data_buf buffer;
+	int8_t lane;
 	if(client == NULL)
 		return;
 	switch(client->connState){
@@ -525,10 +618,15 @@ MQTT_Task(MQTT_Client *client)
 		break;
 	case MQTT_DATA:
 		INFO("MQTT TASK DATA\n");
-		if(QUEUE_IsEmpty(&client->msgQueue) || client->sendTimeout != 0) {
+		if(client->sendTimeout != 0) {
+			break;
+		}
+		// the highest lane with a packet goes first.
+		for(lane = MQTT_LANES - 1; lane >= 0 && QUEUE_IsEmpty(&client->msgQueue[lane]); lane--);
+		if(lane < 0) {
 			break;
 		}
-		if(QUEUE_Gets(&client->msgQueue, dataBuffer, &dataLen, MQTT_BUF_SIZE) == 0){
+		if(QUEUE_Gets(&client->msgQueue[lane], dataBuffer, &dataLen, MQTT_BUF_SIZE) == 0){
 			INFO("%s, dataLen:%d\n", __func__, dataLen);
 			client->mqtt_state.pending_msg_type = mqtt_get_type(dataBuffer);
 			client->mqtt_state.pending_msg_id = mqtt_get_id(dataBuffer, dataLen);
@@ -536,7 +634,9 @@ MQTT_Task(MQTT_Client *client)
             buffer.length = dataLen;
             buffer.data = dataBuffer;
 			INFO("MQTT: Sending, type: %d, id: %04X\r\n",client->mqtt_state.pending_msg_type, client->mqtt_state.pending_msg_id);
+			PD_TRACE_BEGIN(PD_TRACE_TCP_SEND, dataLen);
 			net_tcp_send(client->pCon, buffer, client->sendTimeout);
+			PD_TRACE_END(PD_TRACE_TCP_SEND, dataLen);
 			client->mqtt_state.outbound_message = NULL;
 			break;
 		}
@@ -585,6 +685,7 @@ void FUNCTION_ATTRIBUTE
 MQTT_InitClient(MQTT_Client *mqttClient, uint8_t* client_id, uint8_t* client_user, uint8_t* client_pass, uint32_t keepAliveTime, uint8_t cleanSession)
 {
 	uint32_t temp;
+	uint8_t lane;
 	INFO("MQTT_InitClient\r\n");
 	pd_memset(&mqttClient->connect_info, 0, sizeof(mqtt_connect_info_t));
 
@@ -619,7 +720,10 @@ MQTT_InitClient(MQTT_Client *mqttClient, uint8_t* client_id, uint8_t* client_use
 	mqttClient->mqtt_state.message_length_read = 0;
 
 	mqtt_msg_init(&mqttClient->mqtt_state.mqtt_connection, mqttClient->mqtt_state.out_buffer, mqttClient->mqtt_state.out_buffer_length);
-	QUEUE_Init(&mqttClient->msgQueue, QUEUE_BUFFER_SIZE);
+	for(lane = 0; lane < MQTT_LANES; lane++)
+	{
+		QUEUE_Init(&mqttClient->msgQueue[lane], lane_size[lane]);
+	}
     //MQTT_Task(mqttClient);
 }
 
@@ -729,3 +833,28 @@ MQTT_OnPublished(MQTT_Client *mqttClient, MqttCallback publishedCb)
 {
 	mqttClient->publishedCb = publishedCb;
 }
+
+/**
+  * @brief  Stop or resume reading from the broker, the consumer of the
+  *         published data uses it to hold the broker back while it is busy.
+  *         the hold outlasts a reconnect, it starts once the broker accepted
+  *         the connection. a long hold also holds back the ping response.
+  * @param  client: 	MQTT_Client reference
+  * @param  hold:		1 to stop, 0 to resume
+  * @retval None
+  */
+void FUNCTION_ATTRIBUTE
+MQTT_HoldRecv(MQTT_Client *client, uint8_t hold)
+{
+	if(client->recvHold == hold)
+	{
+		return;
+	}
+
+	INFO("MQTT: %s reading\r\n", hold? "hold": "resume");
+	client->recvHold = hold;
+	if(client->pCon != NULL && client->connState == MQTT_DATA)
+	{
+		net_tcp_recv_hold(client->pCon, hold);
+	}
+}
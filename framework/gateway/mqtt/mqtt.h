@@ -81,6 +81,14 @@ typedef enum {
 	MQTT_PUBLISHING
 } tConnState;
 
+/* outbound lanes, the highest lane with a packet sends first. the gateway
+   maps the PRIORITY_LEVEL_* of a sub device package to the lane of the same
+   number. */
+#define MQTT_LANE_BULK		0	/* telemetry */
+#define MQTT_LANE_NORMAL	1	/* subscriptions, commands and events */
+#define MQTT_LANE_HIGH		2	/* acks, pings and alarms */
+#define MQTT_LANES			3
+
 typedef void (*MqttCallback)(uint32_t *args);
 typedef void (*MqttDataCallback)(uint32_t *args, const char* topic, uint32_t topic_len, const char *data, uint32_t lengh);
 
@@ -108,8 +116,11 @@ typedef struct  {
 	uint32_t connectTick;
 	uint32_t sendTimeout;
 	uint32_t heart_beat_flag;
+	uint8_t recvHold;
+	uint16_t dataMsgId;		// packet id of the publish given to dataCb, 0 for qos 0
+	uint8_t dataDup;		// and its dup flag, set on a redelivery
 	tConnState connState;
-	QUEUE msgQueue;
+	QUEUE msgQueue[MQTT_LANES];
 	void* user_data;
 } MQTT_Client;
 
@@ -142,5 +153,7 @@ BOOL  MQTT_Subscribe(MQTT_Client *client, char* topic, uint8_t qos);
 void  MQTT_Connect(MQTT_Client *mqttClient);
 void  MQTT_Disconnect(MQTT_Client *mqttClient);
 BOOL  MQTT_Publish(MQTT_Client *client, const char* topic, const char* data, int data_length, int qos, int retain);
+BOOL  MQTT_PublishLane(MQTT_Client *client, const char* topic, const char* data, int data_length, int qos, int retain, uint8_t lane);
+void  MQTT_HoldRecv(MQTT_Client *client, uint8_t hold);
 
 #endif /* USER_AT_MQTT_H_ */
@@ -129,7 +129,7 @@ static mqtt_message_t* FUNCTION_ATTRIBUTE fini_message(mqtt_connection_t* connec
 
 void FUNCTION_ATTRIBUTE mqtt_msg_init(mqtt_connection_t* connection, uint8_t* buffer, uint16_t buffer_length)
 {
-  memset(connection, 0, sizeof(connection));
+  memset(connection, 0, sizeof(*connection));
   connection->buffer = buffer;
   connection->buffer_length = buffer_length;
 }
@@ -9,6 +9,7 @@ I8 FUNCTION_ATTRIBUTE PROTO_Init(PROTO_PARSER *parser, PROTO_PARSE_CALLBACK *com
     parser->dataLen = 0;
     parser->callback = completeCallback;
     parser->isEsc = 0;
+    parser->isBegin = 0;
     return 0;
 }
 
@@ -27,6 +27,8 @@
 * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 * POSSIBILITY OF SUCH DAMAGE.
 */
+#define PANDO_MEM_MODULE PD_MEM_MQTT
+
 #include "queue.h"
 #include "../../platform/include/pando_types.h"
 #include "../../platform/include/pando_sys.h"
@@ -40,7 +42,9 @@ void FUNCTION_ATTRIBUTE QUEUE_Init(QUEUE *queue, int bufferSize)
 }
 int32_t FUNCTION_ATTRIBUTE QUEUE_Puts(QUEUE *queue, uint8_t* buffer, uint16_t len)
 {
-	return PROTO_AddRb(&queue->rb, buffer, len);
+	int32_t ret = PROTO_AddRb(&queue->rb, buffer, len);
+	PD_MEM_MARK(PD_BUF_MQTT_QUEUE, queue->rb.fill_cnt);
+	return ret;
 }
 int32_t FUNCTION_ATTRIBUTE QUEUE_Gets(QUEUE *queue, uint8_t* buffer, uint16_t* len, uint16_t maxLen)
 {
@@ -1,21 +1,219 @@
+#define PANDO_MEM_MODULE PD_MEM_GATEWAY
+#define PANDO_LOG_MODULE_LEVEL PANDO_LOG_LEVEL_GATEWAY
+
 #include "pando_channel.h"
 #include "../platform/include/pando_sys.h"
+#include "../platform/include/pando_log.h"
+#include "../platform/include/pando_trace.h"
+#include "../platform/include/pando_task.h"
+
+#define MAX_CHAN_LEN PANDO_CHANNEL_COUNT
+
+// buffers one run of the drain task delivers, the main loop gets a turn
+// between runs.
+#define CHANNEL_DRAIN_BUDGET 4
+
+#define CHANNEL_MSG_NONE 0xff
 
-#define MAX_CHAN_LEN 8
+struct channel_msg
+{
+    uint8_t *buffer;
+    uint16_t length;
+    channel_release_callback release;
+    uint8_t next;               // in its level, or in the free list
+};
+
+// a fifo for each priority level, the buffers come from one pool.
+struct channel_queue
+{
+    struct channel_msg *msgs;   // NULL if the channel delivers in place
+    uint8_t size;
+    uint8_t count;
+    uint8_t free;
+    uint8_t head[CHANNEL_PRIORITY_LEVELS];
+    uint8_t tail[CHANNEL_PRIORITY_LEVELS];
+    uint8_t high;
+    uint8_t low;
+    uint8_t policy;
+    uint8_t congested;
+    uint32_t dropped;
+};
 
 struct pando_channel
 {
     PANDO_CHANNEL_NAME name;
     channel_recv_callback subdevice_cb;
+    channel_name_recv_callback subdevice_name_cb;
     channel_recv_callback device_cb;
+    struct channel_queue queue;
 };
 
 static struct pando_channel channels[MAX_CHAN_LEN];
+static channel_name_recv_callback any_device_cb;
+static channel_congestion_callback congestion_cb;
+static uint8_t congested_count;
+static struct pd_task drain_task;
+static uint8_t drain_next;
+
+static void FUNCTION_ATTRIBUTE
+channel_buffer_free(uint8_t *buffer)
+{
+    pd_free(buffer);
+}
+
+static void FUNCTION_ATTRIBUTE
+channel_deliver(struct pando_channel *channel, uint8_t *buffer, uint16_t length)
+{
+    if(channel->subdevice_cb != NULL ){
+        PD_TRACE_BEGIN(PD_TRACE_CHANNEL_TO_SUBDEVICE, length);
+        channel->subdevice_cb(buffer, length);
+        PD_TRACE_END(PD_TRACE_CHANNEL_TO_SUBDEVICE, length);
+    }
+    else if(channel->subdevice_name_cb != NULL){
+        PD_TRACE_BEGIN(PD_TRACE_CHANNEL_TO_SUBDEVICE, length);
+        channel->subdevice_name_cb(channel->name, buffer, length);
+        PD_TRACE_END(PD_TRACE_CHANNEL_TO_SUBDEVICE, length);
+    }
+}
+
+static void FUNCTION_ATTRIBUTE
+channel_release(uint8_t *buffer, channel_release_callback release)
+{
+    if(release != NULL){
+        release(buffer);
+    }
+}
+
+static void FUNCTION_ATTRIBUTE
+channel_set_congested(struct channel_queue *queue, uint8_t congested)
+{
+    if(queue->congested == congested){
+        return;
+    }
+
+    queue->congested = congested;
+    congested_count += congested? 1: -1;
+
+    // only the first channel to fill up and the last to drain are told.
+    if(congestion_cb != NULL && congested_count == congested){
+        congestion_cb(congested);
+    }
+}
+
+// the highest level with a buffer, the queue is not empty.
+static uint8_t FUNCTION_ATTRIBUTE
+channel_queue_top(struct channel_queue *queue)
+{
+    uint8_t level = CHANNEL_PRIORITY_LEVELS - 1;
+
+    while(queue->head[level] == CHANNEL_MSG_NONE){
+        level--;
+    }
+
+    return level;
+}
+
+// the lowest level with a buffer, the queue is not empty.
+static uint8_t FUNCTION_ATTRIBUTE
+channel_queue_bottom(struct channel_queue *queue)
+{
+    uint8_t level = 0;
+
+    while(queue->head[level] == CHANNEL_MSG_NONE){
+        level++;
+    }
+
+    return level;
+}
+
+// unlink the oldest buffer of a level, its slot is freed.
+static uint8_t FUNCTION_ATTRIBUTE
+channel_queue_pop(struct channel_queue *queue, uint8_t level)
+{
+    uint8_t index = queue->head[level];
+
+    queue->head[level] = queue->msgs[index].next;
+    if(queue->head[level] == CHANNEL_MSG_NONE){
+        queue->tail[level] = CHANNEL_MSG_NONE;
+    }
+
+    queue->msgs[index].next = queue->free;
+    queue->free = index;
+    queue->count--;
+    return index;
+}
+
+static void FUNCTION_ATTRIBUTE
+channel_queue_push(struct channel_queue *queue, uint8_t level, uint8_t *buffer, uint16_t length,
+    channel_release_callback release)
+{
+    uint8_t index = queue->free;
+    struct channel_msg *msg = &queue->msgs[index];
+
+    queue->free = msg->next;
+    msg->buffer = buffer;
+    msg->length = length;
+    msg->release = release;
+    msg->next = CHANNEL_MSG_NONE;
+    if(queue->tail[level] == CHANNEL_MSG_NONE){
+        queue->head[level] = index;
+    }
+    else{
+        queue->msgs[queue->tail[level]].next = index;
+    }
+
+    queue->tail[level] = index;
+    queue->count++;
+}
+
+static void FUNCTION_ATTRIBUTE
+channel_drain(void *arg)
+{
+    uint8_t budget = CHANNEL_DRAIN_BUDGET;
+    uint8_t idle = 0;
+    struct pando_channel *channel = NULL;
+    struct channel_queue *queue = NULL;
+    struct channel_msg msg;
+
+    // the channels take turns, one buffer each.
+    while(budget > 0 && idle < MAX_CHAN_LEN){
+        channel = &channels[drain_next];
+        queue = &channel->queue;
+        drain_next = (drain_next + 1) % MAX_CHAN_LEN;
+        if(queue->count == 0){
+            idle++;
+            continue;
+        }
+
+        idle = 0;
+        budget--;
+        msg = queue->msgs[channel_queue_pop(queue, channel_queue_top(queue))];
+        if(queue->count <= queue->low){
+            channel_set_congested(queue, 0);
+        }
+
+        channel_deliver(channel, msg.buffer, msg.length);
+        channel_release(msg.buffer, msg.release);
+    }
+
+    if(idle < MAX_CHAN_LEN){
+        pando_task_post(&drain_task);
+    }
+}
 
 void FUNCTION_ATTRIBUTE
 on_subdevice_channel_recv(PANDO_CHANNEL_NAME name, channel_recv_callback cb)
 {
     channels[name].subdevice_cb = cb;
+    channels[name].subdevice_name_cb = NULL;
+}
+
+void FUNCTION_ATTRIBUTE
+on_subdevice_channel_name_recv(PANDO_CHANNEL_NAME name, channel_name_recv_callback cb)
+{
+    channels[name].name = name;
+    channels[name].subdevice_name_cb = cb;
+    channels[name].subdevice_cb = NULL;
 }
 
 void FUNCTION_ATTRIBUTE
@@ -24,19 +222,157 @@ on_device_channel_recv(PANDO_CHANNEL_NAME name, channel_recv_callback cb)
     channels[name].device_cb = cb;
 }
 
+void FUNCTION_ATTRIBUTE
+on_device_any_channel_recv(channel_name_recv_callback cb)
+{
+    any_device_cb = cb;
+}
+
+int8_t FUNCTION_ATTRIBUTE
+channel_queue_init(PANDO_CHANNEL_NAME name, uint8_t size, uint8_t high, uint8_t low, uint8_t policy)
+{
+    struct channel_queue *queue = &channels[name].queue;
+
+    uint8_t i = 0;
+
+    if(queue->count > 0 || size == CHANNEL_MSG_NONE || (size > 0 && (high > size || low >= high))){
+        PD_LOGE("invalid queue of channel %d\n", name);
+        return -1;
+    }
+
+    if(queue->msgs != NULL){
+        pd_free(queue->msgs);
+        queue->msgs = NULL;
+    }
+
+    channel_set_congested(queue, 0);
+    queue->size = 0;
+    if(size == 0){
+        return 0;
+    }
+
+    queue->msgs = (struct channel_msg *)pd_malloc(size * sizeof(struct channel_msg));
+    if(queue->msgs == NULL){
+        PD_LOGE("malloc error!\n");
+        return -1;
+    }
+
+    if(drain_task.task_cb == NULL){
+        drain_task.task_cb = channel_drain;
+        pando_task_init(&drain_task);
+    }
+
+    for(i = 0; i < size; i++){
+        queue->msgs[i].next = i + 1 < size? i + 1: CHANNEL_MSG_NONE;
+    }
+
+    for(i = 0; i < CHANNEL_PRIORITY_LEVELS; i++){
+        queue->head[i] = CHANNEL_MSG_NONE;
+        queue->tail[i] = CHANNEL_MSG_NONE;
+    }
+
+    queue->free = 0;
+    queue->size = size;
+    queue->high = high;
+    queue->low = low;
+    queue->policy = policy;
+    return 0;
+}
+
+void FUNCTION_ATTRIBUTE
+on_channel_congestion(channel_congestion_callback cb)
+{
+    congestion_cb = cb;
+}
+
+uint8_t FUNCTION_ATTRIBUTE
+channel_queue_depth(PANDO_CHANNEL_NAME name)
+{
+    return channels[name].queue.count;
+}
+
+uint32_t FUNCTION_ATTRIBUTE
+channel_queue_dropped(PANDO_CHANNEL_NAME name)
+{
+    return channels[name].queue.dropped;
+}
+
+int8_t FUNCTION_ATTRIBUTE
+channel_post_to_subdevice(PANDO_CHANNEL_NAME name, uint8_t * buffer, uint16_t length,
+    uint8_t priority, channel_release_callback release)
+{
+    struct channel_queue *queue = &channels[name].queue;
+    struct channel_msg *msg = NULL;
+    uint8_t level = 0;
+
+    if(queue->msgs == NULL){
+        channel_deliver(&channels[name], buffer, length);
+        channel_release(buffer, release);
+        return 0;
+    }
+
+    if(priority >= CHANNEL_PRIORITY_LEVELS){
+        priority = CHANNEL_PRIORITY_LEVELS - 1;
+    }
+
+    if(queue->count == queue->size){
+        // a buffer of a lower level makes room, else the policy picks one of
+        // the same level. higher levels are never dropped for lower ones.
+        queue->dropped++;
+        level = channel_queue_bottom(queue);
+        if(level > priority || (level == priority && queue->policy == CHANNEL_DROP_NEWEST)){
+            PD_LOGW("channel %d full, drop the newest\n", name);
+            channel_release(buffer, release);
+            return -1;
+        }
+
+        PD_LOGW("channel %d full, drop the oldest of level %d\n", name, level);
+        msg = &queue->msgs[channel_queue_pop(queue, level)];
+        channel_release(msg->buffer, msg->release);
+    }
+
+    channel_queue_push(queue, priority, buffer, length, release);
+    if(queue->count >= queue->high){
+        channel_set_congested(queue, 1);
+    }
+
+    pando_task_post(&drain_task);
+    return 0;
+}
+
 void FUNCTION_ATTRIBUTE
 channel_send_to_subdevice(PANDO_CHANNEL_NAME name, uint8_t * buffer, uint16_t length)
 {
-    if(channels[name].subdevice_cb != NULL ){
-        channels[name].subdevice_cb(buffer, length);
+    uint8_t *copy = NULL;
+
+    if(channels[name].queue.msgs == NULL){
+        channel_deliver(&channels[name], buffer, length);
+        return;
     }
+
+    // the caller keeps its buffer, the queue takes a copy.
+    copy = (uint8_t *)pd_malloc(length);
+    if(copy == NULL){
+        PD_LOGE("malloc error!\n");
+        return;
+    }
+
+    pd_memcpy(copy, buffer, length);
+    channel_post_to_subdevice(name, copy, length, CHANNEL_PRIORITY_DEFAULT, channel_buffer_free);
 }
 
 void FUNCTION_ATTRIBUTE
 channel_send_to_device(PANDO_CHANNEL_NAME name, uint8_t * buffer, uint16_t length)
 {
-	pd_printf("send package to device\n");
+	PD_LOGD("send package to device\n");
     if(channels[name].device_cb != NULL ){
+        PD_TRACE_BEGIN(PD_TRACE_CHANNEL_TO_DEVICE, length);
         channels[name].device_cb(buffer, length);
+        PD_TRACE_END(PD_TRACE_CHANNEL_TO_DEVICE, length);
+    }
+    else if(any_device_cb != NULL){
+        PD_TRACE_BEGIN(PD_TRACE_CHANNEL_TO_DEVICE, length);
+        any_device_cb(name, buffer, length);
+        PD_TRACE_END(PD_TRACE_CHANNEL_TO_DEVICE, length);
     }
 }
@@ -25,11 +25,38 @@ typedef enum {
     PANDO_CHANNEL_PORT_7
 } PANDO_CHANNEL_NAME;
 
+#define PANDO_CHANNEL_COUNT 8
+
 /*
  * "channel_recv_callback" is a callback function invoked when recving buffer from some channel.
  */
 typedef void (* channel_recv_callback)(uint8_t * buffer, uint16_t length);
 
+/*
+ * "channel_name_recv_callback" is the same, and is also told the channel.
+ */
+typedef void (* channel_name_recv_callback)(PANDO_CHANNEL_NAME name, uint8_t * buffer, uint16_t length);
+
+/*
+ * "channel_release_callback" gives a buffer posted to a channel back to its owner.
+ */
+typedef void (* channel_release_callback)(uint8_t * buffer);
+
+/*
+ * "channel_congestion_callback" is invoked when the first queue of a channel reaches its high
+ * watermark, with congested 1, and when the last one is back at its low watermark, with 0.
+ */
+typedef void (* channel_congestion_callback)(uint8_t congested);
+
+// what a full queue drops of the level it drops from.
+#define CHANNEL_DROP_NEWEST 0
+#define CHANNEL_DROP_OLDEST 1
+
+// queued buffers of a higher priority are delivered first, and a full queue drops the lower ones
+// first. the levels match the PRIORITY_LEVEL_* of the sub device protocol.
+#define CHANNEL_PRIORITY_LEVELS 3
+#define CHANNEL_PRIORITY_DEFAULT 1
+
  /******************************************************************************
  * FunctionName : on_subdevice_channel_recv
  * Description  : regiseter the callback function when subdevice received buffer from some channel.
@@ -39,6 +66,16 @@ typedef void (* channel_recv_callback)(uint8_t * buffer, uint16_t length);
 *******************************************************************************/
 void on_subdevice_channel_recv(PANDO_CHANNEL_NAME name, channel_recv_callback cb);
 
+ /******************************************************************************
+ * FunctionName : on_subdevice_channel_name_recv
+ * Description  : the same as on_subdevice_channel_recv, the callback is also told the channel so
+ *                one transport can serve several channels. each replaces the other's callback.
+ * Parameters   : name: channel name
+ *                cb: callback
+ * Returns      : 
+*******************************************************************************/
+void on_subdevice_channel_name_recv(PANDO_CHANNEL_NAME name, channel_name_recv_callback cb);
+
  /******************************************************************************
  * FunctionName : on_device_channel_recv
  * Description  : regiseter the callback function when device received buffer from some channel.
@@ -48,14 +85,72 @@ void on_subdevice_channel_recv(PANDO_CHANNEL_NAME name, channel_recv_callback cb
 *******************************************************************************/
 void on_device_channel_recv(PANDO_CHANNEL_NAME name, channel_recv_callback cb);
 
+ /******************************************************************************
+ * FunctionName : on_device_any_channel_recv
+ * Description  : regiseter the callback function when device received buffer from a channel
+ *                that has no callback of its own.
+ * Parameters   : cb: callback
+ * Returns      : 
+*******************************************************************************/
+void on_device_any_channel_recv(channel_name_recv_callback cb);
+
+ /******************************************************************************
+ * FunctionName : channel_queue_init
+ * Description  : give a channel a queue for the buffers sent to its subdevice. they are handed
+ *                to the subdevice callback later from the main loop, not in the sender's call.
+ * Parameters   : name: channel name
+ *                size: buffers the queue holds, below 255, 0 to deliver in place again.
+ *                high: the channel is congested with this many buffers queued, at most size.
+ *                low: and no longer with this many, below high.
+ *                policy: CHANNEL_DROP_NEWEST or CHANNEL_DROP_OLDEST when the queue is full.
+ * Returns      : 0 if ok, -1 if the parameters are invalid, the queue is not empty or out of memory.
+*******************************************************************************/
+int8_t channel_queue_init(PANDO_CHANNEL_NAME name, uint8_t size, uint8_t high, uint8_t low, uint8_t policy);
+
+ /******************************************************************************
+ * FunctionName : on_channel_congestion
+ * Description  : regiseter the callback function when the channels get congested or drain.
+ * Parameters   : cb: callback
+ * Returns      : 
+*******************************************************************************/
+void on_channel_congestion(channel_congestion_callback cb);
+
+ /******************************************************************************
+ * FunctionName : channel_queue_depth
+ * Description  : the buffers waiting in the queue of a channel.
+ * Parameters   : name: channel name
+ * Returns      : the count, 0 if it has no queue.
+*******************************************************************************/
+uint8_t channel_queue_depth(PANDO_CHANNEL_NAME name);
+
+ /******************************************************************************
+ * FunctionName : channel_queue_dropped
+ * Description  : the buffers the queue of a channel dropped since it was set up.
+ * Parameters   : name: channel name
+ * Returns      : the count.
+*******************************************************************************/
+uint32_t channel_queue_dropped(PANDO_CHANNEL_NAME name);
+
  /******************************************************************************
  * FunctionName : subdevice_channel_send
- * Description  : send data to subdevice.
+ * Description  : send data to subdevice, a channel with a queue keeps a copy at
+ *                CHANNEL_PRIORITY_DEFAULT.
  * Parameters   : name: channel name
  * Returns      : 
 *******************************************************************************/
 void channel_send_to_subdevice(PANDO_CHANNEL_NAME name, uint8_t * buffer, uint16_t length);
 
+ /******************************************************************************
+ * FunctionName : channel_post_to_subdevice
+ * Description  : send data to subdevice without copying it, the channel takes the buffer.
+ * Parameters   : name: channel name
+ *                priority: the level in the queue, below CHANNEL_PRIORITY_LEVELS.
+ *                release: called once the subdevice got the buffer or it was dropped, may be NULL.
+ * Returns      : 0 if delivered or queued, -1 if the full queue dropped it.
+*******************************************************************************/
+int8_t channel_post_to_subdevice(PANDO_CHANNEL_NAME name, uint8_t * buffer, uint16_t length,
+    uint8_t priority, channel_release_callback release);
+
  /******************************************************************************
  * FunctionName : device_channel_send
  * Description  : send data to device.
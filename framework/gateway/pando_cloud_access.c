@@ -1,14 +1,22 @@
+#define PANDO_MEM_MODULE PD_MEM_GATEWAY
+#define PANDO_LOG_MODULE_LEVEL PANDO_LOG_LEVEL_GATEWAY
+
 #include "pando_cloud_access.h"
 #include "../platform/include/pando_storage_interface.h"
 #include "../platform/include/pando_types.h"
 #include "gateway_defs.h"
 #include "pando_channel.h"
+#include "pando_route.h"
+#include "pando_topic.h"
 //#include "pando_system_time.h"
 #include "mqtt/mqtt.h"
 #include "../protocol/sub_device_protocol.h"
 #include "../protocol/pando_protocol.h"
 #include "../platform/include/pando_sys.h"
+#include "../platform/include/pando_log.h"
+#include "../platform/include/pando_trace.h"
 
+#define IP_STR_LEN 16
 #define PORT_STR_LEN 8
 #define DEVICE_TOKEN_LEN 16
 
@@ -28,12 +36,17 @@ conv_addr_str(const char * ip_str, uint8_t * str_ip_addr, int * port)
     }
     // ip address
     uint32_t ip_len = colon - ip_str;
+    if (ip_len >= IP_STR_LEN)
+    {
+        return -1;
+    }
     pd_strncpy(str_ip_addr, ip_str, ip_len);
     str_ip_addr[ip_len] = '\0';
 
     // port
     char str_port_addr[PORT_STR_LEN];
-    pd_strncpy(str_port_addr, colon+1, PORT_STR_LEN);
+    pd_strncpy(str_port_addr, colon+1, PORT_STR_LEN - 1);
+    str_port_addr[PORT_STR_LEN - 1] = '\0';
     *port = atoi(str_port_addr);
     return 0;
 }
@@ -46,24 +59,27 @@ init_gateway_info()
     pd_memset(&gateway_info, 0, sizeof(gateway_info));
     gateway_info.device_id = atol(pando_data_get(DATANAME_DEVICE_ID));
     pd_memcpy(gateway_info.token, pando_device_token, DEVICE_TOKEN_LEN);
-    pd_printf("token:\n");
-    show_package(gateway_info.token, DEVICE_TOKEN_LEN);
+    PD_LOGD("token:\n");
+    PD_LOG_HEX(gateway_info.token, DEVICE_TOKEN_LEN);
     pando_protocol_init(gateway_info);
 }
 
 static void FUNCTION_ATTRIBUTE
-pando_publish_data_channel1(uint8_t* buffer, uint16_t length)
+pando_publish_data(uint8_t* buffer, uint16_t length, uint16_t sub_device_id)
 {
-	pd_printf("pando_publish_data_channel1");
+	PD_LOGD("pando_publish_data from sub device %d\n", sub_device_id);
     struct pando_buffer *gateway_data_buffer = NULL;
     uint16_t buf_len = 0;
     uint16_t payload_type = 0;
+    PD_TRACE_BEGIN(PD_TRACE_PUBLISH, length);
+    pando_protocol_sub_device_rx(sub_device_id, buffer, length);
     buf_len = GATE_HEADER_LEN + length - sizeof(struct device_header);
     gateway_data_buffer = pando_buffer_create(buf_len, GATE_HEADER_LEN - sizeof(struct device_header));
 
     if (gateway_data_buffer->buffer == NULL)
     {
     	pd_printf("%s:malloc failed.\n", __func__);
+        PD_TRACE_END(PD_TRACE_PUBLISH, 0);
         return;
     }
 
@@ -71,11 +87,12 @@ pando_publish_data_channel1(uint8_t* buffer, uint16_t length)
     if (pando_protocol_encode(gateway_data_buffer, &payload_type))
     {
     	pd_printf("pando_protocol_encode error.\n");
+        PD_TRACE_END(PD_TRACE_PUBLISH, 0);
         return;
     }
 
-    pando_protocol_set_sub_device_id(gateway_data_buffer, 1);
-    show_package(gateway_data_buffer->buffer, gateway_data_buffer->buff_len);
+    pando_protocol_set_sub_device_id(gateway_data_buffer, sub_device_id);
+    PD_LOG_HEX(gateway_data_buffer->buffer, gateway_data_buffer->buff_len);
     char topic[2];
     switch(payload_type)
     {
@@ -91,12 +108,15 @@ pando_publish_data_channel1(uint8_t* buffer, uint16_t length)
         default:
         	pd_printf("error payload type\n");
             pando_buffer_delete(gateway_data_buffer);
+            PD_TRACE_END(PD_TRACE_PUBLISH, 0);
             return;
     }
 
     if(mqtt_client.connState == MQTT_DATA)
     {
-    	MQTT_Publish(&mqtt_client, topic, gateway_data_buffer->buffer, gateway_data_buffer->buff_len, 1, 0);
+    	// the lanes are numbered as the priority levels, alarms overtake telemetry.
+    	MQTT_PublishLane(&mqtt_client, topic, gateway_data_buffer->buffer, gateway_data_buffer->buff_len, 1, 0,
+    	    get_sub_device_priority_level(buffer, length));
     }
     else
     {
@@ -104,51 +124,38 @@ pando_publish_data_channel1(uint8_t* buffer, uint16_t length)
     }
 
     pando_buffer_delete(gateway_data_buffer);
+    PD_TRACE_END(PD_TRACE_PUBLISH, length);
 }
 
 static void FUNCTION_ATTRIBUTE
-mqtt_data_cb(uint32_t *args, const char* topic, uint32_t topic_len, const char *data, uint32_t data_len)
+pando_publish_channel_data(PANDO_CHANNEL_NAME name, uint8_t* buffer, uint16_t length)
 {
-	pd_printf("mqtt_data_cb\n");
-	pd_printf("mqtt topic length: %d\n", topic_len);
-	pd_printf("mqtt data length: %d\n", data_len);
-
     uint16_t sub_device_id = 0;
 
-    if((topic == NULL) || (data == NULL))
+    if(pando_route_from_subdevice(name, buffer, length, &sub_device_id) == 0)
     {
-    	pd_printf("no needed mqtt package!");
-        return;
+        pando_publish_data(buffer, length, sub_device_id);
     }
-    char *topic_buf = (char*)pd_malloc(topic_len+1);
-	pd_memset(topic_buf, 0 , topic_len + 1);
-    pd_memcpy(topic_buf, topic, topic_len);
-    topic_buf[topic_len] = 0;
-    pd_printf("the topic is: %s\n", topic_buf);
-
-    uint8_t payload_type = 0;
-    switch(*topic_buf)
+}
+
+static void FUNCTION_ATTRIBUTE
+pando_transfer_to_subdevice(uint16_t payload_type, const uint8_t *data, uint16_t data_len)
+{
+    uint16_t sub_device_id = 0;
+
+    if(data_len < GATE_HEADER_LEN + sizeof(sub_device_id))
     {
-    	case 's':
-    		payload_type = PAYLOAD_TYPE_DATA;
-    		break;
-        case 'c':
-            payload_type = PAYLOAD_TYPE_COMMAND;
-            break;
-        case 'e':
-            payload_type = PAYLOAD_TYPE_EVENT;
-            break;
-        case 'd':
-            payload_type = PAYLOAD_TYPE_DATA;
-            break;
-        default:
-            return;
+    	PD_LOGW("the data from server is too short!\n");
+        return;
     }
 
-    if(topic_buf != NULL)
+    // a redelivery of a message the sub device got already is dropped here,
+    // before it costs a copy and a decode.
+    pd_memcpy(&sub_device_id, data + GATE_HEADER_LEN, sizeof(sub_device_id));
+    sub_device_id = net16_to_host(sub_device_id);
+    if(pando_protocol_check_message(sub_device_id, mqtt_client.dataMsgId, mqtt_client.dataDup))
     {
-    	pd_free(topic_buf);
-    	topic_buf = NULL;
+        return;
     }
 
     struct pando_buffer* pd_buffer;
@@ -163,60 +170,92 @@ mqtt_data_cb(uint32_t *args, const char* topic, uint32_t topic_len, const char *
     if(pd_buffer->buffer == NULL)
     {
     	pd_printf("malloc error!\n");
+        pd_free(pd_buffer);
         return;
     }
     pd_memcpy(pd_buffer->buffer, data, data_len);
     pd_buffer->offset = 0;
-    pando_protocol_get_sub_device_id(pd_buffer, &sub_device_id);
 
-    pd_printf("package from server, get rid of mqtt head:\n");
-    show_package(pd_buffer->buffer, pd_buffer->buff_len);
+    PD_LOGD("package from server, get rid of mqtt head:\n");
+    PD_LOG_HEX(pd_buffer->buffer, pd_buffer->buff_len);
     if(pando_protocol_decode(pd_buffer, payload_type) != 0)
     {
-    	pd_printf("the data from server is wrong!\n");
+    	PD_LOGW("the data from server is wrong!\n");
+        pando_buffer_delete(pd_buffer);
         return;
     }
 
-    struct sub_device_buffer *device_buffer = (struct sub_device_buffer *)pd_malloc(sizeof(struct sub_device_buffer));
-    device_buffer->buffer_length = pd_buffer->buff_len - pd_buffer->offset;
-    device_buffer->buffer = (uint8_t*)pd_malloc(device_buffer->buffer_length);
-    pd_memcpy(device_buffer->buffer, pd_buffer->buffer + pd_buffer->offset, device_buffer->buffer_length);
-    pando_buffer_delete(pd_buffer);
-
-    if(sub_device_id == 1 || sub_device_id == 65535) //65535 is broadcast id.
+    uint16_t device_length = pd_buffer->buff_len - pd_buffer->offset;
+    uint8_t *device_buffer = pando_route_buffer_new(device_length);
+    if(device_buffer == NULL)
     {
-    	pd_printf("transfer data to sub device: %d\n", sub_device_id);
-        channel_send_to_subdevice(PANDO_CHANNEL_PORT_1, device_buffer->buffer,device_buffer->buffer_length);
+    	pd_printf("malloc error!\n");
+        pando_buffer_delete(pd_buffer);
+        return;
     }
+    pd_memcpy(device_buffer, pd_buffer->buffer + pd_buffer->offset, device_length);
+    pando_buffer_delete(pd_buffer);
 
-    else if(sub_device_id == 0)
+    pando_route_to_subdevice(sub_device_id, device_buffer, device_length);
+}
+
+static void FUNCTION_ATTRIBUTE
+mqtt_command_topic_cb(const char *topic, uint16_t topic_len, const uint8_t *data, uint16_t data_len)
+{
+    pando_transfer_to_subdevice(PAYLOAD_TYPE_COMMAND, data, data_len);
+}
+
+static void FUNCTION_ATTRIBUTE
+mqtt_event_topic_cb(const char *topic, uint16_t topic_len, const uint8_t *data, uint16_t data_len)
+{
+    pando_transfer_to_subdevice(PAYLOAD_TYPE_EVENT, data, data_len);
+}
+
+static void FUNCTION_ATTRIBUTE
+mqtt_data_topic_cb(const char *topic, uint16_t topic_len, const uint8_t *data, uint16_t data_len)
+{
+    pando_transfer_to_subdevice(PAYLOAD_TYPE_DATA, data, data_len);
+}
+
+static void FUNCTION_ATTRIBUTE
+channel_congestion_cb(uint8_t congested)
+{
+    // stop reading from the broker until the sub device queues drained.
+    MQTT_HoldRecv(&mqtt_client, congested);
+}
+
+static void FUNCTION_ATTRIBUTE
+mqtt_data_cb(uint32_t *args, const char* topic, uint32_t topic_len, const char *data, uint32_t data_len)
+{
+	PD_LOGD("mqtt_data_cb, topic length: %d, data length: %d\n", topic_len, data_len);
+    if((topic == NULL) || (data == NULL))
     {
-        channel_send_to_subdevice(PANDO_CHANNEL_PORT_0, device_buffer->buffer,device_buffer->buffer_length);
+    	pd_printf("no needed mqtt package!");
+        return;
     }
-    delete_device_package(device_buffer);
+
+    PD_TRACE_BEGIN(PD_TRACE_MQTT_DATA_CB, data_len);
+    pando_topic_dispatch(topic, topic_len, (const uint8_t *)data, data_len);
+    PD_TRACE_END(PD_TRACE_MQTT_DATA_CB, data_len);
 }
 
 static void FUNCTION_ATTRIBUTE
 mqtt_published_cb(uint32_t *arg)
 {
-	pd_printf("MQTT: Published\r\n");
-    MQTT_Client* client = (MQTT_Client*)arg;
-
+	PD_LOGD("MQTT: Published\r\n");
 }
 
 static void FUNCTION_ATTRIBUTE
 mqtt_connect_cb(uint32_t* arg)
 {
 	pd_printf("MQTT: Connected\r\n");
-    MQTT_Client* client = (MQTT_Client*)arg;
-    on_device_channel_recv(PANDO_CHANNEL_PORT_1, pando_publish_data_channel1);
+    on_device_any_channel_recv(pando_publish_channel_data);
 }
 
 static void FUNCTION_ATTRIBUTE
 mqtt_disconnect_cb(uint32_t* arg)
 {
 	pd_printf("MQTT: Disconnected\r\n");
-    MQTT_Client* client = (MQTT_Client*)arg;
 }
 static void FUNCTION_ATTRIBUTE
 mqtt_error_cb(uint32_t* arg)
@@ -254,7 +293,7 @@ pando_cloud_access(gateway_callback callback)
     }
 
     int port;
-    uint8_t ip_string[16];
+    uint8_t ip_string[IP_STR_LEN];
     if(0 != (conv_addr_str(access_addr, ip_string, &port)))
     {
     	pd_printf("wrong access server address...\n");
@@ -274,7 +313,12 @@ pando_cloud_access(gateway_callback callback)
     char* token_str = pando_data_get(DATANAME_ACCESS_TOKEN);
     pd_memcpy(access_token_str, token_str, pd_strlen(token_str) + 1);
     MQTT_InitClient(&mqtt_client, str_device_id_hex, "", access_token_str, PANDO_KEEPALIVE_TIME, 1);
-    pd_printf("access str_device_id_hex:%s\n", &str_device_id_hex);
+    pd_printf("access str_device_id_hex:%s\n", (char *)str_device_id_hex);
+    pando_topic_register("c", mqtt_command_topic_cb);
+    pando_topic_register("e", mqtt_event_topic_cb);
+    pando_topic_register("s", mqtt_data_topic_cb);
+    pando_topic_register("d", mqtt_data_topic_cb);
+    on_channel_congestion(channel_congestion_cb);
     MQTT_OnConnected(&mqtt_client, mqtt_connect_cb);
     MQTT_OnDisconnected(&mqtt_client, mqtt_disconnect_cb);
     MQTT_OnPublished(&mqtt_client, mqtt_published_cb);
@@ -1,3 +1,5 @@
+#define PANDO_MEM_MODULE PD_MEM_GATEWAY
+
 #include "pando_device_login.h"
 #include "../platform/include/pando_storage_interface.h"
 #include "gateway_defs.h"
@@ -23,6 +25,25 @@ static char * request = NULL;
 extern char* g_server_url;
 extern uint8_t pando_device_token[ACCESS_TOKEN_LEN];
 
+struct login_response
+{
+    int code;
+    char message[MSG_BUF_LEN];
+    char access_token[ACCESS_TOKEN_LEN*2 + 16];
+    char access_addr[KEY_BUF_LEN];
+};
+
+// bit of each entry in the pando_json_extract result.
+#define LOGIN_FIELD_CODE BIT(0)
+
+static const struct pando_json_field login_fields[] =
+{
+    PANDO_JSON_FIELD("code", PANDO_JSON_INT, struct login_response, code),
+    PANDO_JSON_FIELD("message", PANDO_JSON_STRING, struct login_response, message),
+    PANDO_JSON_FIELD("data.access_token", PANDO_JSON_STRING, struct login_response, access_token),
+    PANDO_JSON_FIELD("data.access_addr", PANDO_JSON_STRING, struct login_response, access_addr)
+};
+
 static void FUNCTION_ATTRIBUTE
 http_callback_login(char * response)
 {
@@ -40,68 +61,26 @@ http_callback_login(char * response)
     
     pd_printf("response=%s\n(end)\n", response);
 	
-	uint16_t response_len = pd_strlen(response) + 1;
-    char* login_response = (char*)pd_malloc(response_len);
-	pd_memset(login_response, 0, response_len);
-	pd_memcpy(login_response, response, response_len);
-	
-    struct jsonparse_state json_state;
-    jsonparse_setup(&json_state, login_response, pd_strlen(login_response));
-    int code;
-    char message[MSG_BUF_LEN];
-    char access_token[ACCESS_TOKEN_LEN*2 + 16];
-    char access_addr[KEY_BUF_LEN];
-
-    access_token[ACCESS_TOKEN_LEN*2] = '\0';
-    int type;
-    while ((type = jsonparse_next(&json_state)) != 0)
+    struct login_response result;
+    int found;
+
+    pd_memset(&result, 0, sizeof(result));
+    result.code = -1;
+    found = pando_json_extract(response, pd_strlen(response), login_fields,
+        sizeof(login_fields) / sizeof(login_fields[0]), &result);
+    if(found < 0 || (found & LOGIN_FIELD_CODE) == 0)
     {
-        if (type == JSON_TYPE_PAIR_NAME) 
+        pd_printf("bad login response\n");
+        if(device_login_callback != NULL) 
         {
-            if(jsonparse_strcmp_value(&json_state, "code") == 0) 
-            {
-                jsonparse_next(&json_state);
-                jsonparse_next(&json_state);
-                code = jsonparse_get_value_as_int(&json_state);
-            }
-            else if(jsonparse_strcmp_value(&json_state, "message") == 0)
-            {
-                jsonparse_next(&json_state);
-                jsonparse_next(&json_state);
-                jsonparse_copy_value(&json_state, message, MSG_BUF_LEN);
-            }
-            else if(jsonparse_strcmp_value(&json_state, "data") == 0)
-            {
-                while((type = jsonparse_next(&json_state)) != 0 && json_state.depth > 1)
-                {
-                    if(type == JSON_TYPE_PAIR_NAME)
-                    {
-                        if(jsonparse_strcmp_value(&json_state, "access_token") == 0) 
-                        {
-                            jsonparse_next(&json_state);
-                            jsonparse_next(&json_state);
-                            jsonparse_copy_value(&json_state, access_token, ACCESS_TOKEN_LEN*2 + 16);
-                        }
-                        else if(jsonparse_strcmp_value(&json_state, "access_addr") == 0)
-                        {
-                            jsonparse_next(&json_state);
-                            jsonparse_next(&json_state);
-                            jsonparse_copy_value(&json_state, access_addr, KEY_BUF_LEN);
-                        }
-                    }
-                }
-            }
+            device_login_callback(PANDO_LOGIN_FAIL);
         }
+        return;
     }
 
-    if(login_response != NULL)
-    {
-    	pd_free(login_response);
-    }
-
-    if(code != 0)
+    if(result.code != 0)
     {
-    	pd_printf("device login failed: %s\n", message);
+    	pd_printf("device login failed: %s\n", result.message);
         if(device_login_callback != NULL) 
         {
             device_login_callback(PANDO_LOGIN_FAIL);
@@ -109,13 +88,13 @@ http_callback_login(char * response)
         return;
     }
 
-    hex2bin(pando_device_token, access_token);
+    hex2bin(pando_device_token, result.access_token);
 
 
-    pd_printf("device login success, access_addr : %s\n", access_addr);
+    pd_printf("device login success, access_addr : %s\n", result.access_addr);
 
-    pando_data_set(DATANAME_ACCESS_ADDR, access_addr);
-    pando_data_set(DATANAME_ACCESS_TOKEN, access_token);
+    pando_data_set(DATANAME_ACCESS_ADDR, result.access_addr);
+    pando_data_set(DATANAME_ACCESS_TOKEN, result.access_token);
     if(device_login_callback != NULL) 
     {
         device_login_callback(PANDO_LOGIN_OK);
@@ -162,8 +141,13 @@ pando_device_login(gateway_callback callback)
         JSONTREE_PAIR("device_secret", &json_device_secret),
         JSONTREE_PAIR("protocol", &json_protocol));
 
-    request = (char *)pd_malloc(MAX_BUF_LEN);
-    int ret = pando_json_print((struct jsontree_value*)(&device_info), request, MAX_BUF_LEN);
+    request = pando_json_print_new((struct jsontree_value*)(&device_info), MAX_BUF_LEN);
+    if(request == NULL)
+    {
+        pd_printf("%s:malloc failed.\n", __func__);
+        device_login_callback(PANDO_LOGIN_FAIL);
+        return;
+    }
     pd_printf("device login request:::\n%s\n(end)\n", request);
 
 	char post_url[128] = "";
@@ -1,3 +1,5 @@
+#define PANDO_MEM_MODULE PD_MEM_GATEWAY
+
 #include "pando_device_register.h"
 #include "../platform/include/pando_storage_interface.h"
 #include "../platform/include/pando_sys.h"
@@ -17,6 +19,27 @@
 extern char* g_product_key_buf;
 extern char* g_server_url;
 
+struct register_response
+{
+    int code;
+    char message[MSG_BUF_LEN];
+    long device_id;
+    char device_secret[KEY_BUF_LEN];
+    char device_key[KEY_BUF_LEN];
+};
+
+// bit of each entry in the pando_json_extract result.
+#define REGISTER_FIELD_CODE BIT(0)
+
+static const struct pando_json_field register_fields[] =
+{
+    PANDO_JSON_FIELD("code", PANDO_JSON_INT, struct register_response, code),
+    PANDO_JSON_FIELD("message", PANDO_JSON_STRING, struct register_response, message),
+    PANDO_JSON_FIELD("data.device_id", PANDO_JSON_LONG, struct register_response, device_id),
+    PANDO_JSON_FIELD("data.device_secret", PANDO_JSON_STRING, struct register_response, device_secret),
+    PANDO_JSON_FIELD("data.device_key", PANDO_JSON_STRING, struct register_response, device_key)
+};
+
 static gateway_callback device_register_callback = NULL;
 static char* request = NULL;
 
@@ -39,73 +62,27 @@ static void http_callback_register(char * response)
     }
 
     pd_printf("response=%s\n(end)\n", response);
-	uint16_t response_len = pd_strlen(response) + 1;
-    char* register_response = (char*)pd_malloc(response_len);
-	pd_memset(register_response, 0, response_len);
-	pd_memcpy(register_response, response, response_len);
-	
-    struct jsonparse_state json_state;
-    jsonparse_setup(&json_state, response, pd_strlen(response));
-    uint8_t code;
-    char message[MSG_BUF_LEN];
-    long device_id;
-    char device_secret[KEY_BUF_LEN];
-    char device_key[KEY_BUF_LEN];
 
-    int type;
-    while ((type = jsonparse_next(&json_state)) != 0)
+    struct register_response result;
+    int found;
+
+    pd_memset(&result, 0, sizeof(result));
+    result.code = -1;
+    found = pando_json_extract(response, pd_strlen(response), register_fields,
+        sizeof(register_fields) / sizeof(register_fields[0]), &result);
+    if(found < 0 || (found & REGISTER_FIELD_CODE) == 0)
     {
-        if (type == JSON_TYPE_PAIR_NAME) 
+        pd_printf("bad register response\n");
+        if(device_register_callback != NULL)
         {
-            if(jsonparse_strcmp_value(&json_state, "code") == 0) 
-            {
-                jsonparse_next(&json_state);
-                jsonparse_next(&json_state);
-                code = jsonparse_get_value_as_int(&json_state);
-            }
-            else if(jsonparse_strcmp_value(&json_state, "message") == 0)
-            {
-                jsonparse_next(&json_state);
-                jsonparse_next(&json_state);
-                jsonparse_copy_value(&json_state, message, MSG_BUF_LEN);
-            }
-            else if(jsonparse_strcmp_value(&json_state, "data") == 0)
-            {
-                while((type = jsonparse_next(&json_state)) != 0 && json_state.depth > 1)
-                {
-                    if(type == JSON_TYPE_PAIR_NAME)
-                    {
-                        if(jsonparse_strcmp_value(&json_state, "device_id") == 0) 
-                        {
-                            jsonparse_next(&json_state);
-                            jsonparse_next(&json_state);
-                            device_id = jsonparse_get_value_as_long(&json_state);
-                        }
-                        else if(jsonparse_strcmp_value(&json_state, "device_secret") == 0)
-                        {
-                            jsonparse_next(&json_state);
-                            jsonparse_next(&json_state);
-                            jsonparse_copy_value(&json_state, device_secret, KEY_BUF_LEN);
-                        }
-                        else if(jsonparse_strcmp_value(&json_state, "device_key") == 0)
-                        {
-                            jsonparse_next(&json_state);
-                            jsonparse_next(&json_state);
-                            jsonparse_copy_value(&json_state, device_key, KEY_BUF_LEN);
-                        }
-                    }
-                }
-            }
+            device_register_callback(PANDO_REGISTER_FAIL);
         }
+        return;
     }
-	if(register_response != NULL)
-	{
-		pd_free(register_response);
-	}
-	
-    if(code != 0)
+
+    if(result.code != 0)
     {
-        pd_printf("device register failed: %s\n", message);
+        pd_printf("device register failed: %s\n", result.message);
         if(device_register_callback != NULL) 
         {
 			device_register_callback(PANDO_REGISTER_FAIL);
@@ -114,13 +91,13 @@ static void http_callback_register(char * response)
     }
 
     pd_printf("device register success, id: %d, secret : %s, key : %s\n",
-        device_id, device_secret, device_key);
+        result.device_id, result.device_secret, result.device_key);
     char str_device_id[BIG_INT_BUF_LEN];
-    pd_sprintf(str_device_id, "%d", device_id);
+    pd_sprintf(str_device_id, "%d", result.device_id);
     pd_printf("saving device info to storage...\n");
     pando_data_set(DATANAME_DEVICE_ID, str_device_id);
-    pando_data_set(DATANAME_DEVICE_SECRET, device_secret);
-    pando_data_set(DATANAME_DEVICE_KEY, device_key);
+    pando_data_set(DATANAME_DEVICE_SECRET, result.device_secret);
+    pando_data_set(DATANAME_DEVICE_KEY, result.device_key);
     pd_printf("done...\n");
     if(device_register_callback != NULL) 
     {
@@ -162,8 +139,13 @@ void pando_device_register(gateway_callback callback)
         JSONTREE_PAIR("device_type", &json_device_type),
         JSONTREE_PAIR("device_module", &json_device_module),
         JSONTREE_PAIR("version", &json_version));
-    request = (char *)pd_malloc(MAX_BUF_LEN);
-    int ret = pando_json_print((struct jsontree_value*)(&device_info), request, MAX_BUF_LEN);
+    request = pando_json_print_new((struct jsontree_value*)(&device_info), MAX_BUF_LEN);
+    if(request == NULL)
+    {
+        pd_printf("%s:malloc failed.\n", __func__);
+        device_register_callback(PANDO_REGISTER_FAIL);
+        return;
+    }
     pd_printf("device register request:::\n%s\n(end)\n", request);
 
 	char post_url[128] = "";
@@ -0,0 +1,356 @@
+/*******************************************************
+ * File name: pando_route.c
+ * Author:
+ * Versions: 1.0
+ * Description: the routes are kept dense in an array, so a channel's routes
+ *              are found without walking empty entries. an open addressing
+ *              index, hashed from the id and probed linearly, finds the
+ *              route of an id in about one step. removing a route shifts
+ *              the index back instead of leaving a tombstone, and moves the
+ *              last route into the hole.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#define PANDO_MEM_MODULE PD_MEM_GATEWAY
+#define PANDO_LOG_MODULE_LEVEL PANDO_LOG_LEVEL_GATEWAY
+
+#include "pando_route.h"
+#include "../protocol/sub_device_protocol.h"
+#include "../platform/include/pando_sys.h"
+#include "../platform/include/pando_log.h"
+
+#define ROUTE_SLOTS (1 << PANDO_ROUTE_HASH_BITS)
+#define ROUTE_SLOT_MASK (ROUTE_SLOTS - 1)
+
+#if PANDO_ROUTE_MAX >= ROUTE_SLOTS || PANDO_ROUTE_MAX > 255
+#error "PANDO_ROUTE_MAX must be below the index slots and 256"
+#endif
+
+struct pando_route
+{
+    uint16_t sub_device_id;
+    uint8_t channel;
+    struct pando_route_stats stats;
+};
+
+struct route_buffer
+{
+    uint16_t refs;
+    uint16_t length;
+    uint8_t data[];
+};
+
+static struct pando_route s_routes[PANDO_ROUTE_MAX];
+static uint8_t s_route_count;
+
+// route index + 1, 0 is an empty slot.
+static uint8_t s_slots[ROUTE_SLOTS];
+
+// routes of each channel, and the id its frames get by default.
+static uint8_t s_channel_routes[PANDO_CHANNEL_COUNT];
+static uint16_t s_channel_id[PANDO_CHANNEL_COUNT];
+
+static uint32_t s_dropped;
+
+static uint8_t FUNCTION_ATTRIBUTE
+route_hash(uint16_t sub_device_id)
+{
+    // fibonacci hashing, the ids are mostly small and consecutive.
+    return (uint16_t)(sub_device_id * 40503u) >> (16 - PANDO_ROUTE_HASH_BITS);
+}
+
+// the slot of the id, or the empty slot it goes to. there is always an empty
+// slot, the index has more slots than routes.
+static uint8_t FUNCTION_ATTRIBUTE
+route_slot(uint16_t sub_device_id)
+{
+    uint8_t slot = route_hash(sub_device_id);
+
+    while(s_slots[slot] != 0 && s_routes[s_slots[slot] - 1].sub_device_id != sub_device_id)
+    {
+        slot = (slot + 1) & ROUTE_SLOT_MASK;
+    }
+
+    return slot;
+}
+
+static struct pando_route * FUNCTION_ATTRIBUTE
+route_find(uint16_t sub_device_id)
+{
+    uint8_t slot = route_slot(sub_device_id);
+
+    return s_slots[slot] == 0 ? NULL : &s_routes[s_slots[slot] - 1];
+}
+
+static void FUNCTION_ATTRIBUTE
+channel_attach(struct pando_route *route)
+{
+    if(s_channel_routes[route->channel]++ == 0)
+    {
+        s_channel_id[route->channel] = route->sub_device_id;
+    }
+}
+
+static void FUNCTION_ATTRIBUTE
+channel_detach(struct pando_route *route)
+{
+    uint8_t i = 0;
+
+    if(--s_channel_routes[route->channel] == 0
+        || s_channel_id[route->channel] != route->sub_device_id)
+    {
+        return;
+    }
+
+    // the default id went away, another route of the channel takes over.
+    for(i = 0; i < s_route_count; i++)
+    {
+        if(&s_routes[i] != route && s_routes[i].channel == route->channel)
+        {
+            s_channel_id[route->channel] = s_routes[i].sub_device_id;
+            break;
+        }
+    }
+}
+
+int8_t FUNCTION_ATTRIBUTE
+pando_route_add(uint16_t sub_device_id, PANDO_CHANNEL_NAME name)
+{
+    uint8_t slot = 0;
+    struct pando_route *route = NULL;
+
+    if(sub_device_id == PANDO_ROUTE_BROADCAST || (uint8_t)name >= PANDO_CHANNEL_COUNT)
+    {
+        PD_LOGE("invalid route %d to channel %d\n", sub_device_id, name);
+        return -1;
+    }
+
+    slot = route_slot(sub_device_id);
+    if(s_slots[slot] != 0)
+    {
+        route = &s_routes[s_slots[slot] - 1];
+        if(route->channel == name)
+        {
+            return 0;
+        }
+
+        channel_detach(route);
+    }
+    else
+    {
+        if(s_route_count == PANDO_ROUTE_MAX)
+        {
+            PD_LOGE("route table full, sub device %d\n", sub_device_id);
+            return -1;
+        }
+
+        route = &s_routes[s_route_count++];
+        route->sub_device_id = sub_device_id;
+        s_slots[slot] = s_route_count;
+    }
+
+    PD_LOGD("route sub device %d to channel %d\n", sub_device_id, name);
+    route->channel = name;
+    pd_memset(&route->stats, 0, sizeof(route->stats));
+    channel_attach(route);
+    return 0;
+}
+
+int8_t FUNCTION_ATTRIBUTE
+pando_route_remove(uint16_t sub_device_id)
+{
+    uint8_t hole = route_slot(sub_device_id);
+    uint8_t slot = hole;
+    uint8_t home = 0;
+    uint8_t index = 0;
+    uint8_t last = 0;
+
+    if(s_slots[hole] == 0)
+    {
+        return -1;
+    }
+
+    index = s_slots[hole] - 1;
+    channel_detach(&s_routes[index]);
+
+    // shift back the entries of the probe run that could not sit in the hole.
+    for(;;)
+    {
+        slot = (slot + 1) & ROUTE_SLOT_MASK;
+        if(s_slots[slot] == 0)
+        {
+            break;
+        }
+
+        // an entry may fill the hole if its home slot is not in (hole, slot].
+        home = route_hash(s_routes[s_slots[slot] - 1].sub_device_id);
+        if(((slot - home) & ROUTE_SLOT_MASK) >= ((slot - hole) & ROUTE_SLOT_MASK))
+        {
+            s_slots[hole] = s_slots[slot];
+            hole = slot;
+        }
+    }
+
+    s_slots[hole] = 0;
+
+    // keep the routes dense, the last one moves into the freed entry.
+    last = --s_route_count;
+    if(index != last)
+    {
+        s_routes[index] = s_routes[last];
+        s_slots[route_slot(s_routes[index].sub_device_id)] = index + 1;
+    }
+
+    PD_LOGD("route of sub device %d removed\n", sub_device_id);
+    return 0;
+}
+
+int8_t FUNCTION_ATTRIBUTE
+pando_route_lookup(uint16_t sub_device_id, PANDO_CHANNEL_NAME *name)
+{
+    struct pando_route *route = route_find(sub_device_id);
+
+    if(route == NULL)
+    {
+        return -1;
+    }
+
+    *name = (PANDO_CHANNEL_NAME)route->channel;
+    return 0;
+}
+
+int8_t FUNCTION_ATTRIBUTE
+pando_route_get_stats(uint16_t sub_device_id, struct pando_route_stats *stats)
+{
+    struct pando_route *route = route_find(sub_device_id);
+
+    if(route == NULL)
+    {
+        return -1;
+    }
+
+    pd_memcpy(stats, &route->stats, sizeof(*stats));
+    return 0;
+}
+
+uint32_t FUNCTION_ATTRIBUTE
+pando_route_dropped(void)
+{
+    return s_dropped;
+}
+
+uint8_t * FUNCTION_ATTRIBUTE
+pando_route_buffer_new(uint16_t length)
+{
+    struct route_buffer *buf = (struct route_buffer *)pd_malloc(sizeof(struct route_buffer) + length);
+
+    if(buf == NULL)
+    {
+        return NULL;
+    }
+
+    buf->refs = 1;
+    buf->length = length;
+    return buf->data;
+}
+
+void FUNCTION_ATTRIBUTE
+pando_route_buffer_hold(uint8_t *buffer)
+{
+    ((struct route_buffer *)(buffer - sizeof(struct route_buffer)))->refs++;
+}
+
+void FUNCTION_ATTRIBUTE
+pando_route_buffer_release(uint8_t *buffer)
+{
+    struct route_buffer *buf = (struct route_buffer *)(buffer - sizeof(struct route_buffer));
+
+    if(--buf->refs == 0)
+    {
+        pd_free(buf);
+    }
+}
+
+int8_t FUNCTION_ATTRIBUTE
+pando_route_to_subdevice(uint16_t sub_device_id, uint8_t *buffer, uint16_t length)
+{
+    uint8_t i = 0;
+    uint8_t priority = get_sub_device_priority_level(buffer, length);
+    struct pando_route *route = NULL;
+
+    if(sub_device_id == PANDO_ROUTE_BROADCAST)
+    {
+        PD_LOGD("broadcast to %d sub devices\n", s_route_count);
+        for(i = 0; i < PANDO_CHANNEL_COUNT; i++)
+        {
+            if(s_channel_routes[i] != 0)
+            {
+                pando_route_buffer_hold(buffer);
+                channel_post_to_subdevice((PANDO_CHANNEL_NAME)i, buffer, length, priority,
+                    pando_route_buffer_release);
+            }
+        }
+
+        for(i = 0; i < s_route_count; i++)
+        {
+            s_routes[i].stats.down_frames++;
+            s_routes[i].stats.down_bytes += length;
+        }
+
+        pando_route_buffer_release(buffer);
+        return 0;
+    }
+
+    route = route_find(sub_device_id);
+    if(route == NULL)
+    {
+        PD_LOGW("no route to sub device %d\n", sub_device_id);
+        s_dropped++;
+        pando_route_buffer_release(buffer);
+        return -1;
+    }
+
+    PD_LOGD("transfer data to sub device: %d\n", sub_device_id);
+    route->stats.down_frames++;
+    route->stats.down_bytes += length;
+    channel_post_to_subdevice((PANDO_CHANNEL_NAME)route->channel, buffer, length, priority,
+        pando_route_buffer_release);
+    return 0;
+}
+
+int8_t FUNCTION_ATTRIBUTE
+pando_route_from_subdevice(PANDO_CHANNEL_NAME name, uint8_t *buffer, uint16_t length,
+    uint16_t *sub_device_id)
+{
+    uint16_t id = 0;
+    struct pando_route *route = NULL;
+
+    if((uint8_t)name >= PANDO_CHANNEL_COUNT || s_channel_routes[name] == 0)
+    {
+        PD_LOGW("no route from channel %d\n", name);
+        s_dropped++;
+        return -1;
+    }
+
+    // every payload starts with the sub device id, 0 if the sub device does
+    // not set it.
+    if(s_channel_routes[name] > 1 && length >= DEV_HEADER_LEN + sizeof(id))
+    {
+        pd_memcpy(&id, buffer + DEV_HEADER_LEN, sizeof(id));
+        id = net16_to_host(id);
+        route = id == 0 ? NULL : route_find(id);
+    }
+
+    if(route == NULL || route->channel != name)
+    {
+        route = route_find(s_channel_id[name]);
+    }
+
+    route->stats.up_frames++;
+    route->stats.up_bytes += length;
+    *sub_device_id = route->sub_device_id;
+    return 0;
+}
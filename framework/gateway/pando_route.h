@@ -0,0 +1,145 @@
+/*******************************************************
+ * File name: pando_route.h
+ * Author:
+ * Versions: 1.0
+ * Description: the routes between the cloud and the sub devices behind the
+ *              gateway. a route maps a 16 bit sub device id to the channel
+ *              the sub device is attached to, several sub devices may share a
+ *              channel. routes can be added and removed at any time, when a
+ *              sub device is plugged in or out.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#ifndef __PANDO_ROUTE_H__
+#define __PANDO_ROUTE_H__
+
+#include "../platform/include/pando_types.h"
+#include "pando_channel.h"
+
+// sub devices one gateway serves, each route takes about 20 bytes.
+#ifndef PANDO_ROUTE_MAX
+#define PANDO_ROUTE_MAX 64
+#endif
+
+// the id index has 1 << PANDO_ROUTE_HASH_BITS slots, one byte each, twice
+// the routes or more keeps the lookups short.
+#ifndef PANDO_ROUTE_HASH_BITS
+#define PANDO_ROUTE_HASH_BITS 7
+#endif
+
+// frames to this id go to every channel with a route.
+#define PANDO_ROUTE_BROADCAST 0xffff
+
+struct pando_route_stats
+{
+    uint32_t down_frames;   // from the cloud to the sub device
+    uint32_t down_bytes;
+    uint32_t up_frames;     // from the sub device to the cloud
+    uint32_t up_bytes;
+};
+
+/******************************************************************************
+ * FunctionName : pando_route_add
+ * Description  : route a sub device id to a channel. an id that has a route
+ *                already moves to the channel, its statistics restart.
+ * Parameters   : sub_device_id: the id, not PANDO_ROUTE_BROADCAST.
+ *                name: the channel the sub device is attached to.
+ * Returns      : 0 if ok, -1 if the id is invalid or the table is full.
+*******************************************************************************/
+int8_t pando_route_add(uint16_t sub_device_id, PANDO_CHANNEL_NAME name);
+
+/******************************************************************************
+ * FunctionName : pando_route_remove
+ * Description  : remove the route of a sub device id.
+ * Parameters   : sub_device_id: the id.
+ * Returns      : 0 if ok, -1 if the id has no route.
+*******************************************************************************/
+int8_t pando_route_remove(uint16_t sub_device_id);
+
+/******************************************************************************
+ * FunctionName : pando_route_lookup
+ * Description  : the channel of a sub device id.
+ * Parameters   : sub_device_id: the id.
+ *                name: set to the channel.
+ * Returns      : 0 if ok, -1 if the id has no route.
+*******************************************************************************/
+int8_t pando_route_lookup(uint16_t sub_device_id, PANDO_CHANNEL_NAME *name);
+
+/******************************************************************************
+ * FunctionName : pando_route_get_stats
+ * Description  : the statistics of a route.
+ * Parameters   : sub_device_id: the id.
+ *                stats: filled with the counters.
+ * Returns      : 0 if ok, -1 if the id has no route.
+*******************************************************************************/
+int8_t pando_route_get_stats(uint16_t sub_device_id, struct pando_route_stats *stats);
+
+/******************************************************************************
+ * FunctionName : pando_route_dropped
+ * Description  : the frames dropped because their id or channel has no route.
+ * Parameters   : none.
+ * Returns      : the count since boot.
+*******************************************************************************/
+uint32_t pando_route_dropped(void);
+
+/******************************************************************************
+ * FunctionName : pando_route_buffer_new
+ * Description  : allocate a buffer for pando_route_to_subdevice. the buffer is
+ *                reference counted, it is freed with its last reference and
+ *                is created holding one.
+ * Parameters   : length: byte count.
+ * Returns      : the buffer, NULL if out of memory.
+*******************************************************************************/
+uint8_t *pando_route_buffer_new(uint16_t length);
+
+/******************************************************************************
+ * FunctionName : pando_route_buffer_hold
+ * Description  : take a reference, a channel callback holds the buffer it is
+ *                given this way to keep it after returning. channels with a
+ *                queue hold it until it is delivered.
+ * Parameters   : buffer: from pando_route_buffer_new.
+ * Returns      : none.
+*******************************************************************************/
+void pando_route_buffer_hold(uint8_t *buffer);
+
+/******************************************************************************
+ * FunctionName : pando_route_buffer_release
+ * Description  : drop a reference.
+ * Parameters   : buffer: from pando_route_buffer_new.
+ * Returns      : none.
+*******************************************************************************/
+void pando_route_buffer_release(uint8_t *buffer);
+
+/******************************************************************************
+ * FunctionName : pando_route_to_subdevice
+ * Description  : send a frame from the cloud to the channel of its sub device.
+ *                a broadcast frame is handed to every channel with a route,
+ *                all of them get the same buffer. channel queues order the
+ *                frame by the priority level of its command or event.
+ * Parameters   : sub_device_id: the id, or PANDO_ROUTE_BROADCAST.
+ *                buffer: from pando_route_buffer_new, the caller's reference
+ *                        goes with it.
+ *                length: byte count.
+ * Returns      : 0 if sent, -1 if the id has no route.
+*******************************************************************************/
+int8_t pando_route_to_subdevice(uint16_t sub_device_id, uint8_t *buffer, uint16_t length);
+
+/******************************************************************************
+ * FunctionName : pando_route_from_subdevice
+ * Description  : the sub device id of a frame received on a channel. it is
+ *                the id in the frame's payload if that one is routed to the
+ *                channel, sub devices sharing a channel tell themselves apart
+ *                this way. else it is the id routed to the channel first.
+ * Parameters   : name: the channel.
+ *                buffer: the frame, with its device header.
+ *                length: byte count.
+ *                sub_device_id: set to the id.
+ * Returns      : 0 if ok, -1 if the channel has no route.
+*******************************************************************************/
+int8_t pando_route_from_subdevice(PANDO_CHANNEL_NAME name, uint8_t *buffer, uint16_t length,
+    uint16_t *sub_device_id);
+
+#endif
@@ -0,0 +1,225 @@
+/*******************************************************
+ * File name: pando_serial.c
+ * Author:
+ * Versions: 1.0
+ * Description: frames are encoded straight into the transmit buffer the
+ *              next transfer takes, there is no copy of the packet. the two
+ *              buffers swap when a transfer starts. received bytes are
+ *              decoded as they come into the frame buffer, and checked once
+ *              the delimiter arrives.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#define PANDO_MEM_MODULE PD_MEM_GATEWAY
+#define PANDO_LOG_MODULE_LEVEL PANDO_LOG_LEVEL_GATEWAY
+
+#include "pando_serial.h"
+#include "../platform/include/pando_sys.h"
+#include "../platform/include/pando_log.h"
+
+#define SERIAL_FRAME_MAX (PANDO_SERIAL_PACKET_MAX + PANDO_SERIAL_CRC_LEN)
+
+#if PANDO_COBS_MAX(SERIAL_FRAME_MAX) > PANDO_SERIAL_TX_SIZE
+#error "PANDO_SERIAL_TX_SIZE must take a frame of PANDO_SERIAL_PACKET_MAX"
+#endif
+
+struct serial_port
+{
+    pando_serial_write write;   // NULL if the port is free
+    PANDO_CHANNEL_NAME name;
+    uint8_t tx[2][PANDO_SERIAL_TX_SIZE];
+    uint16_t tx_fill;           // bytes in the buffer the frames go to
+    uint8_t tx_next;            // that buffer
+    uint8_t tx_busy;            // the other one is in transfer
+    uint8_t rx[SERIAL_FRAME_MAX];
+    struct pando_cobs_decoder decoder;
+    uint32_t rx_bad_crc;
+    struct pando_serial_stats stats;
+};
+
+static struct serial_port s_ports[PANDO_SERIAL_PORT_MAX];
+
+static struct serial_port * FUNCTION_ATTRIBUTE
+serial_find(PANDO_CHANNEL_NAME name)
+{
+    uint8_t i = 0;
+
+    for(i = 0; i < PANDO_SERIAL_PORT_MAX; i++)
+    {
+        if(s_ports[i].write != NULL && s_ports[i].name == name)
+        {
+            return &s_ports[i];
+        }
+    }
+
+    return NULL;
+}
+
+// write the frames queued, unless a transfer is in flight.
+static void FUNCTION_ATTRIBUTE
+serial_flush(struct serial_port *port)
+{
+    uint8_t *burst = NULL;
+    uint16_t length = 0;
+
+    if(port->tx_busy || port->tx_fill == 0)
+    {
+        return;
+    }
+
+    burst = port->tx[port->tx_next];
+    length = port->tx_fill;
+    port->tx_next ^= 1;
+    port->tx_fill = 0;
+    port->tx_busy = 1;
+    port->stats.tx_bursts++;
+    port->stats.tx_bytes += length;
+    if(port->write(burst, length) == PANDO_SERIAL_WRITE_DONE)
+    {
+        port->tx_busy = 0;
+    }
+}
+
+static void FUNCTION_ATTRIBUTE
+serial_send(PANDO_CHANNEL_NAME name, uint8_t *buffer, uint16_t length)
+{
+    struct serial_port *port = serial_find(name);
+    struct pando_cobs_encoder encoder;
+    uint16_t crc = 0;
+    uint8_t crc_bytes[PANDO_SERIAL_CRC_LEN];
+
+    if(port == NULL)
+    {
+        return;
+    }
+
+    if(length > PANDO_SERIAL_PACKET_MAX
+        || port->tx_fill + PANDO_COBS_MAX(length + PANDO_SERIAL_CRC_LEN) > PANDO_SERIAL_TX_SIZE)
+    {
+        PD_LOGW("serial channel %d drops a packet of %d bytes\n", name, length);
+        port->stats.tx_dropped++;
+        return;
+    }
+
+    crc = pando_crc16(0xffff, buffer, length);
+    crc_bytes[0] = crc >> 8;
+    crc_bytes[1] = crc & 0xff;
+
+    pando_cobs_encode_begin(&encoder, port->tx[port->tx_next] + port->tx_fill);
+    pando_cobs_encode_put(&encoder, buffer, length);
+    pando_cobs_encode_put(&encoder, crc_bytes, sizeof(crc_bytes));
+    port->tx_fill += pando_cobs_encode_end(&encoder);
+    port->stats.tx_frames++;
+
+    serial_flush(port);
+}
+
+int8_t FUNCTION_ATTRIBUTE
+pando_serial_attach(PANDO_CHANNEL_NAME name, pando_serial_write write)
+{
+    struct serial_port *port = NULL;
+    uint8_t i = 0;
+
+    if(write == NULL || serial_find(name) != NULL)
+    {
+        return -1;
+    }
+
+    for(i = 0; i < PANDO_SERIAL_PORT_MAX && port == NULL; i++)
+    {
+        if(s_ports[i].write == NULL)
+        {
+            port = &s_ports[i];
+        }
+    }
+
+    if(port == NULL)
+    {
+        PD_LOGE("no serial port left for channel %d\n", name);
+        return -1;
+    }
+
+    pd_memset(port, 0, sizeof(*port));
+    port->write = write;
+    port->name = name;
+    pando_cobs_decoder_init(&port->decoder, port->rx, sizeof(port->rx));
+    on_subdevice_channel_name_recv(name, serial_send);
+    return 0;
+}
+
+void FUNCTION_ATTRIBUTE
+pando_serial_detach(PANDO_CHANNEL_NAME name)
+{
+    struct serial_port *port = serial_find(name);
+
+    if(port != NULL)
+    {
+        on_subdevice_channel_name_recv(name, NULL);
+        port->write = NULL;
+    }
+}
+
+void FUNCTION_ATTRIBUTE
+pando_serial_input(PANDO_CHANNEL_NAME name, const uint8_t *data, uint16_t length)
+{
+    struct serial_port *port = serial_find(name);
+    uint16_t used = 0;
+    uint16_t frame_length = 0;
+
+    if(port == NULL)
+    {
+        return;
+    }
+
+    port->stats.rx_bytes += length;
+    while(length > 0)
+    {
+        used = pando_cobs_decode(&port->decoder, data, length, &frame_length);
+        data += used;
+        length -= used;
+        if(frame_length == 0)
+        {
+            continue;
+        }
+
+        // the crc over the packet and its crc is 0.
+        if(frame_length <= PANDO_SERIAL_CRC_LEN || pando_crc16(0xffff, port->rx, frame_length) != 0)
+        {
+            port->rx_bad_crc++;
+            continue;
+        }
+
+        port->stats.rx_frames++;
+        channel_send_to_device(name, port->rx, frame_length - PANDO_SERIAL_CRC_LEN);
+    }
+}
+
+void FUNCTION_ATTRIBUTE
+pando_serial_tx_done(PANDO_CHANNEL_NAME name)
+{
+    struct serial_port *port = serial_find(name);
+
+    if(port != NULL)
+    {
+        port->tx_busy = 0;
+        serial_flush(port);
+    }
+}
+
+int8_t FUNCTION_ATTRIBUTE
+pando_serial_get_stats(PANDO_CHANNEL_NAME name, struct pando_serial_stats *stats)
+{
+    struct serial_port *port = serial_find(name);
+
+    if(port == NULL)
+    {
+        return -1;
+    }
+
+    pd_memcpy(stats, &port->stats, sizeof(*stats));
+    stats->rx_errors = port->decoder.errors + port->rx_bad_crc;
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*******************************************************
+ * File name: pando_serial.h
+ * Author:
+ * Versions: 1.0
+ * Description: a serial link under a channel, for sub devices on their own
+ *              mcu. the packets of the channel travel in cobs frames closed
+ *              by a crc-16, see pando_cobs.h. the frames to the sub device
+ *              queue up while the uart is busy and go out together in the
+ *              next transfer, so a dma uart sends them in one burst.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#ifndef __PANDO_SERIAL_H__
+#define __PANDO_SERIAL_H__
+
+#include "../platform/include/pando_types.h"
+#include "../lib/pando_cobs.h"
+#include "pando_channel.h"
+
+// channels with a serial link.
+#ifndef PANDO_SERIAL_PORT_MAX
+#define PANDO_SERIAL_PORT_MAX 1
+#endif
+
+// longest packet, with its device header.
+#ifndef PANDO_SERIAL_PACKET_MAX
+#define PANDO_SERIAL_PACKET_MAX 254
+#endif
+
+// each port has two transmit buffers of this size, one in transfer and one
+// the next frames go to. a buffer takes one frame of the longest packet.
+#ifndef PANDO_SERIAL_TX_SIZE
+#define PANDO_SERIAL_TX_SIZE 512
+#endif
+
+// the frame check after the packet.
+#define PANDO_SERIAL_CRC_LEN 2
+
+// results of pando_serial_write.
+#define PANDO_SERIAL_WRITE_DONE     0   // the bytes went out in the call
+#define PANDO_SERIAL_WRITE_PENDING  1   // a transfer was started
+
+/*
+ * "pando_serial_write" writes a burst of frames to the uart. a pending transfer keeps the data
+ * until it ends with pando_serial_tx_done.
+ */
+typedef uint8_t (* pando_serial_write)(const uint8_t *data, uint16_t length);
+
+struct pando_serial_stats
+{
+    uint32_t tx_frames;
+    uint32_t tx_bursts;         // writes, one or more frames each
+    uint32_t tx_bytes;          // encoded
+    uint32_t tx_dropped;        // too long, or no room while the uart was busy
+    uint32_t rx_frames;
+    uint32_t rx_bytes;          // encoded, delimiters included
+    uint32_t rx_errors;         // malformed, too long or a bad crc
+};
+
+/******************************************************************************
+ * FunctionName : pando_serial_attach
+ * Description  : carry a channel over a serial link. packets sent to the sub
+ *                devices of the channel are framed and written to the uart,
+ *                frames read from it go to the device side of the channel.
+ * Parameters   : name: the channel.
+ *                write: writes to the uart.
+ * Returns      : 0 if ok, -1 if the channel has a link or no port is left.
+*******************************************************************************/
+int8_t pando_serial_attach(PANDO_CHANNEL_NAME name, pando_serial_write write);
+
+/******************************************************************************
+ * FunctionName : pando_serial_detach
+ * Description  : take the serial link off a channel, frames not yet written
+ *                are dropped. no transfer may be in flight.
+ * Parameters   : name: the channel.
+ * Returns      : none.
+*******************************************************************************/
+void pando_serial_detach(PANDO_CHANNEL_NAME name);
+
+/******************************************************************************
+ * FunctionName : pando_serial_input
+ * Description  : bytes read from the uart, any number of frames and parts of
+ *                frames. each complete frame with a good crc is handed to the
+ *                channel in the call, so call it from the main loop and not
+ *                from the uart interrupt.
+ * Parameters   : name: the channel.
+ *                data: the bytes.
+ *                length: byte count.
+ * Returns      : none.
+*******************************************************************************/
+void pando_serial_input(PANDO_CHANNEL_NAME name, const uint8_t *data, uint16_t length);
+
+/******************************************************************************
+ * FunctionName : pando_serial_tx_done
+ * Description  : a pending transfer ended, the frames queued meanwhile are
+ *                written next.
+ * Parameters   : name: the channel.
+ * Returns      : none.
+*******************************************************************************/
+void pando_serial_tx_done(PANDO_CHANNEL_NAME name);
+
+/******************************************************************************
+ * FunctionName : pando_serial_get_stats
+ * Description  : the counters of a channel's serial link.
+ * Parameters   : name: the channel.
+ *                stats: filled with the counters.
+ * Returns      : 0 if ok, -1 if the channel has no link.
+*******************************************************************************/
+int8_t pando_serial_get_stats(PANDO_CHANNEL_NAME name, struct pando_serial_stats *stats);
+
+#endif
@@ -0,0 +1,334 @@
+/*******************************************************
+ * File name: pando_topic.c
+ * Author:
+ * Versions: 1.0
+ * Description: the filters are kept in a trie of their levels, in a fixed
+ *              pool of nodes. a message walks the trie once, a level of its
+ *              topic is only compared with the nodes the levels before it
+ *              led to.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#define PANDO_MEM_MODULE PD_MEM_GATEWAY
+#define PANDO_LOG_MODULE_LEVEL PANDO_LOG_LEVEL_GATEWAY
+
+#include "pando_topic.h"
+#include "../platform/include/pando_sys.h"
+#include "../platform/include/pando_log.h"
+
+#if PANDO_TOPIC_NODE_MAX > 254 || PANDO_TOPIC_LEVEL_LEN > 255
+#error "PANDO_TOPIC_NODE_MAX and PANDO_TOPIC_LEVEL_LEN must be below 255 and 256"
+#endif
+
+#define TOPIC_NONE 0xff
+#define TOPIC_ROOT 0
+
+struct topic_node
+{
+    char level[PANDO_TOPIC_LEVEL_LEN];  // not terminated
+    uint8_t length;
+    uint8_t child;              // first child
+    uint8_t next;               // next sibling, or next free node
+    pando_topic_handler handler;
+};
+
+struct topic_message
+{
+    const char *topic;
+    uint16_t topic_length;
+    const uint8_t *payload;
+    uint16_t payload_length;
+};
+
+// the root, then the pool.
+static struct topic_node s_nodes[PANDO_TOPIC_NODE_MAX + 1];
+static uint8_t s_free = TOPIC_NONE;
+static uint8_t s_init;
+
+static void FUNCTION_ATTRIBUTE
+topic_init(void)
+{
+    uint8_t i = 0;
+
+    if(s_init)
+    {
+        return;
+    }
+
+    s_nodes[TOPIC_ROOT].child = TOPIC_NONE;
+    s_nodes[TOPIC_ROOT].next = TOPIC_NONE;
+    for(i = PANDO_TOPIC_NODE_MAX; i > TOPIC_ROOT; i--)
+    {
+        s_nodes[i].next = s_free;
+        s_free = i;
+    }
+
+    s_init = 1;
+}
+
+static const char * FUNCTION_ATTRIBUTE
+topic_level_end(const char *level, const char *end)
+{
+    while(level < end && *level != '/')
+    {
+        level++;
+    }
+
+    return level;
+}
+
+static uint8_t FUNCTION_ATTRIBUTE
+topic_is_wildcard(const struct topic_node *node, char wildcard)
+{
+    return node->length == 1 && node->level[0] == wildcard;
+}
+
+// levels of a filter, 0 if it is invalid.
+static uint8_t FUNCTION_ATTRIBUTE
+topic_filter_levels(const char *filter, const char *end)
+{
+    uint8_t levels = 0;
+    const char *next = NULL;
+    const char *c = NULL;
+
+    for(;;)
+    {
+        next = topic_level_end(filter, end);
+        for(c = filter; c < next; c++)
+        {
+            // a wildcard takes a whole level, '#' the last one.
+            if((*c == '+' || *c == '#') && next - filter != 1)
+            {
+                return 0;
+            }
+        }
+
+        if((*filter == '#' && next != end) || next - filter > PANDO_TOPIC_LEVEL_LEN
+            || ++levels > PANDO_TOPIC_LEVEL_MAX)
+        {
+            return 0;
+        }
+
+        if(next == end)
+        {
+            return levels;
+        }
+
+        filter = next + 1;
+    }
+}
+
+static uint8_t FUNCTION_ATTRIBUTE
+topic_find_child(uint8_t parent, const char *level, uint8_t length)
+{
+    uint8_t i = s_nodes[parent].child;
+
+    while(i != TOPIC_NONE
+        && (s_nodes[i].length != length || pd_memcmp(s_nodes[i].level, level, length) != 0))
+    {
+        i = s_nodes[i].next;
+    }
+
+    return i;
+}
+
+// the nodes of a filter from its first level, path[levels - 1] is the last.
+// when create is set missing nodes are added, else the path ends at the first
+// one missing. returns the nodes in path.
+static uint8_t FUNCTION_ATTRIBUTE
+topic_walk(const char *filter, uint8_t *path, uint8_t create)
+{
+    const char *end = filter + pd_strlen(filter);
+    const char *next = NULL;
+    uint8_t parent = TOPIC_ROOT;
+    uint8_t depth = 0;
+    uint8_t node = 0;
+
+    for(;;)
+    {
+        next = topic_level_end(filter, end);
+        node = topic_find_child(parent, filter, next - filter);
+        if(node == TOPIC_NONE)
+        {
+            if(!create || s_free == TOPIC_NONE)
+            {
+                return depth;
+            }
+
+            node = s_free;
+            s_free = s_nodes[node].next;
+            pd_memcpy(s_nodes[node].level, filter, next - filter);
+            s_nodes[node].length = next - filter;
+            s_nodes[node].child = TOPIC_NONE;
+            s_nodes[node].handler = NULL;
+            s_nodes[node].next = s_nodes[parent].child;
+            s_nodes[parent].child = node;
+        }
+
+        path[depth++] = node;
+        if(next == end)
+        {
+            return depth;
+        }
+
+        parent = node;
+        filter = next + 1;
+    }
+}
+
+// free the nodes at the end of the path that lead to no handler.
+static void FUNCTION_ATTRIBUTE
+topic_prune(const uint8_t *path, uint8_t depth)
+{
+    uint8_t node = 0;
+    uint8_t *link = NULL;
+
+    while(depth > 0)
+    {
+        node = path[--depth];
+        if(s_nodes[node].handler != NULL || s_nodes[node].child != TOPIC_NONE)
+        {
+            return;
+        }
+
+        link = &s_nodes[depth == 0 ? TOPIC_ROOT : path[depth - 1]].child;
+        while(*link != node)
+        {
+            link = &s_nodes[*link].next;
+        }
+
+        *link = s_nodes[node].next;
+        s_nodes[node].next = s_free;
+        s_free = node;
+    }
+}
+
+int8_t FUNCTION_ATTRIBUTE
+pando_topic_register(const char *filter, pando_topic_handler handler)
+{
+    uint8_t path[PANDO_TOPIC_LEVEL_MAX];
+    uint8_t levels = topic_filter_levels(filter, filter + pd_strlen(filter));
+    uint8_t depth = 0;
+
+    topic_init();
+    if(levels == 0 || handler == NULL)
+    {
+        PD_LOGE("invalid topic filter %s\n", filter);
+        return -1;
+    }
+
+    depth = topic_walk(filter, path, 1);
+    if(depth < levels)
+    {
+        PD_LOGE("no topic node left for %s\n", filter);
+        topic_prune(path, depth);
+        return -1;
+    }
+
+    s_nodes[path[depth - 1]].handler = handler;
+    PD_LOGD("topic filter %s registered\n", filter);
+    return 0;
+}
+
+int8_t FUNCTION_ATTRIBUTE
+pando_topic_unregister(const char *filter)
+{
+    uint8_t path[PANDO_TOPIC_LEVEL_MAX];
+    uint8_t levels = topic_filter_levels(filter, filter + pd_strlen(filter));
+    uint8_t depth = 0;
+
+    topic_init();
+    if(levels == 0)
+    {
+        return -1;
+    }
+
+    depth = topic_walk(filter, path, 0);
+    if(depth < levels || s_nodes[path[depth - 1]].handler == NULL)
+    {
+        return -1;
+    }
+
+    s_nodes[path[depth - 1]].handler = NULL;
+    topic_prune(path, depth);
+    return 0;
+}
+
+static uint8_t FUNCTION_ATTRIBUTE
+topic_call(const struct topic_node *node, const struct topic_message *message)
+{
+    if(node->handler == NULL)
+    {
+        return 0;
+    }
+
+    node->handler(message->topic, message->topic_length, message->payload, message->payload_length);
+    return 1;
+}
+
+// match the topic from level on against the children of parent, level is
+// NULL once the topic has no level left.
+static uint8_t FUNCTION_ATTRIBUTE
+topic_match(uint8_t parent, const char *level, const struct topic_message *message)
+{
+    const char *end = message->topic + message->topic_length;
+    const char *next = level == NULL ? NULL : topic_level_end(level, end);
+    const struct topic_node *node = NULL;
+    uint8_t called = 0;
+    uint8_t i = 0;
+
+    for(i = s_nodes[parent].child; i != TOPIC_NONE; i = s_nodes[i].next)
+    {
+        node = &s_nodes[i];
+        if(topic_is_wildcard(node, '#'))
+        {
+            called += topic_call(node, message);
+            continue;
+        }
+
+        if(level == NULL
+            || (!topic_is_wildcard(node, '+')
+                && (node->length != next - level || pd_memcmp(node->level, level, node->length) != 0)))
+        {
+            continue;
+        }
+
+        if(next == end)
+        {
+            // a '#' child of the last level matches no level.
+            called += topic_call(node, message);
+            called += topic_match(i, NULL, message);
+        }
+        else
+        {
+            called += topic_match(i, next + 1, message);
+        }
+    }
+
+    return called;
+}
+
+uint8_t FUNCTION_ATTRIBUTE
+pando_topic_dispatch(const char *topic, uint16_t topic_length,
+    const uint8_t *payload, uint16_t payload_length)
+{
+    struct topic_message message;
+    uint8_t called = 0;
+
+    topic_init();
+    message.topic = topic;
+    message.topic_length = topic_length;
+    message.payload = payload;
+    message.payload_length = payload_length;
+
+    called = topic_match(TOPIC_ROOT, topic, &message);
+    if(called == 0)
+    {
+        PD_LOGW("no handler for topic of length %d\n", topic_length);
+    }
+
+    return called;
+}
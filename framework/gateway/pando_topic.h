@@ -0,0 +1,70 @@
+/*******************************************************
+ * File name: pando_topic.h
+ * Author:
+ * Versions: 1.0
+ * Description: dispatch of the messages the broker sends to the gateway by
+ *              their topic. handlers are registered for a topic filter, the
+ *              mqtt kind: levels split by '/', a '+' level matches any one
+ *              level and a '#' last level matches the levels left, none
+ *              included. the topic of a message is matched where it lies,
+ *              nothing is copied.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#ifndef __PANDO_TOPIC_H__
+#define __PANDO_TOPIC_H__
+
+#include "../platform/include/pando_types.h"
+
+// trie nodes, a filter takes a node for each level it does not share with
+// the filters registered before it. a node keeps a copy of its level.
+#ifndef PANDO_TOPIC_NODE_MAX
+#define PANDO_TOPIC_NODE_MAX 16
+#endif
+
+// levels of a filter, and the longest level.
+#define PANDO_TOPIC_LEVEL_MAX 8
+#ifndef PANDO_TOPIC_LEVEL_LEN
+#define PANDO_TOPIC_LEVEL_LEN 16
+#endif
+
+// topic is the message's, it is not terminated.
+typedef void (*pando_topic_handler)(const char *topic, uint16_t topic_length,
+    const uint8_t *payload, uint16_t payload_length);
+
+/******************************************************************************
+ * FunctionName : pando_topic_register
+ * Description  : call handler for the messages matching a topic filter. the
+ *                handler of a filter registered already is replaced.
+ * Parameters   : filter: the terminated filter, at most PANDO_TOPIC_LEVEL_MAX
+ *                        levels of PANDO_TOPIC_LEVEL_LEN bytes.
+ *                handler: the handler.
+ * Returns      : 0 if ok, -1 if the filter is invalid or the trie is full.
+*******************************************************************************/
+int8_t pando_topic_register(const char *filter, pando_topic_handler handler);
+
+/******************************************************************************
+ * FunctionName : pando_topic_unregister
+ * Description  : remove the handler of a topic filter.
+ * Parameters   : filter: the filter as registered.
+ * Returns      : 0 if ok, -1 if the filter has no handler.
+*******************************************************************************/
+int8_t pando_topic_unregister(const char *filter);
+
+/******************************************************************************
+ * FunctionName : pando_topic_dispatch
+ * Description  : call the handlers of every filter matching the topic. the
+ *                handlers must not register or unregister filters.
+ * Parameters   : topic: the topic, need not be terminated.
+ *                topic_length: byte count.
+ *                payload: passed to the handlers as it is.
+ *                payload_length: byte count.
+ * Returns      : the handlers called.
+*******************************************************************************/
+uint8_t pando_topic_dispatch(const char *topic, uint16_t topic_length,
+    const uint8_t *payload, uint16_t payload_length);
+
+#endif
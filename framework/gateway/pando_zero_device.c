@@ -8,16 +8,90 @@
  *     Author:
  *     Modification:
  *********************************************************/
+#define PANDO_MEM_MODULE PD_MEM_GATEWAY
+
 #include "pando_channel.h"
+#include "pando_route.h"
 #include "../platform/include/pando_types.h"
 #include "../protocol/sub_device_protocol.h"
 //#include "pando_system_time.h"
 #include "pando_zero_device.h"
 #include "../platform/include/pando_sys.h"
+#include "../platform/include/pando_log.h"
+#include "../platform/include/pando_trace.h"
+#include "../platform/include/platform_miscellaneous_interface.h"
 
 #define COMMON_COMMAND_UPGRADE 65529
 #define COMMON_COMMAND_REBOOT  65535
 #define COMMON_COMMAND_SYN_TIME 65531
+#define COMMON_COMMAND_MEM_STAT 65530
+#define COMMON_COMMAND_TRACE_DUMP 65528
+
+#ifdef PANDO_MEM_STAT
+/******************************************************************************
+ * FunctionName : zero_device_report_mem_stat.
+ * Description  : report the heap counters to the server, one property per module
+ *                numbered by PD_MEM_MODULE, PD_MEM_MODULE_NUM is the total and
+ *                the property after it carries the largest free block (the
+ *                total free heap on ports that cannot tell) and the buffer
+ *                watermarks.
+ * Parameters   : none.
+ * Returns      : none.
+*******************************************************************************/
+static void FUNCTION_ATTRIBUTE
+zero_device_report_mem_stat(void)
+{
+    uint8_t i = 0;
+    struct pando_mem_stat stat;
+    struct TLVs *params = NULL;
+    struct sub_device_buffer *data_buffer = create_data_package(0);
+    if(data_buffer == NULL)
+    {
+        pd_printf("%s:create data package error!\n", __func__);
+        return;
+    }
+
+    for(i = 0; i <= PD_MEM_MODULE_NUM; i++)
+    {
+        params = create_params_block();
+        if(params == NULL)
+        {
+            pd_printf("%s:create params block error!\n", __func__);
+            delete_device_package(data_buffer);
+            return;
+        }
+
+        pando_mem_get_stat(i, &stat);
+        add_next_uint32(params, stat.cur_bytes);
+        add_next_uint32(params, stat.peak_bytes);
+        add_next_uint32(params, stat.alloc_count);
+        add_next_uint32(params, stat.free_count);
+        add_next_uint32(params, stat.fail_count);
+        add_next_property(data_buffer, i, params);
+        delete_params_block(params);
+    }
+
+    params = create_params_block();
+    if(params == NULL)
+    {
+        pd_printf("%s:create params block error!\n", __func__);
+        delete_device_package(data_buffer);
+        return;
+    }
+
+    add_next_uint32(params, get_largest_free_block());
+    for(i = 0; i < PD_BUF_NUM; i++)
+    {
+        add_next_uint32(params, pando_mem_get_watermark(i));
+    }
+    add_next_property(data_buffer, PD_MEM_MODULE_NUM + 1, params);
+    delete_params_block(params);
+
+    finish_package(data_buffer);
+    channel_send_to_device(PANDO_CHANNEL_PORT_0, data_buffer->buffer, data_buffer->buffer_length);
+    delete_device_package(data_buffer);
+}
+#endif
 
 /******************************************************************************
  * FunctionName : zero_device_data_process.
@@ -51,9 +125,22 @@ zero_device_data_process(uint8_t * buffer, uint16_t length)
     {
     	pd_printf("PANDO: synchronize time\n");
         uint64_t time = get_next_uint64(cmd_param);
-        show_package((uint8_t*)(&time), sizeof(time));
+        PD_LOG_HEX((uint8_t*)(&time), sizeof(time));
        // pando_set_system_time(time);
     }
+#ifdef PANDO_MEM_STAT
+    else if(COMMON_COMMAND_MEM_STAT == cmd_body.command_num)
+    {
+        pando_mem_stat_print();
+        zero_device_report_mem_stat();
+    }
+#endif
+#ifdef PANDO_TRACE
+    else if(COMMON_COMMAND_TRACE_DUMP == cmd_body.command_num)
+    {
+        pando_trace_dump();
+    }
+#endif
 
     if( device_buffer->buffer != NULL)
     {
@@ -77,5 +164,6 @@ zero_device_data_process(uint8_t * buffer, uint16_t length)
 void FUNCTION_ATTRIBUTE
 pando_zero_device_init(void)
 {
+    pando_route_add(0, PANDO_CHANNEL_PORT_0);
     on_subdevice_channel_recv(PANDO_CHANNEL_PORT_0, zero_device_data_process);
 }
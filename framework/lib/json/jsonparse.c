@@ -33,6 +33,7 @@
 //#include <stdlib.h>
 //#include <string.h>
 #include "../../platform/include/pando_types.h"
+#include "../../platform/include/pando_sys.h"
 
 /*--------------------------------------------------------------------*/
 static int FUNCTION_ATTRIBUTE
@@ -232,7 +233,7 @@ jsonparse_strcmp_value(struct jsonparse_state *state, const char *str)
   if(state->vtype == 0) {
     return -1;
   }
-  return strncmp(str, &state->json[state->vstart], state->vlen);
+  return pd_strncmp(str, &state->json[state->vstart], state->vlen);
 }
 /*--------------------------------------------------------------------*/
 int FUNCTION_ATTRIBUTE
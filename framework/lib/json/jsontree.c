@@ -37,9 +37,12 @@
  *         Joakim Eriksson <joakime@sics.se>
  */
  
+#define PANDO_MEM_MODULE PD_MEM_JSON
+
 //#include "contiki.h"
 #include "jsontree.h"
 #include "jsonparse.h"
+#include "../../platform/include/pando_sys.h"
 //#include "osapi.h"
 //#include <string.h>
 
@@ -51,54 +54,95 @@
 #define PRINTF(...)
 #endif
 
+/*---------------------------------------------------------------------------*/
+static void FUNCTION_ATTRIBUTE
+put_char(const struct jsontree_context *js_ctx, char c)
+{
+  struct jsontree_buffer *buffer = js_ctx->buffer;
+
+  if(buffer == NULL) {
+    js_ctx->putchar(c);
+    return;
+  }
+  if(buffer->pos < buffer->size) {
+    buffer->data[buffer->pos] = c;
+  }
+  buffer->pos++;
+}
+/*---------------------------------------------------------------------------*/
+void FUNCTION_ATTRIBUTE
+jsontree_write_span(const struct jsontree_context *js_ctx, const char *text,
+                    int len)
+{
+  struct jsontree_buffer *buffer = js_ctx->buffer;
+  int room;
+
+  if(buffer == NULL) {
+    while(len-- > 0) {
+      js_ctx->putchar(*text++);
+    }
+    return;
+  }
+  room = buffer->size - buffer->pos;
+  if(room > 0) {
+    pd_memcpy(buffer->data + buffer->pos, text, len < room ? len : room);
+  }
+  buffer->pos += len;
+}
 /*---------------------------------------------------------------------------*/
 void FUNCTION_ATTRIBUTE
 jsontree_write_atom(const struct jsontree_context *js_ctx, const char *text)
 {
   if(text == NULL) {
-    js_ctx->putchar('0');
+    put_char(js_ctx, '0');
   } else {
-    while(*text != '\0') {
-      js_ctx->putchar(*text++);
-    }
+    jsontree_write_span(js_ctx, text, pd_strlen(text));
   }
 }
 /*---------------------------------------------------------------------------*/
 void FUNCTION_ATTRIBUTE
 jsontree_write_string(const struct jsontree_context *js_ctx, const char *text)
 {
-  js_ctx->putchar('"');
+  const char *start;
+
+  put_char(js_ctx, '"');
   if(text != NULL) {
+    /* copy the runs between quotes, which need escaping */
+    start = text;
     while(*text != '\0') {
       if(*text == '"') {
-        js_ctx->putchar('\\');
+        jsontree_write_span(js_ctx, start, text - start);
+        put_char(js_ctx, '\\');
+        start = text;
       }
-      js_ctx->putchar(*text++);
+      text++;
     }
+    jsontree_write_span(js_ctx, start, text - start);
   }
-  js_ctx->putchar('"');
+  put_char(js_ctx, '"');
 }
 /*---------------------------------------------------------------------------*/
 void FUNCTION_ATTRIBUTE
 jsontree_write_int(const struct jsontree_context *js_ctx, int value)
 {
-  char buf[10];
+  char buf[11];
+  unsigned int u = value;
   int l;
 
   if(value < 0) {
-    js_ctx->putchar('-');
-    value = -value;
+    u = 0 - u;
   }
 
-  l = sizeof(buf) - 1;
+  l = sizeof(buf);
   do {
-    buf[l--] = '0' + (value % 10);
-    value /= 10;
-  } while(value > 0 && l >= 0);
+    buf[--l] = '0' + (u % 10);
+    u /= 10;
+  } while(u > 0);
 
-  while(++l < sizeof(buf)) {
-    js_ctx->putchar(buf[l]);
+  if(value < 0) {
+    buf[--l] = '-';
   }
+  jsontree_write_span(js_ctx, buf + l, sizeof(buf) - l);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -107,11 +151,11 @@ jsontree_write_int_array(const struct jsontree_context *js_ctx, const int *text,
 {
   uint32_t i = 0;
   if(text == NULL) {
-    js_ctx->putchar('0');
+    put_char(js_ctx, '0');
   } else {
     for (i = 0; i < length - 1; i ++) {
       jsontree_write_int(js_ctx, *text++);
-	  js_ctx->putchar(',');
+	  put_char(js_ctx, ',');
     }
 	jsontree_write_int(js_ctx, *text);
   }
@@ -125,10 +169,24 @@ jsontree_setup(struct jsontree_context *js_ctx, struct jsontree_value *root,
 {
   js_ctx->values[0] = root;
   js_ctx->putchar = putchar;
+  js_ctx->buffer = NULL;
   js_ctx->path = 0;
   jsontree_reset(js_ctx);
 }
 /*---------------------------------------------------------------------------*/
+/* print into buffer without a per character callback. the context and the
+   buffer belong to the caller, so several can be in use at the same time. */
+/*---------------------------------------------------------------------------*/
+void FUNCTION_ATTRIBUTE
+jsontree_setup_buffer(struct jsontree_context *js_ctx,
+                      struct jsontree_value *root,
+                      struct jsontree_buffer *buffer)
+{
+  jsontree_setup(js_ctx, root, NULL);
+  js_ctx->buffer = buffer;
+  buffer->pos = 0;
+}
+/*---------------------------------------------------------------------------*/
 void FUNCTION_ATTRIBUTE
 jsontree_reset(struct jsontree_context *js_ctx)
 {
@@ -163,24 +221,23 @@ jsontree_print_next(struct jsontree_context *js_ctx)
 
     index = js_ctx->index[js_ctx->depth];
     if(index == 0) {
-      js_ctx->putchar(v->type);
-      js_ctx->putchar('\n');
+      put_char(js_ctx, v->type);
+      put_char(js_ctx, '\n');
     }
     if(index >= o->count) {
-      js_ctx->putchar('\n');
-      js_ctx->putchar(v->type + 2);
+      put_char(js_ctx, '\n');
+      put_char(js_ctx, v->type + 2);
       /* Default operation: back up one level! */
       break;
     }
 
     if(index > 0) {
-      js_ctx->putchar(',');
-      js_ctx->putchar('\n');
+      jsontree_write_span(js_ctx, ",\n", 2);
     }
     if(v->type == JSON_TYPE_OBJECT) {
       jsontree_write_string(js_ctx,
                             ((struct jsontree_object *)o)->pairs[index].name);
-      js_ctx->putchar(':');
+      put_char(js_ctx, ':');
       ov = ((struct jsontree_object *)o)->pairs[index].value;
     } else {
       ov = o->values[index];
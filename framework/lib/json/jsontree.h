@@ -49,10 +49,20 @@
 #define JSONTREE_MAX_DEPTH 10
 #endif /* JSONTREE_CONF_MAX_DEPTH */
 
+/* output buffer of a context set up with jsontree_setup_buffer. pos keeps
+   counting past size, so after printing it is the length the whole output
+   needs. */
+struct jsontree_buffer {
+    char *data;
+    int size;
+    int pos;
+};
+
 struct jsontree_context {
     struct jsontree_value *values[JSONTREE_MAX_DEPTH];
     uint16_t index[JSONTREE_MAX_DEPTH];
     int (* putchar)(int);
+    struct jsontree_buffer *buffer;
     uint8_t depth;
     uint8_t path;
     int callback_state;
@@ -127,6 +137,9 @@ struct jsontree_array {
 
 void jsontree_setup(struct jsontree_context *js_ctx,
                     struct jsontree_value *root, int (* putchar)(int));
+void jsontree_setup_buffer(struct jsontree_context *js_ctx,
+                           struct jsontree_value *root,
+                           struct jsontree_buffer *buffer);
 void jsontree_reset(struct jsontree_context *js_ctx);
 
 const char *jsontree_path_name(const struct jsontree_context *js_ctx,
@@ -135,6 +148,8 @@ const char *jsontree_path_name(const struct jsontree_context *js_ctx,
 void jsontree_write_int(const struct jsontree_context *js_ctx, int value);
 void jsontree_write_int_array(const struct jsontree_context *js_ctx, const int *text, uint32_t length);
 
+void jsontree_write_span(const struct jsontree_context *js_ctx,
+                         const char *text, int len);
 void jsontree_write_atom(const struct jsontree_context *js_ctx,
                          const char *text);
 void jsontree_write_string(const struct jsontree_context *js_ctx,
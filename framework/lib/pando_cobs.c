@@ -0,0 +1,200 @@
+/*******************************************************
+ * File name: pando_cobs.c
+ * Author:
+ * Versions: 1.0
+ * Description: a frame is cut at its zero bytes into blocks, each block is
+ *              sent after a code byte, its length plus one, standing in for
+ *              the zero that ended it. a block of 254 bytes has code 0xff and
+ *              no zero after it. both sides copy a block at a time, and the
+ *              decoder keeps its place between calls, so the frame is ready
+ *              at its delimiter without a second pass.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#include "pando_cobs.h"
+#include "../platform/include/pando_sys.h"
+
+static const uint16_t crc16_table[16] =
+{
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef
+};
+
+void FUNCTION_ATTRIBUTE
+pando_cobs_encode_begin(struct pando_cobs_encoder *encoder, uint8_t *out)
+{
+    encoder->out = out;
+    encoder->code_at = 0;
+    encoder->length = 1;
+    encoder->code = 1;
+}
+
+void FUNCTION_ATTRIBUTE
+pando_cobs_encode_put(struct pando_cobs_encoder *encoder, const uint8_t *data, uint16_t length)
+{
+    const uint8_t *end = data + length;
+    uint16_t room = 0;
+    uint16_t run = 0;
+
+    while(data < end)
+    {
+        // the bytes up to the next zero, as many as the block has room for.
+        room = 0xff - encoder->code;
+        if(room > end - data)
+        {
+            room = end - data;
+        }
+
+        for(run = 0; run < room && data[run] != 0; run++)
+        {
+        }
+
+        pd_memcpy(encoder->out + encoder->length, data, run);
+        encoder->length += run;
+        encoder->code += run;
+        data += run;
+        if(run == room && encoder->code != 0xff)
+        {
+            continue;
+        }
+
+        // a zero, or a full block, ends the block.
+        if(run < room)
+        {
+            data++;
+        }
+
+        encoder->out[encoder->code_at] = encoder->code;
+        encoder->code_at = encoder->length++;
+        encoder->code = 1;
+    }
+}
+
+uint16_t FUNCTION_ATTRIBUTE
+pando_cobs_encode_end(struct pando_cobs_encoder *encoder)
+{
+    encoder->out[encoder->code_at] = encoder->code;
+    encoder->out[encoder->length++] = 0;
+    return encoder->length;
+}
+
+void FUNCTION_ATTRIBUTE
+pando_cobs_decoder_init(struct pando_cobs_decoder *decoder, uint8_t *buffer, uint16_t size)
+{
+    decoder->buffer = buffer;
+    decoder->size = size;
+    decoder->length = 0;
+    decoder->code = 0;
+    decoder->left = 0;
+    decoder->discard = 0;
+    decoder->errors = 0;
+}
+
+// the frame is too long for the buffer, drop it.
+static void FUNCTION_ATTRIBUTE
+cobs_overflow(struct pando_cobs_decoder *decoder)
+{
+    decoder->discard = 1;
+    decoder->errors++;
+}
+
+uint16_t FUNCTION_ATTRIBUTE
+pando_cobs_decode(struct pando_cobs_decoder *decoder, const uint8_t *data, uint16_t length,
+    uint16_t *frame_length)
+{
+    uint16_t i = 0;
+    uint16_t run = 0;
+    uint8_t byte = 0;
+
+    *frame_length = 0;
+    while(i < length)
+    {
+        byte = data[i];
+        if(byte == 0)
+        {
+            i++;
+            if(!decoder->discard && decoder->left != 0)
+            {
+                // cut short.
+                decoder->errors++;
+            }
+            else if(!decoder->discard)
+            {
+                *frame_length = decoder->length;
+            }
+
+            decoder->length = 0;
+            decoder->code = 0;
+            decoder->left = 0;
+            decoder->discard = 0;
+            if(*frame_length != 0)
+            {
+                return i;
+            }
+
+            // empty frames, delimiters in a row, are skipped.
+            continue;
+        }
+
+        if(decoder->discard)
+        {
+            i++;
+            continue;
+        }
+
+        if(decoder->left == 0)
+        {
+            // the code of the next block stands in for the zero ending this one.
+            if(decoder->code != 0 && decoder->code != 0xff)
+            {
+                if(decoder->length == decoder->size)
+                {
+                    cobs_overflow(decoder);
+                    continue;
+                }
+
+                decoder->buffer[decoder->length++] = 0;
+            }
+
+            decoder->code = byte;
+            decoder->left = byte - 1;
+            i++;
+            continue;
+        }
+
+        // the rest of the block in this data, up to a delimiter cutting it short.
+        for(run = 1; run < decoder->left && i + run < length && data[i + run] != 0; run++)
+        {
+        }
+
+        if(run > decoder->size - decoder->length)
+        {
+            cobs_overflow(decoder);
+            continue;
+        }
+
+        pd_memcpy(decoder->buffer + decoder->length, data + i, run);
+        decoder->length += run;
+        decoder->left -= run;
+        i += run;
+    }
+
+    return length;
+}
+
+uint16_t FUNCTION_ATTRIBUTE
+pando_crc16(uint16_t crc, const uint8_t *data, uint16_t length)
+{
+    const uint8_t *end = data + length;
+
+    for(; data < end; data++)
+    {
+        crc = (crc << 4) ^ crc16_table[(crc >> 12) ^ (*data >> 4)];
+        crc = (crc << 4) ^ crc16_table[(crc >> 12) ^ (*data & 0x0f)];
+    }
+
+    return crc;
+}
@@ -0,0 +1,108 @@
+/*******************************************************
+ * File name: pando_cobs.h
+ * Author:
+ * Versions: 1.0
+ * Description: consistent overhead byte stuffing for serial links. a frame
+ *              is encoded without zero bytes and ends with one, so a reader
+ *              finds the frame boundaries in any stream of bytes, and a frame
+ *              grows by one byte in 254 whatever it holds. the crc here is
+ *              the frame check the serial channel appends.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#ifndef __PANDO_COBS_H
+#define __PANDO_COBS_H
+
+#include "../platform/include/pando_types.h"
+
+// most bytes a frame of length bytes takes encoded, with its delimiter.
+#define PANDO_COBS_MAX(length) ((length) + (length) / 254 + 2)
+
+struct pando_cobs_encoder
+{
+    uint8_t *out;
+    uint16_t length;
+    uint16_t code_at;           // where the code of the current block goes
+    uint8_t code;
+};
+
+struct pando_cobs_decoder
+{
+    uint8_t *buffer;
+    uint16_t size;
+    uint16_t length;
+    uint8_t code;               // of the current block, 0 before the first
+    uint8_t left;               // bytes left in the block
+    uint8_t discard;            // skip to the next delimiter
+    uint32_t errors;            // frames dropped, malformed or too long
+};
+
+/******************************************************************************
+ * FunctionName : pando_cobs_encode_begin
+ * Description  : start encoding a frame, the data is added in parts.
+ * Parameters   : encoder: the state.
+ *                out: room for PANDO_COBS_MAX of the frame length.
+ * Returns      : none.
+*******************************************************************************/
+void pando_cobs_encode_begin(struct pando_cobs_encoder *encoder, uint8_t *out);
+
+/******************************************************************************
+ * FunctionName : pando_cobs_encode_put
+ * Description  : add the next part of the frame.
+ * Parameters   : encoder: the state.
+ *                data: the bytes.
+ *                length: byte count.
+ * Returns      : none.
+*******************************************************************************/
+void pando_cobs_encode_put(struct pando_cobs_encoder *encoder, const uint8_t *data, uint16_t length);
+
+/******************************************************************************
+ * FunctionName : pando_cobs_encode_end
+ * Description  : finish the frame with its delimiter.
+ * Parameters   : encoder: the state.
+ * Returns      : the bytes written to out.
+*******************************************************************************/
+uint16_t pando_cobs_encode_end(struct pando_cobs_encoder *encoder);
+
+/******************************************************************************
+ * FunctionName : pando_cobs_decoder_init
+ * Description  : set up a decoder. bytes before the first delimiter make a
+ *                frame of their own, a reader joining a stream midway drops it
+ *                for its crc.
+ * Parameters   : decoder: the state.
+ *                buffer: gets the decoded frame.
+ *                size: longest frame, longer ones are dropped.
+ * Returns      : none.
+*******************************************************************************/
+void pando_cobs_decoder_init(struct pando_cobs_decoder *decoder, uint8_t *buffer, uint16_t size);
+
+/******************************************************************************
+ * FunctionName : pando_cobs_decode
+ * Description  : decode received bytes, up to the end of the first frame in
+ *                them. call it again with the bytes left for the next one.
+ * Parameters   : decoder: the state.
+ *                data: the bytes.
+ *                length: byte count.
+ *                frame_length: set to the length of the frame in the buffer
+ *                              if one ended, else 0. it stays there until
+ *                              the next call.
+ * Returns      : the bytes used.
+*******************************************************************************/
+uint16_t pando_cobs_decode(struct pando_cobs_decoder *decoder, const uint8_t *data, uint16_t length,
+    uint16_t *frame_length);
+
+/******************************************************************************
+ * FunctionName : pando_crc16
+ * Description  : crc-16/ccitt, polynomial 0x1021. start with 0xffff, a frame
+ *                followed by its crc, high byte first, checks to 0.
+ * Parameters   : crc: the crc so far.
+ *                data: the bytes.
+ *                length: byte count.
+ * Returns      : the crc.
+*******************************************************************************/
+uint16_t pando_crc16(uint16_t crc, const uint8_t *data, uint16_t length);
+
+#endif
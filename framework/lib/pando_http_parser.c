@@ -0,0 +1,378 @@
+/*******************************************************
+ * File name: pando_http_parser.c
+ * Author:
+ * Versions: 1.0
+ * Description: incremental http/1.1 response parser.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#include "pando_http_parser.h"
+#include "../platform/include/pando_sys.h"
+
+enum
+{
+    HTTP_STATE_STATUS = 0,
+    HTTP_STATE_HEADER,
+    HTTP_STATE_BODY,            // Content-Length bytes
+    HTTP_STATE_BODY_CLOSE,      // until the connection closes
+    HTTP_STATE_CHUNK_SIZE,
+    HTTP_STATE_CHUNK_DATA,
+    HTTP_STATE_CHUNK_END,       // the CRLF after chunk data
+    HTTP_STATE_TRAILER,
+    HTTP_STATE_DONE,
+    HTTP_STATE_ERROR
+};
+
+// compares the start of the line with a lower case header name.
+static int FUNCTION_ATTRIBUTE
+header_is(const char *line, const char *name)
+{
+    char c;
+
+    for(; *name != '\0'; line++, name++)
+    {
+        c = *line;
+        if(c >= 'A' && c <= 'Z')
+        {
+            c += 'a' - 'A';
+        }
+
+        if(c != *name)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static const char * FUNCTION_ATTRIBUTE
+skip_space(const char *text)
+{
+    while(*text == ' ' || *text == '\t')
+    {
+        text++;
+    }
+
+    return text;
+}
+
+static int FUNCTION_ATTRIBUTE
+parse_status(struct pando_http_parser *parser)
+{
+    const char *text = parser->line;
+    uint16_t status = 0;
+    uint8_t digits = 0;
+
+    if(!header_is(text, "http/1."))
+    {
+        return -1;
+    }
+
+    text = pd_strchr(text, ' ');
+    if(text == NULL)
+    {
+        return -1;
+    }
+
+    for(text = skip_space(text); *text >= '0' && *text <= '9'; text++, digits++)
+    {
+        status = status * 10 + (*text - '0');
+    }
+
+    if(digits != 3)
+    {
+        return -1;
+    }
+
+    parser->status = status;
+    // http/1.1 connections persist unless the server says otherwise.
+    parser->keep_alive = (parser->line[7] == '1');
+    return 0;
+}
+
+static int FUNCTION_ATTRIBUTE
+parse_header(struct pando_http_parser *parser)
+{
+    const char *text = NULL;
+    uint32_t length = 0;
+
+    if(header_is(parser->line, "content-length:"))
+    {
+        text = skip_space(parser->line + sizeof("content-length:") - 1);
+        if(*text < '0' || *text > '9')
+        {
+            return -1;
+        }
+
+        for(; *text >= '0' && *text <= '9'; text++)
+        {
+            if(length > 0x7fffffff / 10)
+            {
+                return -1;
+            }
+
+            length = length * 10 + (*text - '0');
+        }
+
+        parser->content_length = length;
+    }
+    else if(header_is(parser->line, "transfer-encoding:"))
+    {
+        text = skip_space(parser->line + sizeof("transfer-encoding:") - 1);
+        parser->chunked = header_is(text, "chunked");
+    }
+    else if(header_is(parser->line, "connection:"))
+    {
+        text = skip_space(parser->line + sizeof("connection:") - 1);
+        if(header_is(text, "close"))
+        {
+            parser->keep_alive = 0;
+        }
+        else if(header_is(text, "keep-alive"))
+        {
+            parser->keep_alive = 1;
+        }
+    }
+
+    return 0;
+}
+
+// the empty line after the headers, pick how the body is framed.
+static int FUNCTION_ATTRIBUTE
+end_headers(struct pando_http_parser *parser)
+{
+    int32_t content_length = parser->chunked? -1: parser->content_length;
+
+    // an interim 1xx response, the real one follows.
+    if(parser->status < 200)
+    {
+        parser->state = HTTP_STATE_STATUS;
+        parser->chunked = 0;
+        parser->content_length = -1;
+        return 0;
+    }
+
+    if(parser->cb != NULL && parser->cb->headers != NULL
+        && parser->cb->headers(parser->arg, parser->status, content_length) != 0)
+    {
+        return -1;
+    }
+
+    if(parser->status == 204 || parser->status == 304)
+    {
+        parser->state = HTTP_STATE_DONE;
+    }
+    else if(parser->chunked)
+    {
+        parser->state = HTTP_STATE_CHUNK_SIZE;
+    }
+    else if(parser->content_length >= 0)
+    {
+        parser->remaining = parser->content_length;
+        parser->state = parser->remaining > 0? HTTP_STATE_BODY: HTTP_STATE_DONE;
+    }
+    else
+    {
+        parser->state = HTTP_STATE_BODY_CLOSE;
+        parser->keep_alive = 0;
+    }
+
+    return 0;
+}
+
+static int FUNCTION_ATTRIBUTE
+parse_chunk_size(struct pando_http_parser *parser)
+{
+    const char *text = parser->line;
+    uint32_t size = 0;
+    uint8_t digits = 0;
+    char c;
+
+    for(;; text++, digits++)
+    {
+        c = *text;
+        if(c >= '0' && c <= '9')
+        {
+            c -= '0';
+        }
+        else if(c >= 'a' && c <= 'f')
+        {
+            c -= 'a' - 10;
+        }
+        else if(c >= 'A' && c <= 'F')
+        {
+            c -= 'A' - 10;
+        }
+        else
+        {
+            break;
+        }
+
+        if(size > 0x0fffffff)
+        {
+            return -1;
+        }
+
+        size = (size << 4) | c;
+    }
+
+    if(digits == 0)
+    {
+        return -1;
+    }
+
+    parser->remaining = size;
+    parser->state = size > 0? HTTP_STATE_CHUNK_DATA: HTTP_STATE_TRAILER;
+    return 0;
+}
+
+// a complete line is in parser->line.
+static int FUNCTION_ATTRIBUTE
+parse_line(struct pando_http_parser *parser)
+{
+    switch(parser->state)
+    {
+        case HTTP_STATE_STATUS:
+            parser->state = HTTP_STATE_HEADER;
+            return parse_status(parser);
+        case HTTP_STATE_HEADER:
+            if(parser->line_length == 0)
+            {
+                return end_headers(parser);
+            }
+
+            return parse_header(parser);
+        case HTTP_STATE_CHUNK_SIZE:
+            return parse_chunk_size(parser);
+        case HTTP_STATE_CHUNK_END:
+            parser->state = HTTP_STATE_CHUNK_SIZE;
+            return parser->line_length == 0? 0: -1;
+        case HTTP_STATE_TRAILER:
+            if(parser->line_length == 0)
+            {
+                parser->state = HTTP_STATE_DONE;
+            }
+
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+static int FUNCTION_ATTRIBUTE
+emit_body(struct pando_http_parser *parser, const char *data, uint16_t length)
+{
+    if(parser->cb != NULL && parser->cb->body != NULL)
+    {
+        return parser->cb->body(parser->arg, data, length);
+    }
+
+    return 0;
+}
+
+void FUNCTION_ATTRIBUTE
+pando_http_parser_init(struct pando_http_parser *parser,
+    const struct pando_http_parser_cb *cb, void *arg)
+{
+    pd_memset(parser, 0, sizeof(struct pando_http_parser));
+    parser->state = HTTP_STATE_STATUS;
+    parser->content_length = -1;
+    parser->cb = cb;
+    parser->arg = arg;
+}
+
+int FUNCTION_ATTRIBUTE
+pando_http_parser_feed(struct pando_http_parser *parser,
+    const char *data, uint16_t length)
+{
+    const char *end = data + length;
+    uint16_t span = 0;
+    char c;
+
+    while(data < end)
+    {
+        switch(parser->state)
+        {
+            case HTTP_STATE_DONE:
+                return PANDO_HTTP_DONE;
+            case HTTP_STATE_ERROR:
+                return PANDO_HTTP_ERROR;
+            case HTTP_STATE_BODY:
+            case HTTP_STATE_CHUNK_DATA:
+                span = (end - data < parser->remaining)? end - data: parser->remaining;
+                if(emit_body(parser, data, span) != 0)
+                {
+                    parser->state = HTTP_STATE_ERROR;
+                    return PANDO_HTTP_ERROR;
+                }
+
+                data += span;
+                parser->remaining -= span;
+                if(parser->remaining == 0)
+                {
+                    parser->state = (parser->state == HTTP_STATE_BODY)?
+                        HTTP_STATE_DONE: HTTP_STATE_CHUNK_END;
+                }
+
+                break;
+            case HTTP_STATE_BODY_CLOSE:
+                if(emit_body(parser, data, end - data) != 0)
+                {
+                    parser->state = HTTP_STATE_ERROR;
+                    return PANDO_HTTP_ERROR;
+                }
+
+                data = end;
+                break;
+            default:
+                // a line, CRLF or a bare LF ends it.
+                c = *data++;
+                if(c == '\r')
+                {
+                    break;
+                }
+
+                if(c != '\n')
+                {
+                    if(parser->line_length < PANDO_HTTP_LINE_MAX - 1)
+                    {
+                        parser->line[parser->line_length++] = c;
+                    }
+
+                    break;
+                }
+
+                parser->line[parser->line_length] = '\0';
+                if(parse_line(parser) != 0)
+                {
+                    parser->state = HTTP_STATE_ERROR;
+                    return PANDO_HTTP_ERROR;
+                }
+
+                parser->line_length = 0;
+                break;
+        }
+    }
+
+    if(parser->state == HTTP_STATE_ERROR)
+    {
+        return PANDO_HTTP_ERROR;
+    }
+
+    return parser->state == HTTP_STATE_DONE? PANDO_HTTP_DONE: PANDO_HTTP_MORE;
+}
+
+int FUNCTION_ATTRIBUTE
+pando_http_parser_finish(struct pando_http_parser *parser)
+{
+    if(parser->state == HTTP_STATE_BODY_CLOSE)
+    {
+        parser->state = HTTP_STATE_DONE;
+    }
+
+    return parser->state == HTTP_STATE_DONE? PANDO_HTTP_DONE: PANDO_HTTP_ERROR;
+}
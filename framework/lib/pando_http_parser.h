@@ -0,0 +1,85 @@
+/*******************************************************
+ * File name: pando_http_parser.h
+ * Author:
+ * Versions: 1.0
+ * Description: incremental http/1.1 response parser. it is fed the bytes as
+ *              they arrive, keeps only the current header line, and hands the
+ *              decoded body (Content-Length, chunked or until close) to the
+ *              caller in spans, so nothing has to buffer the whole response.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#ifndef __PANDO_HTTP_PARSER_H
+#define __PANDO_HTTP_PARSER_H
+
+#include "../platform/include/pando_types.h"
+
+// longer header lines are cut, only the names and short values matter here.
+#define PANDO_HTTP_LINE_MAX 64
+
+// results of pando_http_parser_feed and pando_http_parser_finish.
+#define PANDO_HTTP_MORE     0
+#define PANDO_HTTP_DONE     1
+#define PANDO_HTTP_ERROR    (-1)
+
+struct pando_http_parser_cb
+{
+    // status line and headers are parsed, content_length is -1 when the body
+    // is chunked or runs until close. return non-zero to abort.
+    int (*headers)(void *arg, uint16_t status, int32_t content_length);
+    // the next span of the decoded body. return non-zero to abort.
+    int (*body)(void *arg, const char *data, uint16_t length);
+};
+
+struct pando_http_parser
+{
+    uint8_t state;
+    uint8_t chunked;
+    uint8_t keep_alive;             // the server keeps the connection open
+    uint16_t status;
+    int32_t content_length;
+    uint32_t remaining;             // bytes left of the body or the chunk
+    uint8_t line_length;
+    char line[PANDO_HTTP_LINE_MAX];
+    const struct pando_http_parser_cb *cb;
+    void *arg;
+};
+
+/******************************************************************************
+ * FunctionName : pando_http_parser_init
+ * Description  : start parsing a new response.
+ * Parameters   : parser: the parser.
+ *                cb: the callbacks, both optional.
+ *                arg: passed to the callbacks.
+ * Returns      : none.
+*******************************************************************************/
+void pando_http_parser_init(struct pando_http_parser *parser,
+    const struct pando_http_parser_cb *cb, void *arg);
+
+/******************************************************************************
+ * FunctionName : pando_http_parser_feed
+ * Description  : parse the next received bytes, bytes after the end of the
+ *                response are ignored.
+ * Parameters   : parser: the parser.
+ *                data: the bytes.
+ *                length: byte count.
+ * Returns      : PANDO_HTTP_DONE once the response is complete,
+ *                PANDO_HTTP_MORE while it is not, PANDO_HTTP_ERROR if it is
+ *                malformed or a callback aborted.
+*******************************************************************************/
+int pando_http_parser_feed(struct pando_http_parser *parser,
+    const char *data, uint16_t length);
+
+/******************************************************************************
+ * FunctionName : pando_http_parser_finish
+ * Description  : the connection closed, this ends a body without length.
+ * Parameters   : parser: the parser.
+ * Returns      : PANDO_HTTP_DONE if the response is complete, else
+ *                PANDO_HTTP_ERROR.
+*******************************************************************************/
+int pando_http_parser_finish(struct pando_http_parser *parser);
+
+#endif
@@ -1,40 +1,198 @@
+#define PANDO_MEM_MODULE PD_MEM_JSON
+
 #include "pando_json.h"
+#include "../platform/include/pando_sys.h"
+
+int FUNCTION_ATTRIBUTE
+pando_json_print(struct jsontree_value * json_value, char * dst, int len)
+{
+    struct jsontree_context js_ctx;
+    struct jsontree_buffer buffer;
+
+    if(dst == NULL || len <= 0)
+    {
+        return -1;
+    }
+
+    // keep the last byte for the terminator.
+    buffer.data = dst;
+    buffer.size = len - 1;
+    jsontree_setup_buffer(&js_ctx, json_value, &buffer);
+
+    while (jsontree_print_next(&js_ctx));
 
-static char *json_buf;
-static int json_buf_len;
-static int pos;
+    dst[buffer.pos < buffer.size? buffer.pos: buffer.size] = 0;
+
+    return buffer.pos;
+}
+
+char * FUNCTION_ATTRIBUTE
+pando_json_print_new(struct jsontree_value * json_value, int len)
+{
+    char *dst = (char *)pd_malloc(len);
 
+    if(dst != NULL)
+    {
+        pando_json_print(json_value, dst, len);
+    }
+
+    return dst;
+}
+
+#define FNV_OFFSET_BASIS 2166136261UL
+#define FNV_PRIME 16777619UL
+
+static uint32_t FUNCTION_ATTRIBUTE
+json_hash(uint32_t hash, const char *str, int len)
+{
+    int i;
+
+    for(i = 0; i < len; i++)
+    {
+        hash = (hash ^ (uint8_t)str[i]) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+// rules out a hash collision, the key must equal the last segment of the path.
 static int FUNCTION_ATTRIBUTE
-json_putchar(int c)
+json_key_match(const char *path, int path_len, const char *key, int len)
 {
-    if (json_buf != NULL && pos < json_buf_len) 
+    const char *segment = NULL;
+
+    if(len > path_len)
     {
-        json_buf[pos++] = c;
-        return c;
+        return 0;
     }
 
-    return 0;
+    segment = path + path_len - len;
+    if(segment != path && segment[-1] != '.')
+    {
+        return 0;
+    }
+
+    return pd_strncmp(segment, key, len) == 0;
 }
 
-int FUNCTION_ATTRIBUTE 
-pando_json_print(struct jsontree_value * json_value, char * dst, int len)
+static void FUNCTION_ATTRIBUTE
+json_store(struct jsonparse_state *state, const struct pando_json_field *field,
+    char *result)
 {
-    if( dst == NULL) 
+    char *dst = result + field->offset;
+
+    if(field->type == PANDO_JSON_INT)
+    {
+        *(int *)dst = jsonparse_get_value_as_int(state);
+    }
+    else if(field->type == PANDO_JSON_LONG)
+    {
+        *(long *)dst = jsonparse_get_value_as_long(state);
+    }
+    else
+    {
+        jsonparse_copy_value(state, dst, field->size);
+    }
+}
+
+int FUNCTION_ATTRIBUTE
+pando_json_extract(const char *json, int len,
+    const struct pando_json_field *fields, uint8_t count, void *result)
+{
+    struct jsonparse_state state;
+    uint32_t hash[PANDO_JSON_MAX_FIELDS];
+    uint16_t path_len[PANDO_JSON_MAX_FIELDS];
+    // path hash of the object open at each parser depth, 0 for objects in arrays.
+    uint32_t parent[JSONPARSE_MAX_DEPTH];
+    uint32_t key = 0;
+    int pending = -1;
+    int found = 0;
+    int type;
+    int i;
+
+    if(json == NULL || fields == NULL || result == NULL
+        || count > PANDO_JSON_MAX_FIELDS)
     {
         return -1;
     }
-    json_buf = dst;
-    json_buf_len = len;
-    pos = 0;
 
-    struct jsontree_context js_ctx;
-    js_ctx.values[0] = json_value;
-    jsontree_reset(&js_ctx);
-    js_ctx.putchar = json_putchar;
+    for(i = 0; i < count; i++)
+    {
+        path_len[i] = pd_strlen(fields[i].path);
+        hash[i] = json_hash(FNV_OFFSET_BASIS, fields[i].path, path_len[i]);
+    }
 
-    while (jsontree_print_next(&js_ctx));
+    jsonparse_setup(&state, json, len);
+    while((type = jsonparse_next(&state)) != 0)
+    {
+        switch(type)
+        {
+            case JSON_TYPE_OBJECT:
+                if(state.depth >= JSONPARSE_MAX_DEPTH)
+                {
+                    return -1;
+                }
+
+                if(state.depth == 1)
+                {
+                    parent[1] = FNV_OFFSET_BASIS;
+                }
+                else
+                {
+                    parent[state.depth] =
+                        (state.stack[state.depth - 2] == JSON_TYPE_PAIR)? key: 0;
+                }
+
+                pending = -1;
+                break;
+            case JSON_TYPE_PAIR_NAME:
+                pending = -1;
+                key = parent[state.depth];
+                if(key == 0)
+                {
+                    break;
+                }
+
+                if(state.depth > 1)
+                {
+                    key = json_hash(key, ".", 1);
+                }
+
+                key = json_hash(key, state.json + state.vstart, state.vlen);
+                for(i = 0; i < count; i++)
+                {
+                    if(hash[i] == key
+                        && json_key_match(fields[i].path, path_len[i], state.json + state.vstart, state.vlen))
+                    {
+                        pending = i;
+                        break;
+                    }
+                }
+
+                break;
+            case JSON_TYPE_PAIR:
+                break;
+            case JSON_TYPE_STRING:
+            case JSON_TYPE_NUMBER:
+                if(pending >= 0 && jsonparse_get_type(&state) == JSON_TYPE_PAIR
+                    && (type == JSON_TYPE_STRING) == (fields[pending].type == PANDO_JSON_STRING))
+                {
+                    json_store(&state, &fields[pending], (char *)result);
+                    found |= 1 << pending;
+                }
+
+                pending = -1;
+                break;
+            default:
+                pending = -1;
+                break;
+        }
+    }
+
+    if(state.error != JSON_ERROR_OK)
+    {
+        return -1;
+    }
 
-    json_buf[pos] = 0;
-    
-    return pos;
+    return found;
 }
@@ -13,16 +13,72 @@
 #define __PANDO_JSON_H
 
 #include "json/jsontree.h"
+#include "json/jsonparse.h"
+
+// destination types of an extracted field.
+#define PANDO_JSON_INT      JSON_TYPE_INT       // int
+#define PANDO_JSON_LONG     JSON_TYPE_NUMBER    // long
+#define PANDO_JSON_STRING   JSON_TYPE_STRING    // char[size], always terminated
+
+// a field table holds at most this many entries.
+#define PANDO_JSON_MAX_FIELDS 16
+
+// one value picked out of a json document. path is the dotted key path from
+// the top level object, e.g. "data.access_token", the destination is at
+// offset in the result struct handed to pando_json_extract.
+struct pando_json_field
+{
+    const char *path;
+    uint8_t type;
+    uint16_t offset;
+    uint16_t size;
+};
+
+#define PANDO_JSON_OFFSET(st, member) ((uint16_t)(unsigned long)&(((st *)0)->member))
+
+#define PANDO_JSON_FIELD(path, type, st, member) \
+    {path, type, PANDO_JSON_OFFSET(st, member), sizeof(((st *)0)->member)}
 
  /******************************************************************************
  * FunctionName : pando_json_print
- * Description  : print json value to a "char *" string.
+ * Description  : print json value to a "char *" string, reentrant.
  * Parameters   : json_value: the json_value struct ptr.
  *                dst: the string buffer to print to.
  *                len: the length of the output buffer.
- * Returns      : return the length printed, -1 if error
+ * Returns      : the length of the whole json text, -1 if error. if it is
+ *                len or more the output was truncated to len - 1 characters,
+ *                dst is always terminated.
 *******************************************************************************/
 
 int pando_json_print(struct jsontree_value * json_value, char * dst, int len);
 
+ /******************************************************************************
+ * FunctionName : pando_json_print_new
+ * Description  : print json value to a new string, charged to the json module
+ *                of the heap counters. free it with pd_free.
+ * Parameters   : json_value: the json_value struct ptr.
+ *                len: the size of the string.
+ * Returns      : the string, NULL if out of memory. it is truncated as by
+ *                pando_json_print.
+*******************************************************************************/
+
+char *pando_json_print_new(struct jsontree_value * json_value, int len);
+
+ /******************************************************************************
+ * FunctionName : pando_json_extract
+ * Description  : fill a result struct from a json document in one pass, keys
+ *                are matched by the hash of their dotted path, the document is
+ *                read in place and not copied.
+ * Parameters   : json: the json text, must be followed by a '\0'.
+ *                len: the length of json.
+ *                fields: the field table, usually a const array.
+ *                count: the number of fields, at most PANDO_JSON_MAX_FIELDS.
+ *                result: the struct the field offsets refer to.
+ * Returns      : bit n is set if fields[n] was found with the expected type,
+ *                -1 if the document is malformed or nested too deep.
+*******************************************************************************/
+
+int pando_json_extract(const char *json, int len,
+    const struct pando_json_field *fields, uint8_t count, void *result);
+
 #endif
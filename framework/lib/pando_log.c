@@ -0,0 +1,157 @@
+/*******************************************************
+ * File name: pando_log.c
+ * Author:
+ * Versions: 1.0
+ * Description: binary log ring, compiled only with PANDO_LOG_BINARY.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#include "../platform/include/pando_log.h"
+#include <stdarg.h>
+
+#ifdef PANDO_LOG_BINARY
+
+#define RECORD_HEAD(level, args, seq) \
+    (((uint32_t)(level) << 24) | ((uint32_t)(args) << 16) | ((seq) & 0xffff))
+#define RECORD_ARGS(head)   (((head) >> 16) & 0xff)
+#define RECORD_WORDS(head)  (2 + RECORD_ARGS(head))
+
+static uint32_t s_log_ring[PANDO_LOG_RING_WORDS];
+static uint16_t s_log_head = 0;     // next word to write.
+static uint16_t s_log_tail = 0;     // first word of the oldest record.
+static uint16_t s_log_used = 0;     // words in use.
+static uint16_t s_log_seq = 0;
+
+static void FUNCTION_ATTRIBUTE
+ring_put(uint32_t word)
+{
+    s_log_ring[s_log_head] = word;
+    s_log_head = (s_log_head + 1) % PANDO_LOG_RING_WORDS;
+    s_log_used++;
+}
+
+static void FUNCTION_ATTRIBUTE
+ring_drop_oldest(void)
+{
+    uint16_t words = RECORD_WORDS(s_log_ring[s_log_tail]);
+    s_log_tail = (s_log_tail + words) % PANDO_LOG_RING_WORDS;
+    s_log_used -= words;
+}
+
+static uint8_t FUNCTION_ATTRIBUTE
+count_args(const char *fmt)
+{
+    uint8_t count = 0;
+
+    while(*fmt != '\0')
+    {
+        if(*fmt++ != '%')
+        {
+            continue;
+        }
+
+        if(*fmt == '%')
+        {
+            fmt++;
+            continue;
+        }
+
+        count++;
+    }
+
+    return count > PD_LOG_MAX_ARGS? PD_LOG_MAX_ARGS: count;
+}
+
+/******************************************************************************
+ * FunctionName : pd_log_bin_write
+ * Description  : append a record to the binary log ring, the oldest records are
+ *                overwritten when the ring is full. every conversion in fmt
+ *                takes one 32 bit argument, strings are kept as their address.
+ * Parameters   : level: the log level.
+ *                fmt: the format string, its address identifies the message.
+ * Returns      : none.
+*******************************************************************************/
+void FUNCTION_ATTRIBUTE
+pd_log_bin_write(uint8_t level, const char *fmt, ...)
+{
+    va_list ap;
+    uint8_t i = 0;
+    uint8_t args = count_args(fmt);
+
+    while(s_log_used + 2 + args > PANDO_LOG_RING_WORDS)
+    {
+        ring_drop_oldest();
+    }
+
+    ring_put(RECORD_HEAD(level, args, s_log_seq++));
+    ring_put((uint32_t)(unsigned long)fmt);
+
+    va_start(ap, fmt);
+    for(i = 0; i < args; i++)
+    {
+        ring_put(va_arg(ap, uint32_t));
+    }
+    va_end(ap);
+}
+
+/******************************************************************************
+ * FunctionName : pd_log_bin_read
+ * Description  : move whole records out of the binary log ring.
+ * Parameters   : dst: buffer for the records.
+ *                max_words: size of dst in 32 bit words.
+ * Returns      : the number of words written to dst.
+*******************************************************************************/
+uint16_t FUNCTION_ATTRIBUTE
+pd_log_bin_read(uint32_t *dst, uint16_t max_words)
+{
+    uint16_t count = 0;
+    uint16_t words = 0;
+
+    while(s_log_used > 0)
+    {
+        words = RECORD_WORDS(s_log_ring[s_log_tail]);
+        if(count + words > max_words)
+        {
+            break;
+        }
+
+        s_log_used -= words;
+        while(words-- > 0)
+        {
+            dst[count++] = s_log_ring[s_log_tail];
+            s_log_tail = (s_log_tail + 1) % PANDO_LOG_RING_WORDS;
+        }
+    }
+
+    return count;
+}
+
+/******************************************************************************
+ * FunctionName : pd_log_bin_dump
+ * Description  : print and drain the binary log ring as hex words.
+ * Parameters   : none.
+ * Returns      : none.
+*******************************************************************************/
+void FUNCTION_ATTRIBUTE
+pd_log_bin_dump(void)
+{
+    uint32_t record[2 + PD_LOG_MAX_ARGS];
+    uint16_t words = 0;
+    uint16_t i = 0;
+
+    pd_printf("PDLOG BEGIN\n");
+    while((words = pd_log_bin_read(record, 2 + PD_LOG_MAX_ARGS)) > 0)
+    {
+        for(i = 0; i < words; i++)
+        {
+            pd_printf("%08x ", record[i]);
+        }
+        pd_printf("\n");
+    }
+    pd_printf("PDLOG END\n");
+}
+
+#endif /* PANDO_LOG_BINARY */
@@ -0,0 +1,234 @@
+/*******************************************************
+ * File name: pando_mem_stat.c
+ * Author:
+ * Versions: 1.0
+ * Description: per module heap counters and buffer watermarks behind
+ *              pd_malloc/pd_free, compiled only with PANDO_MEM_STAT.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#include "../platform/include/pando_sys.h"
+#include "../platform/include/pando_types.h"
+#include "../platform/include/pando_mem_stat.h"
+#include "../platform/include/platform_miscellaneous_interface.h"
+
+#ifdef PANDO_MEM_STAT
+
+/* every block is prefixed with its size and module so pd_free can uncharge
+ * it, 8 bytes keep the returned pointer aligned for 64 bit values. */
+struct mem_block_head
+{
+    uint32_t size;
+    uint8_t module;
+    uint8_t reserved[3];
+};
+
+static struct pando_mem_stat s_mem_stat[PD_MEM_MODULE_NUM];
+static struct pando_mem_stat s_mem_total;
+static uint32_t s_buf_watermark[PD_BUF_NUM];
+
+static const char *s_module_name[PD_MEM_MODULE_NUM] =
+{
+    "other",
+    "protocol",
+    "mqtt",
+    "gateway",
+    "json",
+    "storage",
+    "subdevice"
+};
+
+static const char *s_buf_name[PD_BUF_NUM] =
+{
+    "mqtt in",
+    "mqtt queue",
+    "http response"
+};
+
+static void FUNCTION_ATTRIBUTE
+stat_charge(struct pando_mem_stat *stat, uint32_t size)
+{
+    stat->cur_bytes += size;
+    stat->alloc_count++;
+    if(stat->cur_bytes > stat->peak_bytes)
+    {
+        stat->peak_bytes = stat->cur_bytes;
+    }
+}
+
+static void FUNCTION_ATTRIBUTE
+stat_uncharge(struct pando_mem_stat *stat, uint32_t size)
+{
+    stat->cur_bytes -= size;
+    stat->free_count++;
+}
+
+/******************************************************************************
+ * FunctionName : pando_mem_malloc
+ * Description  : allocate memory and charge it to a module.
+ * Parameters   : size: bytes to allocate.
+ *                module: the PD_MEM_MODULE charged for the allocation.
+ * Returns      : the memory, or NULL if the heap is exhausted.
+*******************************************************************************/
+void * FUNCTION_ATTRIBUTE
+pando_mem_malloc(uint32_t size, uint8_t module)
+{
+    struct mem_block_head *head = NULL;
+
+    if(module >= PD_MEM_MODULE_NUM)
+    {
+        module = PD_MEM_OTHER;
+    }
+
+    head = (struct mem_block_head *)pd_raw_malloc(sizeof(struct mem_block_head) + size);
+    if(head == NULL)
+    {
+        s_mem_stat[module].fail_count++;
+        s_mem_total.fail_count++;
+        return NULL;
+    }
+
+    head->size = size;
+    head->module = module;
+    stat_charge(&s_mem_stat[module], size);
+    stat_charge(&s_mem_total, size);
+
+    return (void *)(head + 1);
+}
+
+/******************************************************************************
+ * FunctionName : pando_mem_free
+ * Description  : free memory allocated by pando_mem_malloc.
+ * Parameters   : ptr: the memory, NULL is ignored.
+ * Returns      : none.
+*******************************************************************************/
+void FUNCTION_ATTRIBUTE
+pando_mem_free(void *ptr)
+{
+    struct mem_block_head *head = NULL;
+
+    if(ptr == NULL)
+    {
+        return;
+    }
+
+    head = (struct mem_block_head *)ptr - 1;
+    stat_uncharge(&s_mem_stat[head->module], head->size);
+    stat_uncharge(&s_mem_total, head->size);
+    pd_raw_free(head);
+}
+
+/******************************************************************************
+ * FunctionName : pando_mem_mark
+ * Description  : record the fill level of a fixed buffer, keeps the high water mark.
+ * Parameters   : buf_id: the PD_BUF_ID of the buffer.
+ *                used: bytes currently used in the buffer.
+ * Returns      : none.
+*******************************************************************************/
+void FUNCTION_ATTRIBUTE
+pando_mem_mark(uint8_t buf_id, uint32_t used)
+{
+    if(buf_id < PD_BUF_NUM && used > s_buf_watermark[buf_id])
+    {
+        s_buf_watermark[buf_id] = used;
+    }
+}
+
+/******************************************************************************
+ * FunctionName : pando_mem_get_stat
+ * Description  : get the counters of a module.
+ * Parameters   : module: the PD_MEM_MODULE to query, PD_MEM_MODULE_NUM for the total.
+ *                stat: filled with the counters.
+ * Returns      : 0 if success, -1 if the module is invalid.
+*******************************************************************************/
+int FUNCTION_ATTRIBUTE
+pando_mem_get_stat(uint8_t module, struct pando_mem_stat *stat)
+{
+    if(stat == NULL || module > PD_MEM_MODULE_NUM)
+    {
+        return -1;
+    }
+
+    if(module == PD_MEM_MODULE_NUM)
+    {
+        pd_memcpy(stat, &s_mem_total, sizeof(struct pando_mem_stat));
+    }
+    else
+    {
+        pd_memcpy(stat, &s_mem_stat[module], sizeof(struct pando_mem_stat));
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+ * FunctionName : pando_mem_get_watermark
+ * Description  : get the high water mark of a fixed buffer.
+ * Parameters   : buf_id: the PD_BUF_ID of the buffer.
+ * Returns      : the most bytes ever used in the buffer.
+*******************************************************************************/
+uint32_t FUNCTION_ATTRIBUTE
+pando_mem_get_watermark(uint8_t buf_id)
+{
+    if(buf_id >= PD_BUF_NUM)
+    {
+        return 0;
+    }
+
+    return s_buf_watermark[buf_id];
+}
+
+/******************************************************************************
+ * FunctionName : pando_mem_reset_peak
+ * Description  : restart peak and watermark tracking from the current usage.
+ * Parameters   : none.
+ * Returns      : none.
+*******************************************************************************/
+void FUNCTION_ATTRIBUTE
+pando_mem_reset_peak(void)
+{
+    uint8_t i = 0;
+
+    for(i = 0; i < PD_MEM_MODULE_NUM; i++)
+    {
+        s_mem_stat[i].peak_bytes = s_mem_stat[i].cur_bytes;
+    }
+
+    s_mem_total.peak_bytes = s_mem_total.cur_bytes;
+    pd_memset(s_buf_watermark, 0, sizeof(s_buf_watermark));
+}
+
+/******************************************************************************
+ * FunctionName : pando_mem_stat_print
+ * Description  : print all counters, the largest free block and the watermarks.
+ * Parameters   : none.
+ * Returns      : none.
+*******************************************************************************/
+void FUNCTION_ATTRIBUTE
+pando_mem_stat_print(void)
+{
+    uint8_t i = 0;
+
+    pd_printf("heap: module cur/peak bytes, alloc/free/fail\n");
+    for(i = 0; i < PD_MEM_MODULE_NUM; i++)
+    {
+        pd_printf("  %s: %d/%d, %d/%d/%d\n", s_module_name[i],
+            s_mem_stat[i].cur_bytes, s_mem_stat[i].peak_bytes,
+            s_mem_stat[i].alloc_count, s_mem_stat[i].free_count, s_mem_stat[i].fail_count);
+    }
+
+    pd_printf("  total: %d/%d, %d/%d/%d\n",
+        s_mem_total.cur_bytes, s_mem_total.peak_bytes,
+        s_mem_total.alloc_count, s_mem_total.free_count, s_mem_total.fail_count);
+    pd_printf("  largest free block (upper bound): %d\n", get_largest_free_block());
+
+    for(i = 0; i < PD_BUF_NUM; i++)
+    {
+        pd_printf("  %s watermark: %d\n", s_buf_name[i], s_buf_watermark[i]);
+    }
+}
+
+#endif /* PANDO_MEM_STAT */
@@ -0,0 +1,587 @@
+/*******************************************************
+ * File name: pando_tlv_json.c
+ * Author:
+ * Versions: 1.0
+ * Description: render a sub device frame as json for local diagnostics.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#include "pando_tlv_json.h"
+#include "../platform/include/pando_sys.h"
+#include "../protocol/sub_device_protocol.h"
+
+// output cursor, pos keeps counting past size to report the needed length.
+struct tlv_json_out
+{
+    char *data;
+    int size;
+    int pos;
+};
+
+// read cursor over the payload.
+struct tlv_json_in
+{
+    const uint8_t *pos;
+    const uint8_t *end;
+    uint8_t compact;            // the frame has compact TLV headers
+};
+
+static const char s_hex[] = "0123456789abcdef";
+static const char s_base64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static void FUNCTION_ATTRIBUTE
+out_char(struct tlv_json_out *out, char c)
+{
+    if(out->pos < out->size)
+    {
+        out->data[out->pos] = c;
+    }
+
+    out->pos++;
+}
+
+static void FUNCTION_ATTRIBUTE
+out_span(struct tlv_json_out *out, const char *text, int len)
+{
+    int room = out->size - out->pos;
+
+    if(room > 0)
+    {
+        pd_memcpy(out->data + out->pos, text, len < room? len: room);
+    }
+
+    out->pos += len;
+}
+
+static void FUNCTION_ATTRIBUTE
+out_text(struct tlv_json_out *out, const char *text)
+{
+    out_span(out, text, pd_strlen(text));
+}
+
+static void FUNCTION_ATTRIBUTE
+out_uint(struct tlv_json_out *out, uint64_t value)
+{
+    char buf[20];
+    int l = sizeof(buf);
+
+    do
+    {
+        buf[--l] = '0' + (value % 10);
+        value /= 10;
+    } while(value > 0);
+
+    out_span(out, buf + l, sizeof(buf) - l);
+}
+
+static void FUNCTION_ATTRIBUTE
+out_int(struct tlv_json_out *out, int64_t value)
+{
+    if(value < 0)
+    {
+        out_char(out, '-');
+        out_uint(out, 0 - (uint64_t)value);
+        return;
+    }
+
+    out_uint(out, value);
+}
+
+// fixed point with up to 6 decimals, exponent form for very large or small
+// magnitudes. the platform printf may have no %f, so this is done by hand.
+static void FUNCTION_ATTRIBUTE
+out_double(struct tlv_json_out *out, double value)
+{
+    uint64_t integer;
+    uint32_t fraction;
+    int exponent = 0;
+    char digits[6];
+    int i;
+
+    // nan and infinity have no json form.
+    if(value - value != 0)
+    {
+        out_span(out, "null", 4);
+        return;
+    }
+
+    if(value < 0)
+    {
+        out_char(out, '-');
+        value = -value;
+    }
+
+    if(value != 0 && (value >= 1e15 || value < 1e-4))
+    {
+        while(value >= 10)
+        {
+            value /= 10;
+            exponent++;
+        }
+
+        while(value < 1)
+        {
+            value *= 10;
+            exponent--;
+        }
+    }
+
+    integer = (uint64_t)value;
+    fraction = (uint32_t)((value - integer) * 1000000 + 0.5);
+    if(fraction >= 1000000)
+    {
+        integer++;
+        fraction -= 1000000;
+    }
+
+    out_uint(out, integer);
+    if(fraction != 0)
+    {
+        for(i = sizeof(digits) - 1; i >= 0; i--)
+        {
+            digits[i] = '0' + fraction % 10;
+            fraction /= 10;
+        }
+
+        for(i = sizeof(digits); digits[i - 1] == '0'; i--);
+        out_char(out, '.');
+        out_span(out, digits, i);
+    }
+
+    if(exponent != 0)
+    {
+        out_char(out, 'e');
+        out_int(out, exponent);
+    }
+}
+
+static void FUNCTION_ATTRIBUTE
+out_string(struct tlv_json_out *out, const uint8_t *text, uint16_t len)
+{
+    const uint8_t *start = text;
+    const uint8_t *end = text + len;
+    char escape[6] = {'\\', 'u', '0', '0', 0, 0};
+
+    out_char(out, '"');
+    for(; text < end; text++)
+    {
+        if(*text >= 0x20 && *text != '"' && *text != '\\')
+        {
+            continue;
+        }
+
+        out_span(out, (const char *)start, text - start);
+        if(*text < 0x20)
+        {
+            escape[4] = s_hex[*text >> 4];
+            escape[5] = s_hex[*text & 0x0f];
+            out_span(out, escape, sizeof(escape));
+        }
+        else
+        {
+            out_char(out, '\\');
+            out_char(out, *text);
+        }
+
+        start = text + 1;
+    }
+
+    out_span(out, (const char *)start, end - start);
+    out_char(out, '"');
+}
+
+static void FUNCTION_ATTRIBUTE
+out_bytes(struct tlv_json_out *out, const uint8_t *bytes, uint16_t len, uint8_t flags)
+{
+    char quad[4];
+    uint32_t group;
+    uint16_t i;
+
+    out_char(out, '"');
+    if((flags & PANDO_TLV_JSON_BASE64) == 0)
+    {
+        for(i = 0; i < len; i++)
+        {
+            out_char(out, s_hex[bytes[i] >> 4]);
+            out_char(out, s_hex[bytes[i] & 0x0f]);
+        }
+    }
+    else
+    {
+        for(i = 0; i < len; i += 3)
+        {
+            group = bytes[i] << 16;
+            group |= (i + 1 < len)? bytes[i + 1] << 8: 0;
+            group |= (i + 2 < len)? bytes[i + 2]: 0;
+            quad[0] = s_base64[(group >> 18) & 0x3f];
+            quad[1] = s_base64[(group >> 12) & 0x3f];
+            quad[2] = (i + 1 < len)? s_base64[(group >> 6) & 0x3f]: '=';
+            quad[3] = (i + 2 < len)? s_base64[group & 0x3f]: '=';
+            out_span(out, quad, sizeof(quad));
+        }
+    }
+
+    out_char(out, '"');
+}
+
+static void FUNCTION_ATTRIBUTE
+out_key(struct tlv_json_out *out, const char *key)
+{
+    out_char(out, '"');
+    out_text(out, key);
+    out_span(out, "\":", 2);
+}
+
+static void FUNCTION_ATTRIBUTE
+out_pair_uint(struct tlv_json_out *out, const char *key, uint64_t value)
+{
+    out_char(out, ',');
+    out_key(out, key);
+    out_uint(out, value);
+}
+
+// wire values are big endian and may be unaligned.
+static uint64_t FUNCTION_ATTRIBUTE
+read_be(const uint8_t *bytes, uint8_t len)
+{
+    uint64_t value = 0;
+
+    while(len-- > 0)
+    {
+        value = (value << 8) | *bytes++;
+    }
+
+    return value;
+}
+
+static int FUNCTION_ATTRIBUTE
+read_u16(struct tlv_json_in *in, uint16_t *value)
+{
+    if(in->end - in->pos < 2)
+    {
+        return -1;
+    }
+
+    *value = read_be(in->pos, 2);
+    in->pos += 2;
+    return 0;
+}
+
+// a TLV_TYPE_DELTA series as an array of its values.
+static int FUNCTION_ATTRIBUTE
+out_delta(struct tlv_json_out *out, const uint8_t *bytes, uint16_t len)
+{
+    int64_t value = 0;
+    int64_t delta = 0;
+    uint8_t used = 0;
+    const uint8_t *end = bytes + len;
+
+    out_char(out, '[');
+    while(bytes < end)
+    {
+        used = decode_varint(bytes, end - bytes, &delta);
+        if(used == 0)
+        {
+            return -1;
+        }
+
+        if(bytes != end - len)
+        {
+            out_char(out, ',');
+        }
+
+        value += delta;
+        out_int(out, value);
+        bytes += used;
+    }
+
+    out_char(out, ']');
+    return 0;
+}
+
+// one tlv value, -1 if it is truncated or of an unknown type.
+static int FUNCTION_ATTRIBUTE
+out_tlv(struct tlv_json_out *out, struct tlv_json_in *in, uint8_t flags)
+{
+    uint16_t type = 0;
+    uint16_t len = 0;
+    uint8_t header = 0;
+    uint64_t raw = 0;
+    int64_t varint = 0;
+    float f32;
+    double f64;
+    uint32_t u32;
+
+    header = get_tlv_header(in->pos, in->end - in->pos, in->compact, &type, &len);
+    if(header == 0)
+    {
+        return -1;
+    }
+
+    in->pos += header;
+    if(type == TLV_TYPE_VARINT)
+    {
+        decode_varint(in->pos, len, &varint);
+    }
+
+    if(in->end - in->pos < len)
+    {
+        return -1;
+    }
+
+    if(len <= 8)
+    {
+        raw = read_be(in->pos, len);
+    }
+
+    switch(type)
+    {
+        case TLV_TYPE_BYTES:
+            out_bytes(out, in->pos, len, flags);
+            break;
+        case TLV_TYPE_URI:
+            out_string(out, in->pos, len);
+            break;
+        case TLV_TYPE_VARINT:
+            out_int(out, varint);
+            break;
+        case TLV_TYPE_DELTA:
+            if(out_delta(out, in->pos, len) != 0)
+            {
+                return -1;
+            }
+            break;
+        case TLV_TYPE_BOOL:
+            out_text(out, raw? "true": "false");
+            break;
+        case TLV_TYPE_INT8:
+            out_int(out, (int8_t)raw);
+            break;
+        case TLV_TYPE_INT16:
+            out_int(out, (int16_t)raw);
+            break;
+        case TLV_TYPE_INT32:
+            out_int(out, (int32_t)raw);
+            break;
+        case TLV_TYPE_INT64:
+            out_int(out, (int64_t)raw);
+            break;
+        case TLV_TYPE_FLOAT32:
+            u32 = raw;
+            pd_memcpy(&f32, &u32, sizeof(f32));
+            out_double(out, f32);
+            break;
+        case TLV_TYPE_FLOAT64:
+            pd_memcpy(&f64, &raw, sizeof(f64));
+            out_double(out, f64);
+            break;
+        default:
+            out_uint(out, raw);
+            break;
+    }
+
+    in->pos += len;
+    return 0;
+}
+
+static const struct pando_tlv_json_name * FUNCTION_ATTRIBUTE
+find_name(const struct pando_tlv_json_name *names, uint8_t name_count,
+    uint16_t payload_type, uint16_t no)
+{
+    uint8_t i;
+
+    for(i = 0; names != NULL && i < name_count; i++)
+    {
+        if(names[i].payload_type == payload_type && names[i].no == no)
+        {
+            return &names[i];
+        }
+    }
+
+    return NULL;
+}
+
+// the optional name and the params block that follows a property, command
+// or event header.
+static int FUNCTION_ATTRIBUTE
+out_params(struct tlv_json_out *out, struct tlv_json_in *in,
+    const struct pando_tlv_json_name *name, uint8_t flags)
+{
+    uint16_t count = 0;
+    uint16_t i;
+
+    if(read_u16(in, &count) != 0)
+    {
+        return -1;
+    }
+
+    if(name != NULL)
+    {
+        out_char(out, ',');
+        out_key(out, "name");
+        out_string(out, (const uint8_t *)name->name, pd_strlen(name->name));
+    }
+
+    out_char(out, ',');
+    out_key(out, "params");
+    out_char(out, (name != NULL && name->fields != NULL)? '{': '[');
+    for(i = 0; i < count; i++)
+    {
+        if(i > 0)
+        {
+            out_char(out, ',');
+        }
+
+        if(name != NULL && name->fields != NULL)
+        {
+            if(i < name->field_count)
+            {
+                out_key(out, name->fields[i]);
+            }
+            else
+            {
+                out_span(out, "\"_", 2);
+                out_uint(out, i);
+                out_span(out, "\":", 2);
+            }
+        }
+
+        if(out_tlv(out, in, flags) != 0)
+        {
+            return -1;
+        }
+    }
+
+    out_char(out, (name != NULL && name->fields != NULL)? '}': ']');
+    return 0;
+}
+
+static int FUNCTION_ATTRIBUTE
+out_frame(struct tlv_json_out *out, const uint8_t *frame, uint16_t length,
+    const struct pando_tlv_json_name *names, uint8_t name_count, uint8_t flags)
+{
+    struct tlv_json_in in;
+    uint16_t payload_type;
+    uint16_t payload_len;
+    uint16_t sub_device_id = 0;
+    uint16_t no = 0;
+    uint16_t priority = 0;
+    const char *kind;
+
+    if(frame == NULL || length < DEV_HEADER_LEN || frame[0] != MAGIC_HEAD_SUB_DEVICE)
+    {
+        return -1;
+    }
+
+    payload_type = read_be(frame + 2, 2);
+    payload_len = read_be(frame + 4, 2);
+    if(payload_len > length - DEV_HEADER_LEN)
+    {
+        return -1;
+    }
+
+    in.pos = frame + DEV_HEADER_LEN;
+    in.end = in.pos + payload_len;
+    in.compact = (read_be(frame + 6, 2) & PANDO_FLAG_COMPACT) != 0;
+
+    switch(payload_type)
+    {
+        case PAYLOAD_TYPE_DATA:
+            kind = "data";
+            break;
+        case PAYLOAD_TYPE_COMMAND:
+            kind = "command";
+            break;
+        case PAYLOAD_TYPE_EVENT:
+            kind = "event";
+            break;
+        default:
+            return -1;
+    }
+
+    out_char(out, '{');
+    out_key(out, "type");
+    out_string(out, (const uint8_t *)kind, pd_strlen(kind));
+    out_pair_uint(out, "seq", read_be(frame + 8, 4));
+
+    if(payload_type != PAYLOAD_TYPE_DATA)
+    {
+        if(read_u16(&in, &sub_device_id) != 0 || read_u16(&in, &no) != 0
+            || read_u16(&in, &priority) != 0)
+        {
+            return -1;
+        }
+
+        out_pair_uint(out, "sub_device", sub_device_id);
+        out_pair_uint(out, "no", no);
+        out_pair_uint(out, "priority", priority);
+        if(out_params(out, &in, find_name(names, name_count, payload_type, no), flags) != 0)
+        {
+            return -1;
+        }
+
+        out_char(out, '}');
+        return 0;
+    }
+
+    out_char(out, ',');
+    out_key(out, "properties");
+    out_char(out, '[');
+    while(in.pos < in.end)
+    {
+        if(read_u16(&in, &sub_device_id) != 0 || read_u16(&in, &no) != 0)
+        {
+            return -1;
+        }
+
+        if(in.pos > frame + DEV_HEADER_LEN + 4)
+        {
+            out_char(out, ',');
+        }
+
+        out_char(out, '{');
+        out_key(out, "sub_device");
+        out_uint(out, sub_device_id);
+        out_pair_uint(out, "no", no);
+        if(out_params(out, &in, find_name(names, name_count, payload_type, no), flags) != 0)
+        {
+            return -1;
+        }
+
+        out_char(out, '}');
+    }
+
+    out_span(out, "]}", 2);
+    return 0;
+}
+
+int FUNCTION_ATTRIBUTE
+pando_tlv_json(const uint8_t *frame, uint16_t length,
+    const struct pando_tlv_json_name *names, uint8_t name_count, uint8_t flags,
+    char *dst, int size)
+{
+    struct tlv_json_out out;
+
+    if(dst == NULL || size <= 0)
+    {
+        return -1;
+    }
+
+    // keep the last byte for the terminator.
+    out.data = dst;
+    out.size = size - 1;
+    out.pos = 0;
+
+    if(out_frame(&out, frame, length, names, name_count, flags) != 0)
+    {
+        dst[0] = 0;
+        return -1;
+    }
+
+    dst[out.pos < out.size? out.pos: out.size] = 0;
+    return out.pos;
+}
@@ -0,0 +1,59 @@
+/*******************************************************
+ * File name: pando_tlv_json.h
+ * Author:
+ * Versions: 1.0
+ * Description: render a sub device frame as json for local diagnostics.
+ *              the frame is read in place and the json is written straight
+ *              into the caller's buffer, nothing is allocated.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#ifndef __PANDO_TLV_JSON_H
+#define __PANDO_TLV_JSON_H
+
+#include "../platform/include/pando_types.h"
+
+// flags of pando_tlv_json.
+#define PANDO_TLV_JSON_BASE64   BIT(0)  // bytes as base64 instead of hex
+
+// optional name of a property, command or event. with fields the params are
+// printed as an object with these keys instead of an array, params past
+// field_count fall back to "_<index>".
+struct pando_tlv_json_name
+{
+    uint16_t payload_type;          // PAYLOAD_TYPE_DATA, _COMMAND or _EVENT
+    uint16_t no;                    // property, command or event number
+    const char *name;
+    const char * const *fields;     // may be NULL
+    uint8_t field_count;
+};
+
+ /******************************************************************************
+ * FunctionName : pando_tlv_json
+ * Description  : print a sub device frame (device_header and its properties,
+ *                command or event) as json.
+ *                data: {"type":"data","seq":1,"properties":[{"sub_device":0,
+ *                "no":1,"name":"led","params":[1,25.5,"0a0b"]}]}
+ *                command and event: {"type":"command","seq":1,"sub_device":0,
+ *                "no":1,"priority":0,"name":"led","params":[1]}
+ *                "name" is only there if names has an entry for the number.
+ * Parameters   : frame: the frame, starting with the device header.
+ *                length: bytes in frame.
+ *                names: the name table, may be NULL.
+ *                name_count: entries in names.
+ *                flags: PANDO_TLV_JSON_*.
+ *                dst: the string buffer to print to.
+ *                size: the length of dst.
+ * Returns      : the length of the whole json text, -1 if the frame is
+ *                malformed. if it is size or more the output was truncated to
+ *                size - 1 characters, dst is always terminated.
+*******************************************************************************/
+
+int pando_tlv_json(const uint8_t *frame, uint16_t length,
+    const struct pando_tlv_json_name *names, uint8_t name_count, uint8_t flags,
+    char *dst, int size);
+
+#endif
@@ -0,0 +1,99 @@
+/*******************************************************
+ * File name: pando_trace.c
+ * Author:
+ * Versions: 1.0
+ * Description: trace event ring, compiled only with PANDO_TRACE.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#include "../platform/include/pando_sys.h"
+#include "../platform/include/pando_trace.h"
+#include "../platform/include/platform_miscellaneous_interface.h"
+
+#ifdef PANDO_TRACE
+
+static struct pando_trace_record s_trace_ring[PANDO_TRACE_RING_SIZE];
+static uint16_t s_trace_head = 0;   // next record to write.
+static uint16_t s_trace_count = 0;  // records in the ring.
+static uint32_t s_trace_lost = 0;   // records overwritten before being read.
+
+/******************************************************************************
+ * FunctionName : pando_trace_record
+ * Description  : append a trace event to the ring.
+ * Parameters   : id: the PD_TRACE_ID of the stage.
+ *                event: PD_TRACE_EVENT_BEGIN or PD_TRACE_EVENT_END.
+ *                arg: stage specific value.
+ * Returns      : none.
+*******************************************************************************/
+// no FUNCTION_ATTRIBUTE, keep the hot path out of flash cache misses.
+void
+pando_trace_record(uint8_t id, uint8_t event, uint16_t arg)
+{
+    struct pando_trace_record *record = &s_trace_ring[s_trace_head];
+
+    record->cycles = get_cycle_count();
+    record->id = id;
+    record->event = event;
+    record->arg = arg;
+
+    s_trace_head = (s_trace_head + 1) % PANDO_TRACE_RING_SIZE;
+    if(s_trace_count < PANDO_TRACE_RING_SIZE)
+    {
+        s_trace_count++;
+    }
+    else
+    {
+        s_trace_lost++;
+    }
+}
+
+/******************************************************************************
+ * FunctionName : pando_trace_read
+ * Description  : move the oldest records out of the ring.
+ * Parameters   : dst: buffer for the records.
+ *                max_count: size of dst in records.
+ * Returns      : the number of records written to dst.
+*******************************************************************************/
+uint16_t FUNCTION_ATTRIBUTE
+pando_trace_read(struct pando_trace_record *dst, uint16_t max_count)
+{
+    uint16_t count = 0;
+    uint16_t tail = 0;
+
+    while(count < max_count && s_trace_count > 0)
+    {
+        tail = (s_trace_head + PANDO_TRACE_RING_SIZE - s_trace_count) % PANDO_TRACE_RING_SIZE;
+        pd_memcpy(&dst[count++], &s_trace_ring[tail], sizeof(struct pando_trace_record));
+        s_trace_count--;
+    }
+
+    return count;
+}
+
+/******************************************************************************
+ * FunctionName : pando_trace_dump
+ * Description  : print and drain the ring in the text format read by tools/trace_hist.
+ *                "PDTRACE BEGIN <cycles per second> <lost records>", one
+ *                "<id> <event> <cycles> <arg>" line per record, "PDTRACE END".
+ * Parameters   : none.
+ * Returns      : none.
+*******************************************************************************/
+void FUNCTION_ATTRIBUTE
+pando_trace_dump(void)
+{
+    struct pando_trace_record record;
+
+    pd_printf("PDTRACE BEGIN %u %u\n", get_cycle_freq(), s_trace_lost);
+    while(pando_trace_read(&record, 1) == 1)
+    {
+        pd_printf("%u %u %u %u\n", record.id, record.event, record.cycles, record.arg);
+    }
+    pd_printf("PDTRACE END\n");
+
+    s_trace_lost = 0;
+}
+
+#endif /* PANDO_TRACE */
@@ -1,4 +1,5 @@
 #include "gateway/pando_channel.h"
+#include "gateway/pando_route.h"
 #include "subdevice/pando_subdevice.h"
 #include "pando_framework.h"
 #include "gateway/pando_gateway.h"
@@ -8,5 +9,6 @@ pando_framework_init()
 {
     pando_gateway_init();
 
+    pando_route_add(1, PANDO_CHANNEL_PORT_1);
     on_subdevice_channel_recv(PANDO_CHANNEL_PORT_1, pando_subdevice_recv);
 }
@@ -0,0 +1,127 @@
+/*********************************************************
+ * File name: pando_log.h
+ * Author:
+ * Versions: 1.0
+ * Description: leveled log macros.
+ *              PANDO_LOG_LEVEL sets the global level, PANDO_LOG_LEVEL_<MODULE>
+ *              overrides it for one module, and a source file selects its
+ *              module level by defining PANDO_LOG_MODULE_LEVEL before its first
+ *              include. messages above the level are constant folded away,
+ *              with PD_LOG_LEVEL_NONE no log code is emitted at all.
+ *              define PANDO_LOG_BINARY to store the format string address and
+ *              raw arguments in a ring instead of printing, the host decodes
+ *              the ring with the firmware map file.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#ifndef _PANDO_LOG_H_
+#define _PANDO_LOG_H_
+
+#include "pando_types.h"
+#include "pando_sys.h"
+
+#define PD_LOG_LEVEL_NONE       0
+#define PD_LOG_LEVEL_ERROR      1
+#define PD_LOG_LEVEL_WARN       2
+#define PD_LOG_LEVEL_INFO       3
+#define PD_LOG_LEVEL_DEBUG      4
+
+#ifndef PANDO_LOG_LEVEL
+#define PANDO_LOG_LEVEL         PD_LOG_LEVEL_INFO
+#endif
+
+// module levels, default to the global level.
+#ifndef PANDO_LOG_LEVEL_PROTOCOL
+#define PANDO_LOG_LEVEL_PROTOCOL    PANDO_LOG_LEVEL
+#endif
+#ifndef PANDO_LOG_LEVEL_MQTT
+#define PANDO_LOG_LEVEL_MQTT        PANDO_LOG_LEVEL
+#endif
+#ifndef PANDO_LOG_LEVEL_GATEWAY
+#define PANDO_LOG_LEVEL_GATEWAY     PANDO_LOG_LEVEL
+#endif
+#ifndef PANDO_LOG_LEVEL_SUBDEVICE
+#define PANDO_LOG_LEVEL_SUBDEVICE   PANDO_LOG_LEVEL
+#endif
+#ifndef PANDO_LOG_LEVEL_PLATFORM
+#define PANDO_LOG_LEVEL_PLATFORM    PANDO_LOG_LEVEL
+#endif
+
+#ifndef PANDO_LOG_MODULE_LEVEL
+#define PANDO_LOG_MODULE_LEVEL  PANDO_LOG_LEVEL
+#endif
+
+// size of the binary log ring in 32 bit words.
+#ifndef PANDO_LOG_RING_WORDS
+#define PANDO_LOG_RING_WORDS    256
+#endif
+
+// arguments kept per binary record, extra arguments are dropped.
+#define PD_LOG_MAX_ARGS         6
+
+#if PANDO_LOG_LEVEL == PD_LOG_LEVEL_NONE
+
+#define pd_log(level, ...)
+#define pd_log_hex(level, buffer, length)
+
+#elif defined(PANDO_LOG_BINARY)
+
+#define pd_log(level, ...) \
+    do { if((level) <= PANDO_LOG_MODULE_LEVEL) pd_log_bin_write((level), __VA_ARGS__); } while(0)
+#define pd_log_hex(level, buffer, length)
+
+#else
+
+#define pd_log(level, ...) \
+    do { if((level) <= PANDO_LOG_MODULE_LEVEL) pd_printf(__VA_ARGS__); } while(0)
+#define pd_log_hex(level, buffer, length) \
+    do { if((level) <= PANDO_LOG_MODULE_LEVEL) show_package((uint8_t *)(buffer), (length)); } while(0)
+
+#endif
+
+#define PD_LOGE(...)    pd_log(PD_LOG_LEVEL_ERROR, __VA_ARGS__)
+#define PD_LOGW(...)    pd_log(PD_LOG_LEVEL_WARN, __VA_ARGS__)
+#define PD_LOGI(...)    pd_log(PD_LOG_LEVEL_INFO, __VA_ARGS__)
+#define PD_LOGD(...)    pd_log(PD_LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define PD_LOG_HEX(buffer, length)  pd_log_hex(PD_LOG_LEVEL_DEBUG, (buffer), (length))
+
+void show_package(uint8_t *buffer, uint16_t length);
+
+#ifdef PANDO_LOG_BINARY
+
+/******************************************************************************
+ * FunctionName : pd_log_bin_write
+ * Description  : append a record to the binary log ring, the oldest records are
+ *                overwritten when the ring is full. every conversion in fmt
+ *                takes one 32 bit argument, strings are kept as their address.
+ * Parameters   : level: the log level.
+ *                fmt: the format string, its address identifies the message.
+ * Returns      : none.
+*******************************************************************************/
+void pd_log_bin_write(uint8_t level, const char *fmt, ...);
+
+/******************************************************************************
+ * FunctionName : pd_log_bin_read
+ * Description  : move whole records out of the binary log ring.
+ *                a record is a header word (level << 24 | args << 16 | sequence)
+ *                followed by the format address and the arguments.
+ * Parameters   : dst: buffer for the records.
+ *                max_words: size of dst in 32 bit words.
+ * Returns      : the number of words written to dst.
+*******************************************************************************/
+uint16_t pd_log_bin_read(uint32_t *dst, uint16_t max_words);
+
+/******************************************************************************
+ * FunctionName : pd_log_bin_dump
+ * Description  : print and drain the binary log ring as hex words.
+ * Parameters   : none.
+ * Returns      : none.
+*******************************************************************************/
+void pd_log_bin_dump(void);
+
+#endif /* PANDO_LOG_BINARY */
+
+#endif /* _PANDO_LOG_H_ */
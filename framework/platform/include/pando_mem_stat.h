@@ -0,0 +1,125 @@
+/*********************************************************
+ * File name: pando_mem_stat.h
+ * Author:
+ * Versions: 1.0
+ * Description: optional heap and buffer usage instrumentation.
+ *              define PANDO_MEM_STAT in the build to route pd_malloc/pd_free
+ *              through the counters below, every allocation is charged to
+ *              the module given by PANDO_MEM_MODULE in the calling file.
+ *              when PANDO_MEM_STAT is not defined nothing here costs code
+ *              or ram.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#ifndef _PANDO_MEM_STAT_H_
+#define _PANDO_MEM_STAT_H_
+
+#include "pando_types.h"
+
+// the module an allocation is charged to.
+typedef enum {
+    PD_MEM_OTHER = 0,
+    PD_MEM_PROTOCOL,
+    PD_MEM_MQTT,
+    PD_MEM_GATEWAY,
+    PD_MEM_JSON,
+    PD_MEM_STORAGE,
+    PD_MEM_SUBDEVICE,
+    PD_MEM_MODULE_NUM
+} PD_MEM_MODULE;
+
+// fixed buffers whose fill level is worth sizing from data.
+typedef enum {
+    PD_BUF_MQTT_IN = 0,     // mqtt in_buffer, MQTT_BUF_SIZE.
+    PD_BUF_MQTT_QUEUE,      // mqtt outbound lanes, MQTT_LANE_*_SIZE.
+    PD_BUF_HTTP_RESPONSE,   // http response buffer, BUFFER_SIZE_MAX.
+    PD_BUF_NUM
+} PD_BUF_ID;
+
+// a source file sets this before its first include to choose its module.
+#ifndef PANDO_MEM_MODULE
+#define PANDO_MEM_MODULE PD_MEM_OTHER
+#endif
+
+struct pando_mem_stat
+{
+    uint32_t cur_bytes;     // bytes currently allocated.
+    uint32_t peak_bytes;    // highest cur_bytes seen.
+    uint32_t alloc_count;   // successful allocations.
+    uint32_t free_count;    // frees.
+    uint32_t fail_count;    // allocations the heap refused.
+};
+
+#ifdef PANDO_MEM_STAT
+
+#define PD_MEM_MARK(buf_id, used)   pando_mem_mark((buf_id), (used))
+
+/******************************************************************************
+ * FunctionName : pando_mem_malloc
+ * Description  : allocate memory and charge it to a module.
+ * Parameters   : size: bytes to allocate.
+ *                module: the PD_MEM_MODULE charged for the allocation.
+ * Returns      : the memory, or NULL if the heap is exhausted.
+*******************************************************************************/
+void *pando_mem_malloc(uint32_t size, uint8_t module);
+
+/******************************************************************************
+ * FunctionName : pando_mem_free
+ * Description  : free memory allocated by pando_mem_malloc.
+ * Parameters   : ptr: the memory, NULL is ignored.
+ * Returns      : none.
+*******************************************************************************/
+void pando_mem_free(void *ptr);
+
+/******************************************************************************
+ * FunctionName : pando_mem_mark
+ * Description  : record the fill level of a fixed buffer, keeps the high water mark.
+ * Parameters   : buf_id: the PD_BUF_ID of the buffer.
+ *                used: bytes currently used in the buffer.
+ * Returns      : none.
+*******************************************************************************/
+void pando_mem_mark(uint8_t buf_id, uint32_t used);
+
+/******************************************************************************
+ * FunctionName : pando_mem_get_stat
+ * Description  : get the counters of a module.
+ * Parameters   : module: the PD_MEM_MODULE to query, PD_MEM_MODULE_NUM for the total.
+ *                stat: filled with the counters.
+ * Returns      : 0 if success, -1 if the module is invalid.
+*******************************************************************************/
+int pando_mem_get_stat(uint8_t module, struct pando_mem_stat *stat);
+
+/******************************************************************************
+ * FunctionName : pando_mem_get_watermark
+ * Description  : get the high water mark of a fixed buffer.
+ * Parameters   : buf_id: the PD_BUF_ID of the buffer.
+ * Returns      : the most bytes ever used in the buffer.
+*******************************************************************************/
+uint32_t pando_mem_get_watermark(uint8_t buf_id);
+
+/******************************************************************************
+ * FunctionName : pando_mem_reset_peak
+ * Description  : restart peak and watermark tracking from the current usage.
+ * Parameters   : none.
+ * Returns      : none.
+*******************************************************************************/
+void pando_mem_reset_peak(void);
+
+/******************************************************************************
+ * FunctionName : pando_mem_stat_print
+ * Description  : print all counters, the largest free block and the watermarks.
+ * Parameters   : none.
+ * Returns      : none.
+*******************************************************************************/
+void pando_mem_stat_print(void);
+
+#else
+
+#define PD_MEM_MARK(buf_id, used)
+
+#endif /* PANDO_MEM_STAT */
+
+#endif /* _PANDO_MEM_STAT_H_ */
@@ -16,6 +16,10 @@
 
 #define BUFFER_SIZE_MAX  5000
 
+// connections kept at the same time, one per host:port. a connection is
+// closed once its queue of requests is empty.
+#define HTTP_POOL_SIZE  2
+
 typedef void (* http_callback)(char* response);
 
 /******************************************************************************
@@ -84,6 +84,16 @@ void net_tcp_register_sent_callback(struct pando_tcp_conn *conn, net_tcp_sent_ca
 *******************************************************************************/
 void net_tcp_register_recv_callback(struct pando_tcp_conn *conn, net_tcp_recv_callback recv_cb);
 
+/******************************************************************************
+ * FunctionName : net_tcp_recv_hold
+ * Description  : stop or resume passing received data to the recv callback, the
+ *                data waits in the platform and the peer is flow controlled.
+ *                a platform that cannot hold keeps passing the data.
+ * Parameters   : hold: 1 to stop, 0 to resume.
+ * Returns      : none
+*******************************************************************************/
+void net_tcp_recv_hold(struct pando_tcp_conn *conn, uint8_t hold);
+
 /******************************************************************************
  * FunctionName : net_tcp_disconnect
  * Description  : it is used to disconnect the connect.
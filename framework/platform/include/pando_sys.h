@@ -23,8 +23,8 @@
 #include "user_interface.h"
 #include "../../../../user/device_config.h"
 
-#define pd_malloc       os_malloc
-#define pd_free         os_free
+#define pd_raw_malloc   os_malloc
+#define pd_raw_free     os_free
 
 #define pd_memcpy       os_memcpy
 #define pd_memcmp       os_memcmp
@@ -45,8 +45,8 @@
 #include "string.h"
 #include "stdio.h"
 
-#define pd_malloc       mymalloc    //malloc
-#define pd_free         myfree      //free
+#define pd_raw_malloc   mymalloc    //malloc
+#define pd_raw_free     myfree      //free
 
 #define pd_memcpy       memcpy
 #define pd_memcmp      	memcmp
@@ -64,4 +64,14 @@
 
 #endif
 
+#include "pando_mem_stat.h"
+
+#ifdef PANDO_MEM_STAT
+#define pd_malloc(size) pando_mem_malloc((size), PANDO_MEM_MODULE)
+#define pd_free(ptr)    pando_mem_free(ptr)
+#else
+#define pd_malloc       pd_raw_malloc
+#define pd_free         pd_raw_free
+#endif
+
 #endif /* _PANDO_SYS_H_ */
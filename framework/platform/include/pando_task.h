@@ -0,0 +1,48 @@
+/*********************************************************
+ * File name: pando_task.h
+ * Author:
+ * Versions: 1.0
+ * Description: deferred calls, run from the platform's main loop after the
+ *              caller returned. a network or uart callback posts its slow
+ *              work this way instead of doing it in place.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#ifndef _PANDO_TASK_H_
+#define _PANDO_TASK_H_
+
+#include "pando_types.h"
+
+typedef void (*pd_task_cb)(void *arg);
+
+struct pd_task
+{
+    pd_task_cb task_cb;
+    void *arg;
+    // set while posted and not run yet, posts before the task runs are
+    // merged into one run.
+    volatile uint8_t pending;
+    // kept by the platform.
+    struct pd_task *next;
+};
+
+/******************************************************************************
+ * FunctionName : pando_task_init
+ * Description  : register a task with the platform, once.
+ * Parameters   : task: task_cb and arg set, must stay valid.
+ * Returns      : none
+*******************************************************************************/
+void pando_task_init(struct pd_task *task);
+
+/******************************************************************************
+ * FunctionName : pando_task_post
+ * Description  : have the task run from the main loop.
+ * Parameters   : task: a registered task.
+ * Returns      : none
+*******************************************************************************/
+void pando_task_post(struct pd_task *task);
+
+#endif /* _PANDO_TASK_H_ */
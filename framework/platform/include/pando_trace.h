@@ -0,0 +1,92 @@
+/*********************************************************
+ * File name: pando_trace.h
+ * Author:
+ * Versions: 1.0
+ * Description: latency trace points along the gateway pipeline.
+ *              define PANDO_TRACE in the build to record begin/end events with
+ *              the platform cycle counter into a fixed ring, pando_trace_dump()
+ *              prints the ring for tools/trace_hist on the host. without
+ *              PANDO_TRACE the trace points compile to nothing.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#ifndef _PANDO_TRACE_H_
+#define _PANDO_TRACE_H_
+
+#include "pando_types.h"
+
+// the traced stages, keep tools/trace_hist.c in step when adding one.
+typedef enum {
+    PD_TRACE_MQTT_RECV = 0,         // mqtt_tcpclient_recv
+    PD_TRACE_MQTT_DATA_CB,          // mqtt_data_cb
+    PD_TRACE_PROTOCOL_DECODE,       // pando_protocol_decode
+    PD_TRACE_CHANNEL_TO_SUBDEVICE,  // channel_send_to_subdevice
+    PD_TRACE_SUBDEVICE_RECV,        // pando_subdevice_recv
+    PD_TRACE_OBJECT_UNPACK,         // object unpack or command handler
+    PD_TRACE_CHANNEL_TO_DEVICE,     // channel_send_to_device
+    PD_TRACE_PUBLISH,               // pando_publish_data
+    PD_TRACE_PROTOCOL_ENCODE,       // pando_protocol_encode
+    PD_TRACE_MQTT_PUBLISH,          // MQTT_Publish
+    PD_TRACE_TCP_SEND,              // net_tcp_send from the mqtt task
+    PD_TRACE_ID_NUM
+} PD_TRACE_ID;
+
+#define PD_TRACE_EVENT_BEGIN    0
+#define PD_TRACE_EVENT_END      1
+
+// records kept in the ring, the oldest are overwritten.
+#ifndef PANDO_TRACE_RING_SIZE
+#define PANDO_TRACE_RING_SIZE   128
+#endif
+
+struct pando_trace_record
+{
+    uint32_t cycles;    // platform cycle counter.
+    uint8_t id;         // PD_TRACE_ID.
+    uint8_t event;      // PD_TRACE_EVENT_BEGIN or PD_TRACE_EVENT_END.
+    uint16_t arg;       // stage specific, usually a length.
+};
+
+#ifdef PANDO_TRACE
+
+#define PD_TRACE_BEGIN(id, arg) pando_trace_record((id), PD_TRACE_EVENT_BEGIN, (arg))
+#define PD_TRACE_END(id, arg)   pando_trace_record((id), PD_TRACE_EVENT_END, (arg))
+
+/******************************************************************************
+ * FunctionName : pando_trace_record
+ * Description  : append a trace event to the ring.
+ * Parameters   : id: the PD_TRACE_ID of the stage.
+ *                event: PD_TRACE_EVENT_BEGIN or PD_TRACE_EVENT_END.
+ *                arg: stage specific value.
+ * Returns      : none.
+*******************************************************************************/
+void pando_trace_record(uint8_t id, uint8_t event, uint16_t arg);
+
+/******************************************************************************
+ * FunctionName : pando_trace_read
+ * Description  : move the oldest records out of the ring.
+ * Parameters   : dst: buffer for the records.
+ *                max_count: size of dst in records.
+ * Returns      : the number of records written to dst.
+*******************************************************************************/
+uint16_t pando_trace_read(struct pando_trace_record *dst, uint16_t max_count);
+
+/******************************************************************************
+ * FunctionName : pando_trace_dump
+ * Description  : print and drain the ring in the text format read by tools/trace_hist.
+ * Parameters   : none.
+ * Returns      : none.
+*******************************************************************************/
+void pando_trace_dump(void);
+
+#else
+
+#define PD_TRACE_BEGIN(id, arg)
+#define PD_TRACE_END(id, arg)
+
+#endif /* PANDO_TRACE */
+
+#endif /* _PANDO_TRACE_H_ */
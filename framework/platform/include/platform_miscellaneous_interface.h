@@ -30,6 +30,31 @@ bool net_connect_check(void);
 *******************************************************************************/
 void get_device_serial(char* serial_buf);
 
+/******************************************************************************
+ * FunctionName : get_largest_free_block
+ * Description  : get the size of the largest block the heap can still hand out.
+ * Parameters   : none.
+ * Returns      : the size in bytes. ports whose heap cannot tell return the
+ *                total free heap instead, an upper bound.
+*******************************************************************************/
+uint32_t get_largest_free_block(void);
+
+/******************************************************************************
+ * FunctionName : get_cycle_count
+ * Description  : read the free running cpu cycle counter, it wraps at 32 bits.
+ * Parameters   : none.
+ * Returns      : the counter value.
+*******************************************************************************/
+uint32_t get_cycle_count(void);
+
+/******************************************************************************
+ * FunctionName : get_cycle_freq
+ * Description  : get the rate of the cycle counter.
+ * Parameters   : none.
+ * Returns      : cycles per second.
+*******************************************************************************/
+uint32_t get_cycle_freq(void);
+
 
 
 #endif
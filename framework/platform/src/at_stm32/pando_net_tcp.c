@@ -8,9 +8,12 @@
  *     Author:
  *     Modification:
  *********************************************************/
+#define PANDO_LOG_MODULE_LEVEL PANDO_LOG_LEVEL_PLATFORM
+
 #include "pando_net_tcp.h"
 #include "sim5360.h"
 #include "pando_sys.h"
+#include "pando_log.h"
 #include "../../protocol/common_functions.h"
 
 #define MAX_CONNECT_NUM 10
@@ -124,6 +127,18 @@ void net_tcp_connect(struct pando_tcp_conn *conn, uint16_t timeout)
 		}
 	}
 
+	if(i == MAX_CONNECT_NUM)
+	{
+		PD_LOGE("%s, no free connection\n", __func__);
+		if(conn->connected_callback != NULL)
+		{
+			conn->connected_callback(conn, -1);
+		}
+
+		return;
+	}
+
+	// the modem runs each connection on a link of its own.
 	module_tcp_connect(conn->fd, ip, port);
 	/*//AT+CIPSTART
 	char connect_buf[80];
@@ -159,9 +174,9 @@ void net_tcp_register_connected_callback(struct pando_tcp_conn *conn , net_tcp_c
 *******************************************************************************/
 void net_tcp_send(struct pando_tcp_conn *conn, struct data_buf buffer,  uint16_t timeout)
 {
-	pd_printf("%s,tcp send\n", __func__);
-	show_package(buffer.data, buffer.length);
-	module_send_data(0, buffer.data, buffer.length);
+	PD_LOGD("%s,tcp send\n", __func__);
+	PD_LOG_HEX(buffer.data, buffer.length);
+	module_send_data(conn->fd, buffer.data, buffer.length);
 }
 
 
@@ -174,7 +189,7 @@ void net_tcp_send(struct pando_tcp_conn *conn, struct data_buf buffer,  uint16_t
 void net_tcp_register_sent_callback(struct pando_tcp_conn *conn, net_tcp_sent_callback sent_cb)
 {
 	conn->sent_callback = sent_cb;
-	register_module_tcp_sent_callback(0, tcp_sent_callback);
+	register_module_tcp_sent_callback(conn->fd, tcp_sent_callback);
 }
 
 /******************************************************************************
@@ -186,7 +201,18 @@ void net_tcp_register_sent_callback(struct pando_tcp_conn *conn, net_tcp_sent_ca
 void net_tcp_register_recv_callback(struct pando_tcp_conn *conn, net_tcp_recv_callback recv_cb)
 {
 	conn->recv_callback = recv_cb;
-	register_module_tcp_recv_callback(0, tcp_recv_callback);
+	register_module_tcp_recv_callback(conn->fd, tcp_recv_callback);
+}
+
+/******************************************************************************
+ * FunctionName : net_tcp_recv_hold
+ * Description  : stop or resume passing received data to the recv callback.
+ * Parameters   : hold: 1 to stop, 0 to resume.
+ * Returns      : none
+*******************************************************************************/
+void net_tcp_recv_hold(struct pando_tcp_conn *conn, uint8_t hold)
+{
+	// the modem pushes received data over the uart unasked, it cannot be held.
 }
 
 /******************************************************************************
@@ -197,18 +223,11 @@ void net_tcp_register_recv_callback(struct pando_tcp_conn *conn, net_tcp_recv_ca
 *******************************************************************************/
 void net_tcp_disconnect(struct pando_tcp_conn *conn)
 {
-	int i= 0;
-	for( i = 0; i < MAX_CONNECT_NUM; i++)
+	if(conn->fd < MAX_CONNECT_NUM && conn_arry[conn->fd] == conn)
 	{
-		if(conn->fd == conn_arry[i]->fd)
-		{
-			conn_arry[i] = NULL;
-			break;
-		}
+		conn_arry[conn->fd] = NULL;
+		module_tcp_disconnect(conn->fd);
 	}
-
-	//clear_module();
-	//add_send_at_command("AT+CIPCLOSE", "AT+CIPCLOSE\r\n");
 }
 
 /******************************************************************************
@@ -221,7 +240,7 @@ void net_tcp_register_disconnected_callback(struct pando_tcp_conn *conn, \
 	net_tcp_disconnected_callback disconnected_cb)
 {
 	conn->disconnected_callback = disconnected_cb;
-	register_module_tcp_disconnected_callback(0, tcp_disconnected_callback);
+	register_module_tcp_disconnected_callback(conn->fd, tcp_disconnected_callback);
 }
 
 /******************************************************************************
@@ -9,6 +9,8 @@
  *     Modification:
  *********************************************************/
 
+#define PANDO_MEM_MODULE PD_MEM_STORAGE
+
 #include "pando_storage_interface.h"
 #include "platform/include/pando_types.h"
 #include "platform/include/pando_sys.h"
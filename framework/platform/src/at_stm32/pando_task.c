@@ -0,0 +1,44 @@
+#include "platform/include/pando_task.h"
+#include "task.h"
+
+static struct pd_task *s_task_head = NULL;
+
+static int8_t run_tasks(void *pdata);
+
+// one event of the main loop runs all the posted tasks.
+static task_event s_task_event = { run_tasks, NULL, 0, NULL };
+static uint8_t s_event_added = 0;
+
+static int8_t run_tasks(void *pdata)
+{
+	struct pd_task *task;
+	for(task = s_task_head; task != NULL; task = task->next)
+	{
+		if(task->pending)
+		{
+			task->pending = 0;
+			task->task_cb(task->arg);
+		}
+	}
+
+	return 0;
+}
+
+void pando_task_init(struct pd_task *task)
+{
+	if(!s_event_added)
+	{
+		add_event(&s_task_event);
+		s_event_added = 1;
+	}
+
+	task->pending = 0;
+	task->next = s_task_head;
+	s_task_head = task;
+}
+
+void pando_task_post(struct pd_task *task)
+{
+	task->pending = 1;
+	post_event(&s_task_event);
+}
@@ -6,6 +6,19 @@
 
 struct pd_timer *g_timer3_config = NULL;
 struct pd_timer *g_timer2_config = NULL;
+struct pd_timer *g_timer1_config = NULL;
+
+// timer no 3 runs on TIM1, TIM4 belongs to the modem driver.
+#if defined(STM32F10X_XL)
+#define TIM1_UPDATE_IRQn TIM1_UP_TIM10_IRQn
+#define TIM1_UPDATE_IRQHandler TIM1_UP_TIM10_IRQHandler
+#elif defined(STM32F10X_LD_VL) || defined(STM32F10X_MD_VL) || defined(STM32F10X_HD_VL)
+#define TIM1_UPDATE_IRQn TIM1_UP_TIM16_IRQn
+#define TIM1_UPDATE_IRQHandler TIM1_UP_TIM16_IRQHandler
+#else
+#define TIM1_UPDATE_IRQn TIM1_UP_IRQn
+#define TIM1_UPDATE_IRQHandler TIM1_UP_IRQHandler
+#endif
 
 void timer3_init(struct pd_timer * timer);
 void timer3_start(void);
@@ -13,6 +26,9 @@ void timer3_stop(void);
 void timer2_init(void);
 void timer2_start(void);
 void timer2_stop(void);
+void timer1_init(void);
+void timer1_start(void);
+void timer1_stop(void);
 
 void pando_timer_init(struct pd_timer * timer)
 {
@@ -26,6 +42,11 @@ void pando_timer_init(struct pd_timer * timer)
 		g_timer2_config = timer;
 		timer2_init();
 	}
+	else if(timer->timer_no == 3)
+	{
+		g_timer1_config = timer;
+		timer1_init();
+	}
 	else
 	{
 		printf("wrong timer no!\n");
@@ -43,6 +64,10 @@ void pando_timer_start(struct pd_timer * timer)
 	{
 		timer2_start();
 	}
+	else if(timer->timer_no == 3)
+	{
+		timer1_start();
+	}
 	else
 	{
 		printf("wrong timer no!\n");
@@ -61,6 +86,10 @@ void pando_timer_stop(struct pd_timer * timer)
 	{
 		timer2_stop();
 	}
+	else if(timer->timer_no == 3)
+	{
+		timer1_stop();
+	}
 	else
 	{
 		printf("wrong timer no!\n");
@@ -174,3 +203,56 @@ void TIM2_IRQHandler(void)
         }
     }
 }
+
+void timer1_init(void)
+{
+    TIM_TimeBaseInitTypeDef time_structure;
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM1, ENABLE); //enable clock
+    time_structure.TIM_Period = 2 * (g_timer1_config->interval) - 1;
+    time_structure.TIM_Prescaler = 35999;
+    time_structure.TIM_ClockDivision = TIM_CKD_DIV1;
+    time_structure.TIM_CounterMode = TIM_CounterMode_Up;
+    time_structure.TIM_RepetitionCounter = 0; //update on every overflow
+    TIM_TimeBaseInit(TIM1, &time_structure);
+    TIM_ClearITPendingBit(TIM1, TIM_IT_Update);
+    TIM_ITConfig(TIM1, TIM_IT_Update, ENABLE);
+
+    NVIC_InitTypeDef nvic_structure;
+    nvic_structure.NVIC_IRQChannel = TIM1_UPDATE_IRQn; //TIM1 update interrupt
+    nvic_structure.NVIC_IRQChannelPreemptionPriority = 5;
+    nvic_structure.NVIC_IRQChannelSubPriority = 6;
+    nvic_structure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&nvic_structure);
+
+    timer1_stop();
+}
+
+void timer1_start(void)
+{
+    TIM_Cmd(TIM1, ENABLE);
+}
+
+void timer1_stop(void)
+{
+    TIM_Cmd(TIM1, DISABLE);
+}
+
+void TIM1_UPDATE_IRQHandler(void)
+{
+    //Checks whether the TIM interrupt has occurred or not
+    if (TIM_GetITStatus(TIM1, TIM_IT_Update) != RESET)
+    {
+        TIM_ClearITPendingBit(TIM1, TIM_IT_Update); //Clears the TIMx's interrupt pending bits
+
+        task * timer1_task;
+        timer1_task = new_task();
+        timer1_task->handler = g_timer1_config->timer_cb;
+        timer1_task->pdata = g_timer1_config->arg;
+        add_task(timer1_task);
+
+        if(0 == g_timer1_config->repeated)
+        {
+            timer1_stop();
+        }
+    }
+}
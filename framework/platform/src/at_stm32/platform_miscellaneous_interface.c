@@ -1,6 +1,10 @@
 #include "../include/pando_sys.h"
 #include "../include/pando_types.h"
 #include "sim5360.h"
+#include "malloc.h"
+#include "stm32f10x.h"
+
+#define DWT_CYCCNTENA 0x00000001
 
 extern uint8_t g_imei_buf[16];
 
@@ -37,4 +41,43 @@ void get_device_serial(char* serial_buf)
 	pd_memcpy(serial_buf, g_imei_buf, sizeof(g_imei_buf));
 }
 
+/******************************************************************************
+ * FunctionName : get_largest_free_block
+ * Description  : get the size of the largest block the heap can still hand out.
+ * Parameters   : none.
+ * Returns      : the size in bytes.
+*******************************************************************************/
+uint32_t get_largest_free_block(void)
+{
+	return mem_max_free();
+}
+
+/******************************************************************************
+ * FunctionName : get_cycle_count
+ * Description  : read the free running cpu cycle counter, it wraps at 32 bits.
+ *                the DWT counter is enabled on first use.
+ * Parameters   : none.
+ * Returns      : the DWT cycle counter.
+*******************************************************************************/
+uint32_t get_cycle_count(void)
+{
+	if(!(DWT->CTRL & DWT_CYCCNTENA))
+	{
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+		DWT->CYCCNT = 0;
+		DWT->CTRL |= DWT_CYCCNTENA;
+	}
+
+	return DWT->CYCCNT;
+}
 
+/******************************************************************************
+ * FunctionName : get_cycle_freq
+ * Description  : get the rate of the cycle counter.
+ * Parameters   : none.
+ * Returns      : cycles per second.
+*******************************************************************************/
+uint32_t get_cycle_freq(void)
+{
+	return SystemCoreClock;
+}
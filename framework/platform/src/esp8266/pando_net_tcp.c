@@ -263,6 +263,25 @@ void net_tcp_register_recv_callback(struct pando_tcp_conn *conn, net_tcp_recv_ca
 	//pd_free(econn.proto.tcp);
 }
 
+/******************************************************************************
+ * FunctionName : net_tcp_recv_hold
+ * Description  : stop or resume passing received data to the recv callback.
+ * Parameters   : hold: 1 to stop, 0 to resume.
+ * Returns      : none
+*******************************************************************************/
+void net_tcp_recv_hold(struct pando_tcp_conn *conn, uint8_t hold)
+{
+	// the stack stops acking and shrinks the window while held.
+	if(hold)
+	{
+		espconn_recv_hold(econn);
+	}
+	else
+	{
+		espconn_recv_unhold(econn);
+	}
+}
+
 /******************************************************************************
  * FunctionName : net_tcp_disconnect
  * Description  : it is used to disconnect the connect.
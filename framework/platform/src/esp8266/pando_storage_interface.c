@@ -9,6 +9,8 @@
  *     Modification:
  *********************************************************/
 
+#define PANDO_MEM_MODULE PD_MEM_STORAGE
+
 #include "../../include/pando_storage_interface.h"
 #include "../../include/pando_types.h"
 #include "../../include/pando_sys.h"
@@ -74,7 +76,7 @@ load_data_from_flash()
     PRINTF("reading config from flash , key count : %d...\n", cnt);
     for(i=0; i<cnt; i++)
     {
-        struct data_pair * p = (struct data_pair * )os_malloc(sizeof(struct data_pair));
+        struct data_pair * p = (struct data_pair * )pd_malloc(sizeof(struct data_pair));
         spi_flash_read(PANDO_CONFIG_SEC * SPI_FLASH_SEC_SIZE
             + sizeof(int32) + sizeof(int32) + sizeof(struct data_pair)*i,
             (uint32 *)p, sizeof(struct data_pair));
@@ -117,7 +119,7 @@ pando_data_set(char* key, char* value)
         PRINTF("key %s updated...\n", key, p->val);
     } else {
         // key not exist, create a new pair.
-        struct data_pair * p = (struct data_pair * )os_malloc(sizeof(struct data_pair));
+        struct data_pair * p = (struct data_pair * )pd_malloc(sizeof(struct data_pair));
         os_strncpy(p->key, key, DATAPAIR_KEY_LEN);
         os_strncpy(p->val, value, DATAPAIR_VALUE_LEN);
         p->next = head;
@@ -0,0 +1,47 @@
+#include "../../include/pando_task.h"
+#include "os_type.h"
+#include "osapi.h"
+#include "user_interface.h"
+
+// the uart driver of the example takes priority 0.
+#define PANDO_TASK_PRIO         USER_TASK_PRIO_1
+#define PANDO_TASK_QUEUE_LEN    8
+
+static os_event_t task_queue[PANDO_TASK_QUEUE_LEN];
+static uint8_t task_registered = 0;
+
+static void FUNCTION_ATTRIBUTE
+pando_task_run(os_event_t *event)
+{
+	struct pd_task *task = (struct pd_task *)event->par;
+
+	task->pending = 0;
+	task->task_cb(task->arg);
+}
+
+void FUNCTION_ATTRIBUTE
+pando_task_init(struct pd_task *task)
+{
+	task->pending = 0;
+	if(!task_registered)
+	{
+		system_os_task(pando_task_run, PANDO_TASK_PRIO, task_queue, PANDO_TASK_QUEUE_LEN);
+		task_registered = 1;
+	}
+}
+
+void FUNCTION_ATTRIBUTE
+pando_task_post(struct pd_task *task)
+{
+	// a posted task is in the queue once, however often it is posted.
+	if(task->pending)
+	{
+		return;
+	}
+
+	task->pending = 1;
+	if(!system_os_post(PANDO_TASK_PRIO, 0, (os_param_t)task))
+	{
+		task->pending = 0;
+	}
+}
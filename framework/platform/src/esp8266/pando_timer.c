@@ -4,6 +4,7 @@
 #include "osapi.h"
 static os_timer_t timer1;
 static os_timer_t timer2;
+static os_timer_t timer3;
 void FUNCTION_ATTRIBUTE
 pando_timer_init(struct pd_timer * timer)
 {
@@ -19,6 +20,12 @@ pando_timer_init(struct pd_timer * timer)
 		os_timer_setfn(&timer2, (os_timer_func_t *)timer->timer_cb, timer->arg);
 		os_timer_arm(&timer2, timer->interval, timer->repeated);
 	}
+	if(timer->timer_no==3)
+	{
+		os_timer_disarm(&timer3);
+		os_timer_setfn(&timer3, (os_timer_func_t *)timer->timer_cb, timer->arg);
+		os_timer_arm(&timer3, timer->interval, timer->repeated);
+	}
 }
 
 void FUNCTION_ATTRIBUTE
@@ -32,6 +39,10 @@ pando_timer_start(struct pd_timer * timer)
 	{
 		os_timer_arm(&timer2, timer->interval, timer->repeated);
 	}
+	if(timer->timer_no==3)
+	{
+		os_timer_arm(&timer3, timer->interval, timer->repeated);
+	}
 }
 void FUNCTION_ATTRIBUTE
 pando_timer_stop(struct pd_timer * timer)
@@ -45,5 +56,9 @@ pando_timer_stop(struct pd_timer * timer)
 		os_timer_disarm(&timer2);
 
 	}
+	if(timer->timer_no==3)
+	{
+		os_timer_disarm(&timer3);
+	}
 }
 
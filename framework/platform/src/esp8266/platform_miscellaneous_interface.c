@@ -48,4 +48,43 @@ get_device_serial(char* serial_buf)
     PRINTF("device_serial:%s\n", serial_buf);
 }
 
+/******************************************************************************
+ * FunctionName : get_largest_free_block
+ * Description  : the sdk does not expose the largest free block, this returns
+ *                the total free heap, a request of that size can still fail
+ *                on a fragmented heap.
+ * Parameters   : none.
+ * Returns      : the total free heap in bytes.
+*******************************************************************************/
+uint32_t ICACHE_FLASH_ATTR
+get_largest_free_block(void)
+{
+    return system_get_free_heap_size();
+}
 
+/******************************************************************************
+ * FunctionName : get_cycle_count
+ * Description  : read the free running cpu cycle counter, it wraps at 32 bits.
+ *                kept in iram, it is called from trace points.
+ * Parameters   : none.
+ * Returns      : the ccount register.
+*******************************************************************************/
+uint32_t
+get_cycle_count(void)
+{
+    uint32_t ccount;
+    __asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+    return ccount;
+}
+
+/******************************************************************************
+ * FunctionName : get_cycle_freq
+ * Description  : get the rate of the cycle counter.
+ * Parameters   : none.
+ * Returns      : cycles per second.
+*******************************************************************************/
+uint32_t ICACHE_FLASH_ATTR
+get_cycle_freq(void)
+{
+    return system_get_cpu_freq() * 1000000;
+}
@@ -10,19 +10,78 @@
  *********************************************************/
 
 
+#define PANDO_MEM_MODULE PD_MEM_PROTOCOL
+#define PANDO_LOG_MODULE_LEVEL PANDO_LOG_LEVEL_PROTOCOL
+
 #include "pando_protocol.h"
 #include "../platform/include/pando_sys.h"
+#include "../platform/include/pando_log.h"
+#include "../platform/include/pando_trace.h"
 
 static int FUNCTION_ATTRIBUTE check_pdbin_header(struct mqtt_bin_header *bin_header);
 static int FUNCTION_ATTRIBUTE init_device_header(struct device_header *header, struct mqtt_bin_header *bin_header,
-    uint16_t payload_type, uint16_t payload_len);
+    uint16_t payload_type, uint16_t payload_len, uint16_t sub_device_id);
 static int FUNCTION_ATTRIBUTE init_pdbin_header(struct mqtt_bin_header *bin_header, struct device_header *header);
+static int FUNCTION_ATTRIBUTE expand_package(struct pando_buffer *pdbuf);
 
 
 typedef long long unsigned int llui;
 
 struct protocol_base protocol_tool_base_params;
-static int file_cmd_sequence;	//need to be array when there are sub devices more than one.
+
+static struct pando_sub_device_seq s_sub_device_seq[PANDO_SEQ_DEVICE_MAX];
+static uint8_t s_sub_device_seq_count;
+static uint32_t s_sub_device_seq_clock;
+
+/* the sequence state of a sub device. when create is set a sub device without
+ * one gets a new entry, or the least recently used one if the table is full. */
+static struct pando_sub_device_seq * FUNCTION_ATTRIBUTE find_sub_device_seq(uint16_t sub_device_id, int create)
+{
+	struct pando_sub_device_seq *seq = NULL;
+	int i = 0;
+
+	for (i = 0; i < s_sub_device_seq_count; i++)
+	{
+		if (s_sub_device_seq[i].sub_device_id == sub_device_id)
+		{
+			seq = &s_sub_device_seq[i];
+			break;
+		}
+	}
+
+	if (seq == NULL)
+	{
+		if (!create)
+		{
+			return NULL;
+		}
+
+		if (s_sub_device_seq_count < PANDO_SEQ_DEVICE_MAX)
+		{
+			seq = &s_sub_device_seq[s_sub_device_seq_count++];
+		}
+		else
+		{
+			seq = &s_sub_device_seq[0];
+			for (i = 1; i < PANDO_SEQ_DEVICE_MAX; i++)
+			{
+				if (s_sub_device_seq[i].last_use < seq->last_use)
+				{
+					seq = &s_sub_device_seq[i];
+				}
+			}
+		}
+
+		pd_memset(seq, 0, sizeof(*seq));
+		seq->sub_device_id = sub_device_id;
+		/* go on from the last frame sent, so a sub device losing its entry
+		 * does not see old sequences again. */
+		seq->tx_seq = protocol_tool_base_params.sub_device_cmd_seq;
+	}
+
+	seq->last_use = ++s_sub_device_seq_clock;
+	return seq;
+}
 
 struct pando_buffer * FUNCTION_ATTRIBUTE pando_buffer_create(int length, int offset)
 {
@@ -68,10 +127,15 @@ int FUNCTION_ATTRIBUTE pando_protocol_decode(struct pando_buffer *pdbuf, uint16_
 	uint8_t *pdbuf_end = pdbuf->buffer + pdbuf->buff_len;
 	struct device_header sub_device_header;
 	struct mqtt_bin_header *m_header = (struct mqtt_bin_header *)position;
+	struct pando_sub_device_seq *seq = NULL;
+	uint16_t sub_device_id;
+	int length = 0;
 
+	PD_TRACE_BEGIN(PD_TRACE_PROTOCOL_DECODE, pdbuf->buff_len);
     //check token
     if (check_pdbin_header(m_header))
 	{
+		PD_TRACE_END(PD_TRACE_PROTOCOL_DECODE, 0);
 		return -1;
 	}
 
@@ -79,11 +143,19 @@ int FUNCTION_ATTRIBUTE pando_protocol_decode(struct pando_buffer *pdbuf, uint16_
 	if (position > pdbuf_end)
 	{
 		pd_printf("Incorrect decode buffer length.\n");
+		PD_TRACE_END(PD_TRACE_PROTOCOL_DECODE, 0);
 		return -1;
 	}
 	
+	pd_memset(&sub_device_id, 0, sizeof(sub_device_id));
+	if (position + sizeof(sub_device_id) <= pdbuf_end)
+	{
+		pd_memcpy(&sub_device_id, position, sizeof(sub_device_id));
+		sub_device_id = net16_to_host(sub_device_id);
+	}
+
 	init_device_header(&sub_device_header, m_header, payload_type, 
-        pdbuf->buff_len - pdbuf->offset);
+        pdbuf->buff_len - pdbuf->offset, sub_device_id);
 
     //point to sub device packet header in the buffer
 	position -= DEV_HEADER_LEN;	
@@ -91,6 +163,18 @@ int FUNCTION_ATTRIBUTE pando_protocol_decode(struct pando_buffer *pdbuf, uint16_
 	
 	//now from offset to the end of buffer, is sub device packet to send
 	pdbuf->offset = pdbuf->offset + GATE_HEADER_LEN - DEV_HEADER_LEN;
+
+	// a sub device that reads compact TLV headers gets them, in place as they only shrink.
+	seq = find_sub_device_seq(sub_device_id, 0);
+	if (seq != NULL && (seq->rx_flags & PANDO_FLAG_READS_COMPACT))
+	{
+		length = convert_package_tlv(position, pdbuf_end - position, position, 1);
+		if (length > 0)
+		{
+			pdbuf->buff_len = pdbuf->offset + length;
+		}
+	}
+	PD_TRACE_END(PD_TRACE_PROTOCOL_DECODE, pdbuf->buff_len);
 	return 0;
 }
 
@@ -101,13 +185,29 @@ int FUNCTION_ATTRIBUTE pando_protocol_encode(struct pando_buffer *pdbuf, uint16_
 	struct mqtt_bin_header m_header;
 	struct device_header sub_device_header;
 	struct device_header *header = (struct device_header*)position;
-    
+
+	PD_TRACE_BEGIN(PD_TRACE_PROTOCOL_ENCODE, pdbuf->buff_len);
     if ((position += DEV_HEADER_LEN) > buffer_end)
     {
     	pd_printf("Incorrect encode buffer length.\n");
+    	PD_TRACE_END(PD_TRACE_PROTOCOL_ENCODE, 0);
         return -1;
     }
 
+    pd_memcpy((void*)&(sub_device_header.flags), (void*)&(header->flags), sizeof(header->flags));
+    if (net16_to_host(sub_device_header.flags) & PANDO_FLAG_COMPACT)
+    {
+    	if (expand_package(pdbuf))
+    	{
+    		pd_printf("Malformed compact package.\n");
+    		PD_TRACE_END(PD_TRACE_PROTOCOL_ENCODE, 0);
+    		return -1;
+    	}
+
+    	header = (struct device_header *)(pdbuf->buffer + pdbuf->offset);
+    	position = (uint8_t *)header + DEV_HEADER_LEN;
+    }
+
     pd_memcpy((void*)payload_type, (void*)&(header->payload_type), sizeof(header->payload_type));
     *payload_type = net16_to_host(*payload_type);
     pd_memcpy((void*)&(sub_device_header.flags), (void*)&(header->flags), sizeof(header->flags));
@@ -116,6 +216,7 @@ int FUNCTION_ATTRIBUTE pando_protocol_encode(struct pando_buffer *pdbuf, uint16_
 	if (init_pdbin_header(&m_header, &sub_device_header))
 	{
 		pd_printf("Init pdbin header failed.\n");
+		PD_TRACE_END(PD_TRACE_PROTOCOL_ENCODE, 0);
 		return -1;
 	}    
     
@@ -123,6 +224,35 @@ int FUNCTION_ATTRIBUTE pando_protocol_encode(struct pando_buffer *pdbuf, uint16_
 	position -= GATE_HEADER_LEN;
 	pd_memcpy(position, &m_header, GATE_HEADER_LEN);
 	pdbuf->offset = pdbuf->offset + DEV_HEADER_LEN - GATE_HEADER_LEN;
+	PD_TRACE_END(PD_TRACE_PROTOCOL_ENCODE, pdbuf->buff_len);
+	return 0;
+}
+
+/* the cloud gets full TLV headers. the package of a sub device with compact ones
+ * is rewritten into a new buffer, with the same room before it. */
+int FUNCTION_ATTRIBUTE expand_package(struct pando_buffer *pdbuf)
+{
+	uint8_t *package = pdbuf->buffer + pdbuf->offset;
+	uint16_t length = pdbuf->buff_len - pdbuf->offset;
+	int expanded = convert_package_tlv(package, length, NULL, 0);
+	uint8_t *buffer = NULL;
+
+	if (expanded < 0 || pdbuf->offset + expanded > 0xffff)
+	{
+		return -1;
+	}
+
+	buffer = (uint8_t *)pd_malloc(pdbuf->offset + expanded);
+	if (buffer == NULL)
+	{
+		return -1;
+	}
+
+	pd_memcpy(buffer, pdbuf->buffer, pdbuf->offset);
+	convert_package_tlv(package, length, buffer + pdbuf->offset, 0);
+	pd_free(pdbuf->buffer);
+	pdbuf->buffer = buffer;
+	pdbuf->buff_len = pdbuf->offset + expanded;
 	return 0;
 }
 
@@ -138,13 +268,16 @@ int FUNCTION_ATTRIBUTE check_pdbin_header(struct mqtt_bin_header *bin_header)
 }
 
 int FUNCTION_ATTRIBUTE init_device_header(struct device_header *header, struct mqtt_bin_header *bin_header,
-    uint16_t payload_type, uint16_t payload_len)
+    uint16_t payload_type, uint16_t payload_len, uint16_t sub_device_id)
 {
-	protocol_tool_base_params.sub_device_cmd_seq++;
-	header->frame_seq = host32_to_net(protocol_tool_base_params.sub_device_cmd_seq);
+	struct pando_sub_device_seq *seq = find_sub_device_seq(sub_device_id, 1);
+
+	seq->tx_seq++;
+	protocol_tool_base_params.sub_device_cmd_seq = seq->tx_seq;
+	header->frame_seq = host32_to_net(seq->tx_seq);
 	header->magic = MAGIC_HEAD_SUB_DEVICE;
 	header->crc = 0x46;	
-	header->flags = host16_to_net(bin_header->flags);
+	header->flags = host16_to_net((bin_header->flags & ~PANDO_FLAG_COMPACT) | PANDO_FLAG_READS_COMPACT);
 	header->payload_len = host16_to_net(payload_len);
 	header->payload_type = host16_to_net(payload_type);
 
@@ -153,7 +286,11 @@ int FUNCTION_ATTRIBUTE init_device_header(struct device_header *header, struct m
 
 int FUNCTION_ATTRIBUTE init_pdbin_header(struct mqtt_bin_header *bin_header, struct device_header *header)
 {
-	bin_header->flags = host16_to_net(header->flags);
+	// the gateway header has the low byte of the flags. compact headers are
+	// between the gateway and its sub devices only, and the cloud does not
+	// announce varint support.
+	bin_header->flags = (uint8_t)(header->flags
+		& ~(PANDO_FLAG_VARINT | PANDO_FLAG_COMPACT | PANDO_FLAG_READS_COMPACT));
 	bin_header->timestamp = host64_to_net((uint64_t)pd_get_timestamp());
 	pd_memcpy(bin_header->token, protocol_tool_base_params.token, 
                 sizeof(protocol_tool_base_params.token));
@@ -203,7 +340,7 @@ int FUNCTION_ATTRIBUTE pando_protocol_set_sub_device_id(struct pando_buffer *buf
 	}
 	else
 	{
-		pd_printf("set sub_device_id %d\n", sub_device_id);
+		PD_LOGD("set sub_device_id %d\n", sub_device_id);
         sub_device_id = host16_to_net(sub_device_id);
         pd_memcpy(pos, &sub_device_id, sizeof(sub_device_id));
 		return 0;
@@ -256,14 +393,87 @@ uint64_t FUNCTION_ATTRIBUTE pando_protocol_get_cmd_sequence()
 	return protocol_tool_base_params.command_sequence;
 }
 
-void FUNCTION_ATTRIBUTE save_file_sequence()
+void FUNCTION_ATTRIBUTE save_file_sequence(uint16_t sub_device_id)
+{
+	struct pando_sub_device_seq *seq = find_sub_device_seq(sub_device_id, 1);
+
+	seq->file_seq = seq->tx_seq;
+}
+
+int FUNCTION_ATTRIBUTE is_file_feedback(uint16_t sub_device_id, uint32_t sequence)
+{
+	struct pando_sub_device_seq *seq = find_sub_device_seq(sub_device_id, 0);
+
+	return (seq != NULL && seq->file_seq != 0 && sequence == seq->file_seq)?1:0;
+}
+
+int FUNCTION_ATTRIBUTE pando_protocol_check_message(uint16_t sub_device_id, uint16_t msg_id, int redelivery)
+{
+	struct pando_sub_device_seq *seq = NULL;
+	int16_t ahead = 0;
+	uint32_t bit = 0;
+
+	if (msg_id == 0)
+	{
+		return 0;
+	}
+
+	seq = find_sub_device_seq(sub_device_id, 1);
+	ahead = (int16_t)(msg_id - seq->msg_top);
+	if (seq->msg_seen == 0 || ahead >= PANDO_SEQ_WINDOW || ahead <= -PANDO_SEQ_WINDOW)
+	{
+		/* nothing seen yet, or too far from the window to tell. start over. */
+		seq->msg_top = msg_id;
+		seq->msg_seen = 1;
+		return 0;
+	}
+
+	if (ahead > 0)
+	{
+		seq->msg_top = msg_id;
+		seq->msg_seen = (seq->msg_seen << ahead) | 1;
+		return 0;
+	}
+
+	bit = (uint32_t)1 << -ahead;
+	if ((seq->msg_seen & bit) && redelivery)
+	{
+		seq->duplicates++;
+		PD_LOGW("drop redelivered message %d to sub device %d\n", msg_id, sub_device_id);
+		return 1;
+	}
+
+	seq->msg_seen |= bit;
+	return 0;
+}
+
+void FUNCTION_ATTRIBUTE pando_protocol_sub_device_rx(uint16_t sub_device_id, uint8_t *buffer, uint16_t length)
 {
-	file_cmd_sequence = protocol_tool_base_params.sub_device_cmd_seq;
+	struct pando_sub_device_seq *seq = NULL;
+	struct device_header header;
+
+	if (length < DEV_HEADER_LEN)
+	{
+		return;
+	}
+
+	seq = find_sub_device_seq(sub_device_id, 1);
+	pd_memcpy(&header, buffer, DEV_HEADER_LEN);
+	seq->rx_seq = net32_to_host(header.frame_seq);
+	seq->rx_flags = net16_to_host(header.flags);
 }
 
-int FUNCTION_ATTRIBUTE is_file_feedback(uint32_t sequence)
+int FUNCTION_ATTRIBUTE pando_protocol_get_sub_device_seq(uint16_t sub_device_id, struct pando_sub_device_seq *seq)
 {
-	return (sequence == file_cmd_sequence)?1:0;
+	struct pando_sub_device_seq *found = find_sub_device_seq(sub_device_id, 0);
+
+	if (found == NULL)
+	{
+		return -1;
+	}
+
+	pd_memcpy(seq, found, sizeof(*seq));
+	return 0;
 }
 
 #if 0
@@ -321,7 +531,7 @@ int FUNCTION_ATTRIBUTE is_pando_file_command(struct pando_buffer *pdbuf)
 {
     struct mqtt_bin_header *header = (struct mqtt_bin_header *)(pdbuf->buffer + pdbuf->offset);
 
-    if (header->flags == 1)
+    if (header->flags & PANDO_FLAG_FILE)
     {
         return 1;
     }
@@ -31,6 +31,15 @@ extern "C"
 
 #define GATE_HEADER_LEN (sizeof(struct mqtt_bin_header))
 
+/* sub devices the gateway keeps sequences for, the least recently used one
+   gives its entry to a new sub device. */
+#ifndef PANDO_SEQ_DEVICE_MAX
+#define PANDO_SEQ_DEVICE_MAX 16
+#endif
+
+/* cloud message ids one sub device remembers, the newest and the ones below it. */
+#define PANDO_SEQ_WINDOW 32
+
 #pragma pack(1)
 
 struct mqtt_bin_header
@@ -73,6 +82,20 @@ struct protocol_base
 };
 #pragma pack()
 
+/* sequence state of a sub device */
+struct pando_sub_device_seq
+{
+	uint16_t sub_device_id;
+	uint32_t tx_seq;        /* frame sequence of the last frame to the sub device */
+	uint32_t rx_seq;        /* frame sequence of the last frame from the sub device */
+	uint16_t rx_flags;      /* flags of the last frame from the sub device */
+	uint32_t file_seq;      /* frame sequence of the last file command */
+	uint32_t duplicates;    /* redelivered cloud messages dropped */
+	uint16_t msg_top;       /* newest cloud message id */
+	uint32_t msg_seen;      /* bit n set: message id msg_top - n was seen */
+	uint32_t last_use;
+};
+
 
 /* Init basic params of access device */
 int pando_protocol_init(struct protocol_base init_params);
@@ -105,6 +128,24 @@ int pando_protocol_set_sub_device_id(struct pando_buffer *buf, uint16_t sub_devi
 /* get command type after gateway completes decoding the command from server. */
 uint16_t pando_protocol_get_payload_type(struct pando_buffer *pdbuf);
 
+/* record the id of a message from the cloud to a sub device, before it is decoded.
+ * msg_id is the mqtt packet id, 0 for qos 0 messages which are not recorded.
+ * redelivery is set if the message is marked as one, only those can be dropped:
+ * a broker may give the id of an acknowledged message to a new one.
+ * returns 1 if the message is a duplicate to drop, else 0. */
+int pando_protocol_check_message(uint16_t sub_device_id, uint16_t msg_id, int redelivery);
+
+/* record a frame from a sub device, buffer starts with its device header. */
+void pando_protocol_sub_device_rx(uint16_t sub_device_id, uint8_t *buffer, uint16_t length);
+
+/* the sequence state of a sub device, -1 if it has none. */
+int pando_protocol_get_sub_device_seq(uint16_t sub_device_id, struct pando_sub_device_seq *seq);
+
+/* remember the frame sequence of the file command just sent to a sub device,
+ * and tell whether a frame answers it. */
+void save_file_sequence(uint16_t sub_device_id);
+int is_file_feedback(uint16_t sub_device_id, uint32_t sequence);
+
 #ifdef __cplusplus
 }
 #endif
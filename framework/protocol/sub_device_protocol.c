@@ -10,16 +10,22 @@
  *********************************************************/
 
 
+#define PANDO_MEM_MODULE PD_MEM_PROTOCOL
+
 #include "sub_device_protocol.h"
 #include "../platform/include/pando_sys.h"
 
 #define DEFAULT_TLV_BLOCK_SIZE 128
 
+// the getters read params without their bounds, the package is trusted.
+#define TLV_SIZE_TRUSTED 0xffff
+
 /***************** Local types ****************/
 struct params_block_indicator
 {
     uint16_t tlv_count;     //the count of tlv in TLVs
     uint16_t handled_length;
+    uint8_t compact;        //the headers of the package read are compact
 };
 
 struct property_indicator
@@ -34,11 +40,8 @@ struct sub_device_base_params base_params;	//Basic param of sub device
 static uint16_t current_tlv_block_size = 0;	//Current params block size, include count.
 static uint16_t tlv_block_buffer_size;      //Size of buffer pre-malloced to contain params block.
 
-static uint16_t get_tlv_count(struct TLVs *params_block);
-static uint16_t  get_tlv_type(struct TLV *params_in);
-static uint16_t  get_tlv_len(struct TLV *params_in);
-static struct TLV *  get_tlv_value(struct TLV *params_in, void *value);
-static struct TLV *get_tlv_param(struct TLV *params_in, uint16_t *type, uint16_t *length, void *value);
+static struct TLV *get_tlv_param(struct TLV *params_in, uint16_t *type, uint16_t *length,
+    void *value, uint8_t size);
 
 
 
@@ -85,7 +88,8 @@ static struct sub_device_buffer * FUNCTION_ATTRIBUTE create_package(
         header->frame_seq = host32_to_net(base_params.data_sequence);
     }
     
-	header->flags = host16_to_net(flags);
+	// this side reads the compact integer types and TLV headers.
+	header->flags = host16_to_net(flags | PANDO_FLAG_VARINT | PANDO_FLAG_READS_COMPACT);
 	header->magic = MAGIC_HEAD_SUB_DEVICE;
 	header->payload_type = host16_to_net(payload_type);
 		
@@ -95,11 +99,10 @@ static struct sub_device_buffer * FUNCTION_ATTRIBUTE create_package(
 
 // we must maintain the position of tlv for next get operation
 // handled_length means all the tlv has been handled 
-static void FUNCTION_ATTRIBUTE cal_current_position(uint16_t type, uint16_t len)
+static void FUNCTION_ATTRIBUTE cal_current_position(uint16_t tlv_length)
 {
     s_current_param.tlv_count--;
-    s_current_param.handled_length += len
-        + sizeof(type) + sizeof(len) * is_tlv_need_length(type);
+    s_current_param.handled_length += tlv_length;
     
     if (s_current_param.tlv_count == 0)
     {
@@ -126,27 +129,27 @@ static struct TLV FUNCTION_ATTRIBUTE *get_current_tlv(struct TLVs *params)
         + s_current_param.handled_length);   
 }
 
-static void FUNCTION_ATTRIBUTE get_value(struct TLVs *params, void *val)
+// size is the size of val, a value that does not fit leaves it alone.
+static void FUNCTION_ATTRIBUTE get_value(struct TLVs *params, void *val, uint8_t size)
 {
     uint16_t type = 0;
     uint16_t len = 0;
 
     struct TLV* params_in = get_current_tlv(params);  
-    get_tlv_param(params_in, &type, &len, val);
-    cal_current_position(type, len);
+    struct TLV* next = get_tlv_param(params_in, &type, &len, val, size);
+    cal_current_position((uint8_t *)next - (uint8_t *)params_in);
 }
 
 static void FUNCTION_ATTRIBUTE *get_string(struct TLVs *params, uint16_t *len)
 {
     uint16_t type = 0;
-    void *val = NULL;
+    uint8_t header = 0;
     struct TLV* params_in = get_current_tlv(params);
-    val = params_in->value;
-    *len = get_tlv_len(params_in);
-    type = get_tlv_type(params_in);
-    cal_current_position(type, *len);
+    header = get_tlv_header((uint8_t *)params_in, TLV_SIZE_TRUSTED, s_current_param.compact,
+        &type, len);
+    cal_current_position(header + *len);
 
-    return val;
+    return (uint8_t *)params_in + header;
 }
 
 int FUNCTION_ATTRIBUTE init_sub_device(struct sub_device_base_params params)
@@ -160,7 +163,6 @@ int FUNCTION_ATTRIBUTE init_sub_device(struct sub_device_base_params params)
 struct TLVs * FUNCTION_ATTRIBUTE create_params_block(void)
 {
 	struct TLVs *tlv_block = NULL;
-    uint8_t need_length;
 
 	current_tlv_block_size = 0;
 
@@ -182,7 +184,6 @@ int FUNCTION_ATTRIBUTE add_next_param(struct TLVs *params_block, uint16_t next_t
     uint16_t type;
     uint16_t conver_length;
     uint8_t need_length;
-    uint8_t tlv_length;
     uint8_t tmp_value[8];
     uint8_t *tlv_position;
 	struct TLVs *new_property_block = NULL;
@@ -192,6 +193,13 @@ int FUNCTION_ATTRIBUTE add_next_param(struct TLVs *params_block, uint16_t next_t
     if (1 == need_length)
     {
         
+    }
+    else if (0 == need_length && next_type == TLV_TYPE_VARINT)
+    {
+        if(next_length == 0 || next_length > VARINT_MAX_LEN)
+        {
+            return -1;
+        }
     }
     else if (0 == need_length)
     {
@@ -240,7 +248,7 @@ int FUNCTION_ATTRIBUTE add_next_param(struct TLVs *params_block, uint16_t next_t
 	switch(next_type)
 	{
 	    case TLV_TYPE_FLOAT64 :
-		    *((double *)tmp_value) = host64f_to_net(*((uint64_t *)next_value));
+		    *((double *)tmp_value) = host64f_to_net(*((double *)next_value));
 		    pd_memcpy(tlv_position, tmp_value, next_length);
 		    break;
     	case TLV_TYPE_FLOAT32 :
@@ -333,6 +341,7 @@ struct TLVs * FUNCTION_ATTRIBUTE get_sub_device_command(
 
 	struct device_header *head = (struct device_header *)device_buffer->buffer;
 	base_params.command_sequence = net32_to_host(head->frame_seq);
+	s_current_param.compact = (net16_to_host(head->flags) & PANDO_FLAG_COMPACT) != 0;
     command_body->sub_device_id = net16_to_host(tmp_body->sub_device_id);
 
 	command_body->command_num = net16_to_host(tmp_body->command_num);
@@ -343,152 +352,68 @@ struct TLVs * FUNCTION_ATTRIBUTE get_sub_device_command(
         + sizeof(struct pando_command) - sizeof(struct TLVs));
 }
 
-uint16_t FUNCTION_ATTRIBUTE
-get_tlv_count(struct TLVs *params_block)
+// a varint is read into any integer, truncated to its width.
+static void FUNCTION_ATTRIBUTE narrow_number(int64_t number, void *value, uint8_t size)
 {
-    uint16_t count = 0;
-
-    if (params_block == NULL)
+    switch (size)
     {
-        return -1;
+        case sizeof(uint8_t):
+            *(uint8_t *)value = (uint8_t)number;
+            break;
+        case sizeof(uint16_t):
+            *(uint16_t *)value = (uint16_t)number;
+            break;
+        case sizeof(uint32_t):
+            *(uint32_t *)value = (uint32_t)number;
+            break;
+        case sizeof(uint64_t):
+            *(uint64_t *)value = (uint64_t)number;
+            break;
+        default:
+            break;
     }
-    pd_memcpy((void*)(&count), (void*)(&(params_block->count)), sizeof(count));
-    return count;
 }
 
-uint16_t FUNCTION_ATTRIBUTE get_tlv_type(struct TLV *params_in)
-{
-    uint16_t type = 0;
-    pd_memcpy((void*)(&type), (void*)(&(params_in->type)), sizeof(params_in->type));
-    type = net16_to_host(type);
-    return type;
-}
 
+struct TLV * FUNCTION_ATTRIBUTE get_tlv_param(struct TLV *params_in, uint16_t *type,
+    uint16_t *length, void *value, uint8_t size)
 
-uint16_t FUNCTION_ATTRIBUTE get_tlv_len(struct TLV *params_in)
 {
-    uint8_t need_length;
-    uint16_t type = 0;
-    uint16_t length = 0;
-    void *value_pos = NULL;
+    uint8_t header = 0;
+    int64_t number = 0;
+    uint8_t *value_pos = NULL;
 
-    if (params_in == NULL)
-    {
-        return -1;
-    }
-    
-    pd_memcpy((void*)(&type), (void*)(&(params_in->type)), sizeof(params_in->type));
-    type = net16_to_host(type);
-    
-    need_length = is_tlv_need_length(type);
-    if (need_length == 1)
-    {        
-        pd_memcpy((void*)(&length), (void*)(&(params_in->length)), sizeof(params_in->length));
-        length = net16_to_host(length);
-    }
-    else
-    {
-        length = get_type_length(type);
-    }
-
-    return length;
-}
+    header = get_tlv_header((uint8_t *)params_in, TLV_SIZE_TRUSTED, s_current_param.compact,
+        type, length);
+    value_pos = (uint8_t *)params_in + header;
 
-struct TLV * FUNCTION_ATTRIBUTE get_tlv_value(struct TLV *params_in, void *value)
-{
-    uint8_t need_length;
-    void *value_pos = NULL;
-    uint16_t type_p;
-    uint16_t length_p;
-    uint16_t *type = &type_p;
-    uint16_t *length = &length_p;
-
-    pd_memcpy((void*)type, (void*)(&(params_in->type)), sizeof(params_in->type));
-    *type = net16_to_host(*type);
-    
-    need_length = is_tlv_need_length(*type);
-    if (need_length == 1)
-    {        
-        pd_memcpy((void*)length, (void*)(&(params_in->length)), sizeof(params_in->length));
-        *length = net16_to_host(*length);
-        pd_memcpy((void*)value, (void*)(params_in->value), *length);
+    if (*type == TLV_TYPE_VARINT)
+    {
+        decode_varint(value_pos, *length, &number);
+        narrow_number(number, value, size);
     }
-    else
+    else if (*length > size)
     {
-        *length = get_type_length(*type);
-        value_pos = (uint8_t *)params_in + sizeof(params_in->type);
-        pd_memcpy(value, value_pos, *length);
-        switch (*type)
-        {
-            case TLV_TYPE_FLOAT64:
-                net64f_to_host(*(double *)value);
-                break;
-            case TLV_TYPE_UINT64:
-            case TLV_TYPE_INT64:
-                net64_to_host(*(uint64_t *)value);
-                break;
-            case TLV_TYPE_FLOAT32:
-                net32f_to_host(*(float *)value);
-                break;
-            case TLV_TYPE_UINT32:
-            case TLV_TYPE_INT32:
-                net32_to_host(*(uint32_t *)value);
-                break;
-            case TLV_TYPE_INT8:
-            case TLV_TYPE_UINT8:
-            case TLV_TYPE_BOOL:
-                break;
-            case TLV_TYPE_INT16:
-            case TLV_TYPE_UINT16:
-                net16_to_host(*(uint16_t *)value);
-                break;
-            default:
-                break;
-        }//switch            
-    }//need_length == 0
-    
-	return (struct TLV *)((uint8_t *)params_in + *length + sizeof(struct TLV) 
-        - (!need_length) * sizeof(*length));    
-}
-
-
-struct TLV * FUNCTION_ATTRIBUTE get_tlv_param(struct TLV *params_in, uint16_t *type,
-    uint16_t *length, void *value)
-
-{
-    uint8_t need_length;
-    void *value_pos = NULL;
-
-    pd_memcpy((void*)type, (void*)(&(params_in->type)), sizeof(params_in->type));
-    *type = net16_to_host(*type);
-    
-    need_length = is_tlv_need_length(*type);
-    if (need_length == 1)
-    {        
-        pd_memcpy((void*)length, (void*)(&(params_in->length)), sizeof(params_in->length));
-        *length = net16_to_host(*length);
-        pd_memcpy((void*)value, (void*)(params_in->value), *length);
+        pd_printf("Param type %d is longer than the read value\n", *type);
     }
     else
     {
-        *length = get_type_length(*type);
-        value_pos = (uint8_t *)params_in + sizeof(params_in->type);
         pd_memcpy((void*)value, (void*)value_pos, *length);
         switch (*type)
         {
             case TLV_TYPE_FLOAT64:
-                net64f_to_host(*(double *)value);
+                *(double *)value = net64f_to_host(*(double *)value);
                 break;
             case TLV_TYPE_UINT64:
             case TLV_TYPE_INT64:
-                net64_to_host(*(uint64_t *)value);
+                *(uint64_t *)value = net64_to_host(*(uint64_t *)value);
                 break;
             case TLV_TYPE_FLOAT32:
-                net32f_to_host(*(float *)value);
+                *(float *)value = net32f_to_host(*(float *)value);
                 break;
             case TLV_TYPE_UINT32:
             case TLV_TYPE_INT32:
-                net32_to_host(*(uint32_t *)value);
+                *(uint32_t *)value = net32_to_host(*(uint32_t *)value);
                 break;
             case TLV_TYPE_INT8:
             case TLV_TYPE_UINT8:
@@ -496,15 +421,14 @@ struct TLV * FUNCTION_ATTRIBUTE get_tlv_param(struct TLV *params_in, uint16_t *t
                 break;
             case TLV_TYPE_INT16:
             case TLV_TYPE_UINT16:
-                net16_to_host(*(uint16_t *)value);
+                *(uint16_t *)value = net16_to_host(*(uint16_t *)value);
                 break;
             default:
                 break;
         }//switch            
-    }//need_length == 0
+    }
     
-	return (struct TLV *)((uint8_t *)params_in + *length + sizeof(struct TLV) 
-        - (!need_length) * sizeof(*length));
+	return (struct TLV *)(value_pos + *length);
 }
 
 /*******************************************************
@@ -533,6 +457,7 @@ struct TLVs * FUNCTION_ATTRIBUTE get_sub_device_property(
         s_current_property.position += DEV_HEADER_LEN;
         head = (struct device_header *)device_buffer->buffer;
 	    base_params.data_sequence = net32_to_host(head->frame_seq);
+        s_current_param.compact = (net16_to_host(head->flags) & PANDO_FLAG_COMPACT) != 0;
     }    
 
     tmp_body = (struct pando_property *)(device_buffer->buffer
@@ -557,6 +482,50 @@ uint16_t FUNCTION_ATTRIBUTE get_sub_device_payloadtype(struct sub_device_buffer
     return net16_to_host(head->payload_type);
 }
 
+uint16_t FUNCTION_ATTRIBUTE get_sub_device_flags(struct sub_device_buffer *package)
+{
+    struct device_header *head;
+
+    if (package == NULL || package->buffer_length < DEV_HEADER_LEN)
+    {
+        return 0;
+    }
+
+    head = (struct device_header *)package->buffer;
+
+    return net16_to_host(head->flags);
+}
+
+uint8_t FUNCTION_ATTRIBUTE get_sub_device_priority_level(const uint8_t *buffer, uint16_t length)
+{
+    struct device_header head;
+    uint16_t priority = 0;
+
+    if (buffer == NULL || length < DEV_HEADER_LEN)
+    {
+        return PRIORITY_LEVEL_NORMAL;
+    }
+
+    pd_memcpy(&head, buffer, DEV_HEADER_LEN);
+    switch (net16_to_host(head.payload_type))
+    {
+        case PAYLOAD_TYPE_DATA:
+            return PRIORITY_LEVEL_BULK;
+        case PAYLOAD_TYPE_COMMAND:
+        case PAYLOAD_TYPE_EVENT:
+            /* priority follows the id and the number in both payloads */
+            if (length < DEV_HEADER_LEN + 3 * sizeof(uint16_t))
+            {
+                return PRIORITY_LEVEL_NORMAL;
+            }
+
+            pd_memcpy(&priority, buffer + DEV_HEADER_LEN + 2 * sizeof(uint16_t), sizeof(priority));
+            return net16_to_host(priority) == 0 ? PRIORITY_LEVEL_NORMAL : PRIORITY_LEVEL_HIGH;
+        default:
+            return PRIORITY_LEVEL_NORMAL;
+    }
+}
+
 uint8_t FUNCTION_ATTRIBUTE is_tlv_need_length(uint16_t type)
 {
     switch (type)
@@ -572,10 +541,12 @@ uint8_t FUNCTION_ATTRIBUTE is_tlv_need_length(uint16_t type)
         case TLV_TYPE_UINT32:
         case TLV_TYPE_UINT64:
         case TLV_TYPE_BOOL:
+        case TLV_TYPE_VARINT:
             return 0;
             break;
         case TLV_TYPE_BYTES:
         case TLV_TYPE_URI:
+        case TLV_TYPE_DELTA:
             return 1;
             break;
             
@@ -612,6 +583,8 @@ uint8_t FUNCTION_ATTRIBUTE get_type_length(uint16_t type)
             break;
         case TLV_TYPE_BYTES:
         case TLV_TYPE_URI:
+        case TLV_TYPE_VARINT:
+        case TLV_TYPE_DELTA:
             return 0;
             break;
             
@@ -678,7 +651,7 @@ int FUNCTION_ATTRIBUTE add_command(struct sub_device_buffer *command_package,
     old_len = command_package->buffer_length;
 
     /* append payload length */
-    command_package->buffer_length += (sizeof(struct pando_property) 
+    command_package->buffer_length += (sizeof(struct pando_command) 
         + current_tlv_block_size - sizeof(struct TLVs));    
     command_package->buffer = (uint8_t *)pd_malloc(command_package->buffer_length);
     pd_memset(command_package->buffer, 0, command_package->buffer_length);
@@ -717,7 +690,7 @@ int FUNCTION_ATTRIBUTE add_event(struct sub_device_buffer *event_package,
     old_len = event_package->buffer_length;
 
     /* append payload length */
-    event_package->buffer_length += (sizeof(struct pando_property) 
+    event_package->buffer_length += (sizeof(struct pando_event) 
         + current_tlv_block_size - sizeof(struct TLVs));    
     event_package->buffer = (uint8_t *)pd_malloc(event_package->buffer_length);
     pd_memset(event_package->buffer, 0, event_package->buffer_length);
@@ -741,8 +714,25 @@ int FUNCTION_ATTRIBUTE add_event(struct sub_device_buffer *event_package,
 }
 
 int FUNCTION_ATTRIBUTE finish_package(struct sub_device_buffer *package_buf)
+{
+    return finish_package_for(package_buf, 0);
+}
+
+int FUNCTION_ATTRIBUTE finish_package_for(struct sub_device_buffer *package_buf,
+    uint16_t peer_flags)
 {
     struct device_header *header;
+    int length = 0;
+
+    if (peer_flags & PANDO_FLAG_READS_COMPACT)
+    {
+        length = convert_package_tlv(package_buf->buffer, package_buf->buffer_length,
+            package_buf->buffer, 1);
+        if (length > 0)
+        {
+            package_buf->buffer_length = length;
+        }
+    }
 
     header = (struct device_header *)package_buf->buffer;
     header->payload_len = host16_to_net(package_buf->buffer_length
@@ -783,7 +773,7 @@ int FUNCTION_ATTRIBUTE is_device_file_command(struct sub_device_buffer *device_b
 {
     struct device_header *header = (struct device_header *)device_buffer->buffer;
 
-    if (header->flags == 1)
+    if (net16_to_host(header->flags) & PANDO_FLAG_FILE)
     {
         return 1;
     }
@@ -800,14 +790,14 @@ int FUNCTION_ATTRIBUTE is_device_file_command(struct sub_device_buffer *device_b
 uint8_t FUNCTION_ATTRIBUTE get_next_uint8(struct TLVs *params)
 {
     uint8_t val = 0;
-    get_value(params, &val);
+    get_value(params, &val, sizeof(val));
     return val;
 }
 
 uint16_t FUNCTION_ATTRIBUTE get_next_uint16(struct TLVs *params)
 {
     uint16_t val = 0;
-    get_value(params, &val);    
+    get_value(params, &val, sizeof(val));    
     return val;
 
 }
@@ -815,7 +805,7 @@ uint16_t FUNCTION_ATTRIBUTE get_next_uint16(struct TLVs *params)
 uint32_t FUNCTION_ATTRIBUTE get_next_uint32(struct TLVs *params)
 {
     uint32_t val = 0;
-    get_value(params, &val);    
+    get_value(params, &val, sizeof(val));    
     return val;
 
 }
@@ -823,7 +813,7 @@ uint32_t FUNCTION_ATTRIBUTE get_next_uint32(struct TLVs *params)
 uint64_t FUNCTION_ATTRIBUTE get_next_uint64(struct TLVs *params)
 {
     uint64_t val = 0;
-    get_value(params, &val);    
+    get_value(params, &val, sizeof(val));    
     return val;
 
 }
@@ -831,14 +821,14 @@ uint64_t FUNCTION_ATTRIBUTE get_next_uint64(struct TLVs *params)
 int8_t FUNCTION_ATTRIBUTE get_next_int8(struct TLVs *params)
 {
     int8_t val = 0;
-    get_value(params, &val);    
+    get_value(params, &val, sizeof(val));    
     return val;
 }
 
 int16_t FUNCTION_ATTRIBUTE get_next_int16(struct TLVs *params)
 {
     int16_t val = 0;
-    get_value(params, &val);    
+    get_value(params, &val, sizeof(val));    
     return val;
 
 }
@@ -846,7 +836,7 @@ int16_t FUNCTION_ATTRIBUTE get_next_int16(struct TLVs *params)
 int32_t FUNCTION_ATTRIBUTE get_next_int32(struct TLVs *params)
 {
     int32_t val = 0;
-    get_value(params, &val);    
+    get_value(params, &val, sizeof(val));    
     return val;
 
 }
@@ -854,7 +844,7 @@ int32_t FUNCTION_ATTRIBUTE get_next_int32(struct TLVs *params)
 int64_t FUNCTION_ATTRIBUTE get_next_int64(struct TLVs *params)
 {
     int64_t val = 0;
-    get_value(params, &val);    
+    get_value(params, &val, sizeof(val));    
     return val;
 
 }
@@ -862,7 +852,7 @@ int64_t FUNCTION_ATTRIBUTE get_next_int64(struct TLVs *params)
 float FUNCTION_ATTRIBUTE get_next_float32(struct TLVs *params)
 {
     float val = 0;
-    get_value(params, &val);    
+    get_value(params, &val, sizeof(val));    
     return val;
 
 }
@@ -870,7 +860,7 @@ float FUNCTION_ATTRIBUTE get_next_float32(struct TLVs *params)
 double FUNCTION_ATTRIBUTE get_next_float64(struct TLVs *params)
 {
     double val = 0;
-    get_value(params, &val);    
+    get_value(params, &val, sizeof(val));    
     return val;
 
 }
@@ -878,7 +868,7 @@ double FUNCTION_ATTRIBUTE get_next_float64(struct TLVs *params)
 uint8_t FUNCTION_ATTRIBUTE get_next_bool(struct TLVs *params)
 {
     uint8_t val = 0;
-    get_value(params, &val);    
+    get_value(params, &val, sizeof(val));    
     return val;
 
 }
@@ -893,6 +883,44 @@ void FUNCTION_ATTRIBUTE *get_next_bytes(struct TLVs *params, uint16_t *length)
     return get_string(params,length);
 }
 
+int64_t FUNCTION_ATTRIBUTE get_next_varint(struct TLVs *params)
+{
+    int64_t val = 0;
+    get_value(params, &val, sizeof(val));
+    return val;
+}
+
+int FUNCTION_ATTRIBUTE get_next_delta(struct TLVs *params, int32_t *values, uint16_t max)
+{
+    uint16_t length = 0;
+    uint16_t count = 0;
+    uint8_t used = 0;
+    int64_t delta = 0;
+    int64_t value = 0;
+    uint8_t *position = (uint8_t *)get_string(params, &length);
+
+    while (length > 0)
+    {
+        used = decode_varint(position, length, &delta);
+        if (used == 0)
+        {
+            return -1;
+        }
+
+        value += delta;
+        if (count < max)
+        {
+            values[count] = (int32_t)value;
+        }
+
+        count++;
+        position += used;
+        length -= used;
+    }
+
+    return count;
+}
+
 
 int  FUNCTION_ATTRIBUTE
 add_next_uint8(struct TLVs *params, uint8_t next_value)
@@ -971,3 +999,305 @@ add_next_bytes(struct TLVs *params, uint16_t length, void *next_value)
 {
     return add_next_param(params, TLV_TYPE_BYTES, length, next_value);
 }
+
+int FUNCTION_ATTRIBUTE
+add_next_varint(struct TLVs *params, int64_t next_value)
+{
+    uint8_t bytes[VARINT_MAX_LEN];
+
+    return add_next_param(params, TLV_TYPE_VARINT, encode_varint(next_value, bytes), bytes);
+}
+
+int FUNCTION_ATTRIBUTE
+add_next_delta(struct TLVs *params, uint16_t count, const int32_t *values)
+{
+    uint8_t *bytes = NULL;
+    uint16_t length = 0;
+    uint16_t i = 0;
+    int64_t previous = 0;
+    int ret = 0;
+
+    // a difference of two int32 takes 5 bytes at most.
+    if ((uint32_t)count * 5 > 0xffff)
+    {
+        return -1;
+    }
+
+    bytes = (uint8_t *)pd_malloc(count * 5 + 1);
+    if (bytes == NULL)
+    {
+        return -1;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        length += encode_varint((int64_t)values[i] - previous, bytes + length);
+        previous = values[i];
+    }
+
+    ret = add_next_param(params, TLV_TYPE_DELTA, length, bytes);
+    pd_free(bytes);
+    return ret;
+}
+
+uint8_t FUNCTION_ATTRIBUTE
+encode_varint(int64_t value, uint8_t *out)
+{
+    // zig-zag: 0, -1, 1, -2 ... become 0, 1, 2, 3 ...
+    uint64_t zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    uint8_t length = 0;
+
+    while (zigzag >= 0x80)
+    {
+        out[length++] = (uint8_t)zigzag | 0x80;
+        zigzag >>= 7;
+    }
+
+    out[length++] = (uint8_t)zigzag;
+    return length;
+}
+
+uint8_t FUNCTION_ATTRIBUTE
+decode_varint(const uint8_t *buffer, uint16_t length, int64_t *value)
+{
+    uint64_t zigzag = 0;
+    uint8_t i = 0;
+
+    for (i = 0; i < length && i < VARINT_MAX_LEN; i++)
+    {
+        zigzag |= (uint64_t)(buffer[i] & 0x7f) << (7 * i);
+        if ((buffer[i] & 0x80) == 0)
+        {
+            *value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
+
+uint8_t FUNCTION_ATTRIBUTE get_tlv_header(const uint8_t *tlv, uint16_t size, uint8_t compact,
+    uint16_t *type, uint16_t *length)
+{
+    uint8_t header = 0;
+    uint8_t small = 0;
+    int64_t number = 0;
+
+    *length = 0;
+    if (compact)
+    {
+        if (size < 1)
+        {
+            return 0;
+        }
+
+        *type = tlv[0] >> 4;
+        small = tlv[0] & 0x0f;
+        header = 1;
+    }
+    else
+    {
+        if (size < 2)
+        {
+            return 0;
+        }
+
+        *type = (tlv[0] << 8) | tlv[1];
+        header = 2;
+    }
+
+    // TLV_TYPE_DELTA is the last type.
+    if (*type == 0 || *type > TLV_TYPE_DELTA)
+    {
+        return 0;
+    }
+
+    switch (is_tlv_need_length(*type))
+    {
+        case 0:
+            if (small != 0)
+            {
+                return 0;
+            }
+
+            if (*type == TLV_TYPE_VARINT)
+            {
+                *length = decode_varint(tlv + header, size - header, &number);
+                return *length == 0 ? 0 : header;
+            }
+
+            *length = get_type_length(*type);
+            return header;
+        case 1:
+            if (compact && small < TLV_COMPACT_LEN8)
+            {
+                *length = small;
+            }
+            else if (compact && small == TLV_COMPACT_LEN8)
+            {
+                if (size < header + 1)
+                {
+                    return 0;
+                }
+
+                *length = tlv[header++];
+            }
+            else
+            {
+                if (size < header + 2)
+                {
+                    return 0;
+                }
+
+                *length = (tlv[header] << 8) | tlv[header + 1];
+                header += 2;
+            }
+
+            return header;
+        default:
+            return 0;
+    }
+}
+
+// write a TLV header, out may be NULL to only get its length.
+static uint8_t FUNCTION_ATTRIBUTE put_tlv_header(uint8_t *out, uint8_t compact,
+    uint16_t type, uint16_t length)
+{
+    uint8_t header[TLV_HEADER_MAX];
+    uint8_t size = 0;
+    uint8_t need_length = is_tlv_need_length(type);
+
+    if (!compact)
+    {
+        header[size++] = type >> 8;
+        header[size++] = type & 0xff;
+        if (need_length == 1)
+        {
+            header[size++] = length >> 8;
+            header[size++] = length & 0xff;
+        }
+    }
+    else if (need_length != 1)
+    {
+        header[size++] = type << 4;
+    }
+    else if (length < TLV_COMPACT_LEN8)
+    {
+        header[size++] = (type << 4) | length;
+    }
+    else if (length <= 0xff)
+    {
+        header[size++] = (type << 4) | TLV_COMPACT_LEN8;
+        header[size++] = length;
+    }
+    else
+    {
+        header[size++] = (type << 4) | TLV_COMPACT_LEN16;
+        header[size++] = length >> 8;
+        header[size++] = length & 0xff;
+    }
+
+    if (out != NULL)
+    {
+        pd_memcpy(out, header, size);
+    }
+
+    return size;
+}
+
+// copy to the same place or one before, a package compacted in place only
+// moves its bytes down. out may be NULL to only count them.
+static uint16_t FUNCTION_ATTRIBUTE copy_down(uint8_t *out, const uint8_t *from, uint16_t length)
+{
+    uint16_t i = 0;
+
+    if (out != NULL && out != from)
+    {
+        for (i = 0; i < length; i++)
+        {
+            out[i] = from[i];
+        }
+    }
+
+    return length;
+}
+
+int FUNCTION_ATTRIBUTE convert_package_tlv(const uint8_t *package, uint16_t length,
+    uint8_t *out, uint8_t compact)
+{
+    struct device_header header;
+    const uint8_t *position = package + DEV_HEADER_LEN;
+    const uint8_t *end = package + length;
+    uint8_t in_compact = 0;
+    uint16_t body = 0;
+    uint16_t count = 0;
+    uint16_t type = 0;
+    uint16_t value_length = 0;
+    uint8_t header_length = 0;
+    uint32_t written = DEV_HEADER_LEN;
+
+    if (package == NULL || length < DEV_HEADER_LEN)
+    {
+        return -1;
+    }
+
+    pd_memcpy(&header, package, DEV_HEADER_LEN);
+    in_compact = (net16_to_host(header.flags) & PANDO_FLAG_COMPACT) != 0;
+    switch (net16_to_host(header.payload_type))
+    {
+        case PAYLOAD_TYPE_DATA:
+            body = sizeof(struct pando_property);
+            break;
+        case PAYLOAD_TYPE_COMMAND:
+            body = sizeof(struct pando_command);
+            break;
+        case PAYLOAD_TYPE_EVENT:
+            body = sizeof(struct pando_event);
+            break;
+        default:
+            return -1;
+    }
+
+    // each property, command or event with the count of its params, then the params.
+    while (position < end)
+    {
+        if (end - position < body)
+        {
+            return -1;
+        }
+
+        pd_memcpy(&count, position + body - sizeof(struct TLVs), sizeof(count));
+        count = net16_to_host(count);
+        written += copy_down(out == NULL ? NULL : out + written, position, body);
+        position += body;
+
+        while (count-- > 0)
+        {
+            header_length = get_tlv_header(position, end - position, in_compact, &type, &value_length);
+            if (header_length == 0 || end - position - header_length < value_length)
+            {
+                return -1;
+            }
+
+            position += header_length;
+            written += put_tlv_header(out == NULL ? NULL : out + written, compact, type, value_length);
+            written += copy_down(out == NULL ? NULL : out + written, position, value_length);
+            position += value_length;
+        }
+    }
+
+    if (written > 0xffff)
+    {
+        return -1;
+    }
+
+    if (out != NULL)
+    {
+        header.flags = net16_to_host(header.flags) & ~PANDO_FLAG_COMPACT;
+        header.flags = host16_to_net(header.flags | (compact ? PANDO_FLAG_COMPACT : 0));
+        header.payload_len = host16_to_net(written - DEV_HEADER_LEN);
+        pd_memcpy(out, &header, DEV_HEADER_LEN);
+    }
+
+    return written;
+}
@@ -38,9 +38,40 @@ extern "C"
 #define	TLV_TYPE_BYTES  11
 #define	TLV_TYPE_URI    12
 #define	TLV_TYPE_BOOL   13
+#define	TLV_TYPE_VARINT 14  /* integer, zig-zag then LEB128, 1 to 10 bytes and no length */
+#define	TLV_TYPE_DELTA  15  /* integer series with a length, the first value then the
+                               difference to the one before, each as a varint */
+
+/* most bytes of a varint */
+#define VARINT_MAX_LEN 10
+
+/* Bits of device_header.flags. */
+#define PANDO_FLAG_FILE     0x0001  /* a file transfer */
+#define PANDO_FLAG_VARINT   0x0002  /* the sender reads TLV_TYPE_VARINT and TLV_TYPE_DELTA, a
+                                       side writes them only once the other side set it */
+#define PANDO_FLAG_COMPACT  0x0004  /* the TLV headers of the package are compact */
+#define PANDO_FLAG_READS_COMPACT 0x0008  /* the sender reads compact packages, a side compacts
+                                            its packages only once the other side set it */
+
+/* A compact TLV header is one byte with the type in the high nibble. The low nibble is 0
+   for the types of a fixed length and TLV_TYPE_VARINT, else the length of the value up
+   to 13, or TLV_COMPACT_LEN8 and a length byte after it, or TLV_COMPACT_LEN16 and two
+   bytes, high byte first. The params count and the headers of properties, commands and
+   events are the same in both forms. */
+#define TLV_COMPACT_LEN8    14
+#define TLV_COMPACT_LEN16   15
+
+/* most bytes of a TLV header, compact or not */
+#define TLV_HEADER_MAX 4
 
 #define DEV_HEADER_LEN (sizeof(struct device_header))
 
+/* Levels for priority queuing, a higher level goes first. */
+#define PRIORITY_LEVEL_BULK   0   /* data packages */
+#define PRIORITY_LEVEL_NORMAL 1   /* commands and events of priority 0 */
+#define PRIORITY_LEVEL_HIGH   2   /* commands and events of a higher priority, eg. alarms */
+#define PRIORITY_LEVELS       3
+
 #pragma pack(1)
 
 /* a device packet is made up with header and payload */
@@ -162,6 +193,45 @@ struct sub_device_buffer *create_data_package(uint16_t flags);
  *********************************************************/
 int finish_package(struct sub_device_buffer *package_buf);
 
+/*******************************************************
+ * Description: finish_package for one peer, the TLV headers are compacted
+                if the last package from it had PANDO_FLAG_READS_COMPACT.
+ * param
+    in:
+        package_buf: buffer contains device package.
+        peer_flags: the flags of the last package from the peer, 0 if none.
+ * return:
+ *********************************************************/
+int finish_package_for(struct sub_device_buffer *package_buf, uint16_t peer_flags);
+
+/*******************************************************
+ * Description: Rewrite the TLV headers of a package compact or full, with
+                PANDO_FLAG_COMPACT and the payload length to match.
+ * param
+    in:
+        package, length: the package from its device header.
+        compact: 1 for compact headers, 0 for full ones.
+    out:
+        out: the package rewritten, NULL to only get its length. It may be
+             package itself when compacting, the headers only shrink.
+ * return: length of the package rewritten, -1 if it is malformed, too long
+           or not a command, event or data package.
+ *********************************************************/
+int convert_package_tlv(const uint8_t *package, uint16_t length, uint8_t *out, uint8_t compact);
+
+/*******************************************************
+ * Description: Read the header of a TLV.
+ * param
+    in:
+        tlv, size: the TLV and the bytes from it to the end of the package.
+        compact: whether the header is compact.
+    out:
+        type, length: type and length of the value.
+ * return: bytes of the header, 0 if it is truncated or the type is unknown.
+ *********************************************************/
+uint8_t get_tlv_header(const uint8_t *tlv, uint16_t size, uint8_t compact,
+    uint16_t *type, uint16_t *length);
+
 /*******************************************************
  * Description: Add data params block and property number to package.
  * param
@@ -244,6 +314,28 @@ struct TLVs *get_sub_device_property(struct sub_device_buffer *device_buffer, st
  *********************************************************/
 uint16_t get_sub_device_payloadtype(struct sub_device_buffer *package);
 
+/*******************************************************
+ * Description: get the flags of the package, PANDO_FLAG_FILE, PANDO_FLAG_VARINT.
+ * param
+    in:
+        package: package received.
+ * return: the flags.
+ *********************************************************/
+uint16_t get_sub_device_flags(struct sub_device_buffer *package);
+
+/*******************************************************
+ * Description: Get the queuing level of a package from its header and
+                the priority of its first command or event.
+ * param
+    in:
+       buffer: the package.
+       length: length of the package.
+    out:
+ * return: One of PRIORITY_LEVEL_*, PRIORITY_LEVEL_NORMAL if the package is
+           too short to tell.
+ *********************************************************/
+uint8_t get_sub_device_priority_level(const uint8_t *buffer, uint16_t length);
+
 /*******************************************************
  * Description: Delete device buffer after package has been sent to server.
  * param
@@ -291,6 +383,19 @@ double      get_next_float64(struct TLVs *params);
 uint8_t     get_next_bool(struct TLVs *params);
 void        *get_next_uri(struct TLVs *params, uint16_t *length);
 void        *get_next_bytes(struct TLVs *params, uint16_t *length);
+int64_t     get_next_varint(struct TLVs *params);
+
+/*******************************************************
+ * Description: get the next param, a TLV_TYPE_DELTA series.
+ * param
+    in:
+        params: params block.
+        max: room in values.
+    out:
+        values: the series, values after max are skipped.
+ * return: values in the series, -1 if it is malformed.
+ *********************************************************/
+int get_next_delta(struct TLVs *params, int32_t *values, uint16_t max);
 
 /*******************************************************
  * Description: Functions to add param into params block.
@@ -315,6 +420,22 @@ int add_next_float64(struct TLVs *params, double next_value);
 int add_next_bool(struct TLVs *params, uint8_t next_value);
 int add_next_uri(struct TLVs *params, uint16_t length, void *next_value);
 int add_next_bytes(struct TLVs *params, uint16_t length, void *next_value);
+int add_next_varint(struct TLVs *params, int64_t next_value);
+int add_next_delta(struct TLVs *params, uint16_t count, const int32_t *values);
+
+/*******************************************************
+ * Description: zig-zag LEB128 integers, small magnitudes take few bytes.
+ * param
+    in:
+        value: integer to encode.
+        buffer, length: bytes to decode.
+    out:
+        out: VARINT_MAX_LEN bytes of room.
+        value: the integer decoded.
+ * return: bytes written or read, 0 if the bytes are truncated or malformed.
+ *********************************************************/
+uint8_t encode_varint(int64_t value, uint8_t *out);
+uint8_t decode_varint(const uint8_t *buffer, uint16_t length, int64_t *value);
 
 #ifdef __cplusplus
 }
@@ -9,13 +9,42 @@
  *     Modification:    
  *********************************************************/
 
+#define PANDO_MEM_MODULE PD_MEM_SUBDEVICE
+
 #include "pando_object.h"
 #include "../platform/include/pando_sys.h"
 #include "../protocol/pando_machine.h"
+#include "../protocol/sub_device_protocol.h"
 
 #define MAX_OBJECTS 16
 
+// what was last reported of an object, by its index in the list.
+struct object_report
+{
+    uint8_t dirty;
+    float deadband;             // below 0 if not set
+    uint8_t *params;            // NULL until first reported
+    uint16_t length;
+};
+
+#define SAMPLER_NONE 0xff
+
+// the window of a sampled object, in fixed memory.
+struct object_sampler
+{
+    uint8_t object;             // index in the list, SAMPLER_NONE if free
+    uint8_t aggregate;
+    uint16_t interval;          // ticks
+    uint16_t due;               // ticks to the next sample
+    uint16_t window;
+    uint16_t count;             // samples in the window so far
+    double numbers[PANDO_SAMPLED_NUMBERS];
+};
+
 static pando_object s_pando_object_list[MAX_OBJECTS];
+static struct object_report s_object_reports[MAX_OBJECTS];
+static struct object_sampler s_samplers[PANDO_SAMPLED_OBJECTS];
+static uint8_t s_samplers_init;
 static int s_pando_object_list_idx = 0;
 
 void FUNCTION_ATTRIBUTE
@@ -26,6 +55,8 @@ register_pando_object(pando_object object)
         return;
     }
 
+    s_object_reports[s_pando_object_list_idx].dirty = 0;
+    s_object_reports[s_pando_object_list_idx].deadband = -1;
     s_pando_object_list[s_pando_object_list_idx++] = object;
 }
 
@@ -70,3 +101,464 @@ pando_objects_iterator_next(pando_objects_iterator *it)
     }
     return &s_pando_object_list[it->cur++];
 }
+
+void FUNCTION_ATTRIBUTE
+pando_object_set_dirty(uint8_t no)
+{
+    pando_object *object = find_pando_object(no);
+
+    if(object != NULL)
+    {
+        s_object_reports[object - s_pando_object_list].dirty = 1;
+    }
+}
+
+int8_t FUNCTION_ATTRIBUTE
+pando_object_set_deadband(uint8_t no, float deadband)
+{
+    pando_object *object = find_pando_object(no);
+
+    if(object == NULL)
+    {
+        return -1;
+    }
+
+    s_object_reports[object - s_pando_object_list].deadband = deadband;
+    return 0;
+}
+
+uint8_t FUNCTION_ATTRIBUTE
+pando_object_report_due(pando_object *object)
+{
+    struct object_report *report = &s_object_reports[object - s_pando_object_list];
+
+    return report->dirty || report->deadband >= 0 || report->params == NULL;
+}
+
+// big endian, may be unaligned.
+static uint64_t FUNCTION_ATTRIBUTE
+read_be(const uint8_t *bytes, uint8_t length)
+{
+    uint64_t value = 0;
+
+    while(length-- > 0)
+    {
+        value = (value << 8) | *bytes++;
+    }
+
+    return value;
+}
+
+static uint8_t FUNCTION_ATTRIBUTE
+tlv_fixed_length(uint16_t type)
+{
+    switch(type)
+    {
+        case TLV_TYPE_FLOAT64:
+        case TLV_TYPE_INT64:
+        case TLV_TYPE_UINT64:
+            return 8;
+        case TLV_TYPE_FLOAT32:
+        case TLV_TYPE_INT32:
+        case TLV_TYPE_UINT32:
+            return 4;
+        case TLV_TYPE_INT16:
+        case TLV_TYPE_UINT16:
+            return 2;
+        case TLV_TYPE_INT8:
+        case TLV_TYPE_UINT8:
+        case TLV_TYPE_BOOL:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// the value of a number tlv, 0 if the type is not a number.
+static uint8_t FUNCTION_ATTRIBUTE
+tlv_number(uint16_t type, const uint8_t *value, double *number)
+{
+    uint64_t raw = read_be(value, tlv_fixed_length(type));
+    uint32_t raw32 = (uint32_t)raw;
+    int64_t varint = 0;
+    float f32;
+
+    switch(type)
+    {
+        case TLV_TYPE_VARINT:
+            decode_varint(value, VARINT_MAX_LEN, &varint);
+            *number = varint;
+            break;
+        case TLV_TYPE_FLOAT64:
+            pd_memcpy(number, &raw, sizeof(*number));
+            break;
+        case TLV_TYPE_FLOAT32:
+            pd_memcpy(&f32, &raw32, sizeof(f32));
+            *number = f32;
+            break;
+        case TLV_TYPE_INT8:
+            *number = (int8_t)raw;
+            break;
+        case TLV_TYPE_INT16:
+            *number = (int16_t)raw;
+            break;
+        case TLV_TYPE_INT32:
+            *number = (int32_t)raw;
+            break;
+        case TLV_TYPE_INT64:
+            *number = (int64_t)raw;
+            break;
+        case TLV_TYPE_UINT8:
+        case TLV_TYPE_UINT16:
+        case TLV_TYPE_UINT32:
+        case TLV_TYPE_UINT64:
+            *number = raw;
+            break;
+        default:
+            return 0;
+    }
+
+    return 1;
+}
+
+static void FUNCTION_ATTRIBUTE
+write_be(uint8_t *bytes, uint8_t length, uint64_t value)
+{
+    while(length-- > 0)
+    {
+        bytes[length] = (uint8_t)value;
+        value >>= 8;
+    }
+}
+
+// the value of the tlv at *at, which is moved past it. NULL if the tlv runs
+// past end or its type is unknown.
+static const uint8_t * FUNCTION_ATTRIBUTE
+tlv_next(const uint8_t **at, const uint8_t *end, uint16_t *type, uint16_t *length)
+{
+    const uint8_t *value = *at;
+    int64_t number = 0;
+
+    if(end - value < sizeof(*type))
+    {
+        return NULL;
+    }
+
+    *type = read_be(value, sizeof(*type));
+    value += sizeof(*type);
+    *length = tlv_fixed_length(*type);
+    if(*type == TLV_TYPE_VARINT)
+    {
+        *length = decode_varint(value, end - value, &number);
+        if(*length == 0)
+        {
+            return NULL;
+        }
+    }
+    else if(*length == 0)
+    {
+        if((*type != TLV_TYPE_BYTES && *type != TLV_TYPE_URI && *type != TLV_TYPE_DELTA)
+            || end - value < sizeof(*length))
+        {
+            return NULL;
+        }
+
+        *length = read_be(value, sizeof(*length));
+        value += sizeof(*length);
+    }
+
+    if(end - value < *length)
+    {
+        return NULL;
+    }
+
+    *at = value + *length;
+    return value;
+}
+
+// whether two params blocks of the same length differ, numbers by more than
+// the dead-band. blocks that do not parse alike differ.
+static uint8_t FUNCTION_ATTRIBUTE
+params_changed(const uint8_t *old, const uint8_t *params, uint16_t length, float deadband)
+{
+    const uint8_t *end = params + length;
+    const uint8_t *at = params + sizeof(struct TLVs);
+    const uint8_t *tlv = NULL;
+    const uint8_t *value = NULL;
+    uint16_t count = 0;
+    uint16_t type = 0;
+    uint16_t value_length = 0;
+    double old_number = 0;
+    double number = 0;
+
+    if(deadband == 0 || length < sizeof(struct TLVs))
+    {
+        return pd_memcmp(old, params, length) != 0;
+    }
+
+    if(pd_memcmp(old, params, sizeof(struct TLVs)) != 0)
+    {
+        return 1;
+    }
+
+    count = read_be(params, sizeof(struct TLVs));
+    while(count-- > 0)
+    {
+        // the type and length match, then the value.
+        tlv = at;
+        value = tlv_next(&at, end, &type, &value_length);
+        if(value == NULL || pd_memcmp(old + (tlv - params), tlv, value - tlv) != 0)
+        {
+            return 1;
+        }
+
+        if(tlv_number(type, old + (value - params), &old_number) && tlv_number(type, value, &number))
+        {
+            number -= old_number;
+            if(number > deadband || number < -deadband || number != number)
+            {
+                return 1;
+            }
+        }
+        else if(pd_memcmp(old + (value - params), value, value_length) != 0)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+uint8_t FUNCTION_ATTRIBUTE
+pando_object_report(pando_object *object, const uint8_t *params, uint16_t length,
+    uint8_t changed_only)
+{
+    struct object_report *report = &s_object_reports[object - s_pando_object_list];
+    float deadband = report->deadband < 0? 0: report->deadband;
+
+    if(changed_only && report->params != NULL && report->length == length
+        && !params_changed(report->params, params, length, deadband))
+    {
+        report->dirty = 0;
+        return 0;
+    }
+
+    if(report->length != length || report->params == NULL)
+    {
+        if(report->params != NULL)
+        {
+            pd_free(report->params);
+        }
+
+        report->length = 0;
+        report->params = (uint8_t *)pd_malloc(length);
+        if(report->params == NULL)
+        {
+            // reported, without a record it is reported again next time.
+            return 1;
+        }
+
+        report->length = length;
+    }
+
+    pd_memcpy(report->params, params, length);
+    report->dirty = 0;
+    return 1;
+}
+
+static struct object_sampler * FUNCTION_ATTRIBUTE
+find_sampler(uint8_t object)
+{
+    uint8_t i = 0;
+
+    if(!s_samplers_init)
+    {
+        for(i = 0; i < PANDO_SAMPLED_OBJECTS; i++)
+        {
+            s_samplers[i].object = SAMPLER_NONE;
+        }
+
+        s_samplers_init = 1;
+    }
+
+    for(i = 0; i < PANDO_SAMPLED_OBJECTS; i++)
+    {
+        if(s_samplers[i].object == object)
+        {
+            return &s_samplers[i];
+        }
+    }
+
+    return NULL;
+}
+
+int8_t FUNCTION_ATTRIBUTE
+pando_object_set_sampling(uint8_t no, uint16_t interval, uint16_t window, uint8_t aggregate)
+{
+    pando_object *object = find_pando_object(no);
+    struct object_sampler *sampler = NULL;
+
+    if(object == NULL || (interval > 0 && (window == 0 || aggregate > PANDO_AGGREGATE_COUNT)))
+    {
+        return -1;
+    }
+
+    sampler = find_sampler(object - s_pando_object_list);
+    if(interval == 0)
+    {
+        if(sampler != NULL)
+        {
+            sampler->object = SAMPLER_NONE;
+        }
+
+        return 0;
+    }
+
+    if(sampler == NULL && (sampler = find_sampler(SAMPLER_NONE)) == NULL)
+    {
+        return -1;
+    }
+
+    sampler->object = object - s_pando_object_list;
+    sampler->aggregate = aggregate;
+    sampler->interval = interval;
+    sampler->due = interval;
+    sampler->window = window;
+    sampler->count = 0;
+    return 0;
+}
+
+uint8_t FUNCTION_ATTRIBUTE
+pando_object_sample_due(pando_object *object)
+{
+    struct object_sampler *sampler = find_sampler(object - s_pando_object_list);
+
+    if(sampler == NULL || --sampler->due > 0)
+    {
+        return 0;
+    }
+
+    sampler->due = sampler->interval;
+    return 1;
+}
+
+static void FUNCTION_ATTRIBUTE
+sampler_add(struct object_sampler *sampler, uint8_t i, double number)
+{
+    double *value = &sampler->numbers[i];
+
+    if(sampler->aggregate == PANDO_AGGREGATE_COUNT)
+    {
+        *value = (sampler->count == 0? 0: *value) + (number != 0);
+    }
+    else if(sampler->count == 0 || sampler->aggregate == PANDO_AGGREGATE_LAST
+        || (sampler->aggregate == PANDO_AGGREGATE_MIN && number < *value)
+        || (sampler->aggregate == PANDO_AGGREGATE_MAX && number > *value))
+    {
+        *value = number;
+    }
+    else if(sampler->aggregate == PANDO_AGGREGATE_MEAN)
+    {
+        *value += number;
+    }
+}
+
+// put a number in a tlv of its type, integers rounded and held to their range.
+static void FUNCTION_ATTRIBUTE
+tlv_set_number(uint16_t type, uint8_t *value, double number)
+{
+    static const double limits[][2] =
+    {
+        {-128.0, 127.0}, {-32768.0, 32767.0}, {-2147483648.0, 2147483647.0},
+        {-9223372036854775808.0, 9223372036854774784.0},
+        {0, 255.0}, {0, 65535.0}, {0, 4294967295.0}, {0, 18446744073709549568.0}
+    };
+    uint8_t length = tlv_fixed_length(type);
+    uint64_t raw = 0;
+    uint32_t raw32 = 0;
+    float f32 = (float)number;
+
+    if(type == TLV_TYPE_FLOAT64)
+    {
+        pd_memcpy(&raw, &number, sizeof(raw));
+    }
+    else if(type == TLV_TYPE_FLOAT32)
+    {
+        pd_memcpy(&raw32, &f32, sizeof(raw32));
+        raw = raw32;
+    }
+    else
+    {
+        // TLV_TYPE_INT8 to TLV_TYPE_UINT64 are in order.
+        number = number < 0? number - 0.5: number + 0.5;
+        if(number < limits[type - TLV_TYPE_INT8][0])
+        {
+            number = limits[type - TLV_TYPE_INT8][0];
+        }
+        else if(number > limits[type - TLV_TYPE_INT8][1])
+        {
+            number = limits[type - TLV_TYPE_INT8][1];
+        }
+
+        raw = type < TLV_TYPE_UINT8? (uint64_t)(int64_t)number: (uint64_t)number;
+    }
+
+    write_be(value, length, raw);
+}
+
+uint8_t FUNCTION_ATTRIBUTE
+pando_object_sample(pando_object *object, uint8_t *params, uint16_t length)
+{
+    struct object_sampler *sampler = find_sampler(object - s_pando_object_list);
+    const uint8_t *end = params + length;
+    const uint8_t *at = params + sizeof(struct TLVs);
+    const uint8_t *value = NULL;
+    uint16_t count = 0;
+    uint16_t type = 0;
+    uint16_t value_length = 0;
+    uint8_t i = 0;
+    double number = 0;
+
+    if(sampler == NULL || length < sizeof(struct TLVs))
+    {
+        return 1;
+    }
+
+    count = read_be(params, sizeof(struct TLVs));
+    while(count-- > 0 && i < PANDO_SAMPLED_NUMBERS
+        && (value = tlv_next(&at, end, &type, &value_length)) != NULL)
+    {
+        // a varint could change its length, it is reported as last sampled.
+        if(type != TLV_TYPE_VARINT && tlv_number(type, value, &number))
+        {
+            sampler_add(sampler, i++, number);
+        }
+    }
+
+    if(++sampler->count < sampler->window)
+    {
+        return 0;
+    }
+
+    // the same walk again, the numbers take their aggregates.
+    count = read_be(params, sizeof(struct TLVs));
+    at = params + sizeof(struct TLVs);
+    i = 0;
+    while(count-- > 0 && i < PANDO_SAMPLED_NUMBERS
+        && (value = tlv_next(&at, end, &type, &value_length)) != NULL)
+    {
+        if(type != TLV_TYPE_VARINT && tlv_number(type, value, &number))
+        {
+            number = sampler->numbers[i++];
+            if(sampler->aggregate == PANDO_AGGREGATE_MEAN)
+            {
+                number /= sampler->count;
+            }
+
+            tlv_set_number(type, params + (value - params), number);
+        }
+    }
+
+    sampler->count = 0;
+    return 1;
+}
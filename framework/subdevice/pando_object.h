@@ -27,6 +27,23 @@ typedef struct {
 	uint8_t cur;
 }pando_objects_iterator;
 
+// aggregates of a sampling window, for each number an object packs.
+#define PANDO_AGGREGATE_LAST    0   // as last sampled
+#define PANDO_AGGREGATE_MIN     1
+#define PANDO_AGGREGATE_MAX     2
+#define PANDO_AGGREGATE_MEAN    3   // integers rounded
+#define PANDO_AGGREGATE_COUNT   4   // samples in which it was not 0
+
+// objects sampled at a time, and numbers of an object aggregated. the
+// numbers after them and the values that are no numbers are reported as
+// last sampled.
+#ifndef PANDO_SAMPLED_OBJECTS
+#define PANDO_SAMPLED_OBJECTS 4
+#endif
+#ifndef PANDO_SAMPLED_NUMBERS
+#define PANDO_SAMPLED_NUMBERS 4
+#endif
+
 /******************************************************************************
  * FunctionName : register_pando_object.
  * Description  : register a pando object to framework.
@@ -53,4 +70,88 @@ pando_objects_iterator* create_pando_objects_iterator(void);
 void delete_pando_objects_iterator(pando_objects_iterator*);
 pando_object* pando_objects_iterator_next(pando_objects_iterator*);
 
+/******************************************************************************
+ * FunctionName : pando_object_set_dirty.
+ * Description  : mark a pando object as changed, it is packed in the next
+ *                report of the changes.
+ * Parameters   : the object no.
+ * Returns      : none.
+*******************************************************************************/
+void pando_object_set_dirty(uint8_t no);
+
+/******************************************************************************
+ * FunctionName : pando_object_set_deadband.
+ * Description  : pack a pando object in every report of the changes, and
+ *                report it only once a number in it has moved more than the
+ *                dead-band from the value last reported, or any other value
+ *                has changed. a slow drift is reported once it adds up to the
+ *                dead-band, a value wavering about a level is not.
+ * Parameters   : no: the object no.
+ *                deadband: the least change of a number reported, 0 for any
+ *                          change. below 0 the object is packed only when
+ *                          marked dirty again.
+ * Returns      : 0 if ok, -1 if the object is not registered.
+*******************************************************************************/
+int8_t pando_object_set_deadband(uint8_t no, float deadband);
+
+/******************************************************************************
+ * FunctionName : pando_object_report_due.
+ * Description  : whether a report of the changes packs the object: it is
+ *                dirty, has a dead-band or was never reported.
+ * Parameters   : a registered pando object.
+ * Returns      : 1 if it is packed, else 0.
+*******************************************************************************/
+uint8_t pando_object_report_due(pando_object *object);
+
+/******************************************************************************
+ * FunctionName : pando_object_report.
+ * Description  : decide whether the params just packed for an object go in
+ *                a report. if so they are kept as the values last reported
+ *                and the object is no longer dirty.
+ * Parameters   : object: a registered pando object.
+ *                params: the params block packed, as added to the package.
+ *                length: its byte count.
+ *                changed_only: 1 for a report of the changes, 0 for a full
+ *                              one which takes every object.
+ * Returns      : 1 if the params are reported, 0 if they are left out.
+*******************************************************************************/
+uint8_t pando_object_report(pando_object *object, const uint8_t *params, uint16_t length,
+    uint8_t changed_only);
+
+/******************************************************************************
+ * FunctionName : pando_object_set_sampling.
+ * Description  : sample a pando object at an interval and aggregate its
+ *                numbers over a window of samples. see sample_object, which
+ *                also runs the timer.
+ * Parameters   : no: the object no.
+ *                interval: timer ticks between samples, 0 to stop sampling.
+ *                window: samples in a report.
+ *                aggregate: PANDO_AGGREGATE_LAST to PANDO_AGGREGATE_COUNT.
+ * Returns      : 0 if ok, -1 if the object is not registered, the settings
+ *                are invalid or PANDO_SAMPLED_OBJECTS are sampled already.
+*******************************************************************************/
+int8_t pando_object_set_sampling(uint8_t no, uint16_t interval, uint16_t window, uint8_t aggregate);
+
+/******************************************************************************
+ * FunctionName : pando_object_sample_due.
+ * Description  : count a timer tick for a pando object.
+ * Parameters   : a registered pando object.
+ * Returns      : 1 if it is sampled on this tick, else 0.
+*******************************************************************************/
+uint8_t pando_object_sample_due(pando_object *object);
+
+/******************************************************************************
+ * FunctionName : pando_object_sample.
+ * Description  : add the params just packed for a sampled object to its
+ *                window. on the last sample of the window the numbers in the
+ *                params are replaced by their aggregates, in their own types,
+ *                and the next window starts.
+ * Parameters   : object: a sampled pando object.
+ *                params: the params block packed, as added to the package.
+ *                length: its byte count.
+ * Returns      : 1 if the window is complete and the params are to be
+ *                reported, else 0.
+*******************************************************************************/
+uint8_t pando_object_sample(pando_object *object, uint8_t *params, uint16_t length);
+
 #endif /* PANDO_OBJECTS_H_ */
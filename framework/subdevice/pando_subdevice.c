@@ -1,3 +1,6 @@
+#define PANDO_MEM_MODULE PD_MEM_SUBDEVICE
+#define PANDO_LOG_MODULE_LEVEL PANDO_LOG_LEVEL_SUBDEVICE
+
 #include "../subdevice/pando_subdevice.h"
 #include "../gateway/pando_channel.h"
 #include "../protocol/common_functions.h"
@@ -6,9 +9,23 @@
 #include "../subdevice/pando_event.h"
 #include "../subdevice/pando_command.h"
 #include "../platform/include/pando_sys.h"
+#include "../platform/include/pando_log.h"
+#include "../platform/include/pando_trace.h"
+#include "../platform/include/pando_timer.h"
 
 #define CMD_QUERY_STATUS (65528)
 
+static struct pd_timer sample_timer;
+// the flags of the last package from the gateway, they say what it reads.
+static uint16_t peer_flags;
+
+static void FUNCTION_ATTRIBUTE
+send_package(struct sub_device_buffer *package)
+{
+    finish_package_for(package, peer_flags);
+    channel_send_to_device(PANDO_CHANNEL_PORT_1, package->buffer, package->buffer_length);
+}
+
 static void FUNCTION_ATTRIBUTE
 decode_data(struct sub_device_buffer *device_buffer)
 {
@@ -23,16 +40,33 @@ decode_data(struct sub_device_buffer *device_buffer)
         if( NULL == obj )
         {
         	pd_printf("object [%d] not found in list\n", data_body.property_num);
+        	continue;
         }
 
+        PD_TRACE_BEGIN(PD_TRACE_OBJECT_UNPACK, data_body.property_num);
         obj->unpack(object_param);
+        PD_TRACE_END(PD_TRACE_OBJECT_UNPACK, data_body.property_num);
     }
 }
 
-static void FUNCTION_ATTRIBUTE
-send_current_status()
+/******************************************************************************
+ * FunctionName : report_status.
+ * Description  : report the status of the objects.
+ * Parameters   : mode: PANDO_REPORT_FULL or PANDO_REPORT_CHANGED.
+ * Returns      : none.
+*******************************************************************************/
+void FUNCTION_ATTRIBUTE
+report_status(uint8_t mode)
 {
     struct sub_device_buffer* data_buffer;
+    uint8_t changed_only = (mode == PANDO_REPORT_CHANGED);
+    uint16_t reported = 0;
+    uint16_t old_length = 0;
+    uint16_t params_at = 0;
+    pando_object* obj = NULL;
+    pando_objects_iterator* it = NULL;
+    PARAMS* params = NULL;
+
     data_buffer = create_data_package(0);
     if(NULL == data_buffer)
     {
@@ -40,33 +74,160 @@ send_current_status()
         return;
     }
 
-    pando_object* obj = NULL;
-    pando_objects_iterator* it = create_pando_objects_iterator();
+    it = create_pando_objects_iterator();
     while((obj = pando_objects_iterator_next(it))){
-        PARAMS* params =  create_params_block();
+        if(changed_only && !pando_object_report_due(obj))
+        {
+            continue;
+        }
+
+        params =  create_params_block();
         if (params == NULL)
         {
         	pd_printf("Create params block failed.\n");
-            return;
+            break;
         }
         obj->pack(params);
+
+        // the params go in as packed, the object is then cut out again if
+        // nothing in it changed enough to be reported.
+        old_length = data_buffer->buffer_length;
+        params_at = old_length + sizeof(struct pando_property) - sizeof(struct TLVs);
         int ret = add_next_property(data_buffer, obj->no, params);
+        delete_params_block(params);
 
         if (ret != 0)
         {
         	pd_printf("add_next_property failed.");
+            continue;
         }
 
-        delete_params_block(params);
+        if(pando_object_report(obj, data_buffer->buffer + params_at,
+            data_buffer->buffer_length - params_at, changed_only))
+        {
+            reported++;
+        }
+        else
+        {
+            data_buffer->buffer_length = old_length;
+        }
     }
     delete_pando_objects_iterator(it);
 
-    channel_send_to_device(PANDO_CHANNEL_PORT_1, data_buffer->buffer, data_buffer->buffer_length);
-    show_package(data_buffer->buffer, data_buffer->buffer_length);
+    if(reported > 0 || !changed_only)
+    {
+        PD_LOGD("report %d objects\n", reported);
+        send_package(data_buffer);
+        PD_LOG_HEX(data_buffer->buffer, data_buffer->buffer_length);
+    }
     delete_device_package(data_buffer);
 }
 
+// one tick of the sampling timer. the objects due are sampled into a single
+// package, the samples are cut out again and the windows that completed are
+// sent together.
+static void FUNCTION_ATTRIBUTE
+sample_objects(void *arg)
+{
+    struct sub_device_buffer* data_buffer = NULL;
+    uint16_t reported = 0;
+    uint16_t old_length = 0;
+    uint16_t params_at = 0;
+    pando_object* obj = NULL;
+    pando_objects_iterator* it = NULL;
+    PARAMS* params = NULL;
+
+    it = create_pando_objects_iterator();
+    while((obj = pando_objects_iterator_next(it))){
+        if(!pando_object_sample_due(obj))
+        {
+            continue;
+        }
+
+        if(data_buffer == NULL && (data_buffer = create_data_package(0)) == NULL)
+        {
+            pd_printf("create data package error\n");
+            break;
+        }
+
+        params =  create_params_block();
+        if (params == NULL)
+        {
+            pd_printf("Create params block failed.\n");
+            break;
+        }
+
+        obj->pack(params);
+
+        old_length = data_buffer->buffer_length;
+        params_at = old_length + sizeof(struct pando_property) - sizeof(struct TLVs);
+        int ret = add_next_property(data_buffer, obj->no, params);
+        delete_params_block(params);
+        if (ret != 0)
+        {
+            pd_printf("add_next_property failed.");
+            continue;
+        }
+
+        if(pando_object_sample(obj, data_buffer->buffer + params_at, data_buffer->buffer_length - params_at))
+        {
+            pando_object_report(obj, data_buffer->buffer + params_at, data_buffer->buffer_length - params_at, 0);
+            reported++;
+        }
+        else
+        {
+            data_buffer->buffer_length = old_length;
+        }
+    }
+    delete_pando_objects_iterator(it);
+
+    if(reported > 0)
+    {
+        PD_LOGD("report %d sampled objects\n", reported);
+        send_package(data_buffer);
+    }
+
+    if(data_buffer != NULL)
+    {
+        delete_device_package(data_buffer);
+    }
+}
+
+/******************************************************************************
+ * FunctionName : sample_object.
+ * Description  : have the framework sample an object and report the
+ *                aggregates of its numbers once per window.
+ * Parameters   : no: the object no.
+ *                interval: milliseconds between samples.
+ *                window: samples in a report.
+ *                aggregate: PANDO_AGGREGATE_LAST to PANDO_AGGREGATE_COUNT.
+ * Returns      : 0 if ok, -1 if not.
+*******************************************************************************/
+int8_t FUNCTION_ATTRIBUTE
+sample_object(uint8_t no, uint16_t interval, uint16_t window, uint8_t aggregate)
+{
+    uint16_t ticks = (interval + PANDO_SAMPLE_TICK / 2) / PANDO_SAMPLE_TICK;
 
+    if(pando_object_set_sampling(no, interval == 0 || ticks > 0? ticks: 1, window, aggregate) != 0)
+    {
+        PD_LOGE("can not sample object %d\n", no);
+        return -1;
+    }
+
+    if(interval > 0 && sample_timer.timer_cb == NULL)
+    {
+        sample_timer.interval = PANDO_SAMPLE_TICK;
+        sample_timer.repeated = 1;
+        sample_timer.timer_cb = sample_objects;
+        sample_timer.arg = NULL;
+        sample_timer.timer_no = 3;
+        pando_timer_init(&sample_timer);
+        pando_timer_stop(&sample_timer);
+        pando_timer_start(&sample_timer);
+    }
+
+    return 0;
+}
 
 static void FUNCTION_ATTRIBUTE
 decode_command(struct sub_device_buffer *device_buffer)
@@ -76,12 +237,12 @@ decode_command(struct sub_device_buffer *device_buffer)
     PARAMS *cmd_param = get_sub_device_command(device_buffer, &cmd_body);
     if(CMD_QUERY_STATUS == cmd_body.command_num)
     {
-    	pd_printf("receive a get request\n");
-        send_current_status();
+    	PD_LOGD("receive a get request\n");
+        report_status(PANDO_REPORT_FULL);
     }
     else
     {
-        pd_printf("\nReceive a command:%d\n", cmd_body.command_num);
+        PD_LOGD("Receive a command:%d\n", cmd_body.command_num);
         p_cmd_body = find_pando_command(cmd_body.command_num);
         if(p_cmd_body == NULL)
         {
@@ -90,7 +251,9 @@ decode_command(struct sub_device_buffer *device_buffer)
         }
         if(p_cmd_body->unpack != NULL)
         {
+        	PD_TRACE_BEGIN(PD_TRACE_OBJECT_UNPACK, cmd_body.command_num);
         	p_cmd_body->unpack(cmd_param);
+        	PD_TRACE_END(PD_TRACE_OBJECT_UNPACK, cmd_body.command_num);
         }
     }
 
@@ -104,8 +267,9 @@ pando_subdevice_recv(uint8_t * buffer, uint16_t length)
         return;
     }
 
-    pd_printf("subdevive receive a package: \n");
-    show_package(buffer, length);
+    PD_TRACE_BEGIN(PD_TRACE_SUBDEVICE_RECV, length);
+    PD_LOGD("subdevive receive a package: \n");
+    PD_LOG_HEX(buffer, length);
 
     struct sub_device_buffer *device_buffer = (struct sub_device_buffer *)pd_malloc(sizeof(struct sub_device_buffer));
     device_buffer->buffer_length = length;
@@ -114,6 +278,7 @@ pando_subdevice_recv(uint8_t * buffer, uint16_t length)
     pd_memcpy(device_buffer->buffer, buffer, length);
 
     uint16_t payload_type = get_sub_device_payloadtype(device_buffer);
+    peer_flags = get_sub_device_flags(device_buffer);
 
     switch (payload_type) {
     case PAYLOAD_TYPE_DATA:
@@ -128,6 +293,7 @@ pando_subdevice_recv(uint8_t * buffer, uint16_t length)
     }
 
     delete_device_package(device_buffer);
+    PD_TRACE_END(PD_TRACE_SUBDEVICE_RECV, length);
 }
 
 /******************************************************************************
@@ -175,8 +341,20 @@ report_event(uint8_t no)
 	}
 
 	delete_params_block(params);
-	show_package(event_buffer->buffer, event_buffer->buffer_length);
-	channel_send_to_device(PANDO_CHANNEL_PORT_1, event_buffer->buffer, event_buffer->buffer_length);
+	send_package(event_buffer);
+	PD_LOG_HEX(event_buffer->buffer, event_buffer->buffer_length);
 	delete_device_package(event_buffer);
 
 }
+
+/******************************************************************************
+ * FunctionName : peer_reads_varint.
+ * Description  : whether the other side reads the compact integer types.
+ * Parameters   : none.
+ * Returns      : 1 if it does, else 0.
+*******************************************************************************/
+uint8_t FUNCTION_ATTRIBUTE
+peer_reads_varint(void)
+{
+    return (peer_flags & PANDO_FLAG_VARINT) != 0;
+}
@@ -13,6 +13,16 @@
 
 #include "../platform/include/pando_types.h"
 
+// modes of report_status.
+#define PANDO_REPORT_FULL       0   // every object
+#define PANDO_REPORT_CHANGED    1   // the objects changed since last reported
+
+// milliseconds between the ticks of the sampling timer, the sample intervals
+// are rounded to it.
+#ifndef PANDO_SAMPLE_TICK
+#define PANDO_SAMPLE_TICK 100
+#endif
+
 /******************************************************************************
  * FunctionName : pando_subdevice_recv.
  * Description  : process buffer receive from channel.
@@ -29,4 +39,43 @@ void pando_subdevice_recv(uint8_t * buffer, uint16_t length);
 *******************************************************************************/
 void report_event(uint8_t no);
 
+/******************************************************************************
+ * FunctionName : report_status.
+ * Description  : report the status of the objects. a full report answers a
+ *                status query, a report of the changes packs the objects that
+ *                are dirty or have a dead-band and sends the ones that changed
+ *                since last reported, nothing if none did. see
+ *                pando_object_set_dirty and pando_object_set_deadband.
+ * Parameters   : mode: PANDO_REPORT_FULL or PANDO_REPORT_CHANGED.
+ * Returns      : none.
+*******************************************************************************/
+void report_status(uint8_t mode);
+
+/******************************************************************************
+ * FunctionName : sample_object.
+ * Description  : have the framework sample an object and report it once per
+ *                window of samples, each number it packs replaced by its
+ *                aggregate over the window. the objects share one timer, the
+ *                ones due on the same tick are sampled together and the
+ *                windows ending then go in one report.
+ * Parameters   : no: the object no, registered.
+ *                interval: milliseconds between samples, 0 to stop sampling.
+ *                window: samples in a report.
+ *                aggregate: PANDO_AGGREGATE_LAST, PANDO_AGGREGATE_MIN,
+ *                           PANDO_AGGREGATE_MAX, PANDO_AGGREGATE_MEAN or
+ *                           PANDO_AGGREGATE_COUNT.
+ * Returns      : 0 if ok, -1 if not.
+*******************************************************************************/
+int8_t sample_object(uint8_t no, uint16_t interval, uint16_t window, uint8_t aggregate);
+
+/******************************************************************************
+ * FunctionName : peer_reads_varint.
+ * Description  : whether the other side reads TLV_TYPE_VARINT and
+ *                TLV_TYPE_DELTA, as the last package received says. pack
+ *                functions use add_next_varint and add_next_delta only then.
+ * Parameters   : none.
+ * Returns      : 1 if it does, else 0.
+*******************************************************************************/
+uint8_t peer_reads_varint(void);
+
 #endif /* PANDO_SUBDEVICE_H_ */
@@ -0,0 +1,582 @@
+/*******************************************************
+ * File name: bench.c
+ * Author:
+ * Versions: 1.0
+ * Description: host benchmark of the portable framework code, sub device TLV
+ *              packages, gateway protocol header, mqtt framing, the mqtt
+ *              message queue, cobs serial framing and json.
+ *              usage: bench [-c] [-t seconds] [name...]
+ *              -c prints one csv line per case for regression tracking:
+ *              name,ops,seconds,ops_per_sec,bytes_per_sec,ns_per_op
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "protocol/sub_device_protocol.h"
+#include "protocol/pando_protocol.h"
+#include "gateway/mqtt/mqtt_msg.h"
+#include "gateway/mqtt/queue.h"
+#include "lib/pando_cobs.h"
+#include "lib/json/jsonparse.h"
+#include "lib/json/jsontree.h"
+#include "lib/pando_json.h"
+#include "lib/pando_tlv_json.h"
+
+#define MQTT_BUF_SIZE       1024
+#define QUEUE_BUFFER_SIZE   2048
+#define STREAM_MESSAGES     16
+#define STREAM_SEGMENT      128
+
+// one operation of a case, returns the bytes it processed.
+typedef size_t (*bench_fn)(void);
+
+struct bench_case
+{
+    const char *name;
+    bench_fn run;
+};
+
+static volatile size_t s_sink;
+
+static uint8_t s_device_package[256];
+static uint16_t s_device_package_len;
+static uint8_t s_gateway_package[256];
+static uint16_t s_gateway_package_len;
+static uint8_t s_work[256];
+
+static uint8_t s_mqtt_buffer[MQTT_BUF_SIZE];
+static mqtt_connection_t s_mqtt_connection;
+static uint8_t s_mqtt_stream[STREAM_MESSAGES * 128];
+static uint16_t s_mqtt_stream_len;
+
+static QUEUE s_queue;
+
+static const char s_login_response[] =
+    "{\"code\":0,\"message\":\"\",\"data\":{\"device_id\":12345,"
+    "\"access_token\":\"0123456789abcdef0123456789abcdef\","
+    "\"access_addr\":\"tcp://192.168.100.200:1883\"}}";
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static struct sub_device_buffer *
+build_data_package(void)
+{
+    uint8_t bytes[16];
+    struct TLVs *params = NULL;
+    struct sub_device_buffer *package = create_data_package(0);
+
+    memset(bytes, 0x5a, sizeof(bytes));
+
+    params = create_params_block();
+    add_next_uint8(params, 1);
+    add_next_uint32(params, 123456);
+    add_next_float32(params, 25.5f);
+    add_next_property(package, 1, params);
+    delete_params_block(params);
+
+    params = create_params_block();
+    add_next_bytes(params, sizeof(bytes), bytes);
+    add_next_uint16(params, 4000);
+    add_next_property(package, 2, params);
+    delete_params_block(params);
+
+    finish_package(package);
+    return package;
+}
+
+static size_t
+bench_tlv_encode(void)
+{
+    struct sub_device_buffer *package = build_data_package();
+    size_t length = package->buffer_length;
+
+    delete_device_package(package);
+    return length;
+}
+
+static size_t
+bench_tlv_decode(void)
+{
+    struct sub_device_buffer package;
+    struct pando_property property;
+    struct TLVs *params = NULL;
+    uint16_t length = 0;
+    size_t sum = 0;
+
+    package.buffer = s_device_package;
+    package.buffer_length = s_device_package_len;
+
+    while((params = get_sub_device_property(&package, &property)) != NULL)
+    {
+        if(property.property_num == 1)
+        {
+            sum += get_next_uint8(params);
+            sum += get_next_uint32(params);
+            sum += (size_t)get_next_float32(params);
+        }
+        else
+        {
+            sum += *(uint8_t *)get_next_bytes(params, &length);
+            sum += get_next_uint16(params);
+        }
+    }
+
+    s_sink = sum;
+    return s_device_package_len;
+}
+
+// the codec works in place, so both protocol cases restore the input first.
+static size_t
+bench_protocol_encode(void)
+{
+    struct pando_buffer buffer;
+    uint16_t payload_type = 0;
+
+    memcpy(s_work + GATE_HEADER_LEN - DEV_HEADER_LEN, s_device_package, s_device_package_len);
+    buffer.buffer = s_work;
+    buffer.buff_len = GATE_HEADER_LEN - DEV_HEADER_LEN + s_device_package_len;
+    buffer.offset = GATE_HEADER_LEN - DEV_HEADER_LEN;
+    pando_protocol_encode(&buffer, &payload_type);
+
+    return buffer.buff_len;
+}
+
+static size_t
+bench_protocol_decode(void)
+{
+    struct pando_buffer buffer;
+
+    memcpy(s_work, s_gateway_package, s_gateway_package_len);
+    buffer.buffer = s_work;
+    buffer.buff_len = s_gateway_package_len;
+    buffer.offset = 0;
+    pando_protocol_decode(&buffer, PAYLOAD_TYPE_DATA);
+
+    return buffer.buff_len;
+}
+
+static size_t
+bench_mqtt_publish_encode(void)
+{
+    uint16_t message_id = 0;
+    mqtt_message_t *message = mqtt_msg_publish(&s_mqtt_connection, "s",
+        (const char *)s_gateway_package, s_gateway_package_len, 1, 0, &message_id);
+
+    return message->length;
+}
+
+// feeds the stream in tcp sized segments the way mqtt_tcpclient_recv sees it.
+static size_t
+bench_mqtt_stream_parse(void)
+{
+    uint8_t in_buffer[MQTT_BUF_SIZE];
+    uint16_t read = 0;
+    uint16_t offset = 0;
+    uint16_t segment = 0;
+    uint16_t message_length = 0;
+    uint16_t topic_length = 0;
+    uint16_t data_length = 0;
+    size_t sum = 0;
+
+    while(offset < s_mqtt_stream_len)
+    {
+        segment = s_mqtt_stream_len - offset;
+        if(segment > STREAM_SEGMENT)
+        {
+            segment = STREAM_SEGMENT;
+        }
+
+        memcpy(in_buffer + read, s_mqtt_stream + offset, segment);
+        read += segment;
+        offset += segment;
+
+        while(read >= 2)
+        {
+            message_length = mqtt_get_total_length(in_buffer, read);
+            if(message_length > read)
+            {
+                break;
+            }
+
+            if(mqtt_get_type(in_buffer) == MQTT_MSG_TYPE_PUBLISH)
+            {
+                topic_length = message_length;
+                mqtt_get_publish_topic(in_buffer, &topic_length);
+                data_length = message_length;
+                mqtt_get_publish_data(in_buffer, &data_length);
+                sum += topic_length + data_length;
+
+                if(mqtt_get_qos(in_buffer) == 1)
+                {
+                    mqtt_msg_puback(&s_mqtt_connection, mqtt_get_id(in_buffer, message_length));
+                }
+            }
+
+            read -= message_length;
+            memmove(in_buffer, in_buffer + message_length, read);
+        }
+    }
+
+    s_sink = sum;
+    return s_mqtt_stream_len;
+}
+
+static size_t
+bench_queue_put_get(void)
+{
+    uint8_t out[MQTT_BUF_SIZE];
+    uint16_t length = 0;
+
+    QUEUE_Puts(&s_queue, s_gateway_package, s_gateway_package_len);
+    QUEUE_Gets(&s_queue, out, &length, sizeof(out));
+
+    return length;
+}
+
+// a package in a serial frame and back, the crc included, against the
+// byte-stuffed queue above.
+static size_t
+bench_cobs_frame(void)
+{
+    uint8_t encoded[PANDO_COBS_MAX(sizeof(s_gateway_package) + 2)];
+    uint8_t decoded[sizeof(s_gateway_package) + 2];
+    uint8_t crc_bytes[2];
+    struct pando_cobs_encoder encoder;
+    struct pando_cobs_decoder decoder;
+    uint16_t crc = pando_crc16(0xffff, s_gateway_package, s_gateway_package_len);
+    uint16_t length = 0;
+
+    crc_bytes[0] = crc >> 8;
+    crc_bytes[1] = crc & 0xff;
+    pando_cobs_encode_begin(&encoder, encoded);
+    pando_cobs_encode_put(&encoder, s_gateway_package, s_gateway_package_len);
+    pando_cobs_encode_put(&encoder, crc_bytes, sizeof(crc_bytes));
+    pando_cobs_decoder_init(&decoder, decoded, sizeof(decoded));
+    pando_cobs_decode(&decoder, encoded, pando_cobs_encode_end(&encoder), &length);
+
+    s_sink = pando_crc16(0xffff, decoded, length);
+    return length;
+}
+
+static size_t
+bench_tlv_json(void)
+{
+    static const char * const fields[] = {"mode", "count", "temperature"};
+    static const struct pando_tlv_json_name names[] =
+    {
+        {PAYLOAD_TYPE_DATA, 1, "sensor", fields, 3},
+        {PAYLOAD_TYPE_DATA, 2, "blob", NULL, 0}
+    };
+    char json[512];
+
+    return pando_tlv_json(s_device_package, s_device_package_len, names,
+        sizeof(names) / sizeof(names[0]), 0, json, sizeof(json));
+}
+
+// same table as the login response handler in pando_device_login.c.
+struct login_response
+{
+    int code;
+    char message[32];
+    char access_token[48];
+    char access_addr[64];
+};
+
+static const struct pando_json_field s_login_fields[] =
+{
+    PANDO_JSON_FIELD("code", PANDO_JSON_INT, struct login_response, code),
+    PANDO_JSON_FIELD("message", PANDO_JSON_STRING, struct login_response, message),
+    PANDO_JSON_FIELD("data.access_token", PANDO_JSON_STRING, struct login_response, access_token),
+    PANDO_JSON_FIELD("data.access_addr", PANDO_JSON_STRING, struct login_response, access_addr)
+};
+
+static size_t
+bench_json_login_parse(void)
+{
+    struct login_response result;
+
+    pando_json_extract(s_login_response, sizeof(s_login_response) - 1, s_login_fields,
+        sizeof(s_login_fields) / sizeof(s_login_fields[0]), &result);
+
+    s_sink = result.code + result.access_token[0] + result.access_addr[0];
+    return sizeof(s_login_response) - 1;
+}
+
+// the copy and token walk with a string compare per key the login handler
+// used before pando_json_extract, kept as the baseline.
+static size_t
+bench_json_login_walk(void)
+{
+    struct jsonparse_state json_state;
+    int code = -1;
+    int type = 0;
+    char message[64];
+    char access_token[48];
+    char access_addr[64];
+    char *copy = malloc(sizeof(s_login_response));
+
+    memcpy(copy, s_login_response, sizeof(s_login_response));
+    jsonparse_setup(&json_state, copy, sizeof(s_login_response) - 1);
+    while((type = jsonparse_next(&json_state)) != 0)
+    {
+        if(type != JSON_TYPE_PAIR_NAME)
+        {
+            continue;
+        }
+
+        if(jsonparse_strcmp_value(&json_state, "code") == 0)
+        {
+            jsonparse_next(&json_state);
+            jsonparse_next(&json_state);
+            code = jsonparse_get_value_as_int(&json_state);
+        }
+        else if(jsonparse_strcmp_value(&json_state, "message") == 0)
+        {
+            jsonparse_next(&json_state);
+            jsonparse_next(&json_state);
+            jsonparse_copy_value(&json_state, message, sizeof(message));
+        }
+        else if(jsonparse_strcmp_value(&json_state, "data") == 0)
+        {
+            while((type = jsonparse_next(&json_state)) != 0 && json_state.depth > 1)
+            {
+                if(type != JSON_TYPE_PAIR_NAME)
+                {
+                    continue;
+                }
+
+                if(jsonparse_strcmp_value(&json_state, "access_token") == 0)
+                {
+                    jsonparse_next(&json_state);
+                    jsonparse_next(&json_state);
+                    jsonparse_copy_value(&json_state, access_token, sizeof(access_token));
+                }
+                else if(jsonparse_strcmp_value(&json_state, "access_addr") == 0)
+                {
+                    jsonparse_next(&json_state);
+                    jsonparse_next(&json_state);
+                    jsonparse_copy_value(&json_state, access_addr, sizeof(access_addr));
+                }
+            }
+        }
+    }
+
+    free(copy);
+    s_sink = code + access_token[0] + access_addr[0];
+    return sizeof(s_login_response) - 1;
+}
+
+// same tree as the login request in pando_device_login.c.
+static size_t
+bench_json_login_request(void)
+{
+    char request[256];
+    struct jsontree_int json_device_id = JSONTREE_INT(12345);
+    struct jsontree_string json_device_secret = JSONTREE_STRING("0123456789abcdef0123456789abcdef");
+    struct jsontree_string json_protocol = JSONTREE_STRING("mqtt");
+
+    JSONTREE_OBJECT_EXT(device_info,
+        JSONTREE_PAIR("device_id", &json_device_id),
+        JSONTREE_PAIR("device_secret", &json_device_secret),
+        JSONTREE_PAIR("protocol", &json_protocol));
+
+    return pando_json_print((struct jsontree_value *)(&device_info), request, sizeof(request));
+}
+
+// the package to compact TLV headers and back, as a gateway does for a sub
+// device reading them. the size is the compact one.
+static size_t
+bench_tlv_compact(void)
+{
+    uint8_t compact[sizeof(s_device_package)];
+    uint8_t full[sizeof(s_device_package)];
+    int length = convert_package_tlv(s_device_package, s_device_package_len, compact, 1);
+
+    s_sink = convert_package_tlv(compact, length, full, 0);
+    return length;
+}
+
+static const struct bench_case s_cases[] =
+{
+    {"tlv_encode", bench_tlv_encode},
+    {"tlv_decode", bench_tlv_decode},
+    {"protocol_encode", bench_protocol_encode},
+    {"protocol_decode", bench_protocol_decode},
+    {"mqtt_publish_encode", bench_mqtt_publish_encode},
+    {"mqtt_stream_parse", bench_mqtt_stream_parse},
+    {"queue_put_get", bench_queue_put_get},
+    {"cobs_frame", bench_cobs_frame},
+    {"tlv_compact", bench_tlv_compact},
+    {"tlv_json", bench_tlv_json},
+    {"json_login_parse", bench_json_login_parse},
+    {"json_login_walk", bench_json_login_walk},
+    {"json_login_request", bench_json_login_request}
+};
+
+#define CASE_NUM    (sizeof(s_cases) / sizeof(s_cases[0]))
+
+static void
+fixtures_init(void)
+{
+    struct sub_device_base_params device_params;
+    struct protocol_base protocol_params;
+    struct sub_device_buffer *package = NULL;
+    uint16_t payload_type = 0;
+    uint16_t message_id = 0;
+    mqtt_message_t *message = NULL;
+    struct pando_buffer buffer;
+
+    memset(&device_params, 0, sizeof(device_params));
+    init_sub_device(device_params);
+
+    memset(&protocol_params, 0, sizeof(protocol_params));
+    protocol_params.device_id = 12345;
+    memset(protocol_params.token, 0xa5, sizeof(protocol_params.token));
+    pando_protocol_init(protocol_params);
+
+    package = build_data_package();
+    s_device_package_len = package->buffer_length;
+    memcpy(s_device_package, package->buffer, s_device_package_len);
+    delete_device_package(package);
+
+    memcpy(s_work + GATE_HEADER_LEN - DEV_HEADER_LEN, s_device_package, s_device_package_len);
+    buffer.buffer = s_work;
+    buffer.buff_len = GATE_HEADER_LEN - DEV_HEADER_LEN + s_device_package_len;
+    buffer.offset = GATE_HEADER_LEN - DEV_HEADER_LEN;
+    pando_protocol_encode(&buffer, &payload_type);
+    s_gateway_package_len = buffer.buff_len - buffer.offset;
+    memcpy(s_gateway_package, buffer.buffer + buffer.offset, s_gateway_package_len);
+
+    mqtt_msg_init(&s_mqtt_connection, s_mqtt_buffer, sizeof(s_mqtt_buffer));
+    s_mqtt_stream_len = 0;
+    while(s_mqtt_stream_len + 128 <= sizeof(s_mqtt_stream))
+    {
+        message = mqtt_msg_publish(&s_mqtt_connection, "s",
+            (const char *)s_gateway_package, s_gateway_package_len, 1, 0, &message_id);
+        memcpy(s_mqtt_stream + s_mqtt_stream_len, message->data, message->length);
+        s_mqtt_stream_len += message->length;
+    }
+
+    QUEUE_Init(&s_queue, QUEUE_BUFFER_SIZE);
+}
+
+static int
+selected(const char *name, int argc, char *argv[], int first)
+{
+    int i = 0;
+
+    if(first >= argc)
+    {
+        return 1;
+    }
+
+    for(i = first; i < argc; i++)
+    {
+        if(strcmp(argv[i], name) == 0)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int csv = 0;
+    int first = 1;
+    double min_time = 0.5;
+    size_t i = 0;
+
+    while(first < argc && argv[first][0] == '-')
+    {
+        if(strcmp(argv[first], "-c") == 0)
+        {
+            csv = 1;
+            first++;
+        }
+        else if(strcmp(argv[first], "-t") == 0 && first + 1 < argc)
+        {
+            min_time = atof(argv[first + 1]);
+            first += 2;
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [-c] [-t seconds] [name...]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    fixtures_init();
+
+    if(csv)
+    {
+        printf("name,ops,seconds,ops_per_sec,bytes_per_sec,ns_per_op\n");
+    }
+    else
+    {
+        printf("%-22s %12s %14s %14s %10s\n", "case", "ops", "ops/s", "MB/s", "ns/op");
+    }
+
+    for(i = 0; i < CASE_NUM; i++)
+    {
+        unsigned long ops = 0;
+        unsigned long batch = 1;
+        unsigned long n = 0;
+        double bytes = 0;
+        double start = 0;
+        double elapsed = 0;
+
+        if(!selected(s_cases[i].name, argc, argv, first))
+        {
+            continue;
+        }
+
+        // warm up, then grow the batch until the clock reads are negligible.
+        s_cases[i].run();
+        start = now();
+        do
+        {
+            for(n = 0; n < batch; n++)
+            {
+                bytes += s_cases[i].run();
+            }
+
+            ops += batch;
+            if(batch < 65536)
+            {
+                batch *= 2;
+            }
+
+            elapsed = now() - start;
+        } while(elapsed < min_time);
+
+        if(csv)
+        {
+            printf("%s,%lu,%.6f,%.1f,%.1f,%.2f\n", s_cases[i].name, ops, elapsed,
+                ops / elapsed, bytes / elapsed, elapsed * 1e9 / ops);
+        }
+        else
+        {
+            printf("%-22s %12lu %14.0f %14.2f %10.1f\n", s_cases[i].name, ops,
+                ops / elapsed, bytes / elapsed / 1e6, elapsed * 1e9 / ops);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+/*******************************************************
+ * File name: host_misc.c
+ * Author:
+ * Versions: 1.0
+ * Description: host side of platform_miscellaneous_interface.h, the parts
+ *              the trace and memory stat modules read.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#include <malloc.h>
+#include <time.h>
+
+#include "platform/include/platform_miscellaneous_interface.h"
+
+/******************************************************************************
+ * FunctionName : get_largest_free_block
+ * Description  : glibc does not expose its largest free chunk, the free bytes
+ *                held by the allocator are reported instead.
+ * Parameters   : none.
+ * Returns      : the size in bytes.
+*******************************************************************************/
+uint32_t
+get_largest_free_block(void)
+{
+    return mallinfo2().fordblks;
+}
+
+/******************************************************************************
+ * FunctionName : get_cycle_count
+ * Description  : the monotonic clock in nanoseconds, it wraps at 32 bits.
+ * Parameters   : none.
+ * Returns      : the counter.
+*******************************************************************************/
+uint32_t
+get_cycle_count(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+/******************************************************************************
+ * FunctionName : get_cycle_freq
+ * Description  : get the rate of the cycle counter.
+ * Parameters   : none.
+ * Returns      : counts per second.
+*******************************************************************************/
+uint32_t
+get_cycle_freq(void)
+{
+    return 1000000000;
+}
@@ -0,0 +1,594 @@
+/*******************************************************
+ * File name: loadgen.c
+ * Author:
+ * Versions: 1.0
+ * Description: end to end load generator for the gateway's cloud path. runs
+ *              pando_cloud_access against the loopback broker on a virtual
+ *              clock: the broker sends QoS 1 commands to sub device 1 at a
+ *              fixed rate and sub device 1 publishes data packages at a fixed
+ *              rate, over a link with a set round trip time and segment loss.
+ *              reports command latency (broker publish to sub device), the
+ *              command PUBACK time, publish latency (sub device to broker),
+ *              the publish PUBACK time and the sustained publish throughput.
+ *              the broker can redeliver a share of the commands, to count
+ *              the ones the sub device gets twice.
+ *              usage: loadgen [options], loadgen -h lists them.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "loop_platform.h"
+#include "loop_broker.h"
+#include "gateway/gateway_defs.h"
+#include "gateway/pando_channel.h"
+#include "gateway/pando_route.h"
+#include "gateway/pando_cloud_access.h"
+#include "protocol/pando_protocol.h"
+#include "protocol/sub_device_protocol.h"
+
+#define WARMUP_US       2000000ULL
+#define DRAIN_US        10000000ULL
+#define DEVICE_TOKEN    "0123456789abcdef"
+#define COMMAND_NUM     1
+#define PROPERTY_NUM    1
+
+extern uint8_t pando_device_token[];
+
+struct options
+{
+    double duration;        // seconds of load.
+    double command_rate;    // commands per second, 0 for none.
+    double publish_rate;    // publishes per second, 0 for none.
+    uint32_t payload;       // extra bytes in each publish.
+    uint32_t rtt_ms;
+    double loss;            // percent.
+    uint32_t rto_ms;
+    uint32_t seed;
+    uint32_t queue;         // depth of sub device 1's channel queue, 0 for none.
+    double redeliver;       // percent of the commands the broker sends again.
+    int csv;
+    int verbose;
+};
+
+struct latency_set
+{
+    const char *name;
+    double *samples;        // milliseconds.
+    size_t count;
+    size_t size;
+};
+
+// send time per sequence number, and whether it arrived.
+struct sequence_log
+{
+    uint64_t *sent_at;
+    uint8_t *received;
+    uint32_t count;
+    uint32_t size;
+};
+
+static struct options s_options;
+static struct sequence_log s_commands;
+static struct sequence_log s_publishes;
+static uint32_t *s_command_by_id;   // broker message id to command sequence.
+
+static struct latency_set s_command_latency = {"command_latency"};
+static struct latency_set s_command_puback = {"command_puback"};
+static struct latency_set s_publish_latency = {"publish_latency"};
+static struct latency_set s_publish_puback = {"publish_puback"};
+
+static uint64_t s_load_begin;
+static uint64_t s_load_end;
+static uint32_t s_publish_in_window;
+static uint64_t s_publish_bytes_in_window;
+static uint32_t s_commands_received;
+static uint32_t s_commands_duplicated;
+static uint32_t s_publishes_received;
+static int s_access_error;
+
+static void
+set_add(struct latency_set *set, double ms)
+{
+    if(set->count == set->size)
+    {
+        set->size = set->size? set->size * 2: 256;
+        set->samples = (double *)realloc(set->samples, set->size * sizeof(double));
+        if(set->samples == NULL)
+        {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+
+    set->samples[set->count++] = ms;
+}
+
+static int
+compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static double
+percentile(const struct latency_set *set, int pct)
+{
+    size_t index = (set->count * pct + 99) / 100;
+
+    return set->count? set->samples[index? index - 1: 0]: 0;
+}
+
+static uint32_t
+log_add(struct sequence_log *log, uint64_t at)
+{
+    if(log->count == log->size)
+    {
+        log->size = log->size? log->size * 2: 1024;
+        log->sent_at = (uint64_t *)realloc(log->sent_at, log->size * sizeof(uint64_t));
+        log->received = (uint8_t *)realloc(log->received, log->size);
+        if(log->sent_at == NULL || log->received == NULL)
+        {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+
+    log->sent_at[log->count] = at;
+    log->received[log->count] = 0;
+    return log->count++;
+}
+
+static void
+put_u16(uint8_t *p, uint16_t value)
+{
+    p[0] = value >> 8;
+    p[1] = value & 0xff;
+}
+
+static void
+put_u32(uint8_t *p, uint32_t value)
+{
+    p[0] = value >> 24;
+    p[1] = (value >> 16) & 0xff;
+    p[2] = (value >> 8) & 0xff;
+    p[3] = value & 0xff;
+}
+
+static uint32_t
+get_u32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* the broker side. */
+
+// the broker missed the PUBACK, arg is the message id.
+static void
+redeliver_command(void *arg, const uint8_t *data, uint16_t length)
+{
+    loop_broker_redeliver("c", data, length, (uint16_t)(uintptr_t)arg);
+}
+
+// gateway header, then sub device 1 command COMMAND_NUM with one uint32 sequence.
+static void
+send_command(void *arg, const uint8_t *data, uint16_t length)
+{
+    uint8_t packet[64];
+    uint8_t *p = packet;
+    struct mqtt_bin_header header;
+    uint32_t sequence = 0;
+    uint16_t message_id = 0;
+
+    if(loop_now() >= s_load_end)
+    {
+        return;
+    }
+
+    loop_schedule(loop_now() + (uint64_t)(1e6 / s_options.command_rate), send_command, NULL, NULL, 0);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.token, DEVICE_TOKEN, sizeof(header.token));
+    memcpy(p, &header, GATE_HEADER_LEN);
+    p += GATE_HEADER_LEN;
+
+    put_u16(p, 1);                  // sub device id.
+    put_u16(p + 2, COMMAND_NUM);
+    put_u16(p + 4, 0);              // priority.
+    put_u16(p + 6, 1);              // param count.
+    put_u16(p + 8, TLV_TYPE_UINT32);
+    p += 10;
+
+    sequence = log_add(&s_commands, loop_now());
+    put_u32(p, sequence);
+    p += 4;
+
+    message_id = loop_broker_publish("c", packet, p - packet, 1);
+    s_command_by_id[message_id] = sequence;
+    if(s_options.redeliver > 0 && loop_rand() % 10000 < s_options.redeliver * 100)
+    {
+        loop_schedule(loop_now() + s_options.rto_ms * 1000, redeliver_command,
+            (void *)(uintptr_t)message_id, packet, p - packet);
+    }
+}
+
+static void
+broker_connected(void)
+{
+    s_load_begin = loop_now() + WARMUP_US;
+    s_load_end = s_load_begin + (uint64_t)(s_options.duration * 1e6);
+}
+
+// data package from sub device 1, property PROPERTY_NUM starts with a uint32 sequence.
+static void
+broker_publish(const char *topic, uint16_t topic_length, const uint8_t *payload,
+    uint16_t length, uint64_t puback_at)
+{
+    uint32_t offset = GATE_HEADER_LEN + 8;
+    uint32_t sequence = 0;
+
+    if(topic_length != 1 || topic[0] != 's' || length < offset + 4)
+    {
+        return;
+    }
+
+    sequence = get_u32(payload + offset);
+    if(sequence >= s_publishes.count)
+    {
+        return;
+    }
+
+    s_publishes_received++;
+    set_add(&s_publish_latency, (loop_now() - s_publishes.sent_at[sequence]) / 1e3);
+    if(puback_at != 0)
+    {
+        set_add(&s_publish_puback, (puback_at - s_publishes.sent_at[sequence]) / 1e3);
+    }
+
+    if(loop_now() >= s_load_begin && loop_now() < s_load_end)
+    {
+        s_publish_in_window++;
+        s_publish_bytes_in_window += length;
+    }
+}
+
+static void
+broker_puback(uint16_t message_id)
+{
+    uint32_t sequence = s_command_by_id[message_id];
+
+    if(sequence < s_commands.count)
+    {
+        set_add(&s_command_puback, (loop_now() - s_commands.sent_at[sequence]) / 1e3);
+        // the PUBACK of a redelivery is not timed again.
+        s_command_by_id[message_id] = UINT32_MAX;
+    }
+}
+
+/* the sub device side. */
+
+// the gateway compacts the TLV headers of the command, the framework parser
+// reads either form.
+static void
+subdevice_recv(uint8_t *buffer, uint16_t length)
+{
+    uint32_t sequence = 0;
+    struct device_header *header = (struct device_header *)buffer;
+    struct sub_device_buffer package;
+    struct pando_command command;
+    struct TLVs *params = NULL;
+
+    if(length < DEV_HEADER_LEN + sizeof(struct pando_command) + 1
+        || net16_to_host(header->payload_type) != PAYLOAD_TYPE_COMMAND)
+    {
+        return;
+    }
+
+    package.buffer = buffer;
+    package.buffer_length = length;
+    params = get_sub_device_command(&package, &command);
+    if(command.command_num != COMMAND_NUM || net16_to_host(params->count) != 1)
+    {
+        return;
+    }
+
+    sequence = get_next_uint32(params);
+    if(sequence < s_commands.count && s_commands.received[sequence])
+    {
+        s_commands_duplicated++;
+    }
+    else if(sequence < s_commands.count)
+    {
+        s_commands.received[sequence] = 1;
+        s_commands_received++;
+        set_add(&s_command_latency, (loop_now() - s_commands.sent_at[sequence]) / 1e3);
+    }
+}
+
+static void
+send_publish(void *arg, const uint8_t *data, uint16_t length)
+{
+    static uint8_t filler[1024];
+    struct sub_device_buffer *package = NULL;
+    struct TLVs *params = NULL;
+
+    if(loop_now() >= s_load_end)
+    {
+        return;
+    }
+
+    loop_schedule(loop_now() + (uint64_t)(1e6 / s_options.publish_rate), send_publish, NULL, NULL, 0);
+
+    package = create_data_package(0);
+    params = create_params_block();
+    add_next_uint32(params, log_add(&s_publishes, loop_now()));
+    if(s_options.payload > 0)
+    {
+        add_next_bytes(params, s_options.payload, filler);
+    }
+
+    add_next_property(package, PROPERTY_NUM, params);
+    delete_params_block(params);
+    finish_package(package);
+
+    channel_send_to_device(PANDO_CHANNEL_PORT_1, package->buffer, package->buffer_length);
+    delete_device_package(package);
+}
+
+static void
+start_load(void *arg, const uint8_t *data, uint16_t length)
+{
+    if(s_options.command_rate > 0)
+    {
+        send_command(NULL, NULL, 0);
+    }
+
+    if(s_options.publish_rate > 0)
+    {
+        send_publish(NULL, NULL, 0);
+    }
+}
+
+static void
+access_error(int8_t result)
+{
+    s_access_error++;
+}
+
+/* report. */
+
+static void
+set_report(struct latency_set *set, uint32_t sent)
+{
+    double sum = 0;
+    size_t i = 0;
+
+    qsort(set->samples, set->count, sizeof(double), compare_double);
+    for(i = 0; i < set->count; i++)
+    {
+        sum += set->samples[i];
+    }
+
+    if(s_options.csv)
+    {
+        printf("%s_count,%zu\n", set->name, set->count);
+        printf("%s_lost,%u\n", set->name, sent > set->count? (unsigned)(sent - set->count): 0);
+        printf("%s_mean_ms,%.3f\n", set->name, set->count? sum / set->count: 0);
+        printf("%s_p50_ms,%.3f\n", set->name, percentile(set, 50));
+        printf("%s_p90_ms,%.3f\n", set->name, percentile(set, 90));
+        printf("%s_p99_ms,%.3f\n", set->name, percentile(set, 99));
+        printf("%s_max_ms,%.3f\n", set->name, set->count? set->samples[set->count - 1]: 0);
+    }
+    else
+    {
+        printf("%-16s %7zu/%-7u mean %8.2f  p50 %8.2f  p90 %8.2f  p99 %8.2f  max %8.2f ms\n",
+            set->name, set->count, sent, set->count? sum / set->count: 0, percentile(set, 50),
+            percentile(set, 90), percentile(set, 99), set->count? set->samples[set->count - 1]: 0);
+    }
+}
+
+static void
+report(double host_seconds)
+{
+    const struct loop_broker_stat *stat = loop_broker_get_stat();
+    double throughput = s_publish_in_window / s_options.duration;
+    double byte_rate = s_publish_bytes_in_window / s_options.duration;
+    uint32_t messages = s_commands_received + s_publishes_received;
+
+    if(s_options.csv)
+    {
+        printf("key,value\n");
+        printf("rtt_ms,%u\nloss_pct,%.2f\ncommand_rate,%.1f\npublish_rate,%.1f\n",
+            s_options.rtt_ms, s_options.loss, s_options.command_rate, s_options.publish_rate);
+    }
+    else
+    {
+        printf("rtt %u ms, loss %.2f%%, rto %u ms, %.0f commands/s, %.0f publishes/s, %.0f s\n",
+            s_options.rtt_ms, s_options.loss, s_options.rto_ms, s_options.command_rate,
+            s_options.publish_rate, s_options.duration);
+    }
+
+    set_report(&s_command_latency, s_commands.count);
+    set_report(&s_command_puback, s_commands.count);
+    set_report(&s_publish_latency, s_publishes.count);
+    set_report(&s_publish_puback, s_publishes.count);
+
+    if(s_options.csv)
+    {
+        printf("publish_throughput_per_s,%.2f\n", throughput);
+        printf("publish_bytes_per_s,%.1f\n", byte_rate);
+        printf("mqtt_connects,%u\n", stat->connects);
+        printf("broker_bad_packets,%u\n", stat->bad_packets);
+        printf("access_errors,%d\n", s_access_error);
+        printf("channel_dropped,%u\n", channel_queue_dropped(PANDO_CHANNEL_PORT_1));
+        printf("command_redeliveries,%u\n", stat->redeliveries);
+        printf("command_duplicates,%u\n", s_commands_duplicated);
+        printf("host_us_per_message,%.3f\n", messages? host_seconds * 1e6 / messages: 0);
+    }
+    else
+    {
+        printf("publish throughput %.2f/s, %.0f B/s\n", throughput, byte_rate);
+        printf("mqtt connects %u, pings %u, bad packets %u, access errors %d\n",
+            stat->connects, stat->pings, stat->bad_packets, s_access_error);
+        printf("channel queue dropped %u\n", channel_queue_dropped(PANDO_CHANNEL_PORT_1));
+        printf("command redeliveries %u, delivered twice %u\n", stat->redeliveries,
+            s_commands_duplicated);
+        printf("host time %.3f s, %.2f us per delivered message\n", host_seconds,
+            messages? host_seconds * 1e6 / messages: 0);
+    }
+}
+
+static void
+usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  -d seconds   load duration, default 30\n"
+        "  -r rate      commands per second, default 10\n"
+        "  -p rate      publishes per second, default 10\n"
+        "  -b bytes     extra publish payload, default 0\n"
+        "  -R ms        round trip time, default 50\n"
+        "  -l percent   segment loss, default 0\n"
+        "  -o ms        retransmission delay of a lost segment, default 300\n"
+        "  -s seed      random seed, default 1\n"
+        "  -q depth     queue the commands of sub device 1, default 0 for none\n"
+        "  -u percent   commands the broker redelivers, default 0\n"
+        "  -c           csv report\n"
+        "  -v           keep the framework's console output\n", name);
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct loop_link link;
+    struct loop_peer peer;
+    struct loop_broker_handler handler;
+    struct sub_device_base_params device_params;
+    struct timespec begin;
+    struct timespec end;
+    int i = 0;
+
+    s_options.duration = 30;
+    s_options.command_rate = 10;
+    s_options.publish_rate = 10;
+    s_options.rtt_ms = 50;
+    s_options.rto_ms = 300;
+    s_options.seed = 1;
+
+    for(i = 1; i < argc; i++)
+    {
+        const char *value = i + 1 < argc? argv[i + 1]: NULL;
+
+        if(strcmp(argv[i], "-c") == 0)
+        {
+            s_options.csv = 1;
+            continue;
+        }
+
+        if(strcmp(argv[i], "-v") == 0)
+        {
+            s_options.verbose = 1;
+            continue;
+        }
+
+        if(value == NULL || argv[i][0] != '-' || strlen(argv[i]) != 2)
+        {
+            usage(argv[0]);
+            return 2;
+        }
+
+        switch(argv[i][1])
+        {
+            case 'd': s_options.duration = atof(value); break;
+            case 'r': s_options.command_rate = atof(value); break;
+            case 'p': s_options.publish_rate = atof(value); break;
+            case 'b': s_options.payload = atoi(value); break;
+            case 'R': s_options.rtt_ms = atoi(value); break;
+            case 'l': s_options.loss = atof(value); break;
+            case 'o': s_options.rto_ms = atoi(value); break;
+            case 's': s_options.seed = strtoul(value, NULL, 0); break;
+            case 'q': s_options.queue = atoi(value); break;
+            case 'u': s_options.redeliver = atof(value); break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+
+        i++;
+    }
+
+    if(s_options.duration <= 0 || s_options.payload > 1024 || s_options.queue > 255)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    s_command_by_id = (uint32_t *)calloc(65536, sizeof(uint32_t));
+
+    memset(&link, 0, sizeof(link));
+    link.rtt_us = s_options.rtt_ms * 1000;
+    link.loss_permille = (uint32_t)(s_options.loss * 10);
+    link.rto_us = s_options.rto_ms * 1000;
+
+    memset(&peer, 0, sizeof(peer));
+    peer.connected = loop_broker_connected;
+    peer.recv = loop_broker_recv;
+    loop_init(&link, &peer, s_options.seed);
+
+    memset(&handler, 0, sizeof(handler));
+    handler.connected = broker_connected;
+    handler.publish = broker_publish;
+    handler.puback = broker_puback;
+    loop_broker_init(&handler);
+
+    loop_data_set(DATANAME_ACCESS_ADDR, "127.0.0.1:1883");
+    loop_data_set(DATANAME_DEVICE_ID, "12345");
+    loop_data_set(DATANAME_ACCESS_TOKEN, "0123456789abcdef0123456789abcdef");
+    memcpy(pando_device_token, DEVICE_TOKEN, 16);
+
+    memset(&device_params, 0, sizeof(device_params));
+    init_sub_device(device_params);
+    pando_route_add(1, PANDO_CHANNEL_PORT_1);
+    on_subdevice_channel_recv(PANDO_CHANNEL_PORT_1, subdevice_recv);
+    if(s_options.queue > 0)
+    {
+        // congested at three quarters, until drained to a quarter.
+        channel_queue_init(PANDO_CHANNEL_PORT_1, s_options.queue,
+            (s_options.queue * 3 + 3) / 4, s_options.queue / 4, CHANNEL_DROP_OLDEST);
+    }
+
+    if(!s_options.verbose)
+    {
+        loop_quiet(1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    pando_cloud_access(access_error);
+
+    // the load starts after the warm up that follows the first CONNACK.
+    loop_run(WARMUP_US);
+    if(s_load_end == 0)
+    {
+        loop_quiet(0);
+        fprintf(stderr, "gateway did not connect to the broker\n");
+        return 1;
+    }
+
+    loop_schedule(s_load_begin, start_load, NULL, NULL, 0);
+    loop_run(s_load_end + DRAIN_US);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    loop_quiet(0);
+    report((end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9);
+
+    return 0;
+}
@@ -0,0 +1,272 @@
+/*******************************************************
+ * File name: loop_broker.c
+ * Author:
+ * Versions: 1.0
+ * Description: minimal mqtt 3.1.1 broker stand-in for the loopback platform.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#include <string.h>
+
+#include "loop_broker.h"
+#include "loop_platform.h"
+
+#define BROKER_BUF_SIZE     4096
+
+#define MQTT_CONNECT        1
+#define MQTT_PUBLISH        3
+#define MQTT_PUBACK         4
+#define MQTT_SUBSCRIBE      8
+#define MQTT_PINGREQ        12
+#define MQTT_DISCONNECT     14
+
+static struct loop_broker_handler s_handler;
+static struct loop_broker_stat s_stat;
+static uint8_t s_in[BROKER_BUF_SIZE];
+static uint16_t s_in_length;
+static uint16_t s_message_id;
+
+static uint64_t
+send_ack(uint8_t head, uint16_t message_id)
+{
+    uint8_t ack[4];
+
+    ack[0] = head;
+    ack[1] = 2;
+    ack[2] = message_id >> 8;
+    ack[3] = message_id & 0xff;
+
+    return loop_peer_send(ack, sizeof(ack));
+}
+
+static void
+handle_publish(uint8_t flags, const uint8_t *body, uint32_t length)
+{
+    uint8_t qos = (flags >> 1) & 0x03;
+    uint16_t topic_length = 0;
+    uint16_t message_id = 0;
+    uint32_t position = 2;
+    uint64_t puback_at = 0;
+
+    if(length < 2)
+    {
+        s_stat.bad_packets++;
+        return;
+    }
+
+    topic_length = (body[0] << 8) | body[1];
+    position += topic_length;
+    if(position + (qos? 2: 0) > length)
+    {
+        s_stat.bad_packets++;
+        return;
+    }
+
+    if(qos > 0)
+    {
+        message_id = (body[position] << 8) | body[position + 1];
+        position += 2;
+    }
+
+    s_stat.publishes_in++;
+    if(qos == 1)
+    {
+        puback_at = send_ack(0x40, message_id);
+    }
+
+    if(s_handler.publish != NULL)
+    {
+        s_handler.publish((const char *)body + 2, topic_length, body + position,
+            length - position, puback_at);
+    }
+}
+
+static void
+handle_packet(uint8_t head, const uint8_t *body, uint32_t length)
+{
+    static const uint8_t connack[] = {0x20, 0x02, 0x00, 0x00};
+    static const uint8_t pingresp[] = {0xd0, 0x00};
+    uint8_t suback[5];
+
+    switch(head >> 4)
+    {
+        case MQTT_CONNECT:
+            s_stat.connects++;
+            loop_peer_send(connack, sizeof(connack));
+            if(s_handler.connected != NULL)
+            {
+                s_handler.connected();
+            }
+            break;
+        case MQTT_PUBLISH:
+            handle_publish(head & 0x0f, body, length);
+            break;
+        case MQTT_PUBACK:
+            s_stat.pubacks_in++;
+            if(length >= 2 && s_handler.puback != NULL)
+            {
+                s_handler.puback((body[0] << 8) | body[1]);
+            }
+            break;
+        case MQTT_SUBSCRIBE:
+            s_stat.subscribes++;
+            suback[0] = 0x90;
+            suback[1] = 3;
+            suback[2] = body[0];
+            suback[3] = body[1];
+            suback[4] = 0;
+            loop_peer_send(suback, sizeof(suback));
+            break;
+        case MQTT_PINGREQ:
+            s_stat.pings++;
+            loop_peer_send(pingresp, sizeof(pingresp));
+            break;
+        case MQTT_DISCONNECT:
+            break;
+        default:
+            s_stat.bad_packets++;
+            break;
+    }
+}
+
+void
+loop_broker_init(const struct loop_broker_handler *handler)
+{
+    s_handler = *handler;
+    memset(&s_stat, 0, sizeof(s_stat));
+    s_in_length = 0;
+    s_message_id = 0;
+}
+
+void
+loop_broker_connected(void)
+{
+    s_in_length = 0;
+}
+
+void
+loop_broker_recv(const uint8_t *data, uint16_t length)
+{
+    uint32_t remaining = 0;
+    uint32_t multiplier = 1;
+    uint16_t header = 1;
+    uint32_t total = 0;
+
+    if(s_in_length + length > BROKER_BUF_SIZE)
+    {
+        s_stat.bad_packets++;
+        s_in_length = 0;
+        return;
+    }
+
+    memcpy(s_in + s_in_length, data, length);
+    s_in_length += length;
+
+    while(s_in_length >= 2)
+    {
+        remaining = 0;
+        multiplier = 1;
+        header = 1;
+        do
+        {
+            if(header >= s_in_length)
+            {
+                return;
+            }
+
+            remaining += (s_in[header] & 0x7f) * multiplier;
+            multiplier *= 128;
+        } while((s_in[header++] & 0x80) != 0);
+
+        total = header + remaining;
+        if(total > s_in_length)
+        {
+            return;
+        }
+
+        handle_packet(s_in[0], s_in + header, remaining);
+        s_in_length -= total;
+        memmove(s_in, s_in + total, s_in_length);
+    }
+}
+
+// a qos 1 publish gets the next message id, unless it is a redelivery.
+static uint16_t
+send_publish(const char *topic, const uint8_t *payload, uint16_t length, uint8_t qos,
+    uint16_t redelivered_id)
+{
+    uint8_t packet[BROKER_BUF_SIZE];
+    uint16_t topic_length = strlen(topic);
+    uint32_t remaining = 2 + topic_length + (qos? 2: 0) + length;
+    uint16_t position = 1;
+    uint16_t message_id = 0;
+
+    if(remaining + 5 > sizeof(packet))
+    {
+        return 0;
+    }
+
+    packet[0] = 0x30 | (qos << 1) | (redelivered_id? 0x08: 0);
+    do
+    {
+        packet[position] = remaining & 0x7f;
+        remaining >>= 7;
+        if(remaining > 0)
+        {
+            packet[position] |= 0x80;
+        }
+        position++;
+    } while(remaining > 0);
+
+    packet[position++] = topic_length >> 8;
+    packet[position++] = topic_length & 0xff;
+    memcpy(packet + position, topic, topic_length);
+    position += topic_length;
+
+    if(qos)
+    {
+        message_id = redelivered_id;
+        if(message_id == 0)
+        {
+            if(++s_message_id == 0)
+            {
+                s_message_id = 1;
+            }
+
+            message_id = s_message_id;
+        }
+
+        packet[position++] = message_id >> 8;
+        packet[position++] = message_id & 0xff;
+    }
+
+    memcpy(packet + position, payload, length);
+    position += length;
+
+    s_stat.publishes_out++;
+    loop_peer_send(packet, position);
+
+    return message_id;
+}
+
+uint16_t
+loop_broker_publish(const char *topic, const uint8_t *payload, uint16_t length, uint8_t qos)
+{
+    return send_publish(topic, payload, length, qos, 0);
+}
+
+void
+loop_broker_redeliver(const char *topic, const uint8_t *payload, uint16_t length, uint16_t message_id)
+{
+    s_stat.redeliveries++;
+    send_publish(topic, payload, length, 1, message_id);
+}
+
+const struct loop_broker_stat *
+loop_broker_get_stat(void)
+{
+    return &s_stat;
+}
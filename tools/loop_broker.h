@@ -0,0 +1,99 @@
+/*********************************************************
+ * File name: loop_broker.h
+ * Author:
+ * Versions: 1.0
+ * Description: minimal mqtt 3.1.1 broker stand-in for the loopback platform.
+ *              it accepts any CONNECT, acknowledges SUBSCRIBE, PINGREQ and
+ *              QoS 1 PUBLISH, and hands the client's publishes and acks to the
+ *              tool driving it. there is no routing and no session state.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#ifndef _LOOP_BROKER_H_
+#define _LOOP_BROKER_H_
+
+#include <stdint.h>
+
+struct loop_broker_handler
+{
+    // CONNACK has been sent.
+    void (*connected)(void);
+    // a PUBLISH from the client, puback_at is when the client gets the PUBACK, 0 for QoS 0.
+    void (*publish)(const char *topic, uint16_t topic_length,
+        const uint8_t *payload, uint16_t payload_length, uint64_t puback_at);
+    // the client acknowledged a QoS 1 publish of the broker.
+    void (*puback)(uint16_t message_id);
+};
+
+struct loop_broker_stat
+{
+    uint32_t connects;
+    uint32_t subscribes;
+    uint32_t pings;
+    uint32_t publishes_in;
+    uint32_t publishes_out;
+    uint32_t redeliveries;
+    uint32_t pubacks_in;
+    uint32_t bad_packets;
+};
+
+/******************************************************************************
+ * FunctionName : loop_broker_init
+ * Description  : reset the broker.
+ * Parameters   : handler: the callbacks of the driving tool.
+ * Returns      : none.
+*******************************************************************************/
+void loop_broker_init(const struct loop_broker_handler *handler);
+
+/******************************************************************************
+ * FunctionName : loop_broker_connected
+ * Description  : a new tcp connection, drops any partial packet. loop_peer.connected.
+ * Parameters   : none.
+ * Returns      : none.
+*******************************************************************************/
+void loop_broker_connected(void);
+
+/******************************************************************************
+ * FunctionName : loop_broker_recv
+ * Description  : bytes from the client, loop_peer.recv.
+ * Parameters   : data: the bytes.
+ *                length: byte count.
+ * Returns      : none.
+*******************************************************************************/
+void loop_broker_recv(const uint8_t *data, uint16_t length);
+
+/******************************************************************************
+ * FunctionName : loop_broker_publish
+ * Description  : publish to the client.
+ * Parameters   : topic: the topic.
+ *                payload: the payload.
+ *                length: payload length.
+ *                qos: 0 or 1.
+ * Returns      : the message id, 0 for QoS 0.
+*******************************************************************************/
+uint16_t loop_broker_publish(const char *topic, const uint8_t *payload, uint16_t length, uint8_t qos);
+
+/******************************************************************************
+ * FunctionName : loop_broker_redeliver
+ * Description  : publish a QoS 1 message to the client again, with the DUP
+ *                flag, as a broker does when it misses the PUBACK.
+ * Parameters   : topic: the topic.
+ *                payload: the payload.
+ *                length: payload length.
+ *                message_id: the id loop_broker_publish returned.
+ * Returns      : none.
+*******************************************************************************/
+void loop_broker_redeliver(const char *topic, const uint8_t *payload, uint16_t length, uint16_t message_id);
+
+/******************************************************************************
+ * FunctionName : loop_broker_get_stat
+ * Description  : the packet counters.
+ * Parameters   : none.
+ * Returns      : the counters.
+*******************************************************************************/
+const struct loop_broker_stat *loop_broker_get_stat(void);
+
+#endif /* _LOOP_BROKER_H_ */
@@ -0,0 +1,661 @@
+/*******************************************************
+ * File name: loop_platform.c
+ * Author:
+ * Versions: 1.0
+ * Description: host loopback platform, implements pando_net_tcp.h,
+ *              pando_timer.h, pando_task.h and pando_data_get on a virtual
+ *              clock.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "loop_platform.h"
+#include "platform/include/pando_net_tcp.h"
+#include "platform/include/pando_timer.h"
+#include "platform/include/pando_task.h"
+#include "platform/include/pando_storage_interface.h"
+
+#define LOOP_TIMER_NUM  8
+#define LOOP_DATA_NUM   8
+
+struct loop_event
+{
+    uint64_t at;
+    uint64_t order;
+    loop_event_cb cb;
+    void *arg;
+    uint8_t *data;
+    uint16_t length;
+};
+
+struct loop_segment
+{
+    struct loop_segment *next;
+    uint64_t at;
+    uint16_t length;
+    uint8_t data[];
+};
+
+// one direction of the tcp link, segments are delivered in order.
+struct loop_pipe
+{
+    struct loop_segment *head;
+    struct loop_segment *tail;
+    uint64_t last_at;
+};
+
+struct loop_timer
+{
+    struct pd_timer *timer;
+    uint32_t generation;
+};
+
+struct loop_data
+{
+    char key[32];
+    char value[96];
+};
+
+static struct loop_event *s_heap;
+static size_t s_heap_count;
+static size_t s_heap_size;
+static uint64_t s_order;
+static uint64_t s_now;
+static uint32_t s_rand;
+
+static struct loop_link s_link;
+static struct loop_peer s_peer;
+static struct pando_tcp_conn *s_conn;
+static uint32_t s_conn_generation;
+static struct loop_pipe s_up;       // framework to peer.
+static struct loop_pipe s_down;     // peer to framework.
+static int s_recv_hold;
+
+static struct loop_timer s_timer[LOOP_TIMER_NUM];
+static struct loop_data s_data[LOOP_DATA_NUM];
+static int s_saved_stdout = -1;
+
+static int
+event_before(const struct loop_event *a, const struct loop_event *b)
+{
+    return a->at < b->at || (a->at == b->at && a->order < b->order);
+}
+
+static void
+heap_push(struct loop_event *event)
+{
+    size_t i = s_heap_count++;
+
+    if(s_heap_count > s_heap_size)
+    {
+        s_heap_size = s_heap_size? s_heap_size * 2: 256;
+        s_heap = (struct loop_event *)realloc(s_heap, s_heap_size * sizeof(struct loop_event));
+        if(s_heap == NULL)
+        {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+
+    while(i > 0 && event_before(event, &s_heap[(i - 1) / 2]))
+    {
+        s_heap[i] = s_heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+
+    s_heap[i] = *event;
+}
+
+static void
+heap_pop(struct loop_event *event)
+{
+    struct loop_event last;
+    size_t i = 0;
+    size_t child = 0;
+
+    *event = s_heap[0];
+    last = s_heap[--s_heap_count];
+
+    while((child = 2 * i + 1) < s_heap_count)
+    {
+        if(child + 1 < s_heap_count && event_before(&s_heap[child + 1], &s_heap[child]))
+        {
+            child++;
+        }
+
+        if(!event_before(&s_heap[child], &last))
+        {
+            break;
+        }
+
+        s_heap[i] = s_heap[child];
+        i = child;
+    }
+
+    s_heap[i] = last;
+}
+
+static void
+pipe_clear(struct loop_pipe *pipe)
+{
+    struct loop_segment *segment = NULL;
+
+    while((segment = pipe->head) != NULL)
+    {
+        pipe->head = segment->next;
+        free(segment);
+    }
+
+    pipe->tail = NULL;
+    pipe->last_at = 0;
+}
+
+// pop the segments due now, merged up to the mss, returns the merged length.
+static uint16_t
+pipe_take(struct loop_pipe *pipe, uint8_t *buffer)
+{
+    struct loop_segment *segment = NULL;
+    uint16_t length = 0;
+
+    while((segment = pipe->head) != NULL && segment->at <= s_now
+        && (length == 0 || length + segment->length <= s_link.mss))
+    {
+        memcpy(buffer + length, segment->data, segment->length);
+        length += segment->length;
+        pipe->head = segment->next;
+        free(segment);
+    }
+
+    if(pipe->head == NULL)
+    {
+        pipe->tail = NULL;
+    }
+
+    return length;
+}
+
+static void
+pipe_deliver_down(void *arg, const uint8_t *data, uint16_t length)
+{
+    uint8_t buffer[2048];
+    struct data_buf recv;
+
+    if((uint32_t)(unsigned long)arg != s_conn_generation || s_conn == NULL)
+    {
+        return;
+    }
+
+    // held segments stay in the pipe, the release delivers them.
+    while(!s_recv_hold && (recv.length = pipe_take(&s_down, buffer)) > 0)
+    {
+        recv.data = (char *)buffer;
+        if(s_conn->recv_callback != NULL)
+        {
+            s_conn->recv_callback(s_conn, &recv);
+        }
+
+        if((uint32_t)(unsigned long)arg != s_conn_generation)
+        {
+            return;
+        }
+    }
+}
+
+static void
+conn_sent(void *arg, const uint8_t *data, uint16_t length)
+{
+    if((uint32_t)(unsigned long)arg == s_conn_generation && s_conn != NULL
+        && s_conn->sent_callback != NULL)
+    {
+        s_conn->sent_callback(s_conn, 0);
+    }
+}
+
+static void
+pipe_deliver_up(void *arg, const uint8_t *data, uint16_t length)
+{
+    uint8_t buffer[2048];
+    uint16_t recv_length = 0;
+
+    if((uint32_t)(unsigned long)arg != s_conn_generation)
+    {
+        return;
+    }
+
+    while((recv_length = pipe_take(&s_up, buffer)) > 0)
+    {
+        s_peer.recv(buffer, recv_length);
+    }
+}
+
+// queue a segment, returns its delivery time.
+static uint64_t
+pipe_send(struct loop_pipe *pipe, loop_event_cb deliver, const uint8_t *data, uint16_t length)
+{
+    struct loop_segment *segment = NULL;
+    uint64_t at = s_now + s_link.rtt_us / 2;
+
+    if(loop_rand() % 1000 < s_link.loss_permille)
+    {
+        at += s_link.rto_us;
+    }
+
+    // tcp delivers in order, a resent segment holds back the ones behind it.
+    if(at < pipe->last_at)
+    {
+        at = pipe->last_at;
+    }
+
+    pipe->last_at = at;
+
+    segment = (struct loop_segment *)malloc(sizeof(struct loop_segment) + length);
+    segment->next = NULL;
+    segment->at = at;
+    segment->length = length;
+    memcpy(segment->data, data, length);
+
+    if(pipe->tail != NULL)
+    {
+        pipe->tail->next = segment;
+    }
+    else
+    {
+        pipe->head = segment;
+    }
+
+    pipe->tail = segment;
+    loop_schedule(at, deliver, (void *)(unsigned long)s_conn_generation, NULL, 0);
+
+    return at;
+}
+
+static void
+conn_connected(void *arg, const uint8_t *data, uint16_t length)
+{
+    if((uint32_t)(unsigned long)arg != s_conn_generation || s_conn == NULL)
+    {
+        return;
+    }
+
+    if(s_conn->connected_callback != NULL)
+    {
+        s_conn->connected_callback(s_conn, 0);
+    }
+
+    if(s_peer.connected != NULL)
+    {
+        s_peer.connected();
+    }
+}
+
+static void
+timer_expire(void *arg, const uint8_t *data, uint16_t length)
+{
+    struct loop_timer *slot = (struct loop_timer *)arg;
+    struct pd_timer *timer = slot->timer;
+    uint32_t generation = 0;
+
+    memcpy(&generation, data, sizeof(generation));
+    if(timer == NULL || generation != slot->generation)
+    {
+        return;
+    }
+
+    if(timer->repeated)
+    {
+        loop_schedule(s_now + timer->interval * 1000ULL, timer_expire, slot,
+            &slot->generation, sizeof(slot->generation));
+    }
+    else
+    {
+        slot->timer = NULL;
+    }
+
+    if(timer->timer_cb != NULL)
+    {
+        timer->timer_cb(timer->arg);
+    }
+}
+
+static struct loop_timer *
+timer_slot(struct pd_timer *timer)
+{
+    int i = 0;
+    struct loop_timer *free_slot = NULL;
+
+    for(i = 0; i < LOOP_TIMER_NUM; i++)
+    {
+        if(s_timer[i].timer == timer)
+        {
+            return &s_timer[i];
+        }
+
+        if(s_timer[i].timer == NULL && free_slot == NULL)
+        {
+            free_slot = &s_timer[i];
+        }
+    }
+
+    return free_slot;
+}
+
+void
+loop_init(const struct loop_link *link, const struct loop_peer *peer, uint32_t seed)
+{
+    struct loop_event event;
+
+    while(s_heap_count > 0)
+    {
+        heap_pop(&event);
+        free(event.data);
+    }
+
+    pipe_clear(&s_up);
+    pipe_clear(&s_down);
+    memset(s_timer, 0, sizeof(s_timer));
+
+    s_link = *link;
+    if(s_link.mss == 0)
+    {
+        s_link.mss = 536;
+    }
+
+    s_peer = *peer;
+    s_conn = NULL;
+    s_conn_generation++;
+    s_now = 0;
+    s_order = 0;
+    s_rand = seed? seed: 1;
+}
+
+uint64_t
+loop_now(void)
+{
+    return s_now;
+}
+
+void
+loop_schedule(uint64_t at, loop_event_cb cb, void *arg, const void *data, uint16_t length)
+{
+    struct loop_event event;
+
+    event.at = at < s_now? s_now: at;
+    event.order = s_order++;
+    event.cb = cb;
+    event.arg = arg;
+    event.length = length;
+    event.data = NULL;
+
+    if(data != NULL && length > 0)
+    {
+        event.data = (uint8_t *)malloc(length);
+        memcpy(event.data, data, length);
+    }
+
+    heap_push(&event);
+}
+
+void
+loop_run(uint64_t end)
+{
+    struct loop_event event;
+
+    while(s_heap_count > 0 && s_heap[0].at <= end)
+    {
+        heap_pop(&event);
+        s_now = event.at;
+        event.cb(event.arg, event.data, event.length);
+        free(event.data);
+    }
+
+    if(s_now < end)
+    {
+        s_now = end;
+    }
+}
+
+uint64_t
+loop_peer_send(const uint8_t *data, uint16_t length)
+{
+    if(s_conn == NULL)
+    {
+        return 0;
+    }
+
+    return pipe_send(&s_down, pipe_deliver_down, data, length);
+}
+
+void
+loop_data_set(const char *key, const char *value)
+{
+    int i = 0;
+
+    for(i = 0; i < LOOP_DATA_NUM; i++)
+    {
+        if(s_data[i].key[0] == '\0' || strcmp(s_data[i].key, key) == 0)
+        {
+            snprintf(s_data[i].key, sizeof(s_data[i].key), "%s", key);
+            snprintf(s_data[i].value, sizeof(s_data[i].value), "%s", value);
+            return;
+        }
+    }
+}
+
+uint32_t
+loop_rand(void)
+{
+    // xorshift32.
+    s_rand ^= s_rand << 13;
+    s_rand ^= s_rand >> 17;
+    s_rand ^= s_rand << 5;
+    return s_rand;
+}
+
+void
+loop_quiet(int quiet)
+{
+    int null_fd = -1;
+
+    fflush(stdout);
+    if(quiet && s_saved_stdout < 0)
+    {
+        null_fd = open("/dev/null", O_WRONLY);
+        if(null_fd >= 0)
+        {
+            s_saved_stdout = dup(STDOUT_FILENO);
+            dup2(null_fd, STDOUT_FILENO);
+            close(null_fd);
+        }
+    }
+    else if(!quiet && s_saved_stdout >= 0)
+    {
+        dup2(s_saved_stdout, STDOUT_FILENO);
+        close(s_saved_stdout);
+        s_saved_stdout = -1;
+    }
+}
+
+/* pando_net_tcp.h, one client connection to the peer. */
+
+void
+net_tcp_connect(struct pando_tcp_conn *conn, uint16_t timeout)
+{
+    pipe_clear(&s_up);
+    pipe_clear(&s_down);
+    s_conn = conn;
+    s_conn_generation++;
+    s_recv_hold = 0;
+
+    // syn and syn-ack.
+    loop_schedule(s_now + s_link.rtt_us, conn_connected,
+        (void *)(unsigned long)s_conn_generation, NULL, 0);
+}
+
+void
+net_tcp_register_connected_callback(struct pando_tcp_conn *conn, net_tcp_connected_callback connected_cb)
+{
+    conn->connected_callback = connected_cb;
+}
+
+void
+net_tcp_send(struct pando_tcp_conn *conn, struct data_buf buffer, uint16_t timeout)
+{
+    uint64_t at = 0;
+
+    if(conn != s_conn)
+    {
+        return;
+    }
+
+    at = pipe_send(&s_up, pipe_deliver_up, (const uint8_t *)buffer.data, buffer.length);
+
+    // the sent callback follows the peer's ack.
+    loop_schedule(at + s_link.rtt_us / 2, conn_sent,
+        (void *)(unsigned long)s_conn_generation, NULL, 0);
+}
+
+void
+net_tcp_register_sent_callback(struct pando_tcp_conn *conn, net_tcp_sent_callback sent_cb)
+{
+    conn->sent_callback = sent_cb;
+}
+
+void
+net_tcp_register_recv_callback(struct pando_tcp_conn *conn, net_tcp_recv_callback recv_cb)
+{
+    conn->recv_callback = recv_cb;
+}
+
+void
+net_tcp_recv_hold(struct pando_tcp_conn *conn, uint8_t hold)
+{
+    if(conn != s_conn)
+    {
+        return;
+    }
+
+    s_recv_hold = hold;
+    if(!hold)
+    {
+        loop_schedule(s_now, pipe_deliver_down, (void *)(unsigned long)s_conn_generation, NULL, 0);
+    }
+}
+
+void
+net_tcp_disconnect(struct pando_tcp_conn *conn)
+{
+    // the framework frees conn right after, so no callback follows.
+    if(conn == s_conn)
+    {
+        s_conn = NULL;
+        s_conn_generation++;
+        pipe_clear(&s_up);
+        pipe_clear(&s_down);
+    }
+}
+
+void
+net_tcp_register_disconnected_callback(struct pando_tcp_conn *conn, net_tcp_disconnected_callback disconnected_cb)
+{
+    conn->disconnected_callback = disconnected_cb;
+}
+
+int8_t
+net_tcp_server_listen(struct pando_tcp_conn *conn)
+{
+    return -1;
+}
+
+void
+net_tcp_server_accept(struct pando_tcp_conn *conn)
+{
+}
+
+/* pando_timer.h */
+
+void
+pando_timer_init(struct pd_timer *timer)
+{
+}
+
+void
+pando_timer_start(struct pd_timer *timer)
+{
+    struct loop_timer *slot = timer_slot(timer);
+
+    if(slot == NULL)
+    {
+        fprintf(stderr, "loop: out of timers\n");
+        return;
+    }
+
+    slot->timer = timer;
+    slot->generation++;
+    loop_schedule(s_now + timer->interval * 1000ULL, timer_expire, slot,
+        &slot->generation, sizeof(slot->generation));
+}
+
+void
+pando_timer_stop(struct pd_timer *timer)
+{
+    struct loop_timer *slot = timer_slot(timer);
+
+    if(slot != NULL && slot->timer == timer)
+    {
+        slot->generation++;
+        slot->timer = NULL;
+    }
+}
+
+/* pando_task.h */
+
+static void
+task_run(void *arg, const uint8_t *data, uint16_t length)
+{
+    struct pd_task *task = (struct pd_task *)arg;
+
+    task->pending = 0;
+    task->task_cb(task->arg);
+}
+
+void
+pando_task_init(struct pd_task *task)
+{
+    task->pending = 0;
+}
+
+void
+pando_task_post(struct pd_task *task)
+{
+    if(!task->pending)
+    {
+        task->pending = 1;
+        loop_schedule(s_now, task_run, task, NULL, 0);
+    }
+}
+
+/* pando_storage_interface.h */
+
+char *
+pando_data_get(char *key)
+{
+    int i = 0;
+
+    for(i = 0; i < LOOP_DATA_NUM; i++)
+    {
+        if(strcmp(s_data[i].key, key) == 0)
+        {
+            return s_data[i].value;
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,113 @@
+/*********************************************************
+ * File name: loop_platform.h
+ * Author:
+ * Versions: 1.0
+ * Description: host loopback platform for the tools. a virtual clock and
+ *              event queue drive the framework's tcp, timer and storage
+ *              interfaces, the tcp peer is a tool in the same process. the
+ *              link adds a fixed round trip time and seeded segment loss, so
+ *              every run with the same options gives the same result.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#ifndef _LOOP_PLATFORM_H_
+#define _LOOP_PLATFORM_H_
+
+#include <stdint.h>
+
+typedef void (*loop_event_cb)(void *arg, const uint8_t *data, uint16_t length);
+
+// callbacks of the in-process tcp peer.
+struct loop_peer
+{
+    void (*connected)(void);
+    void (*recv)(const uint8_t *data, uint16_t length);
+};
+
+struct loop_link
+{
+    uint32_t rtt_us;            // round trip time.
+    uint32_t loss_permille;     // chance a segment is lost and resent.
+    uint32_t rto_us;            // delay before a lost segment is resent.
+    uint16_t mss;               // segments released together are merged up to this size.
+};
+
+/******************************************************************************
+ * FunctionName : loop_init
+ * Description  : reset the clock and the event queue, seed the link loss.
+ * Parameters   : link: the link model.
+ *                peer: the callbacks of the tcp peer.
+ *                seed: random seed.
+ * Returns      : none.
+*******************************************************************************/
+void loop_init(const struct loop_link *link, const struct loop_peer *peer, uint32_t seed);
+
+/******************************************************************************
+ * FunctionName : loop_now
+ * Description  : the virtual clock.
+ * Parameters   : none.
+ * Returns      : microseconds since loop_init.
+*******************************************************************************/
+uint64_t loop_now(void);
+
+/******************************************************************************
+ * FunctionName : loop_schedule
+ * Description  : run a callback at a virtual time, events at the same time run
+ *                in the order they were scheduled.
+ * Parameters   : at: the virtual time in microseconds.
+ *                cb: the callback.
+ *                arg: passed to cb.
+ *                data: copied and passed to cb, may be NULL.
+ *                length: bytes of data.
+ * Returns      : none.
+*******************************************************************************/
+void loop_schedule(uint64_t at, loop_event_cb cb, void *arg, const void *data, uint16_t length);
+
+/******************************************************************************
+ * FunctionName : loop_run
+ * Description  : run events in time order until the queue is empty or the next
+ *                event is later than end.
+ * Parameters   : end: virtual time to stop at.
+ * Returns      : none.
+*******************************************************************************/
+void loop_run(uint64_t end);
+
+/******************************************************************************
+ * FunctionName : loop_peer_send
+ * Description  : send bytes from the peer to the framework's tcp connection.
+ * Parameters   : data: the bytes.
+ *                length: byte count.
+ * Returns      : the virtual time the framework receives them, 0 if not connected.
+*******************************************************************************/
+uint64_t loop_peer_send(const uint8_t *data, uint16_t length);
+
+/******************************************************************************
+ * FunctionName : loop_data_set
+ * Description  : set a value returned by pando_data_get.
+ * Parameters   : key: the data name.
+ *                value: the value, copied.
+ * Returns      : none.
+*******************************************************************************/
+void loop_data_set(const char *key, const char *value);
+
+/******************************************************************************
+ * FunctionName : loop_rand
+ * Description  : the seeded random source of the loop.
+ * Parameters   : none.
+ * Returns      : a pseudo random number.
+*******************************************************************************/
+uint32_t loop_rand(void);
+
+/******************************************************************************
+ * FunctionName : loop_quiet
+ * Description  : silence the framework's console output, the tools print
+ *                their report after restoring it.
+ * Parameters   : quiet: 1 to send stdout to /dev/null, 0 to restore it.
+ * Returns      : none.
+*******************************************************************************/
+void loop_quiet(int quiet);
+
+#endif /* _LOOP_PLATFORM_H_ */
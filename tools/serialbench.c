@@ -0,0 +1,537 @@
+/*******************************************************
+ * File name: serialbench.c
+ * Author:
+ * Versions: 1.0
+ * Description: loopback test and throughput benchmark of the serial channel
+ *              transport. the gateway side sends packets to a sub device
+ *              through channel_send_to_subdevice over pando_serial, across a
+ *              pair of pipes or a pty in raw mode. the sub device side
+ *              decodes the frames, checks their crc and sends each packet
+ *              back in a frame of its own, to the device side of the channel.
+ *              the uart writes are handled like dma transfers: a burst is
+ *              written in the background and pando_serial_tx_done called
+ *              once all of it is out. every packet that comes back is checked
+ *              against the one sent, the sub device can corrupt a share of
+ *              its frames to exercise the crc check.
+ *              usage: serialbench [options], serialbench -h lists them.
+ *              exits with 1 if a packet was lost or came back wrong.
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gateway/pando_channel.h"
+#include "gateway/pando_serial.h"
+#include "lib/pando_cobs.h"
+#include "platform/include/pando_task.h"
+
+#define CHANNEL         PANDO_CHANNEL_PORT_2
+#define SEQ_LEN         4
+#define READ_SIZE       4096
+#define DRAIN_SECONDS   2.0
+
+struct options
+{
+    double duration;        // seconds of load.
+    uint32_t size;          // packet bytes.
+    uint32_t window;        // packets sent and not back yet.
+    uint32_t corrupt;       // per mille of the frames the sub device corrupts.
+    int pty;
+    int csv;
+};
+
+// one direction of the link, written without blocking.
+struct uart_tx
+{
+    int fd;
+    const uint8_t *data;
+    uint32_t length;
+    uint32_t written;
+};
+
+static struct options s_options;
+static struct uart_tx s_gateway_tx;
+
+// the sub device side.
+static struct uart_tx s_device_tx;
+static struct pando_cobs_decoder s_device_decoder;
+static uint8_t s_device_frame[PANDO_SERIAL_PACKET_MAX + PANDO_SERIAL_CRC_LEN];
+static uint8_t s_device_out[2][READ_SIZE * 2];
+static uint32_t s_device_fill;
+static uint8_t s_device_next;
+static uint32_t s_device_bad;
+static uint32_t s_corrupted;
+static uint32_t s_random = 1;
+
+// the packets.
+static uint32_t s_sent;
+static uint32_t s_dropped;
+static uint32_t s_delivered;
+static uint32_t s_mismatched;
+static int64_t s_last_seq = -1;
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// no channel queue is set up, the channel never posts its task.
+void
+pando_task_init(struct pd_task *task)
+{
+}
+
+void
+pando_task_post(struct pd_task *task)
+{
+}
+
+static uint32_t
+next_random(void)
+{
+    s_random ^= s_random << 13;
+    s_random ^= s_random >> 17;
+    s_random ^= s_random << 5;
+    return s_random;
+}
+
+// the packet of a sequence number, zeros included to exercise the framing.
+static void
+fill_packet(uint8_t *packet, uint32_t seq)
+{
+    uint32_t state = seq * 2654435761u + 1;
+    uint32_t i = 0;
+
+    packet[0] = seq >> 24;
+    packet[1] = seq >> 16;
+    packet[2] = seq >> 8;
+    packet[3] = seq;
+    for(i = SEQ_LEN; i < s_options.size; i++)
+    {
+        state = state * 1103515245u + 12345;
+        packet[i] = (state >> 16) % 8 == 0? 0: state >> 24;
+    }
+}
+
+static void
+set_nonblock(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+// 1 once the burst is out.
+static int
+uart_write(struct uart_tx *tx)
+{
+    ssize_t n = 0;
+
+    while(tx->written < tx->length)
+    {
+        n = write(tx->fd, tx->data + tx->written, tx->length - tx->written);
+        if(n < 0)
+        {
+            if(errno != EAGAIN && errno != EINTR)
+            {
+                perror("write");
+                exit(2);
+            }
+
+            return 0;
+        }
+
+        tx->written += n;
+    }
+
+    return 1;
+}
+
+static uint8_t
+gateway_write(const uint8_t *data, uint16_t length)
+{
+    s_gateway_tx.data = data;
+    s_gateway_tx.length = length;
+    s_gateway_tx.written = 0;
+    return PANDO_SERIAL_WRITE_PENDING;
+}
+
+static void
+gateway_poll_tx(void)
+{
+    if(s_gateway_tx.length > 0 && uart_write(&s_gateway_tx))
+    {
+        s_gateway_tx.length = 0;
+        pando_serial_tx_done(CHANNEL);
+    }
+}
+
+static void
+gateway_recv(uint8_t *buffer, uint16_t length)
+{
+    uint8_t expected[PANDO_SERIAL_PACKET_MAX];
+    uint32_t seq = 0;
+
+    if(length != s_options.size)
+    {
+        s_mismatched++;
+        return;
+    }
+
+    seq = (uint32_t)buffer[0] << 24 | (uint32_t)buffer[1] << 16 | buffer[2] << 8 | buffer[3];
+    fill_packet(expected, seq);
+    if((int64_t)seq <= s_last_seq || seq >= s_sent || memcmp(buffer, expected, length) != 0)
+    {
+        s_mismatched++;
+        return;
+    }
+
+    s_last_seq = seq;
+    s_delivered++;
+}
+
+static void
+device_echo(const uint8_t *packet, uint16_t length)
+{
+    struct pando_cobs_encoder encoder;
+    uint8_t frame[PANDO_SERIAL_PACKET_MAX + PANDO_SERIAL_CRC_LEN];
+    uint16_t crc = pando_crc16(0xffff, packet, length);
+
+    if(s_device_fill + PANDO_COBS_MAX(sizeof(frame)) > sizeof(s_device_out[0]))
+    {
+        fprintf(stderr, "sub device output full\n");
+        exit(2);
+    }
+
+    memcpy(frame, packet, length);
+    frame[length] = crc >> 8;
+    frame[length + 1] = crc & 0xff;
+    if(next_random() % 1000 < s_options.corrupt)
+    {
+        // the crc catches any one byte changed.
+        frame[next_random() % length] ^= 0x5a;
+        s_corrupted++;
+    }
+
+    pando_cobs_encode_begin(&encoder, s_device_out[s_device_next] + s_device_fill);
+    pando_cobs_encode_put(&encoder, frame, length + PANDO_SERIAL_CRC_LEN);
+    s_device_fill += pando_cobs_encode_end(&encoder);
+}
+
+static void
+device_input(const uint8_t *data, uint32_t length)
+{
+    uint16_t used = 0;
+    uint16_t frame_length = 0;
+
+    while(length > 0)
+    {
+        used = pando_cobs_decode(&s_device_decoder, data, length, &frame_length);
+        data += used;
+        length -= used;
+        if(frame_length == 0)
+        {
+            continue;
+        }
+
+        if(frame_length <= PANDO_SERIAL_CRC_LEN || pando_crc16(0xffff, s_device_frame, frame_length) != 0)
+        {
+            s_device_bad++;
+            continue;
+        }
+
+        device_echo(s_device_frame, frame_length - PANDO_SERIAL_CRC_LEN);
+    }
+}
+
+static void
+device_poll_tx(void)
+{
+    if(s_device_tx.length > 0 && !uart_write(&s_device_tx))
+    {
+        return;
+    }
+
+    s_device_tx.length = 0;
+    if(s_device_fill > 0)
+    {
+        s_device_tx.data = s_device_out[s_device_next];
+        s_device_tx.length = s_device_fill;
+        s_device_tx.written = 0;
+        s_device_next ^= 1;
+        s_device_fill = 0;
+        uart_write(&s_device_tx);
+    }
+}
+
+// 0 if the fd had nothing to read.
+static int
+read_into(int fd, int device)
+{
+    uint8_t data[READ_SIZE];
+    ssize_t n = read(fd, data, sizeof(data));
+
+    if(n <= 0)
+    {
+        if(n < 0 && errno != EAGAIN && errno != EINTR && errno != EIO)
+        {
+            perror("read");
+            exit(2);
+        }
+
+        return 0;
+    }
+
+    if(device)
+    {
+        device_input(data, n);
+    }
+    else
+    {
+        pando_serial_input(CHANNEL, data, n);
+    }
+
+    return 1;
+}
+
+static uint32_t
+outstanding(void)
+{
+    return s_sent - s_dropped - s_delivered - s_mismatched - s_corrupted;
+}
+
+static void
+send_packets(void)
+{
+    uint8_t packet[PANDO_SERIAL_PACKET_MAX];
+    struct pando_serial_stats stats;
+    uint32_t dropped = 0;
+
+    while(outstanding() < s_options.window)
+    {
+        pando_serial_get_stats(CHANNEL, &stats);
+        dropped = stats.tx_dropped;
+        fill_packet(packet, s_sent++);
+        channel_send_to_subdevice(CHANNEL, packet, s_options.size);
+        pando_serial_get_stats(CHANNEL, &stats);
+        if(stats.tx_dropped != dropped)
+        {
+            // both buffers are full, wait for the uart.
+            s_dropped++;
+            break;
+        }
+    }
+}
+
+static void
+usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  -d seconds   load duration, default 5\n"
+        "  -s bytes     packet size, %d to %d, default 64\n"
+        "  -w packets   packets in flight, default 16\n"
+        "  -e permille  frames the sub device corrupts, default 0\n"
+        "  -t           run over a pty instead of pipes\n"
+        "  -c           csv report\n", name, SEQ_LEN, PANDO_SERIAL_PACKET_MAX);
+}
+
+static void
+report(double seconds)
+{
+    struct pando_serial_stats stats;
+    double packets = s_delivered / seconds;
+
+    pando_serial_get_stats(CHANNEL, &stats);
+    if(s_options.csv)
+    {
+        printf("link,size,seconds,sent,dropped,delivered,corrupted,mismatched,rx_errors,"
+            "packets_per_sec,payload_bytes_per_sec,wire_bytes_per_sec,frames_per_burst\n");
+        printf("%s,%u,%.3f,%u,%u,%u,%u,%u,%u,%.1f,%.1f,%.1f,%.2f\n", s_options.pty? "pty": "pipe",
+            s_options.size, seconds, s_sent, s_dropped, s_delivered, s_corrupted, s_mismatched,
+            stats.rx_errors, packets, packets * s_options.size,
+            (stats.tx_bytes + stats.rx_bytes) / seconds,
+            stats.tx_bursts? (double)stats.tx_frames / stats.tx_bursts: 0);
+        return;
+    }
+
+    printf("%s link, %u byte packets, %.3f s\n", s_options.pty? "pty": "pipe", s_options.size, seconds);
+    printf("sent %u, held back %u, delivered %u, corrupted %u, mismatched %u\n",
+        s_sent, s_dropped, s_delivered, s_corrupted, s_mismatched);
+    printf("round trips %.0f/s, payload %.2f MB/s each way\n", packets, packets * s_options.size / 1e6);
+    printf("frames %u in %u bursts, %.2f per burst, %.2f%% framing overhead\n",
+        stats.tx_frames, stats.tx_bursts, stats.tx_bursts? (double)stats.tx_frames / stats.tx_bursts: 0,
+        stats.tx_frames? 100.0 * stats.tx_bytes / ((double)stats.tx_frames * s_options.size) - 100: 0);
+    printf("gateway rx errors %u, sub device rx errors %u\n", stats.rx_errors,
+        s_device_bad + s_device_decoder.errors);
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct pando_serial_stats stats;
+    struct pollfd fds[2];
+    struct termios raw;
+    int gateway_rx = -1;
+    int device_rx = -1;
+    int to_device[2];
+    int to_gateway[2];
+    double start = 0;
+    double end = 0;
+    double drain_end = 0;
+    int i = 0;
+
+    s_options.duration = 5;
+    s_options.size = 64;
+    s_options.window = 16;
+
+    for(i = 1; i < argc; i++)
+    {
+        const char *value = i + 1 < argc? argv[i + 1]: NULL;
+
+        if(strcmp(argv[i], "-c") == 0)
+        {
+            s_options.csv = 1;
+            continue;
+        }
+
+        if(strcmp(argv[i], "-t") == 0)
+        {
+            s_options.pty = 1;
+            continue;
+        }
+
+        if(value == NULL || argv[i][0] != '-' || strlen(argv[i]) != 2)
+        {
+            usage(argv[0]);
+            return 2;
+        }
+
+        switch(argv[i][1])
+        {
+            case 'd': s_options.duration = atof(value); break;
+            case 's': s_options.size = atoi(value); break;
+            case 'w': s_options.window = atoi(value); break;
+            case 'e': s_options.corrupt = atoi(value); break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+
+        i++;
+    }
+
+    if(s_options.duration <= 0 || s_options.size < SEQ_LEN || s_options.size > PANDO_SERIAL_PACKET_MAX
+        || s_options.window == 0 || s_options.corrupt > 1000)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if(s_options.pty)
+    {
+        // the master end is the gateway's uart, the slave the sub device's.
+        if(openpty(&to_device[1], &to_device[0], NULL, NULL, NULL) != 0)
+        {
+            perror("openpty");
+            return 2;
+        }
+
+        tcgetattr(to_device[0], &raw);
+        cfmakeraw(&raw);
+        tcsetattr(to_device[0], TCSANOW, &raw);
+        gateway_rx = to_device[1];
+        device_rx = to_device[0];
+        s_gateway_tx.fd = to_device[1];
+        s_device_tx.fd = to_device[0];
+    }
+    else
+    {
+        if(pipe(to_device) != 0 || pipe(to_gateway) != 0)
+        {
+            perror("pipe");
+            return 2;
+        }
+
+        gateway_rx = to_gateway[0];
+        device_rx = to_device[0];
+        s_gateway_tx.fd = to_device[1];
+        s_device_tx.fd = to_gateway[1];
+    }
+
+    set_nonblock(gateway_rx);
+    set_nonblock(device_rx);
+    set_nonblock(s_gateway_tx.fd);
+    set_nonblock(s_device_tx.fd);
+
+    pando_cobs_decoder_init(&s_device_decoder, s_device_frame, sizeof(s_device_frame));
+    pando_serial_attach(CHANNEL, gateway_write);
+    on_device_channel_recv(CHANNEL, gateway_recv);
+
+    start = now();
+    end = start + s_options.duration;
+    drain_end = end + DRAIN_SECONDS;
+    for(;;)
+    {
+        double t = now();
+
+        if(t < end)
+        {
+            send_packets();
+        }
+        else if(outstanding() == 0 || t >= drain_end)
+        {
+            break;
+        }
+
+        gateway_poll_tx();
+        device_poll_tx();
+
+        fds[0].fd = gateway_rx;
+        fds[0].events = POLLIN;
+        fds[1].fd = device_rx;
+        fds[1].events = POLLIN;
+        if(poll(fds, 2, 10) <= 0)
+        {
+            continue;
+        }
+
+        if(fds[0].revents & POLLIN)
+        {
+            read_into(gateway_rx, 0);
+        }
+
+        if(fds[1].revents & POLLIN)
+        {
+            read_into(device_rx, 1);
+        }
+    }
+
+    report(now() - start);
+
+    pando_serial_get_stats(CHANNEL, &stats);
+    if(outstanding() != 0 || s_mismatched != 0 || s_device_bad != 0
+        || stats.rx_errors != s_corrupted || stats.rx_frames != s_delivered)
+    {
+        fprintf(stderr, "serial loopback failed: %u packets not back, %u wrong\n",
+            outstanding(), s_mismatched);
+        return 1;
+    }
+
+    return 0;
+}
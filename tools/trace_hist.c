@@ -0,0 +1,324 @@
+/*******************************************************
+ * File name: trace_hist.c
+ * Author:
+ * Versions: 1.0
+ * Description: host tool, reads the PDTRACE blocks printed by pando_trace_dump()
+ *              from a serial capture and prints a latency histogram per stage
+ *              and for the end to end paths.
+ *              usage: trace_hist [-f cycles_per_second] < capture.log
+ * History:
+ *   1.Date:
+ *     Author:
+ *     Modification:
+ *********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "platform/include/pando_trace.h"
+
+#define HIST_BUCKETS    24
+
+// same order as PD_TRACE_ID.
+static const char *s_stage_name[PD_TRACE_ID_NUM] =
+{
+    "mqtt_recv",
+    "mqtt_data_cb",
+    "protocol_decode",
+    "channel_to_subdevice",
+    "subdevice_recv",
+    "object_unpack",
+    "channel_to_device",
+    "publish",
+    "protocol_encode",
+    "mqtt_publish",
+    "tcp_send"
+};
+
+struct latency_set
+{
+    const char *name;
+    double *samples;        // microseconds.
+    size_t count;
+    size_t size;
+};
+
+// an end to end path, from the begin of one stage to an event of another.
+struct latency_path
+{
+    const char *name;
+    uint8_t from_id;
+    uint8_t to_id;
+    uint8_t to_event;
+    int pending;
+    uint32_t from_cycles;
+    struct latency_set set;
+};
+
+static struct latency_set s_stage[PD_TRACE_ID_NUM];
+static int s_stage_pending[PD_TRACE_ID_NUM];
+static uint32_t s_stage_begin[PD_TRACE_ID_NUM];
+
+static struct latency_path s_path[] =
+{
+    {"downlink: mqtt_recv -> object_unpack", PD_TRACE_MQTT_RECV, PD_TRACE_OBJECT_UNPACK, PD_TRACE_EVENT_BEGIN},
+    {"uplink: publish -> tcp_send", PD_TRACE_PUBLISH, PD_TRACE_TCP_SEND, PD_TRACE_EVENT_END}
+};
+
+#define PATH_NUM    (sizeof(s_path) / sizeof(s_path[0]))
+
+static void
+set_add(struct latency_set *set, double us)
+{
+    if(set->count == set->size)
+    {
+        set->size = set->size? set->size * 2: 64;
+        set->samples = (double *)realloc(set->samples, set->size * sizeof(double));
+        if(set->samples == NULL)
+        {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+
+    set->samples[set->count++] = us;
+}
+
+static int
+compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static double
+percentile(const struct latency_set *set, int pct)
+{
+    size_t index = (set->count * pct + 99) / 100;
+
+    return set->samples[index? index - 1: 0];
+}
+
+// bucket 0 holds samples below 1us, bucket n holds [2^(n-1), 2^n) us.
+static int
+bucket_of(double us)
+{
+    int bucket = 0;
+
+    while(us >= 1.0 && bucket < HIST_BUCKETS - 1)
+    {
+        us /= 2;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+static void
+set_print(struct latency_set *set)
+{
+    size_t hist[HIST_BUCKETS];
+    size_t peak = 0;
+    double sum = 0;
+    size_t i = 0;
+    int b = 0;
+    int last = 0;
+
+    if(set->count == 0)
+    {
+        return;
+    }
+
+    qsort(set->samples, set->count, sizeof(double), compare_double);
+    memset(hist, 0, sizeof(hist));
+    for(i = 0; i < set->count; i++)
+    {
+        sum += set->samples[i];
+        hist[bucket_of(set->samples[i])]++;
+    }
+
+    printf("%s\n", set->name);
+    printf("  count %zu  min %.1f  mean %.1f  p50 %.1f  p90 %.1f  p99 %.1f  max %.1f us\n",
+        set->count, set->samples[0], sum / set->count, percentile(set, 50),
+        percentile(set, 90), percentile(set, 99), set->samples[set->count - 1]);
+
+    for(b = 0; b < HIST_BUCKETS; b++)
+    {
+        if(hist[b] > peak)
+        {
+            peak = hist[b];
+        }
+
+        if(hist[b] > 0)
+        {
+            last = b;
+        }
+    }
+
+    for(b = bucket_of(set->samples[0]); b <= last; b++)
+    {
+        int width = (int)(hist[b] * 40 / peak);
+
+        if(b == 0)
+        {
+            printf("  %8s..%-8u|", "0", 1u);
+        }
+        else
+        {
+            printf("  %8u..%-8u|", 1u << (b - 1), 1u << b);
+        }
+
+        while(width-- > 0)
+        {
+            putchar('#');
+        }
+
+        printf(" %zu\n", hist[b]);
+    }
+}
+
+static void
+reset_pending(void)
+{
+    size_t i = 0;
+
+    memset(s_stage_pending, 0, sizeof(s_stage_pending));
+    for(i = 0; i < PATH_NUM; i++)
+    {
+        s_path[i].pending = 0;
+    }
+}
+
+static void
+handle_record(unsigned id, unsigned event, uint32_t cycles, double freq)
+{
+    size_t i = 0;
+
+    if(id >= PD_TRACE_ID_NUM)
+    {
+        return;
+    }
+
+    // unsigned subtraction handles one wrap of the 32 bit counter.
+    if(event == PD_TRACE_EVENT_BEGIN)
+    {
+        s_stage_pending[id] = 1;
+        s_stage_begin[id] = cycles;
+    }
+    else if(s_stage_pending[id])
+    {
+        set_add(&s_stage[id], (uint32_t)(cycles - s_stage_begin[id]) * 1e6 / freq);
+        s_stage_pending[id] = 0;
+    }
+
+    for(i = 0; i < PATH_NUM; i++)
+    {
+        struct latency_path *path = &s_path[i];
+
+        if(path->pending && id == path->to_id && event == path->to_event)
+        {
+            set_add(&path->set, (uint32_t)(cycles - path->from_cycles) * 1e6 / freq);
+            path->pending = 0;
+        }
+
+        if(id == path->from_id && event == PD_TRACE_EVENT_BEGIN)
+        {
+            path->pending = 1;
+            path->from_cycles = cycles;
+        }
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    char line[256];
+    double freq = 0;
+    double freq_override = 0;
+    int in_block = 0;
+    unsigned long records = 0;
+    unsigned long lost = 0;
+    size_t i = 0;
+
+    if(argc == 3 && strcmp(argv[1], "-f") == 0)
+    {
+        freq_override = atof(argv[2]);
+    }
+    else if(argc != 1)
+    {
+        fprintf(stderr, "usage: %s [-f cycles_per_second] < capture.log\n", argv[0]);
+        return 2;
+    }
+
+    for(i = 0; i < PD_TRACE_ID_NUM; i++)
+    {
+        s_stage[i].name = s_stage_name[i];
+    }
+
+    for(i = 0; i < PATH_NUM; i++)
+    {
+        s_path[i].set.name = s_path[i].name;
+    }
+
+    while(fgets(line, sizeof(line), stdin) != NULL)
+    {
+        char *p = strstr(line, "PDTRACE ");
+        unsigned id = 0;
+        unsigned event = 0;
+        unsigned long cycles = 0;
+        unsigned arg = 0;
+        unsigned long block_freq = 0;
+        unsigned long block_lost = 0;
+
+        if(p != NULL)
+        {
+            if(sscanf(p, "PDTRACE BEGIN %lu %lu", &block_freq, &block_lost) == 2)
+            {
+                in_block = 1;
+                freq = freq_override > 0? freq_override: (double)block_freq;
+                lost += block_lost;
+                if(block_lost > 0)
+                {
+                    // records are missing, an open begin may pair with the wrong end.
+                    reset_pending();
+                }
+            }
+            else if(strncmp(p, "PDTRACE END", 11) == 0)
+            {
+                in_block = 0;
+            }
+
+            continue;
+        }
+
+        if(!in_block || freq <= 0)
+        {
+            continue;
+        }
+
+        if(sscanf(line, "%u %u %lu %u", &id, &event, &cycles, &arg) == 4)
+        {
+            handle_record(id, event, (uint32_t)cycles, freq);
+            records++;
+        }
+    }
+
+    printf("records %lu, lost %lu, %.0f cycles per second\n\n", records, lost, freq);
+
+    for(i = 0; i < PD_TRACE_ID_NUM; i++)
+    {
+        set_print(&s_stage[i]);
+    }
+
+    printf("\n");
+    for(i = 0; i < PATH_NUM; i++)
+    {
+        set_print(&s_path[i].set);
+    }
+
+    return 0;
+}